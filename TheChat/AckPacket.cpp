@@ -0,0 +1,9 @@
+#include "AckPacket.h"
+
+
+AckPacket::AckPacket(uint32_t ackSequence)
+	: header()
+	, ackSequence(ackSequence)
+{
+	header.tableId = GetTableID();
+}
\ No newline at end of file
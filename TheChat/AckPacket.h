@@ -0,0 +1,27 @@
+#pragma once
+
+#include <cstdint>
+
+#include "ChatPacket.h"
+#include "ChatSchema.h"
+#include "ChatTableID.h"
+
+
+// Cumulative acknowledgement: every sequenced packet up to ackSequence has been received.
+class AckPacket final
+{
+public:
+	static constexpr EChatTableID GetTableID() { return EChatTableID::ACK_TABLE; }
+	static constexpr auto GetFields() { return ChatSchema::Fields(&AckPacket::ackSequence); }
+
+public:
+	ChatPacket::Header header;
+	uint32_t ackSequence;
+
+	AckPacket(uint32_t ackSequence = 0);
+	~AckPacket() = default;
+
+	inline auto GetAckSequence() const { return ackSequence; }
+};
+
+static_assert(ChatSchema::MaxSize<AckPacket>() <= ChatPacket::PAYLOAD_SIZE, "AckPacket size overflow.");
\ No newline at end of file
@@ -0,0 +1,1245 @@
+#include "ChatBenchmark.h"
+
+#include <algorithm>
+#include <cctype>
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+#include <random>
+#include <iostream>
+#include <thread>
+#include <memory>
+#include <string>
+#include <vector>
+
+#define WIN32_LEAN_AND_MEAN
+
+#include <windows.h>
+#include <psapi.h>
+#include <ws2tcpip.h>
+
+#include "ChatClientCore.h"
+#include "ChatClientLoop.h"
+#include "ChatConnection.h"
+#include "ChatConstant.h"
+#include "ChatContentFilter.h"
+#include "ChatFanOutPool.h"
+#include "ChatHistogram.h"
+#include "ChatHistory.h"
+#include "ChatIdTable.h"
+#include "ChatRoomRing.h"
+#include "ChatSearchIndex.h"
+#include "ChatTracer.h"
+#include "GreetingsPacket.h"
+#include "MessageBatchPacket.h"
+#include "MessagePacket.h"
+#include "Network.h"
+#include "PrivateMessagePacket.h"
+
+
+using namespace std;
+
+namespace
+{
+	using TConnections = vector<unique_ptr<ChatConnection>>;
+
+	bool SplitAddress(const string& node, string& address, string& port)
+	{
+		const auto pos = node.rfind(':');
+		if (pos == string::npos)
+			return false;
+
+		address = node.substr(0, pos);
+		port = node.substr(pos + 1);
+
+		return true;
+	}
+
+	int64_t NowMicroseconds()
+	{
+		const auto now = chrono::steady_clock::now().time_since_epoch();
+		return chrono::duration_cast<chrono::microseconds>(now).count();
+	}
+
+	// MessagePacket as it was before the schema layer: overlaid on the frame and filled one character at a time.
+	struct LegacyMessagePacket
+	{
+		ChatPacket::Header header;
+		char senderId[ChatConstant::ID_LENGTH + 1];
+		char message[MessagePacket::MESSAGE_LENGTH + 1];
+	};
+
+	static_assert(sizeof(LegacyMessagePacket) <= sizeof(ChatPacket), "LegacyMessagePacket size overflow.");
+
+	void EncodeLegacy(ChatPacket& packet, const string& senderId, const string& text)
+	{
+		auto& message = reinterpret_cast<LegacyMessagePacket&>(packet);
+		message.header.tableId = EChatTableID::MESSAGE_TABLE;
+
+		const int senderLength = std::min<int>(static_cast<int>(senderId.size()), ChatConstant::ID_LENGTH);
+		int i = 0;
+		for (; i < senderLength; ++i)
+		{
+			message.senderId[i] = senderId.at(i);
+		}
+		message.senderId[i] = '\0';
+
+		const int textLength = std::min<int>(static_cast<int>(text.size()), MessagePacket::MESSAGE_LENGTH);
+		for (i = 0; i < textLength; ++i)
+		{
+			message.message[i] = text.at(i);
+		}
+		message.message[i] = '\0';
+	}
+
+	unique_ptr<ChatConnection> Greet(Network::TSocket socket, int index)
+	{
+		auto client = make_unique<ChatConnection>(socket);
+		client->SetID("Server");
+
+		GreetingsPacket greetings(string("bench") + to_string(index));
+		client->RequestSend(ChatPacket::Encode(greetings));
+		client->FlushSendRequests();
+
+		return client;
+	}
+
+	TConnections ConnectClients(const vector<string>& nodes, int numClients)
+	{
+		TConnections clients;
+		clients.reserve(numClients);
+
+		for (int i = 0; i < numClients; ++i)
+		{
+			string address;
+			string port;
+
+			if (!SplitAddress(nodes[i % nodes.size()], address, port))
+			{
+				cerr << "[ChatBenchmark] invalid node address " << nodes[i % nodes.size()] << endl;
+				break;
+			}
+
+			auto socket = Network::Connect(address.c_str(), port.c_str());
+			if (socket == INVALID_SOCKET)
+			{
+				cerr << "[ChatBenchmark] failed to connect to " << address << ':' << port << endl;
+				break;
+			}
+
+			clients.emplace_back(Greet(socket, i));
+		}
+
+		return clients;
+	}
+
+	TConnections ConnectLocalClients(const string& path, int numClients, bool useSharedRing)
+	{
+		TConnections clients;
+
+		for (int i = 0; i < numClients; ++i)
+		{
+			auto socket = Network::ConnectLocal(path.c_str());
+			if (socket == INVALID_SOCKET)
+				break;
+
+			auto client = Greet(socket, i);
+
+			if (useSharedRing)
+			{
+				const auto ringName = string("Local\\TheChat.bench.") + to_string(GetCurrentProcessId()) + '.' + to_string(i);
+				if (!client->RequestSharedRing(ringName, ChatConstant::SHARED_RING_CAPACITY))
+					break;
+
+				client->FlushSendRequests();
+			}
+
+			clients.emplace_back(move(client));
+		}
+
+		return clients;
+	}
+
+	// Polls every client once; returns the number of messages delivered.
+	uint64_t PumpClients(TConnections& clients, vector<WSAPOLLFD>& pollFds, int timeout, ChatHistogram& latency)
+	{
+		pollFds.resize(clients.size());
+
+		for (size_t i = 0; i < clients.size(); ++i)
+		{
+			pollFds[i].fd = clients[i]->GetSocket();
+			pollFds[i].events = POLLRDNORM;
+			pollFds[i].revents = 0;
+		}
+
+		uint64_t numDelivered = 0;
+
+		auto recordDelivery = [&numDelivered, &latency](const char* text)
+			{
+				const auto sentTime = strtoll(text, nullptr, 10);
+				latency.Record(static_cast<uint64_t>(max<int64_t>(NowMicroseconds() - sentTime, 0)));
+
+				++numDelivered;
+			};
+
+		int count = WSAPoll(pollFds.data(), static_cast<u_long>(pollFds.size()), timeout);
+		if (count == SOCKET_ERROR)
+		{
+			cerr << "[ChatBenchmark] WSAPoll failed, error = " << WSAGetLastError() << endl;
+			return 0;
+		}
+
+		for (size_t i = 0; i < clients.size(); ++i)
+		{
+			auto& client = *clients[i];
+
+			if (pollFds[i].revents != 0)
+			{
+				client.Receive();
+
+				for (auto& packet : client.ExtractReceived())
+				{
+					if (packet.header.tableId == EChatTableID::MESSAGE_TABLE)
+					{
+						MessagePacket message;
+						if (packet.Decode(message))
+						{
+							recordDelivery(message.GetMessage());
+						}
+					}
+					else if (packet.header.tableId == EChatTableID::MESSAGE_BATCH_TABLE)
+					{
+						MessageBatchPacket batch;
+						if (packet.Decode(batch))
+						{
+							batch.ForEach([&recordDelivery](uint32_t, const string& message)
+								{
+									recordDelivery(message.c_str());
+								});
+						}
+					}
+					else if (packet.header.tableId == EChatTableID::PRIVATE_MESSAGE_TABLE)
+					{
+						PrivateMessagePacket message;
+						if (packet.Decode(message))
+						{
+							recordDelivery(message.GetMessage());
+						}
+					}
+				}
+			}
+
+			client.FlushSendRequests();
+		}
+
+		return numDelivered;
+	}
+
+	uint64_t WaitForDeliveries(TConnections& clients, vector<WSAPOLLFD>& pollFds, uint64_t numDelivered,
+		uint64_t numExpected, ChatHistogram& latency)
+	{
+		auto lastProgress = chrono::steady_clock::now();
+
+		while (numDelivered < numExpected)
+		{
+			const auto delivered = PumpClients(clients, pollFds, 100, latency);
+			numDelivered += delivered;
+
+			const auto currentTime = chrono::steady_clock::now();
+			if (delivered > 0)
+			{
+				lastProgress = currentTime;
+				continue;
+			}
+
+			if (currentTime - lastProgress > chrono::seconds(5))
+			{
+				cerr << "[ChatBenchmark] stalled, " << (numExpected - numDelivered) << " deliveries missing." << endl;
+				break;
+			}
+		}
+
+		return numDelivered;
+	}
+
+	void Settle(TConnections& clients, vector<WSAPOLLFD>& pollFds, ChatHistogram& latency)
+	{
+		const auto settleTime = chrono::steady_clock::now() + chrono::seconds(1);
+		while (chrono::steady_clock::now() < settleTime)
+		{
+			PumpClients(clients, pollFds, 10, latency);
+		}
+
+		latency.Reset();
+	}
+}
+
+void ChatBenchmark::RunClusterFanOut(const vector<string>& nodes, int numClients, int numMessages)
+{
+	if (nodes.empty() || numClients < 2 || numMessages < 1)
+	{
+		cerr << "[ChatBenchmark] needs at least one node, two clients and one message." << endl;
+		return;
+	}
+
+	auto clients = ConnectClients(nodes, numClients);
+	if (clients.size() != static_cast<size_t>(numClients))
+		return;
+
+	cout << "[ChatBenchmark] " << numClients << " clients connected to " << nodes.size() << " node(s)." << endl;
+
+	ChatHistogram latency;
+	vector<WSAPOLLFD> pollFds;
+
+	// Give greetings and cluster presence time to settle before measuring.
+	Settle(clients, pollFds, latency);
+
+	const uint64_t numExpected = uint64_t(numClients) * (numClients - 1) * numMessages;
+	uint64_t numDelivered = 0;
+
+	const auto startTime = chrono::steady_clock::now();
+
+	for (int i = 0; i < numMessages; ++i)
+	{
+		for (int clientIndex = 0; clientIndex < numClients; ++clientIndex)
+		{
+			MessagePacket message;
+			message.SetMessage(to_string(NowMicroseconds()));
+
+			clients[clientIndex]->RequestSend(ChatPacket::Encode(message));
+		}
+
+		numDelivered += PumpClients(clients, pollFds, 0, latency);
+	}
+
+	numDelivered = WaitForDeliveries(clients, pollFds, numDelivered, numExpected, latency);
+
+	const auto elapsed = chrono::duration<double>(chrono::steady_clock::now() - startTime).count();
+
+	cout << "[ChatBenchmark] cluster fan-out: nodes = " << nodes.size()
+		<< ", clients = " << numClients
+		<< ", sent = " << uint64_t(numClients) * numMessages
+		<< ", delivered = " << numDelivered << '/' << numExpected
+		<< ", elapsed = " << elapsed << "s"
+		<< ", deliveries/s = " << static_cast<uint64_t>(numDelivered / max(elapsed, 1e-9)) << endl;
+
+	latency.Report(cout, "end-to-end latency");
+}
+
+void ChatBenchmark::RunBots(const string& node, int numBots, int numMessages)
+{
+	string address;
+	string port;
+
+	if (!SplitAddress(node, address, port) || numBots < 2 || numMessages < 1)
+	{
+		cerr << "[ChatBenchmark] needs a node address, at least two bots and one message." << endl;
+		return;
+	}
+
+	ChatClientLoop loop;
+	vector<unique_ptr<ChatClientCore>> bots;
+	bots.reserve(numBots);
+
+	size_t numGreeted = 0;
+	uint64_t numDelivered = 0;
+
+	const auto connectStartTime = chrono::steady_clock::now();
+
+	for (int i = 0; i < numBots; ++i)
+	{
+		auto bot = make_unique<ChatClientCore>(string("bot") + to_string(i));
+		bot->SetConnectedHandler([&numGreeted]() { ++numGreeted; });
+		bot->SetMessageHandler([&numDelivered](const string&, const string&) { ++numDelivered; });
+
+		if (!bot->Connect(address.c_str(), port.c_str()))
+		{
+			cerr << "[ChatBenchmark] failed to connect to " << node << endl;
+			return;
+		}
+
+		loop.Add(*bot);
+		bots.emplace_back(move(bot));
+	}
+
+	auto lastProgress = chrono::steady_clock::now();
+	while (numGreeted < bots.size())
+	{
+		const auto greeted = numGreeted;
+		loop.RunOnce(chrono::milliseconds(100));
+
+		const auto currentTime = chrono::steady_clock::now();
+		if (numGreeted > greeted)
+		{
+			lastProgress = currentTime;
+		}
+		else if (currentTime - lastProgress > chrono::seconds(5))
+		{
+			cerr << "[ChatBenchmark] stalled, " << (bots.size() - numGreeted) << " bots not greeted." << endl;
+			return;
+		}
+	}
+
+	const auto connectElapsed = chrono::duration<double>(chrono::steady_clock::now() - connectStartTime).count();
+
+	cout << "[ChatBenchmark] " << numBots << " bots greeted on one loop in " << connectElapsed << "s" << endl;
+
+	// Presence of the last bots still has to reach the first ones.
+	const auto settleTime = chrono::steady_clock::now() + chrono::seconds(1);
+	while (chrono::steady_clock::now() < settleTime)
+	{
+		loop.RunOnce(chrono::milliseconds(10));
+	}
+
+	const uint64_t numExpected = uint64_t(numBots) * (numBots - 1) * numMessages;
+	numDelivered = 0;
+
+	const auto startTime = chrono::steady_clock::now();
+
+	for (int i = 0; i < numMessages; ++i)
+	{
+		for (auto& bot : bots)
+		{
+			bot->Send(to_string(i));
+		}
+
+		loop.RunOnce(chrono::milliseconds(0));
+	}
+
+	lastProgress = chrono::steady_clock::now();
+	while (numDelivered < numExpected)
+	{
+		const auto delivered = numDelivered;
+		loop.RunOnce(chrono::milliseconds(100));
+
+		const auto currentTime = chrono::steady_clock::now();
+		if (numDelivered > delivered)
+		{
+			lastProgress = currentTime;
+		}
+		else if (currentTime - lastProgress > chrono::seconds(5))
+		{
+			cerr << "[ChatBenchmark] stalled, " << (numExpected - numDelivered) << " deliveries missing." << endl;
+			break;
+		}
+	}
+
+	const auto elapsed = chrono::duration<double>(chrono::steady_clock::now() - startTime).count();
+
+	cout << "[ChatBenchmark] bots: bots = " << numBots
+		<< ", sent = " << uint64_t(numBots) * numMessages
+		<< ", delivered = " << numDelivered << '/' << numExpected
+		<< ", elapsed = " << elapsed << "s"
+		<< ", deliveries/s = " << static_cast<uint64_t>(numDelivered / max(elapsed, 1e-9)) << endl;
+}
+
+void ChatBenchmark::RunDirectVsBroadcast(const string& node, int numUsers, int numMessages)
+{
+	if (numUsers < 2 || numMessages < 1)
+	{
+		cerr << "[ChatBenchmark] needs at least two users and one message." << endl;
+		return;
+	}
+
+	auto clients = ConnectClients({ node }, numUsers);
+	if (clients.size() != static_cast<size_t>(numUsers))
+		return;
+
+	cout << "[ChatBenchmark] " << numUsers << " users connected to " << node << endl;
+
+	ChatHistogram latency;
+	vector<WSAPOLLFD> pollFds;
+	Settle(clients, pollFds, latency);
+
+	auto& sender = *clients.front();
+
+	auto report = [&latency](const char* name, uint64_t numDelivered, uint64_t numExpected, double elapsed, int numMessages)
+	{
+		cout << "[ChatBenchmark] " << name << ": messages = " << numMessages
+			<< ", delivered = " << numDelivered << '/' << numExpected
+			<< ", elapsed = " << elapsed << "s"
+			<< ", messages/s = " << static_cast<uint64_t>(numMessages / max(elapsed, 1e-9))
+			<< ", deliveries/s = " << static_cast<uint64_t>(numDelivered / max(elapsed, 1e-9)) << endl;
+
+		latency.Report(cout, name);
+		latency.Reset();
+	};
+
+	{
+		const auto startTime = chrono::steady_clock::now();
+		uint64_t numDelivered = 0;
+
+		for (int i = 0; i < numMessages; ++i)
+		{
+			PrivateMessagePacket message;
+			message.SetSenderID("bench0");
+			message.SetRecipientID(string("bench") + to_string(1 + i % (numUsers - 1)));
+			message.SetMessage(to_string(NowMicroseconds()));
+
+			sender.RequestSend(ChatPacket::Encode(message));
+			numDelivered += PumpClients(clients, pollFds, 0, latency);
+		}
+
+		numDelivered = WaitForDeliveries(clients, pollFds, numDelivered, numMessages, latency);
+
+		const auto elapsed = chrono::duration<double>(chrono::steady_clock::now() - startTime).count();
+		report("direct message", numDelivered, numMessages, elapsed, numMessages);
+	}
+
+	{
+		const auto startTime = chrono::steady_clock::now();
+		const uint64_t numExpected = uint64_t(numUsers - 1) * numMessages;
+		uint64_t numDelivered = 0;
+
+		for (int i = 0; i < numMessages; ++i)
+		{
+			MessagePacket message;
+			message.SetMessage(to_string(NowMicroseconds()));
+
+			sender.RequestSend(ChatPacket::Encode(message));
+			numDelivered += PumpClients(clients, pollFds, 0, latency);
+		}
+
+		numDelivered = WaitForDeliveries(clients, pollFds, numDelivered, numExpected, latency);
+
+		const auto elapsed = chrono::duration<double>(chrono::steady_clock::now() - startTime).count();
+		report("broadcast", numDelivered, numExpected, elapsed, numMessages);
+	}
+}
+
+void ChatBenchmark::RunLocalTransports(const string& node, const string& localPath, int numMessages)
+{
+	if (numMessages < 1)
+	{
+		cerr << "[ChatBenchmark] needs at least one message." << endl;
+		return;
+	}
+
+	auto measure = [numMessages](const char* name, TConnections clients)
+	{
+		if (clients.size() != 2)
+		{
+			cerr << "[ChatBenchmark] " << name << ": failed to connect two clients." << endl;
+			return;
+		}
+
+		ChatHistogram latency;
+		vector<WSAPOLLFD> pollFds;
+		Settle(clients, pollFds, latency);
+
+		uint64_t numDelivered = 0;
+		const auto startTime = chrono::steady_clock::now();
+
+		// One message in flight at a time, so the histogram shows the transport latency rather than queueing.
+		for (int i = 0; i < numMessages; ++i)
+		{
+			MessagePacket message;
+			message.SetMessage(to_string(NowMicroseconds()));
+
+			clients.front()->RequestSend(ChatPacket::Encode(message));
+			numDelivered = WaitForDeliveries(clients, pollFds, numDelivered, numDelivered + 1, latency);
+		}
+
+		const auto elapsed = chrono::duration<double>(chrono::steady_clock::now() - startTime).count();
+
+		cout << "[ChatBenchmark] " << name << ": messages = " << numMessages
+			<< ", delivered = " << numDelivered
+			<< ", elapsed = " << elapsed << "s" << endl;
+
+		latency.Report(cout, name);
+	};
+
+	measure("tcp", ConnectClients({ node }, 2));
+	measure("unix socket", ConnectLocalClients(localPath, 2, false));
+	measure("shared ring", ConnectLocalClients(localPath, 2, true));
+}
+
+void ChatBenchmark::RunContentFilter(const string& patternPath, int numMessages)
+{
+	vector<string> patterns;
+	if (!ChatContentFilter::ReadPatterns(patternPath.c_str(), patterns) || patterns.empty() || numMessages < 1)
+	{
+		cerr << "[ChatBenchmark] needs a non-empty pattern file and at least one message." << endl;
+		return;
+	}
+
+	const auto buildStartTime = chrono::steady_clock::now();
+	ChatContentFilter filter(patterns);
+	const auto buildTime = chrono::duration<double>(chrono::steady_clock::now() - buildStartTime).count();
+
+	cout << "[ChatBenchmark] content filter: patterns = " << filter.GetNumPatterns()
+		<< ", states = " << filter.GetNumStates() << ", build = " << buildTime * 1000.0 << "ms" << endl;
+
+	// Ordinary chat text with a pattern planted in roughly every tenth message.
+	static const char* words[] = { "hello", "there", "how", "are", "you", "today", "see", "the", "new", "map", "lol", "gg" };
+	constexpr int NUM_SAMPLES = 1024;
+
+	mt19937 random(42);
+	vector<string> samples;
+	samples.reserve(NUM_SAMPLES);
+
+	for (int i = 0; i < NUM_SAMPLES; ++i)
+	{
+		string text;
+		while (text.size() < 60)
+		{
+			text += words[random() % size(words)];
+			text += ' ';
+		}
+
+		if (random() % 10 == 0)
+		{
+			text.insert(random() % text.size(), patterns[random() % patterns.size()]);
+		}
+
+		samples.emplace_back(text.substr(0, MessagePacket::MESSAGE_LENGTH));
+	}
+
+	char buffer[MessagePacket::MESSAGE_LENGTH + 1];
+	uint64_t numMatches = 0;
+
+	const auto filterStartTime = chrono::steady_clock::now();
+	for (int i = 0; i < numMessages; ++i)
+	{
+		auto& sample = samples[i % NUM_SAMPLES];
+		memcpy(buffer, sample.c_str(), sample.size() + 1);
+		numMatches += filter.Apply(buffer, sample.size());
+	}
+	const auto filterTime = chrono::duration<double>(chrono::steady_clock::now() - filterStartTime).count();
+
+	vector<string> loweredPatterns;
+	for (auto& pattern : patterns)
+	{
+		string lowered(pattern);
+		transform(lowered.begin(), lowered.end(), lowered.begin(), [](unsigned char ch) { return static_cast<char>(tolower(ch)); });
+		loweredPatterns.emplace_back(move(lowered));
+	}
+
+	uint64_t numNaiveMatches = 0;
+
+	const auto naiveStartTime = chrono::steady_clock::now();
+	for (int i = 0; i < numMessages; ++i)
+	{
+		string lowered(samples[i % NUM_SAMPLES]);
+		transform(lowered.begin(), lowered.end(), lowered.begin(), [](unsigned char ch) { return static_cast<char>(tolower(ch)); });
+
+		for (auto& pattern : loweredPatterns)
+		{
+			for (auto pos = lowered.find(pattern); pos != string::npos; pos = lowered.find(pattern, pos + 1))
+			{
+				++numNaiveMatches;
+			}
+		}
+	}
+	const auto naiveTime = chrono::duration<double>(chrono::steady_clock::now() - naiveStartTime).count();
+
+	auto report = [numMessages](const char* name, double elapsed, uint64_t matches)
+	{
+		cout << "[ChatBenchmark] " << name << ": messages = " << numMessages
+			<< ", matches = " << matches
+			<< ", ns/message = " << static_cast<uint64_t>(elapsed * 1e9 / numMessages)
+			<< ", messages/s = " << static_cast<uint64_t>(numMessages / max(elapsed, 1e-9)) << endl;
+	};
+
+	report("aho-corasick", filterTime, numMatches);
+	report("naive search", naiveTime, numNaiveMatches);
+}
+
+void ChatBenchmark::RunHistorySearch(int numMessages, int numQueries)
+{
+	if (numMessages < 1 || numQueries < 1)
+	{
+		cerr << "[ChatBenchmark] needs at least one message and one query." << endl;
+		return;
+	}
+
+	// Skewed vocabulary so a few words are everywhere and most are rare, like real chat.
+	constexpr int NUM_WORDS = 20000;
+	constexpr int NUM_SENDERS = 256;
+
+	vector<string> words;
+	words.reserve(NUM_WORDS);
+	for (int i = 0; i < NUM_WORDS; ++i)
+	{
+		words.emplace_back(string("w") + to_string(i));
+	}
+
+	mt19937 random(42);
+	auto pickWord = [&random, &words]()
+	{
+		// Cube of a uniform draw favours low ranks.
+		const auto draw = uniform_real_distribution<double>(0.0, 1.0)(random);
+		return words[static_cast<size_t>(draw * draw * draw * (words.size() - 1))];
+	};
+
+	ChatHistory history;
+	ChatSearchIndex index;
+	ChatSearchIndex::TSegments inputs;
+
+	const auto ingestStartTime = chrono::steady_clock::now();
+	for (int i = 0; i < numMessages; ++i)
+	{
+		string text;
+		const auto numTerms = 3 + random() % 10;
+		for (uint32_t j = 0; j < numTerms; ++j)
+		{
+			text += pickWord();
+			text += ' ';
+		}
+
+		const auto sender = string("user") + to_string(random() % NUM_SENDERS);
+		const auto number = history.Append(sender, text);
+		index.Add(number, sender, text);
+
+		// The server merges on a worker; inline is enough to keep the segment count realistic here.
+		while (index.PlanMerge(inputs))
+		{
+			index.CompleteMerge(inputs, ChatSearchIndex::Merge(inputs));
+		}
+	}
+	const auto ingestTime = chrono::duration<double>(chrono::steady_clock::now() - ingestStartTime).count();
+
+	cout << "[ChatBenchmark] history: messages = " << history.GetNumMessages()
+		<< ", history bytes = " << history.GetNumBytes()
+		<< ", index bytes = " << index.GetNumBytes()
+		<< ", segments = " << index.GetNumSegments()
+		<< ", messages/s = " << static_cast<uint64_t>(numMessages / max(ingestTime, 1e-9)) << endl;
+
+	vector<ChatSearchIndex::Query> queries;
+	queries.reserve(numQueries);
+
+	for (int i = 0; i < numQueries; ++i)
+	{
+		string text = pickWord();
+		if (random() % 2 == 0)
+		{
+			text += ' ';
+			text += pickWord();
+		}
+
+		const auto sender = random() % 4 == 0 ? string("user") + to_string(random() % NUM_SENDERS) : string();
+		queries.emplace_back(ChatSearchIndex::MakeQuery(text, sender, 10));
+	}
+
+	ChatHistogram indexLatency;
+	uint64_t numHits = 0;
+
+	for (auto& query : queries)
+	{
+		const auto startTime = chrono::steady_clock::now();
+		numHits += index.Search(query).size();
+		indexLatency.Record(chrono::duration_cast<chrono::microseconds>(chrono::steady_clock::now() - startTime));
+	}
+
+	// The scan is what a history without an index would do: newest first until enough hits are found.
+	ChatHistogram scanLatency;
+	uint64_t numScanHits = 0;
+	const auto numScanQueries = min<size_t>(queries.size(), 100);
+
+	for (size_t i = 0; i < numScanQueries; ++i)
+	{
+		auto& query = queries[i];
+		const auto startTime = chrono::steady_clock::now();
+
+		size_t found = 0;
+		for (auto number = history.GetNumMessages(); number-- > 0 && found < query.maxResults;)
+		{
+			bool isMatch = true;
+			for (auto& key : query.keys)
+			{
+				if (key[0] == '@')
+				{
+					string sender(history.GetSender(number));
+					transform(sender.begin(), sender.end(), sender.begin(), [](unsigned char ch) { return static_cast<char>(tolower(ch)); });
+					isMatch = key.compare(1, string::npos, sender) == 0;
+				}
+				else
+				{
+					bool hasTerm = false;
+					ChatSearchIndex::Tokenize(history.GetText(number), [&hasTerm, &key](const string& term) { hasTerm |= term == key; });
+					isMatch = hasTerm;
+				}
+
+				if (!isMatch)
+					break;
+			}
+
+			found += isMatch;
+		}
+
+		numScanHits += found;
+		scanLatency.Record(chrono::duration_cast<chrono::microseconds>(chrono::steady_clock::now() - startTime));
+	}
+
+	cout << "[ChatBenchmark] index: queries = " << queries.size() << ", hits = " << numHits << endl;
+	indexLatency.Report(cout, "index query");
+	cout << "[ChatBenchmark] scan: queries = " << numScanQueries << ", hits = " << numScanHits << endl;
+	scanLatency.Report(cout, "scan query");
+}
+
+void ChatBenchmark::RunIdleConnections(int numConnections, const string& port)
+{
+	// A source address only has the ephemeral port range (16384 ports by default) to connect from,
+	// so each block of connections binds its own 127.0.0.x.
+	constexpr int CONNECTIONS_PER_ADDRESS = 16000;
+
+	char modulePath[MAX_PATH];
+	if (numConnections < 1 || GetModuleFileNameA(NULL, modulePath, MAX_PATH) == 0)
+	{
+		cerr << "[ChatBenchmark] needs at least one connection." << endl;
+		return;
+	}
+
+	string commandLine = string("\"") + modulePath + "\" server " + port + " --quiet";
+
+	STARTUPINFOA startupInfo;
+	ZeroMemory(&startupInfo, sizeof(startupInfo));
+	startupInfo.cb = sizeof(startupInfo);
+
+	PROCESS_INFORMATION server;
+	if (!CreateProcessA(NULL, &commandLine[0], NULL, NULL, FALSE, 0, NULL, NULL, &startupInfo, &server))
+	{
+		cerr << "[ChatBenchmark] failed to start the server, error = " << GetLastError() << endl;
+		return;
+	}
+
+	auto getServerMemory = [&server](PROCESS_MEMORY_COUNTERS_EX& counters)
+	{
+		ZeroMemory(&counters, sizeof(counters));
+		counters.cb = sizeof(counters);
+		return GetProcessMemoryInfo(server.hProcess, reinterpret_cast<PROCESS_MEMORY_COUNTERS*>(&counters), sizeof(counters)) != FALSE;
+	};
+
+	TConnections clients;
+	clients.reserve(numConnections);
+
+	ChatTrafficStats clientStats;
+	vector<WSAPOLLFD> pollFds;
+	ChatHistogram latency;
+
+	auto addClient = [&clients, &clientStats](Network::TSocket socket)
+	{
+		auto client = make_unique<ChatConnection>(socket);
+		client->SetTrafficStats(&clientStats);
+		clients.emplace_back(move(client));
+	};
+
+	// Idle clients only answer the server's pings, which is all the traffic this benchmark makes;
+	// the server backs its pings off while they stay idle.
+	auto answerPings = [&clients, &pollFds, &latency]()
+	{
+		PumpClients(clients, pollFds, 0, latency);
+	};
+
+	auto probe = INVALID_SOCKET;
+	for (int i = 0; i < 50 && probe == INVALID_SOCKET; ++i)
+	{
+		this_thread::sleep_for(chrono::milliseconds(100));
+		probe = Network::Connect("127.0.0.1", port.c_str());
+	}
+
+	PROCESS_MEMORY_COUNTERS_EX baseline;
+	if (probe == INVALID_SOCKET || !getServerMemory(baseline))
+	{
+		cerr << "[ChatBenchmark] the server did not come up on port " << port << endl;
+		TerminateProcess(server.hProcess, 0);
+		CloseHandle(server.hThread);
+		CloseHandle(server.hProcess);
+		return;
+	}
+
+	addClient(probe);
+
+	const auto connectStartTime = chrono::steady_clock::now();
+	for (int i = 1; i < numConnections; ++i)
+	{
+		auto socket = ::socket(AF_INET, SOCK_STREAM, IPPROTO_TCP);
+		if (socket == INVALID_SOCKET)
+		{
+			cerr << "[ChatBenchmark] socket failed after " << clients.size() << " connections, error = " << WSAGetLastError() << endl;
+			break;
+		}
+
+#ifdef SO_PORT_SCALABILITY
+		// Lets the same ephemeral port be handed out again for each source address.
+		const DWORD scalable = 1;
+		setsockopt(socket, SOL_SOCKET, SO_PORT_SCALABILITY, reinterpret_cast<const char*>(&scalable), sizeof(scalable));
+#endif
+
+		struct sockaddr_in localAddr;
+		ZeroMemory(&localAddr, sizeof(localAddr));
+		localAddr.sin_family = AF_INET;
+		localAddr.sin_addr.s_addr = htonl(INADDR_LOOPBACK + static_cast<u_long>(i / CONNECTIONS_PER_ADDRESS));
+
+		if (bind(socket, (sockaddr*)(&localAddr), sizeof(localAddr)) == SOCKET_ERROR)
+		{
+			cerr << "[ChatBenchmark] bind failed after " << clients.size() << " connections, error = " << WSAGetLastError() << endl;
+			closesocket(socket);
+			break;
+		}
+
+		struct sockaddr_in sockAddr;
+		ZeroMemory(&sockAddr, sizeof(sockAddr));
+		sockAddr.sin_family = AF_INET;
+		sockAddr.sin_port = htons(static_cast<u_short>(atoi(port.c_str())));
+		sockAddr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+
+		if (connect(socket, (sockaddr*)(&sockAddr), sizeof(sockAddr)) == SOCKET_ERROR)
+		{
+			cerr << "[ChatBenchmark] connect failed after " << clients.size() << " connections, error = " << WSAGetLastError() << endl;
+			closesocket(socket);
+			break;
+		}
+
+		if (!Network::SetNonBlocking(socket))
+		{
+			closesocket(socket);
+			break;
+		}
+
+		addClient(socket);
+
+		if (clients.size() % 1000 == 0)
+		{
+			answerPings();
+		}
+
+		if (clients.size() % 100000 == 0)
+		{
+			cout << "[ChatBenchmark] " << clients.size() << " connections open" << endl;
+		}
+	}
+	const auto connectTime = chrono::duration<double>(chrono::steady_clock::now() - connectStartTime).count();
+
+	// Wait for the server to accept everything and for its working set to settle.
+	PROCESS_MEMORY_COUNTERS_EX settled = baseline;
+	for (int i = 0; i < 60; ++i)
+	{
+		const auto previous = settled.WorkingSetSize;
+		this_thread::sleep_for(chrono::milliseconds(500));
+		answerPings();
+
+		if (!getServerMemory(settled) || (i >= 4 && settled.WorkingSetSize <= previous + previous / 200))
+			break;
+	}
+
+	const auto numOpened = clients.size();
+	const auto elapsedMinutes = chrono::duration<double>(chrono::steady_clock::now() - connectStartTime).count() / 60;
+	auto perConnection = [numOpened](size_t before, size_t after)
+	{
+		return after > before ? static_cast<uint64_t>((after - before) / numOpened) : 0;
+	};
+
+	cout << "[ChatBenchmark] idle connections: " << numOpened
+		<< ", connects/s = " << static_cast<uint64_t>(numOpened / max(connectTime, 1e-9)) << endl;
+	cout << "[ChatBenchmark] server working set: " << baseline.WorkingSetSize / 1024 << "KB -> " << settled.WorkingSetSize / 1024
+		<< "KB, " << perConnection(baseline.WorkingSetSize, settled.WorkingSetSize) << " bytes/connection" << endl;
+	cout << "[ChatBenchmark] server private bytes: " << baseline.PrivateUsage / 1024 << "KB -> " << settled.PrivateUsage / 1024
+		<< "KB, " << perConnection(baseline.PrivateUsage, settled.PrivateUsage) << " bytes/connection" << endl;
+
+	// Without back-off every connection would be pinged once per HEART_BEAT_PERIOD.
+	cout << "[ChatBenchmark] pings answered: " << clientStats.numSentPackets << ", "
+		<< clientStats.numSentPackets / numOpened / std::max(elapsedMinutes, 1e-9) << " per connection per minute" << endl;
+
+	clients.clear();
+
+	TerminateProcess(server.hProcess, 0);
+	WaitForSingleObject(server.hProcess, INFINITE);
+	CloseHandle(server.hThread);
+	CloseHandle(server.hProcess);
+}
+
+void ChatBenchmark::RunTracing(int numSpans)
+{
+	if (numSpans < 1)
+	{
+		cerr << "[ChatBenchmark] needs at least one span." << endl;
+		return;
+	}
+
+	auto measure = [numSpans](const char* name, uint32_t traceId)
+	{
+		volatile uint32_t sink = 0;
+
+		const auto startTime = chrono::steady_clock::now();
+		for (int i = 0; i < numSpans; ++i)
+		{
+			ChatTraceScope scope("Bench", traceId);
+			sink = sink + 1;
+		}
+		const auto elapsed = chrono::duration<double>(chrono::steady_clock::now() - startTime).count();
+
+		cout << "[ChatBenchmark] " << name << ": spans = " << numSpans
+			<< ", ns/span = " << elapsed * 1e9 / numSpans << endl;
+	};
+
+	ChatTracer::Enable(0);
+	measure("tracing disabled", 1);
+
+	ChatTracer::Enable(ChatConstant::TRACE_SAMPLE_RATE);
+	measure("tracing enabled, untraced packet", 0);
+	measure("tracing enabled, traced packet", 1);
+
+	ChatTracer::Enable(0);
+}
+
+void ChatBenchmark::RunPacketCodec(int numPackets)
+{
+	if (numPackets < 1)
+	{
+		cerr << "[ChatBenchmark] needs at least one packet." << endl;
+		return;
+	}
+
+	constexpr int NUM_SAMPLES = 256;
+
+	mt19937 random(42);
+	vector<pair<string, string>> samples;
+	samples.reserve(NUM_SAMPLES);
+
+	for (int i = 0; i < NUM_SAMPLES; ++i)
+	{
+		string text(8 + random() % (MessagePacket::MESSAGE_LENGTH - 8), ' ');
+		for (auto& ch : text)
+		{
+			ch = static_cast<char>('a' + random() % 26);
+		}
+
+		samples.emplace_back(string("user") + to_string(random() % 10000), move(text));
+	}
+
+	// Decoders are charged with finding the string lengths too, which is what every consumer does next.
+	auto report = [numPackets](const char* name, chrono::steady_clock::time_point startTime, uint64_t checksum)
+	{
+		const auto elapsed = chrono::duration<double>(chrono::steady_clock::now() - startTime).count();
+
+		cout << "[ChatBenchmark] " << name << ": packets = " << numPackets
+			<< ", ns/packet = " << elapsed * 1e9 / numPackets << ", checksum = " << checksum << endl;
+	};
+
+	// The schema carries the interned sender number instead of the ID, as the server sends it.
+	vector<uint32_t> senderNumbers;
+	for (auto& sample : samples)
+	{
+		senderNumbers.push_back(ChatIdTable::GetNumber(sample.first));
+	}
+
+	vector<ChatPacket> frames(NUM_SAMPLES);
+	uint64_t checksum = 0;
+
+	auto startTime = chrono::steady_clock::now();
+	for (int i = 0; i < numPackets; ++i)
+	{
+		auto& sample = samples[i % NUM_SAMPLES];
+		auto& frame = frames[i % NUM_SAMPLES];
+
+		frame = ChatPacket();
+		EncodeLegacy(frame, sample.first, sample.second);
+		checksum += frame.payload[ChatConstant::ID_LENGTH];
+	}
+	report("legacy encode", startTime, checksum);
+
+	checksum = 0;
+	startTime = chrono::steady_clock::now();
+	for (int i = 0; i < numPackets; ++i)
+	{
+		auto& message = reinterpret_cast<LegacyMessagePacket&>(frames[i % NUM_SAMPLES]);
+		message.senderId[sizeof(message.senderId) - 1] = '\0';
+		message.message[sizeof(message.message) - 1] = '\0';
+
+		checksum += strlen(message.senderId) + strlen(message.message);
+	}
+	report("legacy decode", startTime, checksum);
+
+	checksum = 0;
+	startTime = chrono::steady_clock::now();
+	for (int i = 0; i < numPackets; ++i)
+	{
+		auto& sample = samples[i % NUM_SAMPLES];
+
+		MessagePacket message;
+		message.SetSenderNumber(senderNumbers[i % NUM_SAMPLES]);
+		message.SetMessage(sample.second);
+
+		frames[i % NUM_SAMPLES] = ChatPacket::Encode(message);
+		checksum += frames[i % NUM_SAMPLES].header.payloadLength;
+	}
+	report("schema encode", startTime, checksum);
+
+	checksum = 0;
+	startTime = chrono::steady_clock::now();
+	for (int i = 0; i < numPackets; ++i)
+	{
+		MessagePacket message;
+		if (frames[i % NUM_SAMPLES].Decode(message))
+		{
+			checksum += message.senderNumber + message.message.length;
+		}
+	}
+	report("schema decode", startTime, checksum);
+}
+
+void ChatBenchmark::RunRoomFanOut(int numReaders, int numMessages)
+{
+	if (numReaders < 1 || numMessages < 1)
+	{
+		cerr << "[ChatBenchmark] needs at least one reader and one message." << endl;
+		return;
+	}
+
+	// Socketless readers drop whatever they queued on the next flush, which is kept out of the measurements.
+	constexpr int CHUNK_SIZE = ChatConstant::SEND_WINDOW / 2;
+
+	TConnections readers;
+	for (int i = 0; i < numReaders; ++i)
+	{
+		readers.emplace_back(make_unique<ChatConnection>(INVALID_SOCKET));
+		readers.back()->SetHandle(i + 1);
+	}
+
+	MessagePacket message;
+	message.SetSenderNumber(ChatIdTable::GetNumber("bench"));
+	message.SetMessage("the quick brown fox jumps over the lazy dog");
+
+	auto flush = [&readers]()
+	{
+		for (auto& reader : readers)
+		{
+			reader->FlushSendRequests();
+		}
+	};
+
+	chrono::steady_clock::duration pushTime(0);
+
+	for (int sent = 0; sent < numMessages; sent += CHUNK_SIZE)
+	{
+		const auto startTime = chrono::steady_clock::now();
+		for (int i = sent; i < std::min(sent + CHUNK_SIZE, numMessages); ++i)
+		{
+			for (auto& reader : readers)
+			{
+				reader->RequestSendMessage(message);
+			}
+		}
+		pushTime += chrono::steady_clock::now() - startTime;
+
+		flush();
+	}
+
+	ChatRoomRing room(ChatConstant::ROOM_RING_CAPACITY);
+	chrono::steady_clock::duration publishTime(0);
+	chrono::steady_clock::duration readTime(0);
+
+	for (int sent = 0; sent < numMessages; sent += CHUNK_SIZE)
+	{
+		auto startTime = chrono::steady_clock::now();
+		for (int i = sent; i < std::min(sent + CHUNK_SIZE, numMessages); ++i)
+		{
+			room.Publish(message, 0);
+		}
+		publishTime += chrono::steady_clock::now() - startTime;
+
+		startTime = chrono::steady_clock::now();
+		for (auto& reader : readers)
+		{
+			auto cursor = reader->GetRoomCursor();
+			room.CatchUp(cursor);
+
+			while (cursor < room.GetHead())
+			{
+				reader->RequestSendMessage(room.At(cursor++).message);
+			}
+
+			reader->SetRoomCursor(cursor);
+		}
+		readTime += chrono::steady_clock::now() - startTime;
+
+		flush();
+	}
+
+	auto report = [numMessages](const char* name, chrono::steady_clock::duration elapsed)
+	{
+		cout << "[ChatBenchmark] " << name << ": ns/message = "
+			<< chrono::duration<double, nano>(elapsed).count() / numMessages << endl;
+	};
+
+	cout << "[ChatBenchmark] room fan-out: readers = " << numReaders << ", messages = " << numMessages << endl;
+	report("push producer", pushTime);
+	report("ring producer", publishTime);
+	report("ring readers", readTime);
+}
+
+void ChatBenchmark::RunParallelFanOut(int numReaders, int numMessages, int numThreads)
+{
+	if (numReaders < 1 || numMessages < 1)
+	{
+		cerr << "[ChatBenchmark] needs at least one reader and one message." << endl;
+		return;
+	}
+
+	TConnections readers;
+	for (int i = 0; i < numReaders; ++i)
+	{
+		readers.emplace_back(make_unique<ChatConnection>(INVALID_SOCKET));
+		readers.back()->SetHandle(i + 1);
+	}
+
+	ChatRoomRing room(ChatConstant::ROOM_RING_CAPACITY);
+
+	MessagePacket message;
+	message.SetSenderNumber(ChatIdTable::GetNumber("bench"));
+	message.SetMessage("the quick brown fox jumps over the lazy dog");
+
+	// What the server does for every connection in a pass, minus the send call the socketless readers skip.
+	auto readAndFlush = [&room, &readers](size_t index)
+	{
+		auto& reader = *readers[index];
+		auto cursor = reader.GetRoomCursor();
+
+		while (cursor < room.GetHead())
+		{
+			reader.RequestSendMessage(room.At(cursor++).message);
+		}
+
+		reader.SetRoomCursor(cursor);
+		reader.FlushSendRequests();
+	};
+
+	auto measure = [&](ChatFanOutPool& pool, const char* name)
+	{
+		ChatHistogram passLatency;
+		const size_t numChunks = (readers.size() + ChatConstant::FAN_OUT_CHUNK_SIZE - 1) / ChatConstant::FAN_OUT_CHUNK_SIZE;
+
+		for (int i = 0; i < numMessages; ++i)
+		{
+			room.Publish(message, 0);
+
+			const auto startTime = chrono::steady_clock::now();
+			pool.Run(numChunks, [&readAndFlush, &readers](size_t chunk)
+				{
+					const auto begin = chunk * ChatConstant::FAN_OUT_CHUNK_SIZE;
+					const auto end = std::min(begin + ChatConstant::FAN_OUT_CHUNK_SIZE, readers.size());
+
+					for (size_t index = begin; index < end; ++index)
+					{
+						readAndFlush(index);
+					}
+				});
+
+			passLatency.Record(chrono::duration_cast<chrono::microseconds>(chrono::steady_clock::now() - startTime));
+		}
+
+		passLatency.Report(cout, name);
+	};
+
+	cout << "[ChatBenchmark] parallel fan-out: readers = " << numReaders << ", messages = " << numMessages
+		<< ", threads = " << numThreads << endl;
+
+	// A pool that was never started runs every task on the calling thread.
+	ChatFanOutPool serial;
+	measure(serial, "serial fan-out pass");
+
+	ChatFanOutPool parallel;
+	parallel.Start(static_cast<size_t>(std::max(numThreads, 0)));
+	measure(parallel, "parallel fan-out pass");
+}
\ No newline at end of file
@@ -0,0 +1,53 @@
+#pragma once
+
+#include <string>
+#include <vector>
+
+
+// Load generators that drive running ChatServer processes through the regular client protocol.
+namespace ChatBenchmark
+{
+	// Spreads numClients over the given "address:port" nodes round-robin, lets every client
+	// broadcast numMessages messages and measures cluster-wide delivery throughput and latency.
+	void RunClusterFanOut(const std::vector<std::string>& nodes, int numClients, int numMessages);
+
+	// Connects numUsers clients to one node, then has a single user send numMessages direct
+	// messages and numMessages broadcasts, reporting the throughput of each routing path.
+	void RunDirectVsBroadcast(const std::string& node, int numUsers, int numMessages);
+
+	// Hosts numBots identities on one ChatClientLoop connected to node, lets each broadcast numMessages messages
+	// and reports the connect time and the delivery throughput seen by the bots. Exercises the client library.
+	void RunBots(const std::string& node, int numBots, int numMessages);
+
+	// Fans numMessages messages out to numReaders socketless connections by pushing each one onto every queue, and by
+	// publishing it once to a ChatRoomRing the readers drain, reporting producer and reader cost. Needs no server.
+	void RunRoomFanOut(int numReaders, int numMessages);
+
+	// Publishes numMessages messages one at a time to a room of numReaders socketless connections and times
+	// each pass that reads and flushes all of them, on one thread and on a ChatFanOutPool. Needs no server.
+	void RunParallelFanOut(int numReaders, int numMessages, int numThreads);
+
+	// Sends numMessages one at a time between two clients over TCP, the unix domain socket
+	// at localPath and the shared memory ring, reporting the end-to-end latency of each transport.
+	void RunLocalTransports(const std::string& node, const std::string& localPath, int numMessages);
+
+	// Runs numMessages generated chat messages through the content filter built from the pattern file
+	// and through a naive per-pattern search, reporting the cost per message of each. Needs no server.
+	void RunContentFilter(const std::string& patternPath, int numMessages);
+
+	// Indexes numMessages generated chat messages, then runs numQueries keyword and sender queries against
+	// the index and a linear scan of the history, reporting index size and query latency. Needs no server.
+	void RunHistorySearch(int numMessages, int numQueries);
+
+	// Starts a server child process on port, opens numConnections idle localhost connections to it that
+	// only send heartbeats, and reports the growth of the server's resident memory per connection.
+	void RunIdleConnections(int numConnections, const std::string& port);
+
+	// Times numSpans trace scopes with tracing disabled, enabled for an untraced packet and enabled
+	// for a traced one, reporting the cost per span of each. Needs no server.
+	void RunTracing(int numSpans);
+
+	// Encodes and decodes numPackets chat messages through the table schema and through the overlaid
+	// struct layout tables used before it, reporting the cost per packet of each. Needs no server.
+	void RunPacketCodec(int numPackets);
+}
\ No newline at end of file
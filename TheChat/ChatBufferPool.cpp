@@ -0,0 +1,70 @@
+#include "ChatBufferPool.h"
+
+#include <memory>
+
+
+using namespace std;
+
+namespace
+{
+	constexpr size_t MAX_POOLED_PACKETS = 4096;
+	constexpr size_t MAX_POOLED_QUEUES = 1024;
+	constexpr size_t MAX_POOLED_QUEUE_CAPACITY = 256;
+
+	struct Pool
+	{
+		vector<unique_ptr<ChatPacket>> packets;
+		vector<ChatBufferPool::TQueue> queues;
+	};
+
+	thread_local Pool pool;
+}
+
+ChatPacket* ChatBufferPool::AcquirePacket()
+{
+	if (pool.packets.empty())
+		return new ChatPacket();
+
+	auto packet = pool.packets.back().release();
+	pool.packets.pop_back();
+
+	return packet;
+}
+
+void ChatBufferPool::ReleasePacket(ChatPacket* packet)
+{
+	if (packet == nullptr)
+		return;
+
+	if (pool.packets.size() >= MAX_POOLED_PACKETS)
+	{
+		delete packet;
+		return;
+	}
+
+	pool.packets.emplace_back(packet);
+}
+
+ChatBufferPool::TQueue ChatBufferPool::AcquireQueue()
+{
+	if (pool.queues.empty())
+		return TQueue();
+
+	auto queue = move(pool.queues.back());
+	pool.queues.pop_back();
+
+	return queue;
+}
+
+void ChatBufferPool::ReleaseQueue(TQueue&& queue)
+{
+	if (queue.capacity() == 0 || queue.capacity() > MAX_POOLED_QUEUE_CAPACITY || pool.queues.size() >= MAX_POOLED_QUEUES)
+	{
+		TQueue().swap(queue);
+		return;
+	}
+
+	queue.clear();
+	pool.queues.emplace_back(move(queue));
+	queue = TQueue();
+}
\ No newline at end of file
@@ -0,0 +1,20 @@
+#pragma once
+
+#include <vector>
+
+#include "ChatPacket.h"
+
+
+// Per-thread free lists for connection buffers, so a connection only holds memory while data is in flight.
+// Buffers are returned to the pool of the releasing thread: the chat thread, or a fan-out thread flushing the connection.
+namespace ChatBufferPool
+{
+	using TQueue = std::vector<ChatPacket>;
+
+	ChatPacket* AcquirePacket();
+	void ReleasePacket(ChatPacket* packet);
+
+	// Released queues keep their capacity, unless it grew past what an active connection usually needs.
+	TQueue AcquireQueue();
+	void ReleaseQueue(TQueue&& queue);
+}
\ No newline at end of file
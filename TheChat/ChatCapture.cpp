@@ -0,0 +1,172 @@
+#include "ChatCapture.h"
+
+#include <algorithm>
+#include <fstream>
+#include <iostream>
+
+#define WIN32_LEAN_AND_MEAN
+
+#include <windows.h>
+
+
+using namespace std;
+
+ChatCapture::ChatCapture()
+	: file(INVALID_HANDLE_VALUE)
+	, mapping(nullptr)
+	, header(nullptr)
+	, entries(nullptr)
+	, startTime(chrono::steady_clock::now())
+{
+}
+
+ChatCapture::~ChatCapture()
+{
+	Close();
+}
+
+bool ChatCapture::Open(const char* path, uint64_t capacity)
+{
+	Close();
+
+	const uint64_t fileSize = sizeof(FileHeader) + capacity * sizeof(Entry);
+
+	file = CreateFileA(path, GENERIC_READ | GENERIC_WRITE, FILE_SHARE_READ, nullptr, CREATE_ALWAYS, FILE_ATTRIBUTE_NORMAL, nullptr);
+	if (file == INVALID_HANDLE_VALUE)
+	{
+		cerr << "[ChatCapture] failed to create " << path << ", error = " << GetLastError() << endl;
+		return false;
+	}
+
+	mapping = CreateFileMappingA(file, nullptr, PAGE_READWRITE,
+		static_cast<DWORD>(fileSize >> 32), static_cast<DWORD>(fileSize & 0xFFFFFFFF), nullptr);
+	if (mapping == nullptr)
+	{
+		cerr << "[ChatCapture] failed to map " << path << ", error = " << GetLastError() << endl;
+
+		Close();
+		return false;
+	}
+
+	auto view = static_cast<uint8_t*>(MapViewOfFile(mapping, FILE_MAP_ALL_ACCESS, 0, 0, 0));
+	if (view == nullptr)
+	{
+		cerr << "[ChatCapture] failed to map a view of " << path << ", error = " << GetLastError() << endl;
+
+		Close();
+		return false;
+	}
+
+	header = reinterpret_cast<FileHeader*>(view);
+	header->magic = MAGIC;
+	header->version = VERSION;
+	header->entrySize = sizeof(Entry);
+	header->reserved = 0;
+	header->capacity = capacity;
+	header->numWritten = 0;
+
+	entries = reinterpret_cast<Entry*>(view + sizeof(FileHeader));
+	startTime = chrono::steady_clock::now();
+
+	cout << "[ChatCapture] capturing inbound packets to " << path << ", capacity = " << capacity << endl;
+
+	return true;
+}
+
+void ChatCapture::Close()
+{
+	if (header != nullptr)
+	{
+		FlushViewOfFile(header, 0);
+		UnmapViewOfFile(header);
+
+		header = nullptr;
+		entries = nullptr;
+	}
+
+	if (mapping != nullptr)
+	{
+		CloseHandle(mapping);
+		mapping = nullptr;
+	}
+
+	if (file != INVALID_HANDLE_VALUE)
+	{
+		CloseHandle(file);
+		file = INVALID_HANDLE_VALUE;
+	}
+}
+
+void ChatCapture::Write(uint64_t handle, const ChatPacket& packet)
+{
+	if (!IsOpen())
+		return;
+
+	Next(handle, EEvent::Packet).packet = packet;
+}
+
+void ChatCapture::WriteClose(uint64_t handle)
+{
+	if (!IsOpen())
+		return;
+
+	Next(handle, EEvent::Close);
+}
+
+vector<ChatCapture::Entry> ChatCapture::Load(const char* path)
+{
+	vector<Entry> loaded;
+
+	ifstream input(path, ios::binary);
+	if (!input)
+	{
+		cerr << "[ChatCapture] failed to open " << path << endl;
+		return loaded;
+	}
+
+	FileHeader fileHeader;
+	input.read(reinterpret_cast<char*>(&fileHeader), sizeof(fileHeader));
+
+	if (!input || fileHeader.magic != MAGIC || fileHeader.version != VERSION || fileHeader.entrySize != sizeof(Entry))
+	{
+		cerr << "[ChatCapture] " << path << " is not a compatible capture file." << endl;
+		return loaded;
+	}
+
+	const auto capacity = fileHeader.capacity;
+	const auto numEntries = std::min(fileHeader.numWritten, capacity);
+	const auto first = fileHeader.numWritten > capacity ? fileHeader.numWritten % capacity : 0;
+
+	vector<Entry> ring(static_cast<size_t>(numEntries));
+	input.read(reinterpret_cast<char*>(ring.data()), numEntries * sizeof(Entry));
+
+	if (!input)
+	{
+		cerr << "[ChatCapture] " << path << " is truncated." << endl;
+		return loaded;
+	}
+
+	loaded.reserve(ring.size());
+
+	for (uint64_t i = 0; i < numEntries; ++i)
+	{
+		loaded.push_back(ring[static_cast<size_t>((first + i) % numEntries)]);
+	}
+
+	return loaded;
+}
+
+ChatCapture::Entry& ChatCapture::Next(uint64_t handle, EEvent event)
+{
+	const auto elapsed = chrono::steady_clock::now() - startTime;
+
+	auto& entry = entries[header->numWritten % header->capacity];
+	entry.timestamp = chrono::duration_cast<chrono::microseconds>(elapsed).count();
+	entry.handle = handle;
+	entry.event = event;
+	entry.reserved = 0;
+
+	++header->numWritten;
+
+	return entry;
+}
\ No newline at end of file
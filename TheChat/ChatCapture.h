@@ -0,0 +1,69 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+#include "ChatPacket.h"
+#include "Network.h"
+
+
+// Memory-mapped ring of inbound packets for offline replay.
+// The file keeps the most recent 'capacity' entries; Load() returns them in arrival order.
+class ChatCapture final
+{
+public:
+	static constexpr uint32_t MAGIC = 0x50414354; // "TCAP"
+	static constexpr uint32_t VERSION = 5;
+
+	enum class EEvent : uint32_t
+	{
+		Packet = 0,
+		Close = 1
+	};
+
+	struct Entry
+	{
+		int64_t timestamp;
+		uint64_t handle;
+		EEvent event;
+		uint32_t reserved;
+		ChatPacket packet;
+	};
+
+	struct FileHeader
+	{
+		uint32_t magic;
+		uint32_t version;
+		uint32_t entrySize;
+		uint32_t reserved;
+		uint64_t capacity;
+		uint64_t numWritten;
+	};
+
+private:
+	void* file;
+	void* mapping;
+	FileHeader* header;
+	Entry* entries;
+	Network::TTimeStamp startTime;
+
+public:
+	ChatCapture();
+	~ChatCapture();
+
+	ChatCapture(const ChatCapture&) = delete;
+	ChatCapture& operator = (const ChatCapture&) = delete;
+
+	bool Open(const char* path, uint64_t capacity);
+	void Close();
+
+	void Write(uint64_t handle, const ChatPacket& packet);
+	void WriteClose(uint64_t handle);
+
+	inline bool IsOpen() const { return header != nullptr; }
+
+	static std::vector<Entry> Load(const char* path);
+
+private:
+	Entry& Next(uint64_t handle, EEvent event);
+};
\ No newline at end of file
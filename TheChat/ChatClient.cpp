@@ -2,22 +2,20 @@
 #include "ChatClient.h"
 
 #include <algorithm>
+#include <chrono>
 #include <iostream>
 #include <mutex>
+#include <set>
 #include <thread>
 #include <vector>
 
 #define WIN32_LEAN_AND_MEAN
 
 #include <windows.h>
-#include <ws2tcpip.h>
 
-#include "ChatConnection.h"
 #include "ChatConstant.h"
 #include "ChatPacket.h"
-#include "ChatTableID.h"
-#include "GreetingsPacket.h"
-#include "MessagePacket.h"
+#include "SearchPacket.h"
 
 
 using namespace std;
@@ -31,12 +29,18 @@ namespace
 }
 
 ChatClient::ChatClient(const char* address, const char* port, const char* id)
-	: address(address)
+	: isRunning(false)
+	, address(address)
 	, port(port)
 	, id(id)
-	, socket(INVALID_SOCKET)
+	, isLocal(false)
+	, useSharedRing(false)
+	, lastSearchId(0)
+	, core(id)
 {
 	cout << "[TheChat] " << id << ": Trying to connect to " << address << ":" << port << endl;
+
+	SetHandlers();
 }
 
 ChatClient::~ChatClient()
@@ -44,189 +48,141 @@ ChatClient::~ChatClient()
 	Release();
 }
 
-void ChatClient::Run()
+void ChatClient::SetLocalTransport(bool useSharedRing)
 {
-	Release();
+	isLocal = true;
+	this->useSharedRing = useSharedRing;
+}
 
-	struct addrinfo* addressInfo = nullptr;
-	struct addrinfo* ptr = nullptr;
-	struct addrinfo hints;
+void ChatClient::SetHandlers()
+{
+	core.SetMessageHandler([](const string& senderId, const string& message)
+		{
+			cout << senderId << ": " << message << endl;
+		});
 
-	ZeroMemory(&hints, sizeof(hints));
-	hints.ai_family = AF_UNSPEC;
-	hints.ai_socktype = SOCK_STREAM;
-	hints.ai_protocol = IPPROTO_TCP;
+	core.SetPrivateMessageHandler([](const string& senderId, const string& message)
+		{
+			cout << "[DM] " << senderId << ": " << message << endl;
+		});
 
-	auto result = getaddrinfo(address.c_str(), port.c_str(), &hints, &addressInfo);
-	if (result != 0)
-	{
-		cerr << "[TheChat] getaddrinfo failed. error = " << result << endl;
-		return;
-	}
+	core.SetPresenceHandler([](const string& id, bool isOnline)
+		{
+			cout << "[TheChat] " << id << (isOnline ? " joined." : " left.") << endl;
+		});
 
-	for (ptr = addressInfo; ptr != NULL; ptr = ptr->ai_next)
-	{
-		socket = ::socket(ptr->ai_family, ptr->ai_socktype, ptr->ai_protocol);
-		if (socket == INVALID_SOCKET)
+	core.SetSnapshotHandler([](const set<string>& onlineIDs)
 		{
-			cerr << "[TheChat] socket failed. errpr = " << WSAGetLastError() << endl;
+			cout << "[TheChat] online: " << onlineIDs.size() << endl;
+		});
 
-			return;
-		}
+	core.SetSearchHandler([this](const SearchPacket& result)
+		{
+			if (result.requestId != lastSearchId)
+				return;
+
+			if (result.numResults == 0)
+			{
+				cout << "[Search] no results." << endl;
+				return;
+			}
 
-		result = connect(socket, ptr->ai_addr, (int)ptr->ai_addrlen);
-		if (result == SOCKET_ERROR)
+			cout << "[Search] " << (result.index + 1) << '/' << result.numResults << " #" << result.messageNumber
+				<< ' ' << result.GetSenderID() << ": " << result.GetText() << endl;
+		});
+
+	core.SetConnectedHandler([]()
 		{
-			closesocket(socket);
-			socket = INVALID_SOCKET;
-			continue;
-		}
+			cout << "[TheChat] connected! " << endl;
+		});
 
-		break;
-	}
+	core.SetDisconnectedHandler([this]()
+		{
+			if (isRunning)
+			{
+				cout << "[TheChat] disconnected from the server." << endl;
+			}
+		});
+}
 
-	freeaddrinfo(addressInfo);
+void ChatClient::Run()
+{
+	Release();
 
-	u_long nonBlockingMode = 1;
-	if (ioctlsocket(socket, FIONBIO, &nonBlockingMode) != 0)
+	if (!Connect())
 	{
-		cerr << "[TheChat] ioctlsocket failed, error = " << WSAGetLastError() << endl;
-
-		shutdown(socket, SD_SEND);
-		closesocket(socket);
-		socket = INVALID_SOCKET;
+		cerr << "[TheChat] failed to connect to " << address << ":" << port << endl;
+		return;
+	}
 
+	if (!stdInputSignal.IsValid())
+	{
+		cerr << "[TheChat] failed to create the input signal." << endl;
+		core.Close();
 		return;
 	}
 
 	isRunning = true;
-	connection = ChatConnection(socket);
-	connection.SetID("Server");
-
-	cout << "[TheChat] connected! " << endl;
 
-	GreetingsPacket greetings(id);
-	connection.RequestSend(ChatPacket::From(greetings));
-	connection.FlushSendRequests();
+	cout << "[TheChat] connecting to " << address << ":" << port << endl;
 
-	StartHeartBeatThread();
 	StartStdInputThread();
 
-	fd_set readSet;
-	fd_set writeSet;
-	timeval tval{ 0, 0 };
-	static const string quitMsg("quit");
+	using namespace chrono;
+
+	WSAPOLLFD pollFds[2];
+	auto reconnectTime = steady_clock::now();
 
 	while (isRunning)
 	{
-		if (!connection.IsAlive())
-		{
-			cout << "[TheChat] disconnected from the server." << endl;
-			break;
-		}
-			
-		FD_ZERO(&readSet);
-		FD_ZERO(&writeSet);
-		FD_SET(socket, &readSet);
-		FD_SET(socket, &writeSet);
-
-		int count = select(0, &readSet, &writeSet, nullptr, &tval);
-		if (count <= 0)
-			continue;
-
-		if (FD_ISSET(socket, &readSet))
+		// A lost connection is retried; the server resumes the session, so nothing sent or received is lost.
+		if (!core.IsConnected() && steady_clock::now() >= reconnectTime)
 		{
-			vector<ChatPacket> packets;
-
-			{
-				lock_guard<mutex> lock(connectionMutex);
+			cout << "[TheChat] reconnecting to " << address << ":" << port << endl;
 
-				connection.Receive();
-				packets = connection.ExtractReceived();
-			}
-			
-			for (auto& packet : packets)
-			{
-				if (packet.header.tableId == EChatTableID::MESSAGE_TABLE)
-				{
-					auto& message = packet.As<MessagePacket>();
-					message.Validate();
+			Connect();
+			reconnectTime = steady_clock::now() + milliseconds(ChatConstant::RECONNECT_PERIOD);
+		}
 
-					cout << message.GetSenderID() << ": " << message.GetMessage() << endl;
-					
-					continue;
-				}
+		const bool isConnected = core.IsConnected();
+		const auto wakeUp = isConnected ? core.GetNextDueTime() : reconnectTime;
+		const auto timeout = duration_cast<milliseconds>(wakeUp - steady_clock::now()).count();
 
-				// TODO
-			}
+		pollFds[0].fd = stdInputSignal.GetSocket();
+		pollFds[0].events = POLLRDNORM;
+		pollFds[0].revents = 0;
+		pollFds[1].fd = core.GetSocket();
+		pollFds[1].events = core.GetPollEvents();
+		pollFds[1].revents = 0;
 
-			continue;
+		int count = WSAPoll(pollFds, isConnected ? 2 : 1, static_cast<int>(std::max<long long>(timeout, 0)) + 1);
+		if (count == SOCKET_ERROR)
+		{
+			cerr << "[TheChat] WSAPoll failed, error = " << WSAGetLastError() << endl;
+			break;
 		}
 
-		if (FD_ISSET(socket, &writeSet))
+		if (pollFds[0].revents != 0)
 		{
-			{
-				lock_guard<mutex> lock(stdInputBufferMutex);
-				lock_guard<mutex> connLock(connectionMutex);
-
-				for (auto& msg : stdInputBuffer)
-				{
-					if (isRunning && msg == quitMsg)
-					{
-						isRunning = false;
-					}
-
-					int offset = 0;
-					
-					while (offset < msg.size())
-					{
-						MessagePacket message;
-						message.SetSenderID(id.c_str());
-						offset = message.SetMessage(msg, offset);
-						connection.RequestSend(ChatPacket::From(message));
-					}
-				}
-
-				stdInputBuffer.clear();
-			}
+			stdInputSignal.Drain();
+			ProcessStdInput();
+		}
 
-			{
-				lock_guard<mutex> connLock(connectionMutex);
-				connection.FlushSendRequests();
-			}
+		if (isConnected)
+		{
+			core.Process(pollFds[1].revents != 0);
 		}
 	}
 
 	isRunning = false;
-
-	heartBeatThread.join();
 	stdInputThread.detach();
 
 	Release();
 }
 
-void ChatClient::StartHeartBeatThread()
+bool ChatClient::Connect()
 {
-	auto func = [this]()
-	{
-		while (isRunning)
-		{
-			{
-				lock_guard<mutex> connLock(connectionMutex);
-				if (!connection.IsAlive())
-				{
-					isRunning = false;
-					return;
-				}
-
-				connection.SendHeartBeat();
-			}
-			
-			std::this_thread::sleep_for(chrono::milliseconds(ChatConstant::HEART_BEAT_PERIOD));
-		}
-	};
-
-	heartBeatThread = thread(func);
+	return isLocal ? core.ConnectLocal(address.c_str(), useSharedRing) : core.Connect(address.c_str(), port.c_str());
 }
 
 void ChatClient::StartStdInputThread()
@@ -236,32 +192,92 @@ void ChatClient::StartStdInputThread()
 		while (isRunning)
 		{
 			string sendMsg;
-			std::getline(std::cin, sendMsg);
+			if (!std::getline(std::cin, sendMsg))
+				break;
+
 			sendMsg = sendMsg.substr(0, MAX_MSG_LENGTH);
 
 			{
 				lock_guard<mutex> lock(stdInputBufferMutex);
 				stdInputBuffer.emplace_back(move(sendMsg));
 			}
+
+			stdInputSignal.Notify();
 		}
 	};
 
 	stdInputThread = thread(inputFunc);
 }
 
-void ChatClient::Release()
+void ChatClient::ProcessStdInput()
 {
-	isRunning = false;
+	static const string quitMsg("quit");
+	static const string whisperCmd("/w ");
+	static const string searchCmd("/search ");
 
-	if (socket == INVALID_SOCKET)
-		return;
+	vector<string> inputs;
 
-	auto result = shutdown(socket, SD_SEND);
-	if (result == SOCKET_ERROR)
 	{
-		cerr << "[TheChatClient] shutdown failed." << endl;
+		lock_guard<mutex> lock(stdInputBufferMutex);
+		swap(inputs, stdInputBuffer);
 	}
 
-	closesocket(socket);
-	socket = INVALID_SOCKET;
+	for (auto& msg : inputs)
+	{
+		if (isRunning && msg == quitMsg)
+		{
+			isRunning = false;
+		}
+
+		if (msg.compare(0, searchCmd.size(), searchCmd) == 0)
+		{
+			RequestSearch(msg.substr(searchCmd.size()));
+			continue;
+		}
+
+		if (msg.compare(0, whisperCmd.size(), whisperCmd) == 0)
+		{
+			const auto recipientEnd = msg.find(' ', whisperCmd.size());
+			if (recipientEnd == string::npos)
+			{
+				cout << "[TheChat] usage: /w <id> <message>" << endl;
+				continue;
+			}
+
+			const auto recipient = msg.substr(whisperCmd.size(), recipientEnd - whisperCmd.size());
+			core.SendPrivate(recipient, msg.substr(recipientEnd + 1));
+
+			continue;
+		}
+
+		core.Send(msg);
+	}
 }
+
+// /search [@<id>] <terms>
+void ChatClient::RequestSearch(const string& query)
+{
+	string sender;
+	string terms(query);
+
+	if (!terms.empty() && terms[0] == '@')
+	{
+		const auto senderEnd = std::min(terms.find(' '), terms.size());
+		sender = terms.substr(1, senderEnd - 1);
+		terms = senderEnd < terms.size() ? terms.substr(senderEnd + 1) : string();
+	}
+
+	if (terms.empty() && sender.empty())
+	{
+		cout << "[TheChat] usage: /search [@<id>] <terms>" << endl;
+		return;
+	}
+
+	lastSearchId = core.Search(sender, terms, 10);
+}
+
+void ChatClient::Release()
+{
+	isRunning = false;
+	core.Close();
+}
\ No newline at end of file
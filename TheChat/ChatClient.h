@@ -4,11 +4,13 @@
 #include <mutex>
 #include <string>
 #include <thread>
+#include <vector>
 
-#include "ChatConnection.h"
-#include "Network.h"
+#include "ChatClientCore.h"
+#include "ChatSignal.h"
 
 
+// Console front end of ChatClientCore: reads commands from stdin on a thread of its own and prints what arrives.
 class ChatClient final
 {
 private:
@@ -16,25 +18,31 @@ private:
 	std::string address;
 	std::string port;
 	std::string id;
-	Network::TSocket socket;
+	bool isLocal;
+	bool useSharedRing;
+	uint32_t lastSearchId;
 
-	ChatConnection connection;
+	ChatClientCore core;
 	std::vector<std::string> stdInputBuffer;
 
-	std::mutex connectionMutex;
+	ChatSignal stdInputSignal;
 	std::mutex stdInputBufferMutex;
 	std::thread stdInputThread;
-	std::thread heartBeatThread;
 
 public:
 	ChatClient(const char* address, const char* port, const char* id);
 	~ChatClient();
 
+	// Connects to the unix domain socket at 'address' instead, optionally moving onto a shared memory ring.
+	void SetLocalTransport(bool useSharedRing);
 	void Run();
 
 private:
-	void StartHeartBeatThread();
+	void SetHandlers();
+	bool Connect();
 	void StartStdInputThread();
+	void ProcessStdInput();
+	void RequestSearch(const std::string& query);
 
 	void Release();
 };
\ No newline at end of file
@@ -0,0 +1,377 @@
+#include "ChatClientCore.h"
+
+#include <algorithm>
+#include <chrono>
+#include <memory>
+
+#define WIN32_LEAN_AND_MEAN
+
+#include <windows.h>
+
+#include "ChatConstant.h"
+#include "ChatIdTable.h"
+#include "ChatPacket.h"
+#include "ChatTableID.h"
+#include "GreetingsPacket.h"
+#include "IdMapPacket.h"
+#include "MessageBatchPacket.h"
+#include "MessagePacket.h"
+#include "PrivateMessagePacket.h"
+
+
+using namespace std;
+
+ChatClientCore::ChatClientCore(const std::string& id)
+	: id(id)
+	, connectingSocket(INVALID_SOCKET)
+	, lastSearchId(0)
+	, useSharedRing(false)
+	, isGreeted(false)
+{
+	senderIDs.emplace(ChatIdTable::SERVER_NUMBER, ChatIdTable::SERVER_ID);
+}
+
+ChatClientCore::~ChatClientCore()
+{
+	// Nobody is listening any more.
+	disconnectedHandler = nullptr;
+	Close();
+}
+
+bool ChatClientCore::Connect(const char* address, const char* port)
+{
+	Close();
+	useSharedRing = false;
+
+	connectingSocket = Network::ConnectAsync(address, port);
+	connectDeadline = chrono::steady_clock::now() + chrono::milliseconds(ChatConstant::CONNECT_TIMEOUT);
+
+	return IsConnecting();
+}
+
+bool ChatClientCore::ConnectLocal(const char* path, bool useSharedRing)
+{
+	Close();
+	this->useSharedRing = useSharedRing;
+
+	return Start(Network::ConnectLocal(path));
+}
+
+bool ChatClientCore::Start(Network::TSocket socket)
+{
+	if (socket == INVALID_SOCKET)
+		return false;
+
+	connection = make_unique<ChatConnection>(socket);
+	connection->SetID(ChatIdTable::SERVER_ID);
+
+	// Sequenced packets of the previous connection, and those requested since, wait until the server has
+	// answered whether it resumed the session.
+	connection->AdoptSession(move(retainedSession));
+	retainedSession = ChatSession();
+
+	GreetingsPacket greetings(id, connection->GetReceivedSequence(), connection->GetSessionToken());
+	connection->RequestSend(ChatPacket::Encode(greetings));
+
+	for (auto& packet : pendingRequests)
+	{
+		connection->RequestSend(packet);
+	}
+
+	pendingRequests.clear();
+	connection->FlushSendRequests();
+
+	return true;
+}
+
+bool ChatClientCore::FinishConnect(bool isReady)
+{
+	if (!isReady && chrono::steady_clock::now() < connectDeadline)
+		return true;
+
+	const auto socket = connectingSocket;
+	connectingSocket = INVALID_SOCKET;
+
+	if (!isReady || Network::GetConnectError(socket) != 0)
+	{
+		closesocket(socket);
+		return false;
+	}
+
+	return Start(socket);
+}
+
+void ChatClientCore::Close()
+{
+	if (IsConnecting())
+	{
+		closesocket(connectingSocket);
+		connectingSocket = INVALID_SOCKET;
+	}
+
+	if (connection == nullptr)
+		return;
+
+	retainedSession = connection->ExtractSession();
+	connection.reset();
+	onlineIDs.clear();
+	isGreeted = false;
+
+	if (disconnectedHandler)
+	{
+		disconnectedHandler();
+	}
+}
+
+void ChatClientCore::Send(const std::string& text)
+{
+	int offset = 0;
+	while (offset < text.size())
+	{
+		// The server fills in the sender number of this connection.
+		MessagePacket message;
+		offset = message.SetMessage(text, offset);
+		RequestSend(ChatPacket::Encode(message));
+	}
+}
+
+void ChatClientCore::SendPrivate(const std::string& recipientId, const std::string& text)
+{
+	int offset = 0;
+	while (offset < text.size())
+	{
+		PrivateMessagePacket message;
+		message.SetSenderID(id);
+		message.SetRecipientID(recipientId);
+		offset = message.SetMessage(text, offset);
+		RequestSend(ChatPacket::Encode(message));
+	}
+}
+
+uint32_t ChatClientCore::Search(const std::string& senderId, const std::string& terms, uint16_t maxResults)
+{
+	SearchPacket request(++lastSearchId, true);
+	request.maxResults = std::min(maxResults, SearchPacket::MAX_RESULTS);
+	request.SetSenderID(senderId);
+	request.SetText(terms);
+
+	RequestSend(ChatPacket::Encode(request));
+
+	return lastSearchId;
+}
+
+void ChatClientCore::RequestSend(const ChatPacket& packet)
+{
+	if (connection == nullptr)
+	{
+		pendingRequests.emplace_back(packet);
+		return;
+	}
+
+	connection->RequestSend(packet);
+}
+
+bool ChatClientCore::Process(bool isReady)
+{
+	if (IsConnecting())
+		return FinishConnect(isReady);
+
+	if (connection == nullptr)
+		return false;
+
+	if (isReady)
+	{
+		connection->Receive();
+
+		for (auto& packet : connection->ExtractReceived())
+		{
+			ProcessPacket(packet);
+
+			// A handler may have closed the client.
+			if (connection == nullptr)
+				return false;
+		}
+	}
+
+	if (!connection->IsAlive())
+	{
+		Close();
+		return false;
+	}
+
+	if (chrono::steady_clock::now() >= GetNextHeartBeat())
+	{
+		connection->SendHeartBeat();
+	}
+
+	if (connection->HasSendRequests())
+	{
+		connection->FlushSendRequests();
+	}
+
+	return true;
+}
+
+Network::TTimeStamp ChatClientCore::GetNextDueTime() const
+{
+	if (IsConnecting())
+		return connectDeadline;
+
+	if (connection == nullptr)
+		return Network::TTimeStamp::max();
+
+	return std::min(GetNextHeartBeat(), connection->GetNextDueTime());
+}
+
+Network::TTimeStamp ChatClientCore::GetNextHeartBeat() const
+{
+	// Once the server pings, its pings and our pongs keep the connection alive. Until then a heartbeat only goes
+	// out after a period in which nothing else did, so a client that is talking sends none.
+	if (connection->IsPinged() || connection->HasSendRequests())
+		return Network::TTimeStamp::max();
+
+	return connection->GetLastSendTime() + chrono::milliseconds(ChatConstant::UNPINGED_HEART_BEAT_PERIOD);
+}
+
+void ChatClientCore::ProcessPacket(const ChatPacket& packet)
+{
+	switch (packet.header.tableId)
+	{
+	case EChatTableID::MESSAGE_TABLE:
+	{
+		MessagePacket message;
+		if (packet.Decode(message) && messageHandler)
+		{
+			messageHandler(FindSenderID(message.GetSenderNumber()), message.GetMessage());
+		}
+
+		break;
+	}
+
+	case EChatTableID::MESSAGE_BATCH_TABLE:
+	{
+		MessageBatchPacket batch;
+		if (packet.Decode(batch) && messageHandler)
+		{
+			batch.ForEach([this](uint32_t senderNumber, const string& message) { messageHandler(FindSenderID(senderNumber), message); });
+		}
+
+		break;
+	}
+
+	case EChatTableID::PRIVATE_MESSAGE_TABLE:
+	{
+		PrivateMessagePacket message;
+		if (packet.Decode(message) && privateMessageHandler)
+		{
+			privateMessageHandler(message.GetSenderID(), message.GetMessage());
+		}
+
+		break;
+	}
+
+	case EChatTableID::ID_MAP_TABLE:
+	{
+		IdMapPacket idMap;
+		if (packet.Decode(idMap))
+		{
+			idMap.ForEach([this](uint32_t senderNumber, const string& id) { senderIDs[senderNumber] = id; });
+		}
+
+		break;
+	}
+
+	case EChatTableID::ID_LIST_TABLE:
+	{
+		IdListPacket idList;
+		if (packet.Decode(idList))
+		{
+			ProcessIdList(idList);
+		}
+
+		break;
+	}
+
+	case EChatTableID::SEARCH_TABLE:
+	{
+		SearchPacket hit;
+		if (packet.Decode(hit) && searchHandler)
+		{
+			searchHandler(hit);
+		}
+
+		break;
+	}
+
+	case EChatTableID::GREETINGS_TABLE:
+	{
+		GreetingsPacket greetings;
+		if (!packet.Decode(greetings))
+			break;
+
+		// A new session numbers its packets from the start; our unacknowledged ones are all sent again.
+		if (!greetings.IsResumed())
+		{
+			connection->ForgetReceivedSequence();
+		}
+
+		connection->SetSessionToken(greetings.GetSessionToken());
+		connection->Resume(greetings.GetLastReceivedSequence());
+
+		if (useSharedRing)
+		{
+			const auto ringName = string("Local\\TheChat.") + to_string(GetCurrentProcessId()) + '.' + id;
+			connection->RequestSharedRing(ringName, ChatConstant::SHARED_RING_CAPACITY);
+		}
+
+		if (!isGreeted)
+		{
+			isGreeted = true;
+
+			if (connectedHandler)
+			{
+				connectedHandler();
+			}
+		}
+
+		break;
+	}
+
+	default:
+		break;
+	}
+}
+
+void ChatClientCore::ProcessIdList(const IdListPacket& idList)
+{
+	const auto kind = idList.GetKind();
+	if (kind == IdListPacket::EKind::SnapshotBegin)
+	{
+		onlineIDs.clear();
+	}
+
+	idList.ForEach([this, kind](IdListPacket::EOperation operation, const string& id)
+		{
+			const bool isChanged = operation == IdListPacket::EOperation::Leave ? onlineIDs.erase(id) > 0 : onlineIDs.insert(id).second;
+
+			if (isChanged && kind == IdListPacket::EKind::Delta && presenceHandler)
+			{
+				presenceHandler(id, operation == IdListPacket::EOperation::Join);
+			}
+		});
+
+	if (kind != IdListPacket::EKind::Delta && snapshotHandler)
+	{
+		snapshotHandler(onlineIDs);
+	}
+}
+
+string ChatClientCore::FindSenderID(uint32_t senderNumber) const
+{
+	auto iter = senderIDs.find(senderNumber);
+	if (iter != senderIDs.end())
+		return iter->second;
+
+	// Only seen if the map was lost, e.g. acknowledged before a session was resumed by a new process.
+	return '#' + to_string(senderNumber);
+}
\ No newline at end of file
@@ -0,0 +1,108 @@
+#pragma once
+
+#include <functional>
+#include <memory>
+#include <set>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "ChatConnection.h"
+#include "IdListPacket.h"
+#include "Network.h"
+#include "SearchPacket.h"
+
+
+// One chat identity speaking the client protocol, without console I/O or threads of its own.
+// The owner polls GetSocket() for GetPollEvents() and calls Process() when it is ready or GetNextDueTime() has passed;
+// ChatClientLoop does that for any number of identities. Events are reported through the handlers,
+// which may call back into the client, Close() included.
+class ChatClientCore final
+{
+public:
+	using TMessageHandler = std::function<void(const std::string& senderId, const std::string& message)>;
+	using TPresenceHandler = std::function<void(const std::string& id, bool isOnline)>;
+	using TSnapshotHandler = std::function<void(const std::set<std::string>& onlineIDs)>;
+	using TSearchHandler = std::function<void(const SearchPacket& result)>;
+	using TStateHandler = std::function<void()>;
+
+private:
+	std::string id;
+	std::unique_ptr<ChatConnection> connection;
+	// A TCP connect in progress; the connection is only made, and greets, once it finished.
+	Network::TSocket connectingSocket;
+	Network::TTimeStamp connectDeadline;
+	// Delivery state kept between connections, resumed by the next one if the server still has its side,
+	// and what was requested while disconnected.
+	ChatSession retainedSession;
+	std::vector<ChatPacket> pendingRequests;
+	std::set<std::string> onlineIDs;
+	// Sender numbers the server has mapped so far. Its numbers never change, so this outlives reconnects.
+	std::unordered_map<uint32_t, std::string> senderIDs;
+	uint32_t lastSearchId;
+	bool useSharedRing;
+	bool isGreeted;
+
+	TMessageHandler messageHandler;
+	TMessageHandler privateMessageHandler;
+	TPresenceHandler presenceHandler;
+	TSnapshotHandler snapshotHandler;
+	TSearchHandler searchHandler;
+	TStateHandler connectedHandler;
+	TStateHandler disconnectedHandler;
+
+public:
+	explicit ChatClientCore(const std::string& id);
+	~ChatClientCore();
+
+	ChatClientCore(const ChatClientCore&) = delete;
+	ChatClientCore& operator = (const ChatClientCore&) = delete;
+
+	// Returns once the connect started; Process() finishes it, or gives up after CONNECT_TIMEOUT.
+	bool Connect(const char* address, const char* port);
+	// Connects to the unix domain socket at path instead, optionally moving onto a shared memory ring.
+	bool ConnectLocal(const char* path, bool useSharedRing);
+	void Close();
+
+	// Long texts are split over as many packets as needed. Sends are queued until the next Process(),
+	// or until connected again, where they go after what the previous connection left unacknowledged.
+	void Send(const std::string& text);
+	void SendPrivate(const std::string& recipientId, const std::string& text);
+	// Returns the request ID the results will carry.
+	uint32_t Search(const std::string& senderId, const std::string& terms, uint16_t maxResults);
+
+	// Receives if isReady, dispatches what arrived, then sends a heartbeat if due and flushes. Returns false once disconnected.
+	// While connecting, isReady tells that the connect finished, one way or the other.
+	bool Process(bool isReady);
+	Network::TTimeStamp GetNextDueTime() const;
+
+	// Called for broadcasts and direct messages.
+	inline void SetMessageHandler(TMessageHandler handler) { messageHandler = std::move(handler); }
+	inline void SetPrivateMessageHandler(TMessageHandler handler) { privateMessageHandler = std::move(handler); }
+	// Called for every join or leave after the initial snapshot, and with the whole list after each snapshot packet.
+	inline void SetPresenceHandler(TPresenceHandler handler) { presenceHandler = std::move(handler); }
+	inline void SetSnapshotHandler(TSnapshotHandler handler) { snapshotHandler = std::move(handler); }
+	inline void SetSearchHandler(TSearchHandler handler) { searchHandler = std::move(handler); }
+	// Connected fires once the server has greeted back, disconnected once the connection is gone.
+	inline void SetConnectedHandler(TStateHandler handler) { connectedHandler = std::move(handler); }
+	inline void SetDisconnectedHandler(TStateHandler handler) { disconnectedHandler = std::move(handler); }
+
+	inline auto& GetID() const { return id; }
+	inline auto& GetOnlineIDs() const { return onlineIDs; }
+	// Also true while the connect is in progress; IsGreeted() tells once the server answered.
+	inline bool IsConnected() const { return connection != nullptr || IsConnecting(); }
+	inline bool IsConnecting() const { return connectingSocket != INVALID_SOCKET; }
+	inline bool IsGreeted() const { return isGreeted; }
+	inline Network::TSocket GetSocket() const { return connection != nullptr ? connection->GetSocket() : connectingSocket; }
+	inline short GetPollEvents() const { return IsConnecting() ? POLLWRNORM : POLLRDNORM; }
+
+private:
+	bool Start(Network::TSocket socket);
+	// Returns false once the connect failed or timed out.
+	bool FinishConnect(bool isReady);
+	void RequestSend(const ChatPacket& packet);
+	Network::TTimeStamp GetNextHeartBeat() const;
+	void ProcessPacket(const ChatPacket& packet);
+	void ProcessIdList(const IdListPacket& idList);
+	std::string FindSenderID(uint32_t senderNumber) const;
+};
\ No newline at end of file
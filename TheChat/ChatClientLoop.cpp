@@ -0,0 +1,83 @@
+#include "ChatClientLoop.h"
+
+#include <algorithm>
+#include <iostream>
+
+#define WIN32_LEAN_AND_MEAN
+
+#include <windows.h>
+
+
+using namespace std;
+
+void ChatClientLoop::Add(ChatClientCore& client)
+{
+	if (std::find(clients.begin(), clients.end(), &client) != clients.end())
+		return;
+
+	clients.push_back(&client);
+}
+
+void ChatClientLoop::Remove(ChatClientCore& client)
+{
+	// Only cleared here, the lists are compacted by the next RunOnce().
+	std::replace(clients.begin(), clients.end(), &client, static_cast<ChatClientCore*>(nullptr));
+	std::replace(polledClients.begin(), polledClients.end(), &client, static_cast<ChatClientCore*>(nullptr));
+}
+
+size_t ChatClientLoop::RunOnce(std::chrono::milliseconds maxWait)
+{
+	clients.erase(std::remove(clients.begin(), clients.end(), nullptr), clients.end());
+
+	auto currentTime = chrono::steady_clock::now();
+	auto wakeUp = currentTime + maxWait;
+
+	polledClients.clear();
+	pollFds.clear();
+
+	for (auto client : clients)
+	{
+		if (!client->IsConnected())
+			continue;
+
+		wakeUp = std::min(wakeUp, client->GetNextDueTime());
+
+		WSAPOLLFD pollFd;
+		pollFd.fd = client->GetSocket();
+		pollFd.events = client->GetPollEvents();
+		pollFd.revents = 0;
+
+		pollFds.push_back(pollFd);
+		polledClients.push_back(client);
+	}
+
+	if (pollFds.empty())
+		return 0;
+
+	const auto timeout = chrono::ceil<chrono::milliseconds>(wakeUp - currentTime).count();
+	if (WSAPoll(pollFds.data(), static_cast<u_long>(pollFds.size()), static_cast<int>(std::max<long long>(timeout, 0))) == SOCKET_ERROR)
+	{
+		cerr << "[ChatClientLoop] WSAPoll failed, error = " << WSAGetLastError() << endl;
+		return polledClients.size();
+	}
+
+	currentTime = chrono::steady_clock::now();
+	size_t numConnected = 0;
+
+	for (size_t i = 0; i < polledClients.size(); ++i)
+	{
+		const bool isReady = pollFds[i].revents != 0;
+
+		if (polledClients[i] != nullptr && (isReady || polledClients[i]->GetNextDueTime() <= currentTime))
+		{
+			polledClients[i]->Process(isReady);
+		}
+
+		if (polledClients[i] != nullptr && polledClients[i]->IsConnected())
+		{
+			++numConnected;
+		}
+	}
+
+	return numConnected;
+}
\ No newline at end of file
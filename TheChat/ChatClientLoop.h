@@ -0,0 +1,31 @@
+#pragma once
+
+#include <chrono>
+#include <vector>
+
+#include "ChatClientCore.h"
+#include "Network.h"
+
+
+// Drives any number of ChatClientCore instances from one thread with a single WSAPoll over their sockets.
+// Clients are not owned; Remove() may be called from their handlers while RunOnce() is processing.
+class ChatClientLoop final
+{
+private:
+	std::vector<ChatClientCore*> clients;
+	std::vector<ChatClientCore*> polledClients;
+	std::vector<WSAPOLLFD> pollFds;
+
+public:
+	ChatClientLoop() = default;
+	~ChatClientLoop() = default;
+
+	void Add(ChatClientCore& client);
+	void Remove(ChatClientCore& client);
+
+	// Waits up to maxWait for a socket to become ready or a client to become due, processes those
+	// clients and returns how many are still connected.
+	size_t RunOnce(std::chrono::milliseconds maxWait);
+
+	inline auto GetNumClients() const { return clients.size(); }
+};
\ No newline at end of file
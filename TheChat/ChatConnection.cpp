@@ -1,47 +1,117 @@
 #include "ChatConnection.h"
 
+#include <algorithm>
 #include <cassert>
+#include <climits>
+#include <cstdint>
+#include <cstring>
 #include <iostream>
 #include <memory>
 #include <ws2tcpip.h>
 
+#include "AckPacket.h"
+#include "ChatBufferPool.h"
+#include "ChatIdTable.h"
+#include "ChatTracer.h"
+
 
 using namespace std;
 
 ChatConnection::ChatConnection()
-	: isAlive(false)
-	, identifier("Unknown")
+	: identifier(&ChatIdTable::Unknown())
+	, idNumber(ChatIdTable::GetNumber(ChatIdTable::Unknown()))
 	, socket(INVALID_SOCKET)
 	, timeStamp(std::chrono::steady_clock::now())
-	, receiveBuffer{0, }
+	, peerAddress{}
+	, ackDueTime(timeStamp)
+	, deliveryLatency(nullptr)
+	, sendTimeStamp(timeStamp)
+	, pingTime(timeStamp)
+	, heartBeatPeriod(ChatConstant::HEART_BEAT_PERIOD)
+	, peerHeartBeatPeriod(0)
+	, handle(0)
+	, roomCursor(0)
+	, capture(nullptr)
+	, batchSize(1)
+	, batchDelay(0)
+	, firstRequestTime(timeStamp)
+	, coalesceSize(1)
+	, coalesceDelay(0)
+	, coalesceStartTime(timeStamp)
+	, trafficStats(nullptr)
+	, numStreamPackets(0)
+	, sharedRingRetryTime(timeStamp)
+	, sendOffset(0)
+	, receiveBuffer(nullptr)
+	, receivedLength(0)
+	, isAlive(false)
+	, isPingPending(false)
+	, isIdleSincePing(false)
+	, isResumePending(false)
+	, isAckPending(false)
+	, isIdentified(false)
+	, isPeer(false)
+	, isLocal(false)
+	, isSharedRingPending(false)
+	, isSendBlocked(false)
 {
 }
 
 ChatConnection::ChatConnection(Network::TSocket socket)
-	: isAlive(true)
-	, identifier("Unknown")
+	: identifier(&ChatIdTable::Unknown())
+	, idNumber(ChatIdTable::GetNumber(ChatIdTable::Unknown()))
 	, socket(socket)
 	, timeStamp(std::chrono::steady_clock::now())
-	, receiveBuffer{0, }
+	, peerAddress{}
+	, ackDueTime(timeStamp)
+	, deliveryLatency(nullptr)
+	, sendTimeStamp(timeStamp)
+	, pingTime(timeStamp)
+	, heartBeatPeriod(ChatConstant::HEART_BEAT_PERIOD)
+	, peerHeartBeatPeriod(0)
+	, handle(0)
+	, roomCursor(0)
+	, capture(nullptr)
+	, batchSize(1)
+	, batchDelay(0)
+	, firstRequestTime(timeStamp)
+	, coalesceSize(1)
+	, coalesceDelay(0)
+	, coalesceStartTime(timeStamp)
+	, trafficStats(nullptr)
+	, numStreamPackets(0)
+	, sharedRingRetryTime(timeStamp)
+	, sendOffset(0)
+	, receiveBuffer(nullptr)
+	, receivedLength(0)
+	, isAlive(true)
+	, isPingPending(false)
+	, isIdleSincePing(false)
+	, isResumePending(false)
+	, isAckPending(false)
+	, isIdentified(false)
+	, isPeer(false)
+	, isLocal(false)
+	, isSharedRingPending(false)
+	, isSendBlocked(false)
 {
 	if (socket == INVALID_SOCKET)
 		return;
 
-	struct sockaddr_in sockAddr;
-	int nameLen = sizeof(struct sockaddr_in);
+	struct sockaddr_storage localAddr;
+	int localNameLen = sizeof(localAddr);
 
-	if (getpeername(socket, (sockaddr*)(&sockAddr), &nameLen) != 0)
+	if (getsockname(socket, (sockaddr*)(&localAddr), &localNameLen) == 0 && localAddr.ss_family == AF_UNIX)
 	{
-		address = "SomeWhere";
+		isLocal = true;
 		return;
 	}
 
-	char ipAddress[16];
-	address = inet_ntop(AF_INET, &sockAddr.sin_addr, ipAddress, sizeof(ipAddress));
-	address += ':';
-
-	int port = ntohs(sockAddr.sin_port);
-	address += to_string(port);
+	int nameLen = sizeof(peerAddress);
+	if (getpeername(socket, (sockaddr*)(&peerAddress), &nameLen) != 0)
+	{
+		peerAddress = {};
+	}
 }
 
 ChatConnection::~ChatConnection()
@@ -52,12 +122,19 @@ ChatConnection::~ChatConnection()
 void ChatConnection::Close()
 {
 	isAlive = false;
-	
-	if (socket != INVALID_SOCKET)
+	sharedRing.reset();
+	isSharedRingPending = false;
+
+	ChatBufferPool::ReleasePacket(receiveBuffer);
+	receiveBuffer = nullptr;
+	receivedLength = 0;
+
+	if (socket == INVALID_SOCKET)
 		return;
 
 	shutdown(socket, SD_BOTH);
 	closesocket(socket);
+	socket = INVALID_SOCKET;
 }
 
 bool ChatConnection::IsAlive() const
@@ -65,13 +142,9 @@ bool ChatConnection::IsAlive() const
 	if (!isAlive)
 		return false;
 
-	const auto currentTime = chrono::steady_clock::now();
-	const auto deltaTime = chrono::duration_cast<chrono::seconds>(currentTime - timeStamp);
-	const auto deltaSeconds = deltaTime.count();
-
-	if (deltaSeconds > ChatConstant::CONNECTION_TIMEOUT)
+	if (chrono::steady_clock::now() - timeStamp > GetTimeout())
 	{
-		cout << "[ChatConnection][Error] " << identifier << '@' << address << " : connection timed-out!" << endl;
+		cout << "[ChatConnection][Error] " << GetID() << '@' << GetAddress() << " : connection timed-out!" << endl;
 		return false;
 	}
 
@@ -80,40 +153,402 @@ bool ChatConnection::IsAlive() const
 
 void ChatConnection::RequestSend(const ChatPacket& packet)
 {
-	packetsToBeSent.emplace_back(packet);
+	// Messages held for coalescing were requested first, so they take their sequence ahead of this packet.
+	// An ID map is the exception: the held messages may use the numbers it maps.
+	if (coalescedMessages != nullptr && ChatPacket::IsSequenced(packet.header.tableId)
+		&& packet.header.tableId != EChatTableID::ID_MAP_TABLE)
+	{
+		FlushCoalescedMessages();
+	}
+
+	if (GetNumSendRequests() == 0)
+	{
+		firstRequestTime = chrono::steady_clock::now();
+	}
+
+	auto& lane = sendLanes[static_cast<size_t>(ChatPacket::GetSendLane(packet.header.tableId))];
+	if (lane.packets.capacity() == 0)
+	{
+		lane.packets = ChatBufferPool::AcquireQueue();
+	}
+
+	lane.packets.emplace_back(packet);
+}
+
+size_t ChatConnection::GetNumSendRequests() const
+{
+	size_t numRequests = packetsToBeSent.size();
+	for (auto& lane : sendLanes)
+	{
+		numRequests += lane.GetSize();
+	}
+
+	return numRequests;
+}
+
+void ChatConnection::ScheduleLanes(size_t window)
+{
+	using ESendLane = ChatPacket::ESendLane;
+	constexpr uint32_t WEIGHTS[] = { 0, ChatConstant::INTERACTIVE_LANE_WEIGHT, ChatConstant::BULK_LANE_WEIGHT };
+
+	// Control packets are few, small and unsequenced; they always go and may overrun the window.
+	auto& control = sendLanes[static_cast<size_t>(ESendLane::Control)];
+	while (control.head < control.packets.size())
+	{
+		PushToWire(control.packets[control.head++]);
+	}
+
+	// Backpressure: nothing unacknowledged is ever dropped, so a sequenced packet waits at the front of its lane while
+	// the retransmit buffer is full or a resume is pending. A window of SIZE_MAX moves everything regardless.
+	auto isReady = [this, window](const ChatPacket& packet)
+	{
+		return window == SIZE_MAX || !ChatPacket::IsSequenced(packet.header.tableId) || !IsSequencingHeld();
+	};
+
+	bool hasMore = true;
+	while (hasMore && packetsToBeSent.size() < window)
+	{
+		hasMore = false;
+
+		for (size_t i = static_cast<size_t>(ESendLane::Interactive); i < static_cast<size_t>(ESendLane::MAX); ++i)
+		{
+			auto& lane = sendLanes[i];
+			for (uint32_t n = 0; n < WEIGHTS[i] && lane.head < lane.packets.size() && packetsToBeSent.size() < window
+				&& isReady(lane.packets[lane.head]); ++n)
+			{
+				PushToWire(lane.packets[lane.head++]);
+			}
+
+			hasMore = hasMore || (lane.head < lane.packets.size() && isReady(lane.packets[lane.head]));
+		}
+	}
+
+	for (auto& lane : sendLanes)
+	{
+		if (lane.head < lane.packets.size())
+		{
+			// A lane that never drains is compacted once half of it is taken.
+			if (lane.head >= ChatConstant::SEND_WINDOW && lane.head * 2 >= lane.packets.size())
+			{
+				lane.packets.erase(lane.packets.begin(), lane.packets.begin() + lane.head);
+				lane.head = 0;
+			}
+
+			continue;
+		}
+
+		ChatBufferPool::ReleaseQueue(move(lane.packets));
+		lane.head = 0;
+	}
+}
+
+void ChatConnection::PushToWire(const ChatPacket& packet)
+{
+	if (packetsToBeSent.capacity() == 0)
+	{
+		packetsToBeSent = ChatBufferPool::AcquireQueue();
+	}
+
+	// Sequences are handed out here rather than on request, so they stay in wire order across the lanes.
+	if (!ChatPacket::IsSequenced(packet.header.tableId))
+	{
+		packetsToBeSent.emplace_back(packet);
+		return;
+	}
+
+	auto& buffer = session.retransmitBuffer;
+	buffer.push_back({ packet, chrono::steady_clock::now() });
+
+	auto& sequenced = buffer.back().packet;
+	sequenced.header.sequence = ++session.sendSequence;
+	packetsToBeSent.emplace_back(sequenced);
+}
+
+void ChatConnection::RequestSendMessage(const MessagePacket& message)
+{
+	const auto senderNumber = message.GetSenderNumber();
+	const auto text = message.message.View();
+
+	AnnounceID(senderNumber);
+
+	if (coalesceSize <= 1)
+	{
+		FlushIdMap();
+		RequestSend(ChatPacket::Encode(message));
+		return;
+	}
+
+	if (coalescedMessages != nullptr && !coalescedMessages->Add(senderNumber, text))
+	{
+		FlushCoalescedMessages();
+	}
+
+	if (coalescedMessages == nullptr)
+	{
+		coalescedMessages = make_unique<MessageBatchPacket>();
+		coalesceStartTime = chrono::steady_clock::now();
+		coalescedMessages->Add(senderNumber, text);
+	}
+
+	// A batch can only carry one trace ID; the first traced message in it wins.
+	if (coalescedMessages->header.traceId == 0)
+	{
+		coalescedMessages->header.traceId = message.header.traceId;
+	}
+
+	if (coalescedMessages->GetCount() >= coalesceSize)
+	{
+		FlushCoalescedMessages();
+	}
+}
+
+void ChatConnection::FlushCoalescedMessages()
+{
+	if (coalescedMessages == nullptr)
+		return;
+
+	const auto batch = move(coalescedMessages);
+
+	FlushIdMap();
+	RequestSend(ChatPacket::Encode(*batch));
+}
+
+void ChatConnection::AnnounceID(uint32_t number)
+{
+	if (number == ChatIdTable::SERVER_NUMBER || (number < announcedIDs.size() && announcedIDs[number]))
+		return;
+
+	const auto id = ChatIdTable::Find(number);
+	if (id == nullptr)
+		return;
+
+	if (pendingIdMap != nullptr && !pendingIdMap->Add(number, *id))
+	{
+		FlushIdMap();
+	}
+
+	if (pendingIdMap == nullptr)
+	{
+		pendingIdMap = make_unique<IdMapPacket>();
+		pendingIdMap->Add(number, *id);
+	}
+
+	if (number >= announcedIDs.size())
+	{
+		announcedIDs.resize(number + 1, false);
+	}
+
+	announcedIDs[number] = true;
+}
+
+void ChatConnection::FlushIdMap()
+{
+	if (pendingIdMap == nullptr)
+		return;
+
+	// Shares the lane of the messages, so it is on the wire before any message queued after it.
+	RequestSend(ChatPacket::Encode(*pendingIdMap));
+	pendingIdMap.reset();
 }
 
 void ChatConnection::Receive()
 {
-	constexpr int MAX_SIZE = ChatConstant::PACKET_SIZE;
+	// Shared by every connection of the thread; whatever is left of a frame at the end of a read moves to receiveBuffer.
+	static thread_local char chunk[ChatConstant::RECEIVE_CHUNK_SIZE];
 
-	int recvBytes = recv(socket, (char*)receiveBuffer, MAX_SIZE, 0);
-	if (recvBytes < 1)
+	if (IsOnSharedRing())
 	{
-		cout << "[ChatConnection] Broken connection. " << identifier << "@" << address << endl;
-		Close();
+		ReceiveSharedRing();
 		return;
 	}
 
+	for (int numBytes = 0; numBytes < ChatConstant::MAX_RECEIVE_BYTES_PER_CALL && socket != INVALID_SOCKET; )
+	{
+		int recvBytes = recv(socket, chunk, sizeof(chunk), 0);
+		if (recvBytes == SOCKET_ERROR && WSAGetLastError() == WSAEWOULDBLOCK)
+			break;
+
+		if (recvBytes < 1)
+		{
+			cout << "[ChatConnection] Broken connection. " << GetID() << "@" << GetAddress() << endl;
+			Close();
+			return;
+		}
+
+		// Any inbound bytes prove the peer alive, a heartbeat may be stuck behind a long backlog on its side.
+		timeStamp = chrono::steady_clock::now();
+		numBytes += recvBytes;
+
+		ReceiveFrames(chunk, recvBytes);
+
+		if (IsOnSharedRing())
+		{
+			// The peer only writes wake-ups after its last frame, so the rest of the chunk carries nothing.
+			ReceiveSharedRing();
+			break;
+		}
+	}
+
+	// Only a partially received packet keeps the buffer.
+	if (receivedLength == 0 && receiveBuffer != nullptr)
+	{
+		ChatBufferPool::ReleasePacket(receiveBuffer);
+		receiveBuffer = nullptr;
+	}
+}
+
+void ChatConnection::ReceiveFrames(const char* bytes, int length)
+{
+	constexpr int HEADER_SIZE = sizeof(ChatPacket::Header);
+
+	const char* cursor = bytes;
+	const char* end = bytes + length;
+
+	while (cursor < end && socket != INVALID_SOCKET && !IsOnSharedRing())
+	{
+		if (receiveBuffer == nullptr)
+		{
+			receiveBuffer = ChatBufferPool::AcquirePacket();
+		}
+
+		// The header tells how much of the frame follows it.
+		const int frameSize = receivedLength < HEADER_SIZE ? HEADER_SIZE : static_cast<int>(receiveBuffer->GetWireSize());
+		const int taken = std::min<int>(frameSize - receivedLength, static_cast<int>(end - cursor));
+
+		memcpy(reinterpret_cast<char*>(receiveBuffer) + receivedLength, cursor, taken);
+		receivedLength += taken;
+		cursor += taken;
+
+		if (receivedLength == HEADER_SIZE)
+		{
+			const auto payloadLength = receiveBuffer->header.payloadLength;
+			if (payloadLength > ChatPacket::PAYLOAD_SIZE)
+			{
+				cerr << "[ChatConnection][Error] " << GetID() << '@' << GetAddress() << " : frame of " << payloadLength
+					<< " bytes exceeds the payload size." << endl;
+				Close();
+				return;
+			}
+
+			// A pooled buffer still holds the tail of an earlier frame.
+			memset(receiveBuffer->payload + payloadLength, 0, ChatPacket::PAYLOAD_SIZE - payloadLength);
+		}
+
+		if (receivedLength < HEADER_SIZE || receivedLength < static_cast<int>(receiveBuffer->GetWireSize()))
+			continue;
+
+		receivedLength = 0;
+		ProcessReceived(*receiveBuffer);
+	}
+}
+
+void ChatConnection::ReceiveSharedRing()
+{
+	char wakeUps[64];
+
+	while (true)
+	{
+		int recvBytes = recv(socket, wakeUps, sizeof(wakeUps), 0);
+		if (recvBytes == SOCKET_ERROR && WSAGetLastError() == WSAEWOULDBLOCK)
+			break;
+
+		if (recvBytes < 1)
+		{
+			cout << "[ChatConnection] Broken connection. " << GetID() << "@" << GetAddress() << endl;
+			Close();
+			return;
+		}
+
+		timeStamp = chrono::steady_clock::now();
+	}
+
+	// The ring has to be drained completely, the writer only wakes us up again once it sees it empty.
+	ChatPacket packet;
+	while (sharedRing != nullptr && sharedRing->Read(packet))
+	{
+		timeStamp = chrono::steady_clock::now();
+		ProcessReceived(packet);
+	}
+}
+
+void ChatConnection::InjectReceived(const ChatPacket& packet)
+{
 	timeStamp = chrono::steady_clock::now();
 
-	if (recvBytes < ChatConstant::PACKET_SIZE)
-		return;
+	ChatPacket injected(packet);
+	ProcessReceived(injected);
+}
 
-	assert(recvBytes <= MAX_SIZE);
-	recvBytes = std::min<int>(recvBytes, MAX_SIZE);
-	auto& header = reinterpret_cast<ChatPacket::Header&>(receiveBuffer[0]);
+void ChatConnection::ProcessReceived(ChatPacket& packet)
+{
+	auto& header = packet.header;
+
+	if (capture != nullptr)
+	{
+		capture->Write(handle, packet);
+	}
 
 	if (header.tableId == EChatTableID::HEARTBEAT)
 		return;
 
+	if (header.tableId == EChatTableID::PING_TABLE)
+	{
+		PingPacket ping;
+		if (packet.Decode(ping))
+		{
+			ProcessPing(ping);
+		}
+
+		return;
+	}
+
+	// Data keeps the link alive on its own; once it goes quiet, pinging starts over from the shortest period.
+	isIdleSincePing = false;
+	heartBeatPeriod = chrono::milliseconds(ChatConstant::HEART_BEAT_PERIOD);
+
+	if (header.tableId == EChatTableID::ACK_TABLE)
+	{
+		AckPacket ack;
+		if (packet.Decode(ack))
+		{
+			ProcessAck(ack.GetAckSequence(), true);
+		}
+
+		return;
+	}
+
+	if (header.tableId == EChatTableID::SHARED_RING_TABLE)
+	{
+		SharedRingPacket sharedRing;
+		if (packet.Decode(sharedRing))
+		{
+			ProcessSharedRing(sharedRing);
+		}
+
+		return;
+	}
+
+	// Data packets are sampled where they enter; forwarded copies keep the ID they arrived with.
+	if (header.traceId == 0 && header.sequence != 0 && ChatTracer::IsEnabled())
+	{
+		header.traceId = ChatTracer::Sample();
+	}
+
+	ChatTraceScope traceScope("Receive", header.traceId);
+
+	if (header.sequence != 0)
+	{
+		if (header.sequence <= session.receivedSequence)
+			return;
+
+		session.receivedSequence = header.sequence;
+		ScheduleAck();
+	}
+
 	switch (header.packetType)
 	{
 	case ChatPacket::EPacketType::Normal:
-	{
-		auto& packet = reinterpret_cast<ChatPacket&>(header);
 		receivedPackets.emplace_back(packet);
-	}
 		break;
 
 	default:
@@ -132,24 +567,521 @@ std::vector<ChatPacket> ChatConnection::ExtractReceived()
 
 void ChatConnection::FlushSendRequests()
 {
-	for (const auto& packet : packetsToBeSent)
+	const auto currentTime = chrono::steady_clock::now();
+
+	if (coalescedMessages != nullptr && currentTime >= coalesceStartTime + coalesceDelay)
+	{
+		FlushCoalescedMessages();
+	}
+
+	if (isAckPending && currentTime >= ackDueTime)
+	{
+		isAckPending = false;
+
+		AckPacket ack(session.receivedSequence);
+		RequestSend(ChatPacket::Encode(ack));
+	}
+
+	const auto numRequests = GetNumSendRequests();
+	if (numRequests == 0)
+		return;
+
+	if (socket == INVALID_SOCKET)
+	{
+		// Sequenced packets still in the lanes have to reach the retransmit buffer to survive in the session.
+		ScheduleLanes(SIZE_MAX);
+		packetsToBeSent.clear();
+		sendOffset = 0;
+		return;
+	}
+
+	if (batchSize > 1 && sendOffset == 0 && numRequests < batchSize
+		&& currentTime < firstRequestTime + batchDelay)
+	{
+		return;
+	}
+
+	// The wire queue is refilled a window at a time while the transport keeps up.
+	do
+	{
+		ScheduleLanes(ChatConstant::SEND_WINDOW);
+
+		const size_t numStreamed = sharedRing != nullptr ? numStreamPackets : packetsToBeSent.size();
+		if (numStreamed > 0 && !SendStream(numStreamed))
+			return;
+
+		if (IsOnSharedRing() && !packetsToBeSent.empty())
+		{
+			WriteSharedRing();
+		}
+	}
+	while (packetsToBeSent.empty() && socket != INVALID_SOCKET && GetNumSendRequests() > 0 && !IsSequencingHeld());
+
+	ReleaseIdleBuffers();
+}
+
+void ChatConnection::ReleaseIdleBuffers()
+{
+	if (packetsToBeSent.empty() && sendOffset == 0)
+	{
+		ChatBufferPool::ReleaseQueue(move(packetsToBeSent));
+	}
+}
+
+bool ChatConnection::SendStream(size_t numPackets)
+{
+	// Frames are trimmed to their payload and gathered so the window still goes out in one send; sendOffset is
+	// counted from the start of the first frame. Shared by every connection of the thread, it is refilled each call.
+	static thread_local vector<char> wireBytes;
+
+	wireBytes.clear();
+	for (size_t i = 0; i < numPackets; ++i)
+	{
+		const char* frame = reinterpret_cast<const char*>(&packetsToBeSent[i]);
+		wireBytes.insert(wireBytes.end(), frame, frame + packetsToBeSent[i].GetWireSize());
+	}
+
+	const char* data = wireBytes.data();
+	const size_t totalBytes = wireBytes.size();
+	const auto startTime = ChatTracer::IsEnabled() ? ChatTracer::Now() : 0;
+
+	while (sendOffset < totalBytes)
+	{
+		const int length = static_cast<int>(std::min<size_t>(totalBytes - sendOffset, INT_MAX));
+		const int sentBytes = send(socket, data + sendOffset, length, 0);
+
+		if (trafficStats != nullptr)
+		{
+			trafficStats->numSendCalls.fetch_add(1, memory_order_relaxed);
+		}
+
+		if (sentBytes == SOCKET_ERROR)
+		{
+			if (WSAGetLastError() == WSAEWOULDBLOCK)
+			{
+				isSendBlocked = true;
+				break;
+			}
+
+			cout << "[ChatConnection] Broken connection while sending. " << GetID() << "@" << GetAddress() << endl;
+			Close();
+
+			packetsToBeSent.clear();
+			sendOffset = 0;
+			return false;
+		}
+
+		sendOffset += sentBytes;
+	}
+
+	size_t numSent = 0;
+	while (numSent < numPackets && sendOffset >= packetsToBeSent[numSent].GetWireSize())
+	{
+		sendOffset -= packetsToBeSent[numSent++].GetWireSize();
+	}
+
+	if (trafficStats != nullptr)
+	{
+		trafficStats->numSentPackets.fetch_add(numSent, memory_order_relaxed);
+	}
+
+	if (numSent > 0)
+	{
+		sendTimeStamp = chrono::steady_clock::now();
+	}
+
+	if (startTime != 0)
+	{
+		RecordSent("Send", numSent, startTime);
+	}
+
+	packetsToBeSent.erase(packetsToBeSent.begin(), packetsToBeSent.begin() + numSent);
+	numStreamPackets -= std::min(numStreamPackets, numSent);
+
+	if (numSent < numPackets)
+		return false;
+
+	isSendBlocked = false;
+	return true;
+}
+
+void ChatConnection::WriteSharedRing()
+{
+	bool needsWakeUp = false;
+	const auto startTime = ChatTracer::IsEnabled() ? ChatTracer::Now() : 0;
+	const auto numWritten = sharedRing->Write(packetsToBeSent.data(), packetsToBeSent.size(), needsWakeUp);
+
+	if (startTime != 0)
+	{
+		RecordSent("WriteSharedRing", numWritten, startTime);
+	}
+
+	packetsToBeSent.erase(packetsToBeSent.begin(), packetsToBeSent.begin() + numWritten);
+
+	if (numWritten > 0)
+	{
+		sendTimeStamp = chrono::steady_clock::now();
+	}
+
+	if (trafficStats != nullptr)
 	{
-		const char* data = reinterpret_cast<const char*>(&packet);
-		send(socket, data, sizeof(packet), 0);
+		trafficStats->numSentPackets.fetch_add(numWritten, memory_order_relaxed);
 	}
 
-	packetsToBeSent.clear();
+	if (!packetsToBeSent.empty())
+	{
+		// The reader is behind; try again shortly instead of spinning on a writable socket.
+		sharedRingRetryTime = chrono::steady_clock::now() + chrono::milliseconds(1);
+	}
+
+	if (!needsWakeUp)
+		return;
+
+	if (trafficStats != nullptr)
+	{
+		trafficStats->numSendCalls.fetch_add(1, memory_order_relaxed);
+	}
+
+	// A full socket buffer still holds unread wake-ups, so a would-block loses nothing.
+	const char wakeUp = 0;
+	if (send(socket, &wakeUp, 1, 0) == SOCKET_ERROR && WSAGetLastError() != WSAEWOULDBLOCK)
+	{
+		cout << "[ChatConnection] Broken connection while waking up the ring reader. " << GetID() << "@" << GetAddress() << endl;
+		Close();
+
+		packetsToBeSent.clear();
+	}
+}
+
+void ChatConnection::RecordSent(const char* name, size_t numPackets, int64_t startTime) const
+{
+	const auto endTime = ChatTracer::Now();
+
+	for (size_t i = 0; i < numPackets; ++i)
+	{
+		const auto traceId = packetsToBeSent[i].header.traceId;
+		if (traceId != 0)
+		{
+			ChatTracer::Record(name, traceId, startTime, endTime);
+		}
+	}
+}
+
+Network::TTimeStamp ChatConnection::GetNextDueTime() const
+{
+	auto due = Network::TTimeStamp::max();
+
+	if (isAckPending)
+	{
+		due = ackDueTime;
+	}
+
+	// Held sequenced packets only become due with the ack or resume that releases them.
+	const auto& control = sendLanes[static_cast<size_t>(ChatPacket::ESendLane::Control)];
+	const bool hasSendable = IsSequencingHeld() ? !packetsToBeSent.empty() || control.GetSize() > 0 : GetNumSendRequests() > 0;
+	const bool hasStreamPackets = sharedRing != nullptr ? numStreamPackets > 0 : hasSendable;
+	if (hasStreamPackets && !isSendBlocked)
+	{
+		due = std::min(due, batchSize > 1 ? firstRequestTime + batchDelay : firstRequestTime);
+	}
+
+	if (coalescedMessages != nullptr)
+	{
+		due = std::min(due, coalesceStartTime + coalesceDelay);
+	}
+
+	if (IsOnSharedRing() && GetNumSendRequests() > numStreamPackets)
+	{
+		due = std::min(due, sharedRingRetryTime);
+	}
+
+	return due;
 }
 
 void ChatConnection::SendHeartBeat()
 {
-	ChatPacket packet;
-	const char* data = reinterpret_cast<const char*>(&packet);
-	send(socket, data, sizeof(packet), 0);
+	RequestSend(ChatPacket());
+}
+
+void ChatConnection::SendPing()
+{
+	// The last ping was answered and nothing else arrived since, so the link is idle; ping it less often.
+	if (isIdleSincePing && !isPingPending)
+	{
+		heartBeatPeriod = std::min(heartBeatPeriod * 2, chrono::milliseconds(ChatConstant::MAX_HEART_BEAT_PERIOD));
+	}
+
+	pingTime = chrono::steady_clock::now();
+	isPingPending = true;
+	isIdleSincePing = true;
+
+	const auto sendTime = chrono::duration_cast<chrono::microseconds>(pingTime.time_since_epoch()).count();
+	PingPacket ping(static_cast<uint64_t>(sendTime), static_cast<uint32_t>(heartBeatPeriod.count()), true);
+	RequestSend(ChatPacket::Encode(ping));
+
+	if (trafficStats != nullptr)
+	{
+		trafficStats->numPings.fetch_add(1, memory_order_relaxed);
+	}
+}
+
+Network::TTimeStamp ChatConnection::GetNextPingTime() const
+{
+	return std::max(timeStamp, pingTime) + heartBeatPeriod;
+}
+
+std::chrono::milliseconds ChatConnection::GetTimeout() const
+{
+	// Within one period of silence a ping is sent or, on the pinged side, expected. Beyond that a slow link
+	// is told from a dead one by its retransmit timeout.
+	const auto grace = std::max(chrono::milliseconds(ChatConstant::PING_GRACE_PERIOD),
+		chrono::duration_cast<chrono::milliseconds>(rtt.GetRetransmitTimeout() * ChatConstant::PING_GRACE_RTOS));
+
+	return std::max(heartBeatPeriod, peerHeartBeatPeriod) + grace;
+}
+
+void ChatConnection::ProcessPing(const PingPacket& ping)
+{
+	if (ping.IsRequest())
+	{
+		peerHeartBeatPeriod = chrono::milliseconds(ping.GetHeartBeatPeriod());
+
+		// The pong goes through the control lane ahead of queued data, so it measures the link rather than our backlog.
+		PingPacket pong(ping.GetSendTime(), ping.GetHeartBeatPeriod(), false);
+		RequestSend(ChatPacket::Encode(pong));
+		return;
+	}
+
+	// A pong nobody waits for was not sent by this process, e.g. it is replayed from a capture.
+	if (!isPingPending)
+		return;
+
+	isPingPending = false;
+
+	const auto currentTime = chrono::duration_cast<chrono::microseconds>(chrono::steady_clock::now().time_since_epoch());
+	const auto sample = currentTime - chrono::microseconds(ping.GetSendTime());
+	if (sample.count() < 0)
+		return;
+
+	rtt.AddSample(sample);
+}
+
+void ChatConnection::SetBatchPolicy(size_t maxPackets, std::chrono::milliseconds maxDelay)
+{
+	batchSize = std::max<size_t>(maxPackets, 1);
+	batchDelay = maxDelay;
+}
+
+void ChatConnection::SetCoalescePolicy(size_t maxMessages, std::chrono::milliseconds maxDelay)
+{
+	coalesceSize = std::max<size_t>(maxMessages, 1);
+	coalesceDelay = maxDelay;
+
+	if (coalesceSize <= 1)
+	{
+		FlushCoalescedMessages();
+	}
+}
+
+bool ChatConnection::RequestSharedRing(const std::string& name, uint32_t capacity)
+{
+	if (!isLocal || sharedRing != nullptr)
+		return false;
+
+	auto ring = make_unique<ChatSharedRing>();
+	if (!ring->Create(name, capacity))
+		return false;
+
+	// Everything queued so far still goes through the socket, and the request has to be the last of it:
+	// the other side takes whatever follows on the socket for wake-ups.
+	ScheduleLanes(SIZE_MAX);
+
+	SharedRingPacket request(name, true);
+	RequestSend(ChatPacket::Encode(request));
+	ScheduleLanes(SIZE_MAX);
+
+	sharedRing = move(ring);
+	isSharedRingPending = true;
+	numStreamPackets = packetsToBeSent.size();
+
+	return true;
+}
+
+void ChatConnection::ProcessSharedRing(const SharedRingPacket& packet)
+{
+	if (packet.IsRequest())
+	{
+		auto ring = make_unique<ChatSharedRing>();
+		const bool isAccepted = isLocal && sharedRing == nullptr && ring->Open(packet.GetName());
+
+		ScheduleLanes(SIZE_MAX);
+
+		SharedRingPacket answer(packet.GetName(), false, isAccepted);
+		RequestSend(ChatPacket::Encode(answer));
+		ScheduleLanes(SIZE_MAX);
+
+		if (!isAccepted)
+		{
+			cerr << "[ChatConnection][Error] " << GetID() << '@' << GetAddress() << " : shared ring declined." << endl;
+			return;
+		}
+
+		sharedRing = move(ring);
+		numStreamPackets = packetsToBeSent.size();
+
+		cout << "[ChatConnection] " << GetID() << '@' << GetAddress() << " moved onto shared ring " << packet.GetName() << endl;
+		return;
+	}
+
+	if (!isSharedRingPending)
+		return;
+
+	isSharedRingPending = false;
+
+	if (!packet.IsAccepted())
+	{
+		cerr << "[ChatConnection][Error] shared ring declined, staying on the socket." << endl;
+
+		sharedRing.reset();
+		numStreamPackets = 0;
+	}
 }
 
 void ChatConnection::SetID(const char* id)
 {
-	identifier = id;
+	identifier = &ChatIdTable::Intern(id);
+	idNumber = ChatIdTable::GetNumber(*identifier);
+	isIdentified = true;
+}
+
+void ChatConnection::SetPeer(const char* nodeName)
+{
+	isPeer = true;
+	identifier = &ChatIdTable::Intern(nodeName);
+	idNumber = ChatIdTable::GetNumber(*identifier);
+}
+
+void ChatConnection::MapPeerNumber(uint32_t peerNumber, uint32_t number)
+{
+	if (peerNumber >= peerNumbers.size())
+	{
+		peerNumbers.resize(peerNumber + 1, NO_NUMBER);
+	}
+
+	peerNumbers[peerNumber] = number;
+}
+
+uint32_t ChatConnection::FindPeerNumber(uint32_t peerNumber) const
+{
+	if (peerNumber == ChatIdTable::SERVER_NUMBER)
+		return ChatIdTable::SERVER_NUMBER;
+
+	return peerNumber < peerNumbers.size() ? peerNumbers[peerNumber] : NO_NUMBER;
 }
 
+std::string ChatConnection::GetAddress() const
+{
+	if (isLocal)
+		return "local";
+
+	if (peerAddress.sin_family != AF_INET)
+		return "SomeWhere";
+
+	char ipAddress[16];
+	string address(inet_ntop(AF_INET, &peerAddress.sin_addr, ipAddress, sizeof(ipAddress)));
+	address += ':';
+	address += to_string(ntohs(peerAddress.sin_port));
+
+	return address;
+}
+
+
+
+ChatSession ChatConnection::ExtractSession()
+{
+	// Messages still held for coalescing belong to the session like any other unsent ones.
+	FlushCoalescedMessages();
+	ScheduleLanes(SIZE_MAX);
+
+	ChatSession extracted;
+	swap(extracted, session);
+	extracted.retiredTime = chrono::steady_clock::now();
+
+	return extracted;
+}
+
+void ChatConnection::RestoreSession(ChatSession&& retained, uint32_t peerReceivedSequence)
+{
+	AdoptSession(move(retained));
+	Resume(peerReceivedSequence);
+}
+
+void ChatConnection::AdoptSession(ChatSession&& retained)
+{
+	session = move(retained);
+	isResumePending = true;
+}
+
+void ChatConnection::ForgetReceivedSequence()
+{
+	session.receivedSequence = 0;
+	isAckPending = false;
+}
+
+void ChatConnection::Resume(uint32_t peerReceivedSequence)
+{
+	isResumePending = false;
+	ProcessAck(peerReceivedSequence, false);
+
+	vector<ChatPacket> resent;
+	resent.reserve(session.retransmitBuffer.size() + packetsToBeSent.size());
+
+	auto begin = packetsToBeSent.begin();
+	if (sendOffset > 0 && begin != packetsToBeSent.end())
+	{
+		// The partially sent packet has to be completed first to keep the stream framed.
+		resent.emplace_back(*begin);
+		++begin;
+	}
+
+	for (auto& pending : session.retransmitBuffer)
+	{
+		resent.emplace_back(pending.packet);
+	}
+
+	for (auto it = begin; it != packetsToBeSent.end(); ++it)
+	{
+		if (it->header.sequence != 0)
+			continue;
+
+		resent.emplace_back(*it);
+	}
+
+	swap(resent, packetsToBeSent);
+}
+
+void ChatConnection::ScheduleAck()
+{
+	if (isAckPending)
+		return;
+
+	isAckPending = true;
+	ackDueTime = chrono::steady_clock::now() + chrono::milliseconds(ChatConstant::ACK_DELAY);
+}
+
+void ChatConnection::ProcessAck(uint32_t ackSequence, bool recordLatency)
+{
+	const auto currentTime = chrono::steady_clock::now();
+	auto& buffer = session.retransmitBuffer;
+
+	while (!buffer.empty() && buffer.front().packet.header.sequence <= ackSequence)
+	{
+		if (recordLatency && deliveryLatency != nullptr)
+		{
+			const auto latency = currentTime - buffer.front().sentTime;
+			deliveryLatency->Record(chrono::duration_cast<chrono::microseconds>(latency));
+		}
+
+		buffer.pop_front();
+	}
+}
\ No newline at end of file
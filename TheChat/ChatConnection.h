@@ -1,48 +1,212 @@
 #pragma once
 
+#include <atomic>
 #include <chrono>
+#include <memory>
 #include <string>
 #include <vector>
 
+#include "ChatCapture.h"
 #include "ChatConstant.h"
+#include "ChatHistogram.h"
 #include "ChatPacket.h"
+#include "ChatRttEstimator.h"
+#include "ChatSession.h"
+#include "ChatSharedRing.h"
+#include "IdMapPacket.h"
+#include "MessageBatchPacket.h"
+#include "MessagePacket.h"
 #include "Network.h"
+#include "PingPacket.h"
+#include "SharedRingPacket.h"
+
+
+// Traffic counters shared by the connections of one server, reset by whoever reports them.
+// Connections may be flushed from several threads at once, hence the atomics.
+struct ChatTrafficStats final
+{
+	std::atomic<uint64_t> numSentPackets = 0;
+	std::atomic<uint64_t> numSendCalls = 0;
+	std::atomic<uint64_t> numPings = 0;
+};
+
+// Packets of one priority waiting for the wire queue. They are taken from the front by advancing head,
+// the storage goes back to ChatBufferPool once the lane is drained.
+struct ChatSendLane final
+{
+	std::vector<ChatPacket> packets;
+	size_t head = 0;
+
+	inline size_t GetSize() const { return packets.size() - head; }
+};
 
 
 class ChatConnection final
 {
 private:
-	bool isAlive;
-	std::string identifier;
-	std::string address;
+	// An idle connection only keeps what it needs to be polled: the ID is interned, the address is kept
+	// raw and formatted on demand, and buffers come from ChatBufferPool only while data is in flight.
+	const std::string* identifier;
+	uint32_t idNumber;
 	Network::TSocket socket;
 	Network::TTimeStamp timeStamp;
+	struct sockaddr_in peerAddress;
+
+	ChatSession session;
+	Network::TTimeStamp ackDueTime;
+	ChatHistogram* deliveryLatency;
+
+	// Whoever pings does so once nothing arrived for heartBeatPeriod, doubling the period while the link stays idle
+	// and resetting it once data flows again. Pongs feed the RTT estimate; the pinged side only learns
+	// peerHeartBeatPeriod, the silence it has to expect at most.
+	Network::TTimeStamp sendTimeStamp;
+	Network::TTimeStamp pingTime;
+	std::chrono::milliseconds heartBeatPeriod;
+	std::chrono::milliseconds peerHeartBeatPeriod;
+	ChatRttEstimator rtt;
+
+	uint64_t handle;
+	uint64_t roomCursor;
+	ChatCapture* capture;
+
+	uint32_t batchSize;
+	std::chrono::milliseconds batchDelay;
+	Network::TTimeStamp firstRequestTime;
+
+	uint32_t coalesceSize;
+	std::chrono::milliseconds coalesceDelay;
+	Network::TTimeStamp coalesceStartTime;
+	std::unique_ptr<MessageBatchPacket> coalescedMessages;
+	ChatTrafficStats* trafficStats;
 
+	// Sender numbers whose ID was already sent to this connection, and the entries not sent yet. A peer node
+	// numbers IDs on its own; peerNumbers turns its numbers into ours, NO_NUMBER where it has not mapped one.
+	std::vector<bool> announcedIDs;
+	std::unique_ptr<IdMapPacket> pendingIdMap;
+	std::vector<uint32_t> peerNumbers;
+
+	// Same-host connections may move their packets onto a shared memory ring. The first numStreamPackets
+	// queued packets still go through the socket, which only carries wake-up bytes afterwards.
+	size_t numStreamPackets;
+	Network::TTimeStamp sharedRingRetryTime;
+	std::unique_ptr<ChatSharedRing> sharedRing;
+
+	// Requests wait in a lane by priority; packetsToBeSent is the wire queue, sequenced and committed
+	// to the stream in order, and refilled from the lanes up to ChatConstant::SEND_WINDOW.
 	std::vector<ChatPacket> receivedPackets;
+	ChatSendLane sendLanes[static_cast<size_t>(ChatPacket::ESendLane::MAX)];
 	std::vector<ChatPacket> packetsToBeSent;
+	size_t sendOffset;
+
+	// Holds a partially received packet between Receive() calls, nullptr otherwise.
+	ChatPacket* receiveBuffer;
+	int receivedLength;
 
-	uint8_t receiveBuffer[ChatConstant::PACKET_SIZE];
+	bool isAlive;
+	bool isPingPending;
+	bool isIdleSincePing;
+	bool isResumePending;
+	bool isAckPending;
+	bool isIdentified;
+	bool isPeer;
+	bool isLocal;
+	bool isSharedRingPending;
+	bool isSendBlocked;
 
 public:
+	static constexpr uint32_t NO_NUMBER = UINT32_MAX;
+
 	ChatConnection();
 	ChatConnection(Network::TSocket socket);
 	~ChatConnection();
 
-	inline bool operator == (const ChatConnection& rhs) const { return socket == rhs.socket; }
-	inline bool operator != (const ChatConnection& rhs) const { return socket != rhs.socket; }
+	ChatConnection(const ChatConnection&) = delete;
+	ChatConnection& operator = (const ChatConnection&) = delete;
+
+	inline bool operator == (const ChatConnection& rhs) const { return this == &rhs; }
+	inline bool operator != (const ChatConnection& rhs) const { return this != &rhs; }
 	void Close();
 
 	bool IsAlive() const;
 	void RequestSend(const ChatPacket& packet);
+	void RequestSendMessage(const MessagePacket& message);
+	inline bool HasSendRequests() const { return GetNumSendRequests() > 0 || isAckPending || coalescedMessages != nullptr; }
 	void Receive();
+	void InjectReceived(const ChatPacket& packet);
 
 	std::vector<ChatPacket> ExtractReceived();
 	void FlushSendRequests();
 
 	void SendHeartBeat();
+	void SendPing();
+	inline bool IsPingDue(Network::TTimeStamp currentTime) const { return currentTime >= GetNextPingTime(); }
+	Network::TTimeStamp GetNextPingTime() const;
+	std::chrono::milliseconds GetTimeout() const;
 	void SetID(const char* id);
+	void SetPeer(const char* nodeName);
+	void MapPeerNumber(uint32_t peerNumber, uint32_t number);
+	uint32_t FindPeerNumber(uint32_t peerNumber) const;
+	void SetBatchPolicy(size_t maxPackets, std::chrono::milliseconds maxDelay);
+	void SetCoalescePolicy(size_t maxMessages, std::chrono::milliseconds maxDelay);
+	bool RequestSharedRing(const std::string& name, uint32_t capacity);
 
-	inline auto& GetID() const { return identifier; }
-	inline auto& GetAddress() const { return address; }
+	ChatSession ExtractSession();
+	void RestoreSession(ChatSession&& retained, uint32_t peerReceivedSequence);
+	// Takes a retained session over but holds its sequenced packets until Resume() learns what the peer received.
+	void AdoptSession(ChatSession&& retained);
+	void Resume(uint32_t peerReceivedSequence);
+	// The peer started a new session, so its sequences start over.
+	void ForgetReceivedSequence();
+	inline void SetSessionToken(uint64_t token) { session.token = token; }
+	inline auto GetSessionToken() const { return session.token; }
+
+	inline void SetDeliveryLatencyHistogram(ChatHistogram* histogram) { deliveryLatency = histogram; }
+	inline void SetTrafficStats(ChatTrafficStats* stats) { trafficStats = stats; }
+	inline void SetCapture(ChatCapture* capture) { this->capture = capture; }
+	inline void SetHandle(uint64_t handle) { this->handle = handle; }
+	inline auto GetHandle() const { return handle; }
+	inline void SetRoomCursor(uint64_t cursor) { roomCursor = cursor; }
+	inline auto GetRoomCursor() const { return roomCursor; }
+	size_t GetNumSendRequests() const;
+	Network::TTimeStamp GetNextDueTime() const;
+
+	inline bool IsSendBlocked() const { return isSendBlocked; }
+	inline bool IsAckPending() const { return isAckPending; }
+	inline auto GetAckDueTime() const { return ackDueTime; }
+	inline auto GetReceivedSequence() const { return session.receivedSequence; }
+
+	// Zero until the first pong arrived.
+	inline auto GetSmoothedRtt() const { return rtt.GetSmoothedRtt(); }
+	inline auto GetRttVariance() const { return rtt.GetVariance(); }
+	inline auto GetHeartBeatPeriod() const { return heartBeatPeriod; }
+	inline bool IsPinged() const { return peerHeartBeatPeriod.count() > 0; }
+	inline auto GetLastSendTime() const { return sendTimeStamp; }
+
+	inline auto& GetID() const { return *identifier; }
+	inline auto GetIDNumber() const { return idNumber; }
+	std::string GetAddress() const;
 	inline auto GetSocket() { return socket; }
+	inline bool IsIdentified() const { return isIdentified; }
+	inline bool IsPeer() const { return isPeer; }
+	inline bool IsLocal() const { return isLocal; }
+	inline bool IsOnSharedRing() const { return sharedRing != nullptr && !isSharedRingPending; }
+
+private:
+	void ReceiveFrames(const char* bytes, int length);
+	void ProcessReceived(ChatPacket& packet);
+	inline bool IsSequencingHeld() const { return isResumePending || session.retransmitBuffer.size() >= static_cast<size_t>(ChatConstant::RETRANSMIT_BUFFER_SIZE); }
+	void ReleaseIdleBuffers();
+	void ScheduleLanes(size_t window);
+	void PushToWire(const ChatPacket& packet);
+	void ProcessSharedRing(const SharedRingPacket& packet);
+	void ReceiveSharedRing();
+	bool SendStream(size_t numPackets);
+	void RecordSent(const char* name, size_t numPackets, int64_t startTime) const;
+	void WriteSharedRing();
+	void FlushCoalescedMessages();
+	void AnnounceID(uint32_t number);
+	void FlushIdMap();
+	void ProcessPing(const PingPacket& ping);
+	void ScheduleAck();
+	void ProcessAck(uint32_t ackSequence, bool recordLatency);
 };
\ No newline at end of file
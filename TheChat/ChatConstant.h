@@ -1,5 +1,6 @@
 #pragma once
 
+#include <cstddef>
 #include <cstdint>
 
 
@@ -9,9 +10,66 @@ namespace ChatConstant
 	
 	static constexpr int PACKET_SIZE = 256;
 	static constexpr int PACKET_LAST_INDEX = PACKET_SIZE - 1;
+	// Frames are only as long as their payload, so a read takes in several and a call is bounded in bytes.
+	static constexpr int RECEIVE_CHUNK_SIZE = PACKET_SIZE * 16;
+	static constexpr int MAX_RECEIVE_PER_CALL = 64;
+	static constexpr int MAX_RECEIVE_BYTES_PER_CALL = PACKET_SIZE * MAX_RECEIVE_PER_CALL;
 	
+	// A connection that went quiet is pinged after HEART_BEAT_PERIOD, backing off to MAX_HEART_BEAT_PERIOD while it stays idle.
+	// It times out one period plus PING_GRACE_PERIOD, or PING_GRACE_RTOS retransmit timeouts on a slow link, after it went quiet.
 	static constexpr uint32_t HEART_BEAT_PERIOD = 2000;
+	static constexpr uint32_t MAX_HEART_BEAT_PERIOD = 30000;
 	static constexpr uint32_t CONNECTION_TIMEOUT = HEART_BEAT_PERIOD * 5;
+	static constexpr uint32_t PING_GRACE_PERIOD = CONNECTION_TIMEOUT - HEART_BEAT_PERIOD;
+	static constexpr int PING_GRACE_RTOS = 4;
+	// A client the server has not pinged yet sends heartbeats instead, strictly less often than the server pings so
+	// the first ping always wins the race, yet well within CONNECTION_TIMEOUT for a server that never pings.
+	static constexpr uint32_t UNPINGED_HEART_BEAT_PERIOD = HEART_BEAT_PERIOD * 2;
+	static_assert(UNPINGED_HEART_BEAT_PERIOD > HEART_BEAT_PERIOD && UNPINGED_HEART_BEAT_PERIOD < CONNECTION_TIMEOUT,
+		"A client heartbeat has to lose the race to the first ping and still beat the timeout.");
 
 	static constexpr int ID_LENGTH = 32;
-}
+
+	static constexpr uint32_t ACK_DELAY = 20;
+	// A client sending more than this before its greeting is authorized is disconnected.
+	static constexpr size_t MAX_PACKETS_AWAITING_AUTH = 64;
+	// Sequenced packets wait in their send lane once this many are unacknowledged.
+	static constexpr int RETRANSMIT_BUFFER_SIZE = 1024;
+	static constexpr uint32_t SESSION_RETENTION_PERIOD = CONNECTION_TIMEOUT * 6;
+	static constexpr uint32_t METRICS_REPORT_PERIOD = 10000;
+	static constexpr uint32_t PRESENCE_TICK = 100;
+	static constexpr uint64_t CAPTURE_CAPACITY = 1 << 18;
+
+	// Broadcasts to a client are coalesced into one frame per tick, or held up to the delay until the size is reached.
+	static constexpr uint32_t COALESCE_DELAY = 0;
+	static constexpr int COALESCE_SIZE = 32;
+
+	// Messages published to the room stay readable for one lap of the ring.
+	static constexpr size_t ROOM_RING_CAPACITY = 4096;
+
+	// With this many connections, reading the room and flushing is split into chunks run on the fan-out pool.
+	static constexpr size_t FAN_OUT_PARALLEL_THRESHOLD = 2048;
+	static constexpr size_t FAN_OUT_CHUNK_SIZE = 256;
+
+	// Packets are moved from the send lanes onto the wire queue only while it holds less than the window, so control
+	// packets wait behind at most one window. Interactive and bulk lanes then share the window by weight.
+	static constexpr int SEND_WINDOW = 64;
+	static constexpr uint32_t INTERACTIVE_LANE_WEIGHT = 4;
+	static constexpr uint32_t BULK_LANE_WEIGHT = 1;
+
+	static constexpr uint32_t SHARED_RING_CAPACITY = 1024;
+	static constexpr uint32_t AUTH_FAILURE_DELAY = 1000;
+	static constexpr uint32_t FILTER_RELOAD_PERIOD = 2000;
+	static constexpr uint32_t TRACE_SAMPLE_RATE = 64;
+
+	// The proxy stops reading a side once this much of it waits to be forwarded; a full bucket holds the burst period of bandwidth.
+	static constexpr int PROXY_READ_SIZE = 16384;
+	static constexpr size_t PROXY_BUFFER_LIMIT = 1 << 22;
+	static constexpr uint32_t PROXY_BURST_PERIOD = 100;
+
+	static constexpr uint32_t CONNECT_TIMEOUT = 5000;
+	static constexpr uint32_t RECONNECT_PERIOD = 3000;
+	static constexpr uint32_t PEER_RETRY_PERIOD = 3000;
+	static constexpr uint32_t PEER_BATCH_DELAY = 5;
+	static constexpr int PEER_BATCH_SIZE = 64;
+}
\ No newline at end of file
@@ -0,0 +1,343 @@
+#include "ChatContentFilter.h"
+
+#include <algorithm>
+#include <bit>
+#include <cctype>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <queue>
+
+#if defined(_M_X64) || defined(_M_IX86) || defined(__SSE2__)
+#define CHAT_FILTER_SSE2 1
+#include <emmintrin.h>
+#endif
+
+#if defined(_M_X64) || defined(__SSSE3__)
+#define CHAT_FILTER_SSSE3 1
+#include <tmmintrin.h>
+#endif
+
+#if defined(CHAT_FILTER_SSSE3) && defined(_MSC_VER)
+#include <intrin.h>
+#endif
+
+
+using namespace std;
+
+namespace
+{
+	constexpr uint32_t NO_STATE = UINT32_MAX;
+
+	// Beyond this many distinct first bytes the vector compares cost more than the scalar bitmap lookup.
+	constexpr size_t MAX_SIMD_FIRST_BYTES = 8;
+
+	constexpr int NUM_SHUFFLE_BUCKETS = 8;
+	// The shuffle prefilter is left off unless it rules out all but this share of printable byte pairs; past that,
+	// restarting the scan at every candidate costs more than stepping the automaton over each byte.
+	constexpr double MAX_SHUFFLE_PASS_RATE = 1.0 / 16;
+	// Second byte of a one-byte pattern: any byte may follow it.
+	constexpr int ANY_BYTE = 256;
+
+	inline uint8_t ToLower(uint8_t byte)
+	{
+		return static_cast<uint8_t>(tolower(byte));
+	}
+
+	bool HasShuffle()
+	{
+#if defined(CHAT_FILTER_SSSE3) && defined(_MSC_VER)
+		// Every x64 compiler has the instruction, but a few early x64 CPUs lack it.
+		int info[4];
+		__cpuid(info, 1);
+		return (info[2] & (1 << 9)) != 0;
+#elif defined(CHAT_FILTER_SSSE3)
+		return true;
+#else
+		return false;
+#endif
+	}
+}
+
+ChatContentFilter::ChatContentFilter(const vector<string>& patterns)
+	: classes{ 0, }
+	, numClasses(1)
+	, firstByteBits{ 0, }
+	, numPatterns(0)
+	, shuffleMasks{}
+	, isShuffleEnabled(false)
+{
+	// Class 0 stands for every byte that no pattern contains.
+	for (auto& pattern : patterns)
+	{
+		for (auto ch : pattern)
+		{
+			const auto byte = ToLower(static_cast<uint8_t>(ch));
+			if (classes[byte] == 0)
+			{
+				classes[byte] = static_cast<uint16_t>(numClasses++);
+			}
+		}
+	}
+
+	for (int byte = 0; byte < 256; ++byte)
+	{
+		classes[byte] = classes[ToLower(static_cast<uint8_t>(byte))];
+	}
+
+	transitions.assign(numClasses, NO_STATE);
+	matchLengths.assign(1, 0);
+
+	for (auto& pattern : patterns)
+	{
+		if (pattern.empty() || pattern.size() > MAX_PATTERN_LENGTH)
+			continue;
+
+		uint32_t state = 0;
+		for (auto ch : pattern)
+		{
+			auto& next = transitions[size_t(state) * numClasses + classes[static_cast<uint8_t>(ch)]];
+			if (next == NO_STATE)
+			{
+				next = static_cast<uint32_t>(matchLengths.size());
+				matchLengths.push_back(0);
+				transitions.resize(transitions.size() + numClasses, NO_STATE);
+			}
+
+			state = transitions[size_t(state) * numClasses + classes[static_cast<uint8_t>(ch)]];
+		}
+
+		matchLengths[state] = static_cast<uint8_t>(pattern.size());
+
+		const auto first = static_cast<uint8_t>(pattern.front());
+		for (auto byte : { ToLower(first), static_cast<uint8_t>(toupper(first)) })
+		{
+			if (!IsFirstByte(byte))
+			{
+				firstByteBits[byte >> 6] |= uint64_t(1) << (byte & 63);
+				firstBytes.push_back(byte);
+			}
+		}
+
+		++numPatterns;
+	}
+
+	// Breadth-first pass turning the trie into a complete automaton; failure links never leave the table.
+	vector<uint32_t> failures(matchLengths.size(), 0);
+	queue<uint32_t> pending;
+	pending.push(0);
+
+	while (!pending.empty())
+	{
+		const auto state = pending.front();
+		pending.pop();
+
+		for (uint32_t symbol = 0; symbol < numClasses; ++symbol)
+		{
+			auto& next = transitions[size_t(state) * numClasses + symbol];
+			const auto fallback = state == 0 ? 0 : transitions[size_t(failures[state]) * numClasses + symbol];
+
+			if (next == NO_STATE)
+			{
+				next = fallback;
+				continue;
+			}
+
+			failures[next] = fallback;
+			matchLengths[next] = std::max(matchLengths[next], matchLengths[fallback]);
+			pending.push(next);
+		}
+	}
+
+	BuildShuffleMasks(patterns);
+}
+
+void ChatContentFilter::BuildShuffleMasks(const vector<string>& patterns)
+{
+	// Fingerprints sorted together so a bucket holds similar ones and its nibble masks stay narrow.
+	vector<pair<int, int>> fingerprints;
+	for (auto& pattern : patterns)
+	{
+		if (pattern.empty() || pattern.size() > MAX_PATTERN_LENGTH)
+			continue;
+
+		const int second = pattern.size() > 1 ? ToLower(static_cast<uint8_t>(pattern[1])) : ANY_BYTE;
+		fingerprints.emplace_back(ToLower(static_cast<uint8_t>(pattern[0])), second);
+	}
+
+	sort(fingerprints.begin(), fingerprints.end());
+	fingerprints.erase(unique(fingerprints.begin(), fingerprints.end()), fingerprints.end());
+
+	if (fingerprints.empty() || !HasShuffle())
+		return;
+
+	auto allow = [this](int position, uint8_t byte, uint8_t bucketBit)
+	{
+		for (auto variant : { ToLower(byte), static_cast<uint8_t>(toupper(byte)) })
+		{
+			shuffleMasks[position * 2][variant & 0x0f] |= bucketBit;
+			shuffleMasks[position * 2 + 1][variant >> 4] |= bucketBit;
+		}
+	};
+
+	for (size_t i = 0; i < fingerprints.size(); ++i)
+	{
+		const auto bucketBit = static_cast<uint8_t>(1 << (i * NUM_SHUFFLE_BUCKETS / fingerprints.size()));
+		allow(0, static_cast<uint8_t>(fingerprints[i].first), bucketBit);
+
+		if (fingerprints[i].second != ANY_BYTE)
+		{
+			allow(1, static_cast<uint8_t>(fingerprints[i].second), bucketBit);
+			continue;
+		}
+
+		for (int nibble = 0; nibble < 16; ++nibble)
+		{
+			shuffleMasks[2][nibble] |= bucketBit;
+			shuffleMasks[3][nibble] |= bucketBit;
+		}
+	}
+
+	int numPairs = 0;
+	int numCandidates = 0;
+	for (int first = ' '; first <= '~'; ++first)
+	{
+		for (int second = ' '; second <= '~'; ++second)
+		{
+			++numPairs;
+			numCandidates += IsShuffleCandidate(static_cast<uint8_t>(first), static_cast<uint8_t>(second));
+		}
+	}
+
+	isShuffleEnabled = numCandidates <= numPairs * MAX_SHUFFLE_PASS_RATE;
+}
+
+bool ChatContentFilter::IsShuffleCandidate(uint8_t first, uint8_t second) const
+{
+	return (shuffleMasks[0][first & 0x0f] & shuffleMasks[1][first >> 4] & shuffleMasks[2][second & 0x0f] & shuffleMasks[3][second >> 4]) != 0;
+}
+
+bool ChatContentFilter::ReadPatterns(const char* path, vector<string>& patterns)
+{
+	ifstream file(path);
+	if (!file)
+	{
+		cerr << "[ChatContentFilter] failed to open " << path << endl;
+		return false;
+	}
+
+	string line;
+	while (getline(file, line))
+	{
+		if (!line.empty() && line.back() == '\r')
+		{
+			line.pop_back();
+		}
+
+		if (line.empty() || line.front() == '#')
+			continue;
+
+		patterns.emplace_back(move(line));
+	}
+
+	return true;
+}
+
+shared_ptr<const ChatContentFilter> ChatContentFilter::Load(const char* path)
+{
+	vector<string> patterns;
+	if (!ReadPatterns(path, patterns))
+		return nullptr;
+
+	return make_shared<const ChatContentFilter>(patterns);
+}
+
+int ChatContentFilter::Apply(char* text, size_t length) const
+{
+	auto bytes = reinterpret_cast<uint8_t*>(text);
+	int numMatches = 0;
+	uint32_t state = 0;
+
+	for (size_t i = 0; i < length; ++i)
+	{
+		if (state == 0)
+		{
+			// From the root only a pattern's first byte leads anywhere, so jump straight to the next one.
+			i = FindCandidate(bytes, i, length);
+			if (i >= length)
+				break;
+		}
+
+		state = transitions[size_t(state) * numClasses + classes[bytes[i]]];
+
+		const auto matchLength = matchLengths[state];
+		if (matchLength == 0)
+			continue;
+
+		memset(text + i + 1 - matchLength, MASK, matchLength);
+		++numMatches;
+	}
+
+	return numMatches;
+}
+
+size_t ChatContentFilter::FindCandidate(const uint8_t* text, size_t from, size_t length) const
+{
+	if (firstBytes.empty())
+		return length;
+
+#ifdef CHAT_FILTER_SSSE3
+	if (isShuffleEnabled)
+	{
+		const auto nibble = _mm_set1_epi8(0x0f);
+		const auto firstLow = _mm_loadu_si128(reinterpret_cast<const __m128i*>(shuffleMasks[0].data()));
+		const auto firstHigh = _mm_loadu_si128(reinterpret_cast<const __m128i*>(shuffleMasks[1].data()));
+		const auto secondLow = _mm_loadu_si128(reinterpret_cast<const __m128i*>(shuffleMasks[2].data()));
+		const auto secondHigh = _mm_loadu_si128(reinterpret_cast<const __m128i*>(shuffleMasks[3].data()));
+
+		// Each lane ends up with the buckets whose patterns may start at that position; the loads read one byte ahead.
+		for (; from + 17 <= length; from += 16)
+		{
+			const auto first = _mm_loadu_si128(reinterpret_cast<const __m128i*>(text + from));
+			const auto second = _mm_loadu_si128(reinterpret_cast<const __m128i*>(text + from + 1));
+
+			auto buckets = _mm_and_si128(_mm_shuffle_epi8(firstLow, _mm_and_si128(first, nibble)),
+				_mm_shuffle_epi8(firstHigh, _mm_and_si128(_mm_srli_epi16(first, 4), nibble)));
+			buckets = _mm_and_si128(buckets, _mm_shuffle_epi8(secondLow, _mm_and_si128(second, nibble)));
+			buckets = _mm_and_si128(buckets, _mm_shuffle_epi8(secondHigh, _mm_and_si128(_mm_srli_epi16(second, 4), nibble)));
+
+			const auto mask = ~static_cast<uint32_t>(_mm_movemask_epi8(_mm_cmpeq_epi8(buckets, _mm_setzero_si128()))) & 0xffff;
+			if (mask != 0)
+				return from + countr_zero(mask);
+		}
+	}
+#endif
+
+#ifdef CHAT_FILTER_SSE2
+	if (!isShuffleEnabled && firstBytes.size() <= MAX_SIMD_FIRST_BYTES)
+	{
+		for (; from + 16 <= length; from += 16)
+		{
+			const auto block = _mm_loadu_si128(reinterpret_cast<const __m128i*>(text + from));
+
+			__m128i hits = _mm_setzero_si128();
+			for (auto byte : firstBytes)
+			{
+				hits = _mm_or_si128(hits, _mm_cmpeq_epi8(block, _mm_set1_epi8(static_cast<char>(byte))));
+			}
+
+			const auto mask = static_cast<uint32_t>(_mm_movemask_epi8(hits));
+			if (mask != 0)
+				return from + countr_zero(mask);
+		}
+	}
+#endif
+
+	for (; from < length; ++from)
+	{
+		if (IsFirstByte(text[from]))
+			return from;
+	}
+
+	return length;
+}
\ No newline at end of file
@@ -0,0 +1,58 @@
+#pragma once
+
+#include <array>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
+
+// Case-insensitive multi-pattern matcher (Aho-Corasick) compiled into a dense transition table.
+// Bytes are mapped to a small alphabet of the bytes that occur in patterns, so a state row fits a few cache lines.
+// From the root state a prefilter skips to the next position a pattern could start at: a nibble-shuffle test of the
+// first two bytes of every pattern in eight buckets, 16 positions at a time, or a compare against a few first bytes.
+// Either only engages while it rules out most positions of ordinary text. With thousands of patterns nearly every
+// position could start one, so the scan is one table step per byte.
+// Instances are immutable once built; reloading builds a new one and swaps the shared pointer.
+class ChatContentFilter final
+{
+public:
+	static constexpr char MASK = '*';
+	static constexpr size_t MAX_PATTERN_LENGTH = UINT8_MAX;
+
+private:
+	std::array<uint16_t, 256> classes;
+	uint32_t numClasses;
+	std::vector<uint32_t> transitions;
+	std::vector<uint8_t> matchLengths;
+
+	std::array<uint64_t, 4> firstByteBits;
+	std::vector<uint8_t> firstBytes;
+	size_t numPatterns;
+
+	// Low and high nibble masks of the first and second byte; bit b is set if a pattern in bucket b allows that nibble.
+	std::array<std::array<uint8_t, 16>, 4> shuffleMasks;
+	bool isShuffleEnabled;
+
+public:
+	explicit ChatContentFilter(const std::vector<std::string>& patterns);
+	~ChatContentFilter() = default;
+
+	// One pattern per line; empty lines and lines starting with '#' are skipped.
+	static bool ReadPatterns(const char* path, std::vector<std::string>& patterns);
+	static std::shared_ptr<const ChatContentFilter> Load(const char* path);
+
+	// Masks every match in place and returns the number of matches.
+	int Apply(char* text, size_t length) const;
+
+	inline auto GetNumPatterns() const { return numPatterns; }
+	inline auto GetNumStates() const { return matchLengths.size(); }
+	inline bool IsPrefilterEnabled() const { return isShuffleEnabled; }
+
+private:
+	void BuildShuffleMasks(const std::vector<std::string>& patterns);
+	bool IsShuffleCandidate(uint8_t first, uint8_t second) const;
+
+	size_t FindCandidate(const uint8_t* text, size_t from, size_t length) const;
+	inline bool IsFirstByte(uint8_t byte) const { return (firstByteBits[byte >> 6] >> (byte & 63)) & 1; }
+};
\ No newline at end of file
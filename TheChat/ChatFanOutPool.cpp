@@ -0,0 +1,144 @@
+#include "ChatFanOutPool.h"
+
+#include <exception>
+#include <iostream>
+
+#include "ChatTracer.h"
+
+
+using namespace std;
+
+ChatFanOutPool::ChatFanOutPool()
+	: numShares(0)
+	, task(nullptr)
+	, generation(0)
+	, numBusy(0)
+	, isStopping(false)
+{
+}
+
+ChatFanOutPool::~ChatFanOutPool()
+{
+	Stop();
+}
+
+void ChatFanOutPool::Start(size_t numThreads)
+{
+	Stop();
+
+	if (numThreads == 0)
+		return;
+
+	isStopping = false;
+
+	// The calling thread works on the first share.
+	numShares = numThreads + 1;
+	shares = make_unique<Share[]>(numShares);
+
+	for (size_t i = 1; i < numShares; ++i)
+	{
+		threads.emplace_back([this, i]() { Work(i); });
+	}
+}
+
+void ChatFanOutPool::Stop()
+{
+	{
+		lock_guard<std::mutex> lock(mutex);
+		isStopping = true;
+	}
+
+	startCondition.notify_all();
+
+	for (auto& thread : threads)
+	{
+		thread.join();
+	}
+
+	threads.clear();
+	shares.reset();
+	numShares = 0;
+}
+
+void ChatFanOutPool::Run(size_t numTasks, const TTask& task)
+{
+	if (threads.empty() || numTasks <= 1)
+	{
+		for (size_t i = 0; i < numTasks; ++i)
+		{
+			task(i);
+		}
+
+		return;
+	}
+
+	for (size_t i = 0; i < numShares; ++i)
+	{
+		shares[i].next.store(numTasks * i / numShares, memory_order_relaxed);
+		shares[i].end = numTasks * (i + 1) / numShares;
+	}
+
+	{
+		lock_guard<std::mutex> lock(mutex);
+		this->task = &task;
+		numBusy = threads.size();
+		++generation;
+	}
+
+	startCondition.notify_all();
+	RunShares(0);
+
+	unique_lock<std::mutex> lock(mutex);
+	doneCondition.wait(lock, [this]() { return numBusy == 0; });
+	this->task = nullptr;
+}
+
+void ChatFanOutPool::Work(size_t shareIndex)
+{
+	ChatTracer::NameThread("fan-out");
+
+	uint64_t lastGeneration = 0;
+
+	while (true)
+	{
+		{
+			unique_lock<std::mutex> lock(mutex);
+			startCondition.wait(lock, [this, lastGeneration]() { return isStopping || generation != lastGeneration; });
+
+			if (isStopping)
+				return;
+
+			lastGeneration = generation;
+		}
+
+		RunShares(shareIndex);
+
+		{
+			lock_guard<std::mutex> lock(mutex);
+			if (--numBusy > 0)
+				continue;
+		}
+
+		doneCondition.notify_one();
+	}
+}
+
+void ChatFanOutPool::RunShares(size_t shareIndex)
+{
+	for (size_t i = 0; i < numShares; ++i)
+	{
+		auto& share = shares[(shareIndex + i) % numShares];
+
+		for (auto index = share.next.fetch_add(1, memory_order_relaxed); index < share.end; index = share.next.fetch_add(1, memory_order_relaxed))
+		{
+			try
+			{
+				(*task)(index);
+			}
+			catch (const exception& e)
+			{
+				cerr << "[ChatFanOutPool][Error] task failed: " << e.what() << endl;
+			}
+		}
+	}
+}
\ No newline at end of file
@@ -0,0 +1,59 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+
+// Threads that run one parallel loop at a time together with the calling thread. Every participant starts on
+// its own contiguous share of the tasks and steals from the shares of the others once it is done, so a share
+// holding slow tasks is finished by whoever is free. Taking a task is one atomic increment, nothing is locked.
+class ChatFanOutPool final
+{
+public:
+	using TTask = std::function<void(size_t index)>;
+
+private:
+	struct alignas(64) Share
+	{
+		std::atomic<size_t> next = 0;
+		size_t end = 0;
+	};
+
+	std::vector<std::thread> threads;
+	std::unique_ptr<Share[]> shares;
+	size_t numShares;
+
+	std::mutex mutex;
+	std::condition_variable startCondition;
+	std::condition_variable doneCondition;
+	const TTask* task;
+	uint64_t generation;
+	size_t numBusy;
+	bool isStopping;
+
+public:
+	ChatFanOutPool();
+	~ChatFanOutPool();
+
+	ChatFanOutPool(const ChatFanOutPool&) = delete;
+	ChatFanOutPool& operator = (const ChatFanOutPool&) = delete;
+
+	void Start(size_t numThreads);
+	void Stop();
+	// Calls task once for every index below numTasks and returns when all calls have returned.
+	void Run(size_t numTasks, const TTask& task);
+
+	inline bool IsStarted() const { return !threads.empty(); }
+	inline size_t GetNumThreads() const { return threads.size(); }
+
+private:
+	void Work(size_t shareIndex);
+	void RunShares(size_t shareIndex);
+};
\ No newline at end of file
@@ -0,0 +1,90 @@
+#include "ChatHistogram.h"
+
+#include <algorithm>
+
+
+using namespace std;
+
+namespace
+{
+	int ToBucket(uint64_t value)
+	{
+		int bucket = 0;
+		while (value > 1 && bucket < ChatHistogram::NUM_BUCKETS - 1)
+		{
+			value >>= 1;
+			++bucket;
+		}
+
+		return bucket;
+	}
+}
+
+ChatHistogram::ChatHistogram()
+	: buckets{0, }
+	, count(0)
+	, sum(0)
+	, maxValue(0)
+{
+}
+
+void ChatHistogram::Record(chrono::microseconds latency)
+{
+	Record(static_cast<uint64_t>(std::max<int64_t>(latency.count(), 0)));
+}
+
+void ChatHistogram::Record(uint64_t microseconds)
+{
+	++buckets[ToBucket(microseconds)];
+	++count;
+	sum += microseconds;
+	maxValue = std::max(maxValue, microseconds);
+}
+
+void ChatHistogram::Merge(const ChatHistogram& other)
+{
+	for (int i = 0; i < NUM_BUCKETS; ++i)
+	{
+		buckets[i] += other.buckets[i];
+	}
+
+	count += other.count;
+	sum += other.sum;
+	maxValue = std::max(maxValue, other.maxValue);
+}
+
+void ChatHistogram::Reset()
+{
+	buckets.fill(0);
+	count = 0;
+	sum = 0;
+	maxValue = 0;
+}
+
+uint64_t ChatHistogram::GetPercentile(double percentile) const
+{
+	if (count == 0)
+		return 0;
+
+	const auto target = static_cast<uint64_t>(count * percentile / 100.0);
+	uint64_t accumulated = 0;
+
+	for (int i = 0; i < NUM_BUCKETS; ++i)
+	{
+		accumulated += buckets[i];
+		if (accumulated > target)
+			return std::min(uint64_t(1) << (i + 1), maxValue);
+	}
+
+	return maxValue;
+}
+
+void ChatHistogram::Report(ostream& os, const char* name) const
+{
+	os << "[ChatHistogram] " << name << ": count = " << count
+		<< ", mean = " << GetMean() << "us"
+		<< ", p50 = " << GetPercentile(50.0) << "us"
+		<< ", p99 = " << GetPercentile(99.0) << "us"
+		<< ", p999 = " << GetPercentile(99.9) << "us"
+		<< ", max = " << maxValue << "us" << endl;
+}
\ No newline at end of file
@@ -0,0 +1,36 @@
+#pragma once
+
+#include <array>
+#include <chrono>
+#include <cstdint>
+#include <ostream>
+
+
+// Log2-bucketed latency histogram in microseconds. Not thread-safe; owned by a single loop.
+class ChatHistogram final
+{
+public:
+	static constexpr int NUM_BUCKETS = 32;
+
+private:
+	std::array<uint64_t, NUM_BUCKETS> buckets;
+	uint64_t count;
+	uint64_t sum;
+	uint64_t maxValue;
+
+public:
+	ChatHistogram();
+	~ChatHistogram() = default;
+
+	void Record(std::chrono::microseconds latency);
+	void Record(uint64_t microseconds);
+	void Merge(const ChatHistogram& other);
+	void Reset();
+
+	uint64_t GetPercentile(double percentile) const;
+	void Report(std::ostream& os, const char* name) const;
+
+	inline auto GetCount() const { return count; }
+	inline auto GetMax() const { return maxValue; }
+	inline auto GetMean() const { return count > 0 ? sum / count : 0; }
+};
\ No newline at end of file
@@ -0,0 +1,41 @@
+#include "ChatHistory.h"
+
+#include <algorithm>
+
+
+using namespace std;
+
+uint32_t ChatHistory::Append(string_view sender, string_view text)
+{
+	sender = sender.substr(0, UINT8_MAX);
+	text = text.substr(0, UINT8_MAX);
+
+	Entry entry;
+	entry.offset = arena.size();
+	entry.senderLength = static_cast<uint8_t>(sender.size());
+	entry.textLength = static_cast<uint8_t>(text.size());
+
+	arena.append(sender);
+	arena.append(text);
+	entries.push_back(entry);
+
+	return static_cast<uint32_t>(entries.size() - 1);
+}
+
+string_view ChatHistory::GetSender(uint32_t number) const
+{
+	if (number >= entries.size())
+		return string_view();
+
+	auto& entry = entries[number];
+	return string_view(arena).substr(entry.offset, entry.senderLength);
+}
+
+string_view ChatHistory::GetText(uint32_t number) const
+{
+	if (number >= entries.size())
+		return string_view();
+
+	auto& entry = entries[number];
+	return string_view(arena).substr(entry.offset + entry.senderLength, entry.textLength);
+}
\ No newline at end of file
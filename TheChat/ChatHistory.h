@@ -0,0 +1,35 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <vector>
+
+
+// Append-only store of chat messages, numbered from 0 in arrival order.
+// Senders and texts are packed into one arena so each message costs little more than its bytes.
+class ChatHistory final
+{
+private:
+	struct Entry
+	{
+		uint64_t offset;
+		uint8_t senderLength;
+		uint8_t textLength;
+	};
+
+	std::vector<Entry> entries;
+	std::string arena;
+
+public:
+	ChatHistory() = default;
+	~ChatHistory() = default;
+
+	uint32_t Append(std::string_view sender, std::string_view text);
+
+	std::string_view GetSender(uint32_t number) const;
+	std::string_view GetText(uint32_t number) const;
+
+	inline auto GetNumMessages() const { return static_cast<uint32_t>(entries.size()); }
+	inline auto GetNumBytes() const { return arena.size() + entries.size() * sizeof(Entry); }
+};
\ No newline at end of file
@@ -0,0 +1,133 @@
+#include "ChatIdTable.h"
+
+#include <array>
+#include <atomic>
+#include <mutex>
+#include <unordered_map>
+
+
+using namespace std;
+
+namespace
+{
+	constexpr uint32_t CHUNK_BITS = 12;
+	constexpr uint32_t CHUNK_SIZE = 1 << CHUNK_BITS;
+	constexpr uint32_t MAX_CHUNKS = ChatIdTable::MAX_IDS / CHUNK_SIZE;
+	constexpr const char* UNKNOWN_ID = "Unknown";
+
+	using TChunk = array<const string*, CHUNK_SIZE>;
+
+	// Interning takes the lock; numbers are looked up without it, since Find() runs per recipient on the fan-out workers.
+	// IDs go into fixed-size chunks that never move, and a number is published with the size only once its slot is set.
+	struct Table
+	{
+		mutex tableMutex;
+		unordered_map<string, uint32_t> numbers;
+		atomic<TChunk*> chunks[MAX_CHUNKS] = {};
+		atomic<uint32_t> size{ 0 };
+
+		// Unknown is there from the start so a full table still has it to hand out.
+		Table()
+		{
+			Add(ChatIdTable::SERVER_ID);
+			Add(UNKNOWN_ID);
+		}
+
+		~Table()
+		{
+			for (auto& chunk : chunks)
+			{
+				delete chunk.load(memory_order_relaxed);
+			}
+		}
+
+		// Returns nullptr if the table is full and does not hold id yet.
+		const pair<const string, uint32_t>* Add(string_view id)
+		{
+			const auto number = size.load(memory_order_relaxed);
+
+			auto iter = numbers.find(string(id));
+			if (iter != numbers.end())
+				return &*iter;
+
+			if (number >= ChatIdTable::MAX_IDS)
+				return nullptr;
+
+			// Map nodes never move, so the returned key stays valid while the table grows.
+			auto result = numbers.try_emplace(string(id), number);
+
+			auto& chunk = chunks[number >> CHUNK_BITS];
+			if (chunk.load(memory_order_relaxed) == nullptr)
+			{
+				chunk.store(new TChunk(), memory_order_relaxed);
+			}
+
+			(*chunk.load(memory_order_relaxed))[number & (CHUNK_SIZE - 1)] = &result.first->first;
+			size.store(number + 1, memory_order_release);
+
+			return &*result.first;
+		}
+
+		const pair<const string, uint32_t>& AddOrUnknown(string_view id)
+		{
+			auto added = Add(id);
+			return added != nullptr ? *added : *Add(UNKNOWN_ID);
+		}
+
+		const string* Find(uint32_t number) const
+		{
+			if (number >= size.load(memory_order_acquire))
+				return nullptr;
+
+			return (*chunks[number >> CHUNK_BITS].load(memory_order_relaxed))[number & (CHUNK_SIZE - 1)];
+		}
+	};
+
+	Table& GetTable()
+	{
+		static Table table;
+		return table;
+	}
+}
+
+const std::string& ChatIdTable::Intern(std::string_view id)
+{
+	auto& table = GetTable();
+	lock_guard<mutex> lock(table.tableMutex);
+
+	return table.AddOrUnknown(id).first;
+}
+
+uint32_t ChatIdTable::GetNumber(std::string_view id)
+{
+	auto& table = GetTable();
+	lock_guard<mutex> lock(table.tableMutex);
+
+	return table.AddOrUnknown(id).second;
+}
+
+const std::string* ChatIdTable::TryIntern(std::string_view id)
+{
+	auto& table = GetTable();
+	lock_guard<mutex> lock(table.tableMutex);
+
+	auto added = table.Add(id);
+	return added != nullptr ? &added->first : nullptr;
+}
+
+const std::string* ChatIdTable::Find(uint32_t number)
+{
+	return GetTable().Find(number);
+}
+
+
+const std::string& ChatIdTable::Unknown()
+{
+	static const string& unknown = Intern(UNKNOWN_ID);
+	return unknown;
+}
+
+bool ChatIdTable::IsReserved(std::string_view id)
+{
+	return id == SERVER_ID || id == UNKNOWN_ID;
+}
\ No newline at end of file
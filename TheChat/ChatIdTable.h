@@ -0,0 +1,29 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <string_view>
+
+
+// Process-wide table of interned IDs. Every connection with the same ID points at one shared string,
+// which stays valid for the life of the process; the table only grows with the number of distinct IDs,
+// up to MAX_IDS, after which new IDs intern as Unknown. Clients choose their IDs, so that is what bounds it.
+// Each ID also gets a dense number in interning order, which is what messages carry on the wire.
+namespace ChatIdTable
+{
+	// Interned before anything else, so every process agrees on it without a mapping.
+	static constexpr uint32_t SERVER_NUMBER = 0;
+	static constexpr const char* SERVER_ID = "Server";
+
+	static constexpr uint32_t MAX_IDS = 1 << 20;
+
+	const std::string& Intern(std::string_view id);
+	uint32_t GetNumber(std::string_view id);
+	// Returns nullptr instead of Unknown if the table is full and does not hold id yet.
+	const std::string* TryIntern(std::string_view id);
+	// Returns nullptr if no ID was given that number. Lock-free, unlike interning.
+	const std::string* Find(uint32_t number);
+	const std::string& Unknown();
+	// Server and Unknown already stand for the server and for IDs that did not fit, so no client may greet as them.
+	bool IsReserved(std::string_view id);
+}
\ No newline at end of file
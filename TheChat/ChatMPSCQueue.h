@@ -0,0 +1,70 @@
+#pragma once
+
+#include <atomic>
+#include <utility>
+
+
+// Unbounded lock-free multi-producer single-consumer queue (Vyukov).
+// Push() never blocks and may be called from any thread; Pop() must only be called by the owner thread.
+template <typename T>
+class ChatMPSCQueue final
+{
+private:
+	struct Node
+	{
+		std::atomic<Node*> next;
+		T value;
+
+		Node() : next(nullptr), value() {}
+		Node(T&& value) : next(nullptr), value(std::move(value)) {}
+	};
+
+	std::atomic<Node*> head;
+	Node* tail;
+
+public:
+	ChatMPSCQueue()
+		: head(new Node())
+		, tail(head.load(std::memory_order_relaxed))
+	{
+	}
+
+	~ChatMPSCQueue()
+	{
+		T value;
+		while (Pop(value))
+		{
+		}
+
+		delete tail;
+	}
+
+	ChatMPSCQueue(const ChatMPSCQueue&) = delete;
+	ChatMPSCQueue& operator = (const ChatMPSCQueue&) = delete;
+
+	void Push(T value)
+	{
+		auto node = new Node(std::move(value));
+		auto prev = head.exchange(node, std::memory_order_acq_rel);
+		prev->next.store(node, std::memory_order_release);
+	}
+
+	bool Pop(T& value)
+	{
+		auto next = tail->next.load(std::memory_order_acquire);
+		if (next == nullptr)
+			return false;
+
+		value = std::move(next->value);
+
+		delete tail;
+		tail = next;
+
+		return true;
+	}
+
+	bool IsEmpty() const
+	{
+		return tail->next.load(std::memory_order_acquire) == nullptr;
+	}
+};
\ No newline at end of file
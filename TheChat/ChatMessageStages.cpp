@@ -0,0 +1,36 @@
+#include "ChatMessageStages.h"
+
+
+using namespace std;
+
+void ChatMessageStages::Add(TStage&& stage)
+{
+	stages.emplace_back(move(stage));
+}
+
+bool ChatMessageStages::Run(uint32_t senderNumber, MessagePacket& message) const
+{
+	message.SetSenderNumber(senderNumber);
+
+	for (auto& stage : stages)
+	{
+		if (!stage(message))
+			return false;
+	}
+
+	return true;
+}
+
+bool ChatMessageStages::Run(uint32_t senderNumber, string_view senderId, PrivateMessagePacket& message) const
+{
+	message.SetSenderID(senderId);
+
+	MessagePacket staged;
+	staged.message = message.message;
+
+	if (!Run(senderNumber, staged))
+		return false;
+
+	message.message = staged.message;
+	return true;
+}
\ No newline at end of file
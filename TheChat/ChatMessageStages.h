@@ -0,0 +1,33 @@
+#pragma once
+
+#include <cstdint>
+#include <functional>
+#include <string_view>
+#include <vector>
+
+#include "MessagePacket.h"
+#include "PrivateMessagePacket.h"
+
+
+// The stages every chat message from a client runs through before it goes out, in the order they were added.
+// Clients only speak for themselves: the sender they put in a message is replaced by their own before any stage sees it.
+class ChatMessageStages final
+{
+public:
+	// A stage returning false drops the message.
+	using TStage = std::function<bool(MessagePacket& message)>;
+
+private:
+	std::vector<TStage> stages;
+
+public:
+	ChatMessageStages() = default;
+	~ChatMessageStages() = default;
+
+	void Add(TStage&& stage);
+
+	// Both return false once a stage dropped the message.
+	bool Run(uint32_t senderNumber, MessagePacket& message) const;
+	// A private message runs as a room message from its sender and keeps whatever the stages left of the text.
+	bool Run(uint32_t senderNumber, std::string_view senderId, PrivateMessagePacket& message) const;
+};
\ No newline at end of file
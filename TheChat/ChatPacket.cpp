@@ -5,4 +5,55 @@ ChatPacket::ChatPacket()
 	: header()
 	, payload{0, }
 {
+}
+
+bool ChatPacket::IsSequenced(EChatTableID tableId)
+{
+	switch (tableId)
+	{
+	case EChatTableID::HEARTBEAT:
+	case EChatTableID::GREETINGS_TABLE:
+	case EChatTableID::ID_LIST_TABLE:
+	case EChatTableID::ACK_TABLE:
+	case EChatTableID::PEER_HELLO_TABLE:
+	case EChatTableID::PEER_PRESENCE_TABLE:
+	case EChatTableID::SHARED_RING_TABLE:
+	case EChatTableID::SEARCH_TABLE:
+	case EChatTableID::PING_TABLE:
+		return false;
+
+	default:
+		break;
+	}
+
+	return true;
+}
+
+ChatPacket::ESendLane ChatPacket::GetSendLane(EChatTableID tableId)
+{
+	// Control packets skip the window and the resume hold, so only unsequenced tables may go there.
+	switch (tableId)
+	{
+	case EChatTableID::HEARTBEAT:
+	case EChatTableID::GREETINGS_TABLE:
+	case EChatTableID::ACK_TABLE:
+	case EChatTableID::PEER_HELLO_TABLE:
+	case EChatTableID::SHARED_RING_TABLE:
+	case EChatTableID::PING_TABLE:
+		return ESendLane::Control;
+
+	// Private messages share the lane with room messages so a reader sees them in the order they were sent.
+	// The room keeps a slow reader's backlog, so this lane holds about a window at most. An ID map is queued
+	// right ahead of the first message using a number it maps, so the lane's order gets it there first.
+	case EChatTableID::MESSAGE_TABLE:
+	case EChatTableID::MESSAGE_BATCH_TABLE:
+	case EChatTableID::PRIVATE_MESSAGE_TABLE:
+	case EChatTableID::ID_MAP_TABLE:
+		return ESendLane::Bulk;
+
+	default:
+		break;
+	}
+
+	return ESendLane::Interactive;
 }
\ No newline at end of file
@@ -1,9 +1,15 @@
 #pragma once
 
+#include <algorithm>
+#include <bit>
 #include <cassert>
+#include <cstddef>
 #include <cstdint>
+#include <cstring>
+#include <type_traits>
 
 #include "ChatConstant.h"
+#include "ChatSchema.h"
 #include "ChatTableID.h"
 
 
@@ -16,6 +22,15 @@ public:
 		Request = 1
 	};
 
+	// Send queues of a connection, in the order the flush serves them.
+	enum class ESendLane : uint8_t
+	{
+		Control,
+		Interactive,
+		Bulk,
+		MAX
+	};
+
 public:
 	struct Header
 	{
@@ -25,45 +40,63 @@ public:
 		uint8_t index = 0;
 		uint8_t maxIndex = 0;
 		uint16_t payloadLength = 0;
+		uint32_t sequence = 0;
+		uint32_t traceId = 0;
 	};
 
+	// The header goes onto the wire as it is laid out in memory, so it has to be free of padding
+	// and the host little-endian like the payload encoding. Every Windows target is.
+	static_assert(sizeof(Header) == 16 && offsetof(Header, payloadLength) == 6 && offsetof(Header, traceId) == 12,
+		"ChatPacket::Header must not contain padding.");
+	static_assert(std::endian::native == std::endian::little, "ChatPacket::Header is sent in host byte order.");
+	static_assert(std::is_trivially_copyable_v<Header>, "ChatPacket::Header is copied as bytes.");
+
 	static constexpr int PAYLOAD_SIZE = ChatConstant::PACKET_SIZE - sizeof(Header);
-	union
-	{
-		uint8_t data[ChatConstant::PACKET_SIZE];
-		struct
-		{
-			Header header;
-			uint8_t payload[PAYLOAD_SIZE];
-		};
-	};
+	Header header;
+	uint8_t payload[PAYLOAD_SIZE];
 
 	ChatPacket();
 	~ChatPacket() = default;
 
+	// A frame goes onto the wire trimmed to its payload.
+	inline size_t GetWireSize() const { return sizeof(Header) + header.payloadLength; }
+
+	static bool IsSequenced(EChatTableID tableId);
+	static ESendLane GetSendLane(EChatTableID tableId);
+
+	// Encodes a table into a frame through its schema; the rest of the payload is zeroed.
 	template<typename T>
-	T& As()
+	static ChatPacket Encode(const T& packet)
 	{
-		assert(T::GetTableID() == header.tableId);
-		return reinterpret_cast<T&>(*this);
+		static_assert(ChatSchema::MaxSize<T>() <= PAYLOAD_SIZE, "Table does not fit the packet payload.");
+
+		ChatPacket encoded(packet.header);
+		const auto length = ChatSchema::Encode(packet, encoded.payload);
+		memset(encoded.payload + length, 0, PAYLOAD_SIZE - length);
+
+		encoded.header.tableId = T::GetTableID();
+		encoded.header.payloadLength = static_cast<uint16_t>(length);
+
+		return encoded;
 	}
 
+	// Decodes the table in this frame into decoded. A malformed frame returns false and is to be dropped.
 	template<typename T>
-	const T& As() const
+	bool Decode(T& decoded) const
 	{
 		assert(T::GetTableID() == header.tableId);
-		return reinterpret_cast<const T&>(*this);
-	}
 
-	template<typename T>
-	static ChatPacket& From(T& packet)
-	{
-		return reinterpret_cast<ChatPacket&>(packet);
+		if (header.payloadLength > PAYLOAD_SIZE)
+			return false;
+
+		decoded.header = header;
+		return ChatSchema::Decode(decoded, payload, header.payloadLength);
 	}
 
-	template<typename T>
-	static const ChatPacket& From(const T& packet)
+private:
+	// Leaves the payload for Encode() to fill.
+	explicit ChatPacket(const Header& header)
+		: header(header)
 	{
-		return reinterpret_cast<const ChatPacket&>(packet);
 	}
 };
@@ -0,0 +1,156 @@
+#include "ChatPresence.h"
+
+#include <algorithm>
+
+#include "IdListPacket.h"
+
+
+using namespace std;
+
+int ChatPresence::Join(const string& id, ChatConnection& connection)
+{
+	auto& entry = Touch(id);
+	entry.connections.push_back(&connection);
+
+	return static_cast<int>(entry.connections.size());
+}
+
+int ChatPresence::Leave(const string& id, ChatConnection& connection)
+{
+	auto iter = entries.find(id);
+	if (iter == entries.end())
+		return 0;
+
+	auto& local = iter->second.connections;
+	auto found = find(local.begin(), local.end(), &connection);
+	if (found == local.end())
+		return static_cast<int>(local.size());
+
+	changes.emplace(id, true);
+
+	*found = local.back();
+	local.pop_back();
+
+	const int numLocal = static_cast<int>(local.size());
+	Release(id);
+
+	return numLocal;
+}
+
+void ChatPresence::JoinRemote(const string& id)
+{
+	++Touch(id).numRemote;
+}
+
+void ChatPresence::LeaveRemote(const string& id)
+{
+	auto iter = entries.find(id);
+	if (iter == entries.end() || iter->second.numRemote <= 0)
+		return;
+
+	changes.emplace(id, true);
+
+	--iter->second.numRemote;
+	Release(id);
+}
+
+ChatConnection* ChatPresence::Find(const string& id) const
+{
+	auto iter = entries.find(id);
+	if (iter == entries.end() || iter->second.connections.empty())
+		return nullptr;
+
+	return iter->second.connections.back();
+}
+
+vector<string> ChatPresence::GetLocalIDs() const
+{
+	vector<string> ids;
+
+	for (auto& entry : entries)
+	{
+		if (entry.second.connections.empty())
+			continue;
+
+		ids.push_back(entry.first);
+	}
+
+	return ids;
+}
+
+vector<ChatPacket> ChatPresence::BuildSnapshot() const
+{
+	vector<ChatPacket> packets;
+	IdListPacket current(IdListPacket::EKind::SnapshotBegin);
+
+	for (auto& entry : entries)
+	{
+		if (current.Add(IdListPacket::EOperation::Join, entry.first))
+			continue;
+
+		packets.emplace_back(ChatPacket::Encode(current));
+
+		current = IdListPacket(IdListPacket::EKind::Snapshot);
+		current.Add(IdListPacket::EOperation::Join, entry.first);
+	}
+
+	packets.emplace_back(ChatPacket::Encode(current));
+
+	return packets;
+}
+
+vector<ChatPacket> ChatPresence::ExtractDeltas()
+{
+	vector<ChatPacket> packets;
+	IdListPacket current(IdListPacket::EKind::Delta);
+
+	for (auto& change : changes)
+	{
+		auto iter = entries.find(change.first);
+		const bool isOnline = iter != entries.end() && iter->second.IsOnline();
+
+		// Joined and left again within the same tick, or the other way around.
+		if (isOnline == change.second)
+			continue;
+
+		const auto operation = isOnline ? IdListPacket::EOperation::Join : IdListPacket::EOperation::Leave;
+		if (current.Add(operation, change.first))
+			continue;
+
+		packets.emplace_back(ChatPacket::Encode(current));
+
+		current = IdListPacket(IdListPacket::EKind::Delta);
+		current.Add(operation, change.first);
+	}
+
+	changes.clear();
+
+	if (current.GetCount() > 0)
+	{
+		packets.emplace_back(ChatPacket::Encode(current));
+	}
+
+	return packets;
+}
+
+ChatPresence::Entry& ChatPresence::Touch(const string& id)
+{
+	auto iter = entries.find(id);
+	if (iter != entries.end())
+	{
+		changes.emplace(id, iter->second.IsOnline());
+		return iter->second;
+	}
+
+	changes.emplace(id, false);
+	return entries[id];
+}
+
+void ChatPresence::Release(const string& id)
+{
+	auto iter = entries.find(id);
+	if (iter == entries.end() || iter->second.IsOnline())
+		return;
+
+	entries.erase(iter);
+}
\ No newline at end of file
@@ -0,0 +1,49 @@
+#pragma once
+
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "ChatPacket.h"
+
+
+class ChatConnection;
+
+// Directory of online IDs. Local IDs are indexed to their connections, IDs on other cluster
+// nodes are only counted. Changes are collected per tick and published as compact deltas.
+class ChatPresence final
+{
+private:
+	struct Entry
+	{
+		std::vector<ChatConnection*> connections;
+		int numRemote = 0;
+
+		inline bool IsOnline() const { return !connections.empty() || numRemote > 0; }
+	};
+
+	std::unordered_map<std::string, Entry> entries;
+	std::unordered_map<std::string, bool> changes;
+
+public:
+	ChatPresence() = default;
+	~ChatPresence() = default;
+
+	int Join(const std::string& id, ChatConnection& connection);
+	int Leave(const std::string& id, ChatConnection& connection);
+	void JoinRemote(const std::string& id);
+	void LeaveRemote(const std::string& id);
+
+	ChatConnection* Find(const std::string& id) const;
+	std::vector<std::string> GetLocalIDs() const;
+
+	std::vector<ChatPacket> BuildSnapshot() const;
+	std::vector<ChatPacket> ExtractDeltas();
+
+	inline bool HasChanges() const { return !changes.empty(); }
+	inline auto GetNumOnline() const { return entries.size(); }
+
+private:
+	Entry& Touch(const std::string& id);
+	void Release(const std::string& id);
+};
\ No newline at end of file
@@ -0,0 +1,594 @@
+#include "ChatProxy.h"
+
+#include <algorithm>
+#include <climits>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+
+#define WIN32_LEAN_AND_MEAN
+
+#include <windows.h>
+#include <ws2tcpip.h>
+
+#include "ChatConstant.h"
+
+
+using namespace std;
+
+ChatProxy::ChatProxy(const char* port, const char* serverAddress, const char* serverPort)
+	: port(port)
+	, serverAddress(serverAddress)
+	, serverPort(serverPort)
+	, listenSocket(INVALID_SOCKET)
+	, startTime(chrono::steady_clock::now())
+	, stallStartTime(startTime)
+	, lastRefillTime(startTime)
+	, nextStep(0)
+	, random(random_device()())
+	, nextReportTime(startTime)
+	, numUpstreamBytes(0)
+	, numDownstreamBytes(0)
+{
+}
+
+ChatProxy::~ChatProxy()
+{
+	CloseAll();
+
+	if (listenSocket != INVALID_SOCKET)
+	{
+		closesocket(listenSocket);
+	}
+}
+
+bool ChatProxy::LoadScript(const char* path)
+{
+	ifstream file(path);
+	if (!file)
+	{
+		cerr << "[ChatProxy] failed to open the script " << path << endl;
+		return false;
+	}
+
+	vector<ScriptStep> steps;
+	string line;
+	int lineNumber = 0;
+
+	while (getline(file, line))
+	{
+		++lineNumber;
+
+		if (!line.empty() && line.back() == '\r')
+		{
+			line.pop_back();
+		}
+
+		if (line.empty() || line[0] == '#')
+			continue;
+
+		istringstream tokens(line);
+		int64_t at = -1;
+		ScriptStep step;
+
+		if (!(tokens >> at) || at < 0)
+		{
+			cerr << "[ChatProxy] script line " << lineNumber << " has to start with a time in ms: " << line << endl;
+			return false;
+		}
+
+		step.at = chrono::milliseconds(at);
+
+		string token;
+		while (tokens >> token)
+		{
+			if (token == "cut")
+			{
+				step.isCut = true;
+				continue;
+			}
+
+			const auto pos = token.find('=');
+			const auto name = token.substr(0, pos);
+			const int64_t value = pos == string::npos ? -1 : atoll(token.c_str() + pos + 1);
+
+			Impairment check;
+			if (value < 0 || !ApplySetting(check, name, value))
+			{
+				cerr << "[ChatProxy] script line " << lineNumber << " has an invalid setting: " << token << endl;
+				return false;
+			}
+
+			step.settings.emplace_back(name, value);
+		}
+
+		steps.emplace_back(move(step));
+	}
+
+	// Steps run in time order, whatever order the file lists them in.
+	stable_sort(steps.begin(), steps.end(), [](const ScriptStep& lhs, const ScriptStep& rhs) { return lhs.at < rhs.at; });
+
+	script = move(steps);
+	nextStep = 0;
+
+	cout << "[ChatProxy] script loaded, steps = " << script.size() << endl;
+	return true;
+}
+
+void ChatProxy::Run()
+{
+	if (!Listen())
+		return;
+
+	startTime = chrono::steady_clock::now();
+	stallStartTime = startTime;
+	lastRefillTime = startTime;
+	nextReportTime = startTime + chrono::milliseconds(ChatConstant::METRICS_REPORT_PERIOD);
+
+	cout << "[ChatProxy] forwarding port " << port << " to " << serverAddress << ':' << serverPort
+		<< ", latency = " << impairment.latency << " ms, jitter = " << impairment.jitter
+		<< " ms, bandwidth = " << impairment.bandwidth << " B/s" << endl;
+
+	vector<WSAPOLLFD> pollFds;
+
+	while (true)
+	{
+		auto currentTime = chrono::steady_clock::now();
+		RunScript(currentTime);
+
+		const bool isStalled = GetStallEnd(currentTime) > currentTime;
+
+		// Reads stop while too much waits in a direction; writes are only polled for while something is due.
+		auto getEvents = [isStalled, currentTime, this](const Direction& inbound, const Direction& outbound)
+			{
+				short events = 0;
+
+				if (!inbound.isEnded && inbound.numBuffered < ChatConstant::PROXY_BUFFER_LIMIT)
+				{
+					events |= POLLRDNORM;
+				}
+
+				if (!isStalled && !outbound.chunks.empty() && outbound.chunks.front().dueTime <= currentTime && !IsWaitingForTokens(outbound))
+				{
+					events |= POLLWRNORM;
+				}
+
+				return events;
+			};
+
+		pollFds.clear();
+		pollFds.push_back({ listenSocket, POLLRDNORM, 0 });
+
+		for (auto& link : links)
+		{
+			pollFds.push_back({ link.client, getEvents(link.upstream, link.downstream), 0 });
+			pollFds.push_back({ link.server, link.isConnecting ? static_cast<short>(POLLWRNORM) : getEvents(link.downstream, link.upstream), 0 });
+		}
+
+		const auto timeout = chrono::ceil<chrono::milliseconds>(GetNextWakeUp(currentTime) - currentTime).count();
+		if (WSAPoll(pollFds.data(), static_cast<u_long>(pollFds.size()), static_cast<int>(std::clamp<long long>(timeout, 0, INT_MAX))) == SOCKET_ERROR)
+		{
+			cerr << "[ChatProxy] WSAPoll failed, error = " << WSAGetLastError() << endl;
+			break;
+		}
+
+		currentTime = chrono::steady_clock::now();
+		RefillTokens(currentTime);
+
+		// Links are only added after this loop, so they still line up with their poll entries.
+		auto pollFd = pollFds.begin() + 1;
+
+		for (auto it = links.begin(); it != links.end(); pollFd += 2)
+		{
+			auto& link = *it;
+
+			if (link.isConnecting && !FinishConnect(link, pollFd[1].revents, currentTime))
+			{
+				Close(link);
+				it = links.erase(it);
+				continue;
+			}
+
+			Receive(link.client, link.upstream, currentTime);
+
+			if (!link.isConnecting)
+			{
+				Receive(link.server, link.downstream, currentTime);
+			}
+
+			const auto sentUp = link.isConnecting ? 0 : Send(link.server, link.upstream, currentTime);
+			const auto sentDown = Send(link.client, link.downstream, currentTime);
+
+			numUpstreamBytes += std::max<int64_t>(sentUp, 0);
+			numDownstreamBytes += std::max<int64_t>(sentDown, 0);
+
+			// A side that ended is closed once everything it sent got through, like a FIN would be.
+			const bool isDone = (link.upstream.isEnded && link.upstream.chunks.empty())
+				|| (link.downstream.isEnded && link.downstream.chunks.empty());
+
+			if (sentUp < 0 || sentDown < 0 || isDone)
+			{
+				Close(link);
+				it = links.erase(it);
+				continue;
+			}
+
+			++it;
+		}
+
+		if (pollFds[0].revents != 0)
+		{
+			Accept();
+		}
+
+		ReportMetrics(currentTime);
+	}
+
+	CloseAll();
+}
+
+bool ChatProxy::Listen()
+{
+	struct addrinfo* addrInfo = nullptr;
+	struct addrinfo hints;
+
+	ZeroMemory(&hints, sizeof(hints));
+	hints.ai_family = AF_INET;
+	hints.ai_socktype = SOCK_STREAM;
+	hints.ai_protocol = IPPROTO_TCP;
+	hints.ai_flags = AI_PASSIVE;
+
+	int result = getaddrinfo(NULL, port.c_str(), &hints, &addrInfo);
+	if (result != 0)
+	{
+		cerr << "[ChatProxy] getaddrinfo failed. error = " << result << endl;
+		return false;
+	}
+
+	listenSocket = ::socket(addrInfo->ai_family, addrInfo->ai_socktype, addrInfo->ai_protocol);
+	if (listenSocket == INVALID_SOCKET
+		|| ::bind(listenSocket, addrInfo->ai_addr, (int)addrInfo->ai_addrlen) == SOCKET_ERROR
+		|| listen(listenSocket, SOMAXCONN) == SOCKET_ERROR
+		|| !Network::SetNonBlocking(listenSocket))
+	{
+		cerr << "[ChatProxy] listen failed. error = " << WSAGetLastError() << endl;
+
+		freeaddrinfo(addrInfo);
+		if (listenSocket != INVALID_SOCKET)
+		{
+			closesocket(listenSocket);
+			listenSocket = INVALID_SOCKET;
+		}
+
+		return false;
+	}
+
+	freeaddrinfo(addrInfo);
+	return true;
+}
+
+void ChatProxy::Accept()
+{
+	while (true)
+	{
+		auto clientSocket = accept(listenSocket, NULL, NULL);
+		if (clientSocket == INVALID_SOCKET)
+		{
+			if (WSAGetLastError() != WSAEWOULDBLOCK)
+			{
+				cerr << "[ChatProxy] accept failed, error = " << WSAGetLastError() << endl;
+			}
+
+			return;
+		}
+
+		// The connect finishes in the poll loop, so a slow server never holds up the other links.
+		auto serverSocket = Network::ConnectAsync(serverAddress.c_str(), serverPort.c_str());
+		if (serverSocket == INVALID_SOCKET || !Network::SetNonBlocking(clientSocket))
+		{
+			cerr << "[ChatProxy] failed to connect to " << serverAddress << ':' << serverPort << endl;
+
+			if (serverSocket != INVALID_SOCKET)
+			{
+				closesocket(serverSocket);
+			}
+
+			closesocket(clientSocket);
+			continue;
+		}
+
+		// The proxy adds its own delays; Nagle on top of them would only blur what is being measured.
+		Network::SetNoDelay(clientSocket);
+
+		const auto currentTime = chrono::steady_clock::now();
+
+		Link link;
+		link.client = clientSocket;
+		link.server = serverSocket;
+		link.upstream.lastDueTime = currentTime;
+		link.downstream.lastDueTime = currentTime;
+		link.connectDeadline = currentTime + chrono::milliseconds(ChatConstant::CONNECT_TIMEOUT);
+
+		links.emplace_back(move(link));
+	}
+}
+
+bool ChatProxy::FinishConnect(Link& link, short revents, Network::TTimeStamp currentTime)
+{
+	if ((revents & (POLLWRNORM | POLLERR | POLLHUP)) == 0)
+	{
+		if (currentTime < link.connectDeadline)
+			return true;
+
+		cerr << "[ChatProxy] connecting to " << serverAddress << ':' << serverPort << " timed out" << endl;
+		return false;
+	}
+
+	const int error = Network::GetConnectError(link.server);
+	if (error != 0 || (revents & (POLLERR | POLLHUP)) != 0)
+	{
+		cerr << "[ChatProxy] failed to connect to " << serverAddress << ':' << serverPort << ", error = " << error << endl;
+		return false;
+	}
+
+	Network::SetNoDelay(link.server);
+	link.isConnecting = false;
+	return true;
+}
+
+void ChatProxy::RunScript(Network::TTimeStamp currentTime)
+{
+	while (nextStep < script.size() && startTime + script[nextStep].at <= currentTime)
+	{
+		const auto& step = script[nextStep++];
+
+		for (auto& setting : step.settings)
+		{
+			ApplySetting(impairment, setting.first, setting.second);
+
+			if (setting.first == "stall" || setting.first == "every")
+			{
+				stallStartTime = startTime + step.at;
+			}
+		}
+
+		cout << "[ChatProxy] step at " << step.at.count() << " ms: latency = " << impairment.latency
+			<< " ms, jitter = " << impairment.jitter << " ms, bandwidth = " << impairment.bandwidth
+			<< " B/s, stall = " << impairment.stallDuration << " ms every " << impairment.stallPeriod << " ms" << endl;
+
+		if (step.isCut)
+		{
+			cout << "[ChatProxy] cutting " << links.size() << " connection(s)" << endl;
+			CloseAll();
+		}
+	}
+}
+
+Network::TTimeStamp ChatProxy::GetStallEnd(Network::TTimeStamp currentTime) const
+{
+	if (impairment.stallDuration <= 0 || currentTime < stallStartTime)
+		return currentTime;
+
+	const auto duration = chrono::milliseconds(impairment.stallDuration);
+	auto begin = stallStartTime;
+
+	if (impairment.stallPeriod > 0)
+	{
+		const auto period = chrono::milliseconds(impairment.stallPeriod);
+		begin += (currentTime - stallStartTime) / period * period;
+	}
+
+	return std::max(currentTime, begin + duration);
+}
+
+void ChatProxy::Receive(Network::TSocket socket, Direction& direction, Network::TTimeStamp currentTime)
+{
+	while (!direction.isEnded && direction.numBuffered < ChatConstant::PROXY_BUFFER_LIMIT)
+	{
+		Chunk chunk;
+		chunk.data.resize(ChatConstant::PROXY_READ_SIZE);
+
+		const int length = recv(socket, chunk.data.data(), static_cast<int>(chunk.data.size()), 0);
+		if (length == SOCKET_ERROR && WSAGetLastError() == WSAEWOULDBLOCK)
+			return;
+
+		if (length <= 0)
+		{
+			direction.isEnded = true;
+			return;
+		}
+
+		chunk.data.resize(length);
+
+		// Jitter never reorders the stream: a chunk is not due before the one read ahead of it.
+		const auto jitter = impairment.jitter > 0 ? uniform_int_distribution<int>(0, impairment.jitter)(random) : 0;
+		chunk.dueTime = std::max(currentTime + chrono::milliseconds(impairment.latency + jitter), direction.lastDueTime);
+
+		direction.lastDueTime = chunk.dueTime;
+		direction.numBuffered += length;
+		direction.chunks.emplace_back(move(chunk));
+	}
+}
+
+int64_t ChatProxy::Send(Network::TSocket socket, Direction& direction, Network::TTimeStamp currentTime)
+{
+	if (GetStallEnd(currentTime) > currentTime)
+		return 0;
+
+	int64_t numSent = 0;
+
+	while (!direction.chunks.empty() && direction.chunks.front().dueTime <= currentTime)
+	{
+		auto& chunk = direction.chunks.front();
+		auto length = chunk.data.size() - chunk.offset;
+
+		if (impairment.bandwidth > 0)
+		{
+			length = std::min<size_t>(length, static_cast<size_t>(direction.tokens));
+			if (length == 0)
+				break;
+		}
+
+		const int sentBytes = send(socket, chunk.data.data() + chunk.offset, static_cast<int>(length), 0);
+		if (sentBytes == SOCKET_ERROR)
+		{
+			if (WSAGetLastError() == WSAEWOULDBLOCK)
+				break;
+
+			return -1;
+		}
+
+		chunk.offset += sentBytes;
+		direction.numBuffered -= sentBytes;
+		direction.tokens -= sentBytes;
+		numSent += sentBytes;
+
+		if (chunk.offset == chunk.data.size())
+		{
+			direction.chunks.pop_front();
+		}
+
+		if (static_cast<size_t>(sentBytes) < length)
+			break;
+	}
+
+	return numSent;
+}
+
+void ChatProxy::RefillTokens(Network::TTimeStamp currentTime)
+{
+	const auto elapsed = chrono::duration<double>(currentTime - lastRefillTime).count();
+	lastRefillTime = currentTime;
+
+	if (impairment.bandwidth <= 0)
+		return;
+
+	const double burst = std::max<double>(impairment.bandwidth * ChatConstant::PROXY_BURST_PERIOD / 1000.0, 1.0);
+
+	for (auto& link : links)
+	{
+		link.upstream.tokens = std::min(link.upstream.tokens + elapsed * impairment.bandwidth, burst);
+		link.downstream.tokens = std::min(link.downstream.tokens + elapsed * impairment.bandwidth, burst);
+	}
+}
+
+bool ChatProxy::IsWaitingForTokens(const Direction& direction) const
+{
+	return impairment.bandwidth > 0 && direction.tokens < 1.0;
+}
+
+Network::TTimeStamp ChatProxy::GetNextWakeUp(Network::TTimeStamp currentTime) const
+{
+	auto wakeUp = std::min(nextReportTime, currentTime + chrono::milliseconds(ChatConstant::METRICS_REPORT_PERIOD));
+
+	if (nextStep < script.size())
+	{
+		wakeUp = std::min(wakeUp, startTime + script[nextStep].at);
+	}
+
+	const auto stallEnd = GetStallEnd(currentTime);
+
+	for (auto& link : links)
+	{
+		// Nothing is due on a link still connecting; its poll entry wakes the loop once the connect finished.
+		if (link.isConnecting)
+		{
+			wakeUp = std::min(wakeUp, link.connectDeadline);
+			continue;
+		}
+
+		for (auto direction : { &link.upstream, &link.downstream })
+		{
+			if (direction->chunks.empty())
+				continue;
+
+			auto due = std::max(direction->chunks.front().dueTime, stallEnd);
+
+			// Waits for the bucket to hold at least one byte again.
+			if (IsWaitingForTokens(*direction))
+			{
+				const auto refill = chrono::duration<double>((1.0 - direction->tokens) / impairment.bandwidth);
+				due = std::max(due, currentTime + chrono::ceil<chrono::milliseconds>(refill));
+			}
+
+			wakeUp = std::min(wakeUp, due);
+		}
+	}
+
+	return wakeUp;
+}
+
+void ChatProxy::ReportMetrics(Network::TTimeStamp currentTime)
+{
+	if (currentTime < nextReportTime)
+		return;
+
+	const auto reportStartTime = nextReportTime - chrono::milliseconds(ChatConstant::METRICS_REPORT_PERIOD);
+	const auto seconds = chrono::duration<double>(currentTime - reportStartTime).count();
+
+	cout << "[ChatProxy] connections = " << links.size() << ", upstream = " << static_cast<uint64_t>(numUpstreamBytes / seconds)
+		<< " B/s, downstream = " << static_cast<uint64_t>(numDownstreamBytes / seconds) << " B/s" << endl;
+
+	numUpstreamBytes = 0;
+	numDownstreamBytes = 0;
+	nextReportTime = currentTime + chrono::milliseconds(ChatConstant::METRICS_REPORT_PERIOD);
+}
+
+void ChatProxy::CloseAll()
+{
+	for (auto& link : links)
+	{
+		Close(link);
+	}
+
+	links.clear();
+}
+
+void ChatProxy::Close(Link& link)
+{
+	closesocket(link.client);
+	closesocket(link.server);
+
+	link.client = INVALID_SOCKET;
+	link.server = INVALID_SOCKET;
+}
+
+bool ChatProxy::ApplySetting(Impairment& impairment, const string& name, int64_t value)
+{
+	if (value < 0)
+		return false;
+
+	const auto milliseconds = static_cast<int>(std::min<int64_t>(value, INT_MAX));
+
+	if (name == "latency")
+	{
+		impairment.latency = milliseconds;
+		return true;
+	}
+
+	if (name == "jitter")
+	{
+		impairment.jitter = milliseconds;
+		return true;
+	}
+
+	if (name == "bandwidth")
+	{
+		impairment.bandwidth = value;
+		return true;
+	}
+
+	if (name == "stall")
+	{
+		impairment.stallDuration = milliseconds;
+		return true;
+	}
+
+	if (name == "every")
+	{
+		impairment.stallPeriod = milliseconds;
+		return true;
+	}
+
+	return false;
+}
\ No newline at end of file
@@ -0,0 +1,118 @@
+#pragma once
+
+#include <chrono>
+#include <cstdint>
+#include <deque>
+#include <list>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "Network.h"
+
+
+// TCP proxy that forwards between clients and one server while impairing the link the way a mobile network
+// would: one-way latency with jitter, a bandwidth cap per direction, stalls and cut connections. Bytes are
+// never reordered or dropped, as TCP would not either; what changes is when they arrive.
+//
+// A script file changes the impairment over time, one step per line: <at ms> <setting>=<value>...
+// Settings are latency, jitter, bandwidth and stall (ms, ms, bytes/s, ms), every (ms between stalls,
+// 0 stalls once), and a bare "cut", which closes every proxied connection. Lines starting with # are skipped.
+class ChatProxy final
+{
+public:
+	struct Impairment
+	{
+		int latency = 0;
+		int jitter = 0;
+		// Bytes per second in each direction, 0 is unlimited.
+		int64_t bandwidth = 0;
+		int stallDuration = 0;
+		int stallPeriod = 0;
+	};
+
+private:
+	struct Chunk
+	{
+		Network::TTimeStamp dueTime;
+		std::vector<char> data;
+		size_t offset = 0;
+	};
+
+	// Bytes read from one side, waiting to be written to the other.
+	struct Direction
+	{
+		std::deque<Chunk> chunks;
+		size_t numBuffered = 0;
+		Network::TTimeStamp lastDueTime;
+		double tokens = 0;
+		bool isEnded = false;
+	};
+
+	struct Link
+	{
+		Network::TSocket client = INVALID_SOCKET;
+		Network::TSocket server = INVALID_SOCKET;
+		Direction upstream;
+		Direction downstream;
+		// Client bytes are buffered while the server side is still connecting.
+		Network::TTimeStamp connectDeadline;
+		bool isConnecting = true;
+	};
+
+	struct ScriptStep
+	{
+		std::chrono::milliseconds at;
+		std::vector<std::pair<std::string, int64_t>> settings;
+		bool isCut = false;
+	};
+
+	std::string port;
+	std::string serverAddress;
+	std::string serverPort;
+	Network::TSocket listenSocket;
+
+	Impairment impairment;
+	Network::TTimeStamp startTime;
+	Network::TTimeStamp stallStartTime;
+	Network::TTimeStamp lastRefillTime;
+	std::vector<ScriptStep> script;
+	size_t nextStep;
+	std::mt19937 random;
+
+	std::list<Link> links;
+	Network::TTimeStamp nextReportTime;
+	uint64_t numUpstreamBytes;
+	uint64_t numDownstreamBytes;
+
+public:
+	ChatProxy(const char* port, const char* serverAddress, const char* serverPort);
+	~ChatProxy();
+
+	ChatProxy(const ChatProxy&) = delete;
+	ChatProxy& operator = (const ChatProxy&) = delete;
+
+	inline void SetImpairment(const Impairment& impairment) { this->impairment = impairment; }
+	bool LoadScript(const char* path);
+
+	void Run();
+
+private:
+	bool Listen();
+	void Accept();
+	// Returns false once the server side failed to connect.
+	bool FinishConnect(Link& link, short revents, Network::TTimeStamp currentTime);
+	void RunScript(Network::TTimeStamp currentTime);
+	// Returns the end of the stall in progress, currentTime if there is none.
+	Network::TTimeStamp GetStallEnd(Network::TTimeStamp currentTime) const;
+	void Receive(Network::TSocket socket, Direction& direction, Network::TTimeStamp currentTime);
+	// Returns the bytes written, or -1 once the socket failed.
+	int64_t Send(Network::TSocket socket, Direction& direction, Network::TTimeStamp currentTime);
+	void RefillTokens(Network::TTimeStamp currentTime);
+	bool IsWaitingForTokens(const Direction& direction) const;
+	Network::TTimeStamp GetNextWakeUp(Network::TTimeStamp currentTime) const;
+	void ReportMetrics(Network::TTimeStamp currentTime);
+	void CloseAll();
+	static void Close(Link& link);
+	static bool ApplySetting(Impairment& impairment, const std::string& name, int64_t value);
+};
\ No newline at end of file
@@ -0,0 +1,35 @@
+#include "ChatRoomRing.h"
+
+#include <algorithm>
+#include <bit>
+
+
+using namespace std;
+
+ChatRoomRing::ChatRoomRing(size_t capacity)
+	: entries(std::bit_ceil(std::max<size_t>(capacity, 1)))
+	, mask(entries.size() - 1)
+	, head(0)
+{
+}
+
+void ChatRoomRing::Publish(const MessagePacket& message, uint64_t senderHandle)
+{
+	auto& entry = entries[head & mask];
+	entry.message = message;
+	entry.senderHandle = senderHandle;
+
+	++head;
+}
+
+uint64_t ChatRoomRing::CatchUp(uint64_t& cursor) const
+{
+	const uint64_t tail = head > entries.size() ? head - entries.size() : 0;
+	if (cursor >= tail)
+		return 0;
+
+	const auto numSkipped = tail - cursor;
+	cursor = tail;
+
+	return numSkipped;
+}
\ No newline at end of file
@@ -0,0 +1,39 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+#include "MessagePacket.h"
+
+
+// Preallocated ring of the messages published to a room. Publishing is O(1) whatever the size of the room:
+// readers keep their own cursor, the sequence of the next message they read, and the producer never looks at them.
+// A reader more than a lap behind has lost the oldest messages. Used from the chat thread only.
+class ChatRoomRing final
+{
+public:
+	struct Entry
+	{
+		MessagePacket message;
+		uint64_t senderHandle = 0;
+	};
+
+private:
+	std::vector<Entry> entries;
+	uint64_t mask;
+	uint64_t head;
+
+public:
+	// capacity is rounded up to a power of two.
+	explicit ChatRoomRing(size_t capacity);
+	~ChatRoomRing() = default;
+
+	void Publish(const MessagePacket& message, uint64_t senderHandle);
+
+	// Moves a lapped cursor to the oldest message still in the ring and returns the number of messages it skipped.
+	uint64_t CatchUp(uint64_t& cursor) const;
+
+	inline const Entry& At(uint64_t sequence) const { return entries[sequence & mask]; }
+	inline auto GetHead() const { return head; }
+	inline auto GetCapacity() const { return entries.size(); }
+};
\ No newline at end of file
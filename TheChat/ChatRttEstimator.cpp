@@ -0,0 +1,29 @@
+#include "ChatRttEstimator.h"
+
+#include <algorithm>
+
+
+using namespace std;
+
+ChatRttEstimator::ChatRttEstimator()
+	: smoothedRtt(0)
+	, variance(0)
+{
+}
+
+void ChatRttEstimator::AddSample(std::chrono::microseconds sample)
+{
+	// A zero estimate means no sample yet, so a loopback round trip counts as one microsecond.
+	sample = std::max(sample, chrono::microseconds(1));
+
+	if (smoothedRtt.count() == 0)
+	{
+		smoothedRtt = sample;
+		variance = sample / 2;
+		return;
+	}
+
+	const auto deviation = smoothedRtt > sample ? smoothedRtt - sample : sample - smoothedRtt;
+	variance = (variance * 3 + deviation) / 4;
+	smoothedRtt = (smoothedRtt * 7 + sample) / 8;
+}
\ No newline at end of file
@@ -0,0 +1,24 @@
+#pragma once
+
+#include <chrono>
+
+
+// Smoothed round trip time and its variance, fed with ping samples as TCP feeds its own (RFC 6298):
+// the first sample sets both, later ones move them by 1/8 and 1/4 of the difference.
+class ChatRttEstimator final
+{
+private:
+	std::chrono::microseconds smoothedRtt;
+	std::chrono::microseconds variance;
+
+public:
+	ChatRttEstimator();
+	~ChatRttEstimator() = default;
+
+	void AddSample(std::chrono::microseconds sample);
+
+	// Zero until the first sample.
+	inline auto GetSmoothedRtt() const { return smoothedRtt; }
+	inline auto GetVariance() const { return variance; }
+	inline auto GetRetransmitTimeout() const { return smoothedRtt + variance * 4; }
+};
\ No newline at end of file
@@ -0,0 +1,154 @@
+#include "ChatScheduler.h"
+
+#include <exception>
+#include <iostream>
+
+#include "ChatConnection.h"
+
+
+using namespace std;
+
+ChatScheduler::ChatScheduler(ChatSignal& wakeUpSignal, TConnectionResolver&& resolver)
+	: wakeUpSignal(wakeUpSignal)
+	, resolver(move(resolver))
+{
+}
+
+ChatScheduler::~ChatScheduler()
+{
+	workers.Stop();
+
+	// Whatever is still suspended belongs to nobody else; destroying the frames releases their locals.
+	coroutine_handle<> handle;
+	while (completedHandles.Pop(handle))
+	{
+		handle.destroy();
+	}
+
+	for (auto& ready : readyHandles)
+	{
+		ready.destroy();
+	}
+
+	while (!timers.empty())
+	{
+		timers.top().handle.destroy();
+		timers.pop();
+	}
+
+	for (auto& waiter : flushWaiters)
+	{
+		waiter.handle.destroy();
+	}
+}
+
+void ChatScheduler::StartWorkers(size_t numThreads)
+{
+	workers.Start(numThreads);
+}
+
+void ChatScheduler::StopWorkers()
+{
+	workers.Stop();
+}
+
+void ChatScheduler::Spawn(ChatTask&& task)
+{
+	task.Detach();
+}
+
+void ChatScheduler::Run()
+{
+	coroutine_handle<> handle;
+	while (completedHandles.Pop(handle))
+	{
+		readyHandles.push_back(handle);
+	}
+
+	const auto currentTime = chrono::steady_clock::now();
+	while (!timers.empty() && timers.top().dueTime <= currentTime)
+	{
+		readyHandles.push_back(timers.top().handle);
+		timers.pop();
+	}
+
+	ResolveFlushWaiters();
+
+	// Coroutines made ready while resuming these wait for the next iteration, so one busy handler cannot starve the loop.
+	deque<coroutine_handle<>> resumed;
+	swap(resumed, readyHandles);
+
+	for (auto& ready : resumed)
+	{
+		ready.resume();
+	}
+}
+
+void ChatScheduler::ResolveFlushWaiters()
+{
+	for (auto it = flushWaiters.begin(); it != flushWaiters.end();)
+	{
+		auto connection = resolver(it->connectionHandle);
+		const bool isGone = connection == nullptr || !connection->IsAlive();
+
+		if (!isGone && connection->GetNumSendRequests() > 0)
+		{
+			++it;
+			continue;
+		}
+
+		*it->isFlushed = !isGone;
+		readyHandles.push_back(it->handle);
+		it = flushWaiters.erase(it);
+	}
+}
+
+Network::TTimeStamp ChatScheduler::GetNextDueTime() const
+{
+	if (!readyHandles.empty())
+		return chrono::steady_clock::now();
+
+	if (timers.empty())
+		return Network::TTimeStamp::max();
+
+	return timers.top().dueTime;
+}
+
+void ChatScheduler::WorkerAwaiter::await_suspend(coroutine_handle<> handle)
+{
+	if (!scheduler.workers.IsStarted())
+	{
+		scheduler.StartWorkers(thread::hardware_concurrency());
+	}
+
+	auto& owner = scheduler;
+	scheduler.workers.Post([&owner, job = move(job), handle]()
+		{
+			try
+			{
+				job();
+			}
+			catch (const exception& e)
+			{
+				cerr << "[ChatScheduler][Error] worker job failed: " << e.what() << endl;
+			}
+
+			owner.completedHandles.Push(coroutine_handle<>(handle));
+			owner.wakeUpSignal.Notify();
+		});
+}
+
+bool ChatScheduler::FlushAwaiter::await_suspend(coroutine_handle<> handle)
+{
+	auto connection = scheduler.resolver(connectionHandle);
+	if (connection == nullptr || !connection->IsAlive())
+	{
+		isFlushed = false;
+		return false;
+	}
+
+	connection->RequestSend(packet);
+	scheduler.flushWaiters.push_back({ connectionHandle, handle, &isFlushed });
+
+	return true;
+}
\ No newline at end of file
@@ -0,0 +1,107 @@
+#pragma once
+
+#include <chrono>
+#include <coroutine>
+#include <deque>
+#include <functional>
+#include <queue>
+#include <vector>
+
+#include "ChatMPSCQueue.h"
+#include "ChatPacket.h"
+#include "ChatSignal.h"
+#include "ChatTask.h"
+#include "ChatWorkerPool.h"
+#include "Network.h"
+
+
+class ChatConnection;
+
+// Resumes ChatTask coroutines on the event loop thread. Run() has to be called once per loop iteration
+// after the connections are flushed, and the loop must not sleep past GetNextDueTime().
+// Coroutines refer to connections by handle, because a connection may be gone by the time they resume.
+class ChatScheduler final
+{
+public:
+	using TConnectionResolver = std::function<ChatConnection*(uint64_t connectionHandle)>;
+
+	struct SleepAwaiter
+	{
+		ChatScheduler& scheduler;
+		Network::TTimeStamp dueTime;
+
+		bool await_ready() const noexcept { return false; }
+		void await_suspend(std::coroutine_handle<> handle) { scheduler.timers.push({ dueTime, handle }); }
+		void await_resume() const noexcept {}
+	};
+
+	struct WorkerAwaiter
+	{
+		ChatScheduler& scheduler;
+		ChatWorkerPool::TJob job;
+
+		bool await_ready() const noexcept { return false; }
+		void await_suspend(std::coroutine_handle<> handle);
+		void await_resume() const noexcept {}
+	};
+
+	// Resumes with true once the packet has left the send queue, or false if the connection is gone.
+	struct FlushAwaiter
+	{
+		ChatScheduler& scheduler;
+		uint64_t connectionHandle;
+		ChatPacket packet;
+		bool isFlushed = false;
+
+		bool await_ready() const noexcept { return false; }
+		bool await_suspend(std::coroutine_handle<> handle);
+		bool await_resume() const noexcept { return isFlushed; }
+	};
+
+private:
+	struct Timer
+	{
+		Network::TTimeStamp dueTime;
+		std::coroutine_handle<> handle;
+
+		bool operator > (const Timer& rhs) const { return dueTime > rhs.dueTime; }
+	};
+
+	struct FlushWaiter
+	{
+		uint64_t connectionHandle;
+		std::coroutine_handle<> handle;
+		bool* isFlushed;
+	};
+
+private:
+	ChatSignal& wakeUpSignal;
+	TConnectionResolver resolver;
+
+	std::deque<std::coroutine_handle<>> readyHandles;
+	std::priority_queue<Timer, std::vector<Timer>, std::greater<Timer>> timers;
+	std::vector<FlushWaiter> flushWaiters;
+	ChatMPSCQueue<std::coroutine_handle<>> completedHandles;
+	ChatWorkerPool workers;
+
+public:
+	ChatScheduler(ChatSignal& wakeUpSignal, TConnectionResolver&& resolver);
+	~ChatScheduler();
+
+	ChatScheduler(const ChatScheduler&) = delete;
+	ChatScheduler& operator = (const ChatScheduler&) = delete;
+
+	void StartWorkers(size_t numThreads);
+	// Runs the jobs still queued, which may use the owner's state, so call it while the owner is whole.
+	void StopWorkers();
+	void Spawn(ChatTask&& task);
+	void Run();
+	Network::TTimeStamp GetNextDueTime() const;
+
+	inline SleepAwaiter Sleep(std::chrono::milliseconds duration) { return { *this, std::chrono::steady_clock::now() + duration }; }
+	inline WorkerAwaiter RunOnWorker(ChatWorkerPool::TJob&& job) { return { *this, std::move(job) }; }
+	inline FlushAwaiter SendAndFlush(uint64_t connectionHandle, const ChatPacket& packet) { return { *this, connectionHandle, packet }; }
+
+private:
+	void ResolveFlushWaiters();
+};
\ No newline at end of file
@@ -0,0 +1,231 @@
+#pragma once
+
+#include <algorithm>
+#include <bit>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <string_view>
+#include <tuple>
+#include <type_traits>
+
+
+// Compile-time packet schemas. A table lists its fields once, in wire order, from a static GetFields();
+// Encode/Decode walk that list and produce little-endian, padding-free bytes, so the payload layout no
+// longer depends on the compiler, the struct packing or the host byte order. MaxSize<T>() is the largest
+// encoding of T and is checked against the payload size where the table is encoded.
+namespace ChatSchema
+{
+	// Fixed capacity string, kept null-terminated in memory. On the wire: [length][characters].
+	template<size_t N>
+	struct String
+	{
+		static_assert(N <= UINT8_MAX, "String length has to fit its length byte.");
+		static constexpr size_t CAPACITY = N;
+
+		char data[N + 1] = {};
+		uint8_t length = 0;
+
+		// Copies as much of text as fits and returns the number of characters taken.
+		size_t Assign(std::string_view text)
+		{
+			length = static_cast<uint8_t>(std::min(text.size(), N));
+			memcpy(data, text.data(), length);
+			data[length] = '\0';
+
+			return length;
+		}
+
+		inline const char* c_str() const { return data; }
+		inline std::string_view View() const { return std::string_view(data, length); }
+	};
+
+	// Fixed capacity byte blob. On the wire: [16-bit length][bytes].
+	template<size_t N>
+	struct Bytes
+	{
+		static_assert(N <= UINT16_MAX, "Bytes length has to fit its length field.");
+		static constexpr size_t CAPACITY = N;
+
+		uint8_t data[N] = {};
+		uint16_t length = 0;
+	};
+
+	template<typename T, bool = std::is_enum_v<T>>
+	struct RawOf
+	{
+		using Type = std::make_unsigned_t<T>;
+	};
+
+	template<typename T>
+	struct RawOf<T, true>
+	{
+		using Type = std::make_unsigned_t<std::underlying_type_t<T>>;
+	};
+
+	// Encoding of one field type: MAX_SIZE, Encode() returning the end of what it wrote,
+	// and Decode() returning the end of what it read or nullptr if the input is malformed.
+	template<typename T, typename = void>
+	struct Field;
+
+	template<typename T>
+	struct Field<T, std::enable_if_t<(std::is_integral_v<T> || std::is_enum_v<T>) && !std::is_same_v<T, bool>>>
+	{
+		using TRaw = typename RawOf<T>::Type;
+		static constexpr size_t MAX_SIZE = sizeof(T);
+
+		static uint8_t* Encode(const T& value, uint8_t* out)
+		{
+			const auto raw = static_cast<TRaw>(value);
+
+			if constexpr (std::endian::native == std::endian::little)
+			{
+				memcpy(out, &raw, sizeof(raw));
+			}
+			else
+			{
+				for (size_t i = 0; i < sizeof(raw); ++i)
+				{
+					out[i] = static_cast<uint8_t>(raw >> (8 * i));
+				}
+			}
+
+			return out + sizeof(raw);
+		}
+
+		static const uint8_t* Decode(T& value, const uint8_t* in, const uint8_t* end)
+		{
+			if (static_cast<size_t>(end - in) < sizeof(TRaw))
+				return nullptr;
+
+			TRaw raw = 0;
+
+			if constexpr (std::endian::native == std::endian::little)
+			{
+				memcpy(&raw, in, sizeof(raw));
+			}
+			else
+			{
+				for (size_t i = 0; i < sizeof(raw); ++i)
+				{
+					raw |= static_cast<TRaw>(static_cast<TRaw>(in[i]) << (8 * i));
+				}
+			}
+
+			value = static_cast<T>(raw);
+			return in + sizeof(raw);
+		}
+	};
+
+	template<size_t N>
+	struct Field<String<N>>
+	{
+		static constexpr size_t MAX_SIZE = 1 + N;
+
+		static uint8_t* Encode(const String<N>& value, uint8_t* out)
+		{
+			const auto length = std::min<size_t>(value.length, N);
+
+			out[0] = static_cast<uint8_t>(length);
+			memcpy(out + 1, value.data, length);
+
+			return out + 1 + length;
+		}
+
+		static const uint8_t* Decode(String<N>& value, const uint8_t* in, const uint8_t* end)
+		{
+			if (in >= end)
+				return nullptr;
+
+			const size_t length = in[0];
+			if (length > N || static_cast<size_t>(end - in - 1) < length)
+				return nullptr;
+
+			memcpy(value.data, in + 1, length);
+			value.data[length] = '\0';
+			value.length = static_cast<uint8_t>(length);
+
+			return in + 1 + length;
+		}
+	};
+
+	template<size_t N>
+	struct Field<Bytes<N>>
+	{
+		static constexpr size_t MAX_SIZE = 2 + N;
+
+		static uint8_t* Encode(const Bytes<N>& value, uint8_t* out)
+		{
+			const auto length = static_cast<uint16_t>(std::min<size_t>(value.length, N));
+
+			out = Field<uint16_t>::Encode(length, out);
+			memcpy(out, value.data, length);
+
+			return out + length;
+		}
+
+		static const uint8_t* Decode(Bytes<N>& value, const uint8_t* in, const uint8_t* end)
+		{
+			uint16_t length = 0;
+
+			in = Field<uint16_t>::Decode(length, in, end);
+			if (in == nullptr || length > N || static_cast<size_t>(end - in) < length)
+				return nullptr;
+
+			memcpy(value.data, in, length);
+			value.length = length;
+
+			return in + length;
+		}
+	};
+
+	template<typename TMember>
+	struct MemberOf;
+
+	template<typename TPacket, typename TValue>
+	struct MemberOf<TValue TPacket::*>
+	{
+		using TField = Field<TValue>;
+	};
+
+	template<typename... TMembers>
+	constexpr auto Fields(TMembers... members)
+	{
+		return std::make_tuple(members...);
+	}
+
+	template<typename TPacket>
+	constexpr size_t MaxSize()
+	{
+		return std::apply([](auto... members) { return (size_t(0) + ... + MemberOf<decltype(members)>::TField::MAX_SIZE); }, TPacket::GetFields());
+	}
+
+	// Writes the fields of packet to out, which has room for MaxSize<TPacket>() bytes, and returns the bytes written.
+	template<typename TPacket>
+	size_t Encode(const TPacket& packet, uint8_t* out)
+	{
+		uint8_t* cursor = out;
+
+		std::apply([&packet, &cursor](auto... members)
+			{
+				((cursor = MemberOf<decltype(members)>::TField::Encode(packet.*members, cursor)), ...);
+			}, TPacket::GetFields());
+
+		return static_cast<size_t>(cursor - out);
+	}
+
+	// Reads the fields of packet from in. Fails on the first malformed field, leaving it and the rest untouched.
+	template<typename TPacket>
+	bool Decode(TPacket& packet, const uint8_t* in, size_t length)
+	{
+		const uint8_t* cursor = in;
+		const uint8_t* end = in + length;
+
+		std::apply([&packet, &cursor, end](auto... members)
+			{
+				((cursor = cursor != nullptr ? MemberOf<decltype(members)>::TField::Decode(packet.*members, cursor, end) : nullptr), ...);
+			}, TPacket::GetFields());
+
+		return cursor != nullptr;
+	}
+}
\ No newline at end of file
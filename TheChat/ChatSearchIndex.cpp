@@ -0,0 +1,503 @@
+#include "ChatSearchIndex.h"
+
+#include <algorithm>
+#include <cctype>
+#include <map>
+
+
+using namespace std;
+
+namespace
+{
+	void WriteVarint(vector<uint8_t>& data, uint32_t value)
+	{
+		while (value >= 0x80)
+		{
+			data.push_back(static_cast<uint8_t>(value | 0x80));
+			value >>= 7;
+		}
+
+		data.push_back(static_cast<uint8_t>(value));
+	}
+
+	uint32_t ReadVarint(const uint8_t*& cursor)
+	{
+		uint32_t value = 0;
+		int shift = 0;
+
+		while (*cursor & 0x80)
+		{
+			value |= uint32_t(*cursor++ & 0x7F) << shift;
+			shift += 7;
+		}
+
+		value |= uint32_t(*cursor++) << shift;
+		return value;
+	}
+
+	// A posting list of either the active segment or a sealed one, walked from the newest document.
+	class PostingList final
+	{
+	private:
+		const vector<uint32_t>* plain;
+		const ChatSearchIndex::Segment* segment;
+		const ChatSearchIndex::Segment::Term* term;
+
+		uint32_t cachedBlock;
+		vector<uint32_t> decoded;
+
+	public:
+		PostingList(const vector<uint32_t>& plain)
+			: plain(&plain), segment(nullptr), term(nullptr), cachedBlock(UINT32_MAX)
+		{
+		}
+
+		PostingList(const ChatSearchIndex::Segment& segment, const ChatSearchIndex::Segment::Term& term)
+			: plain(nullptr), segment(&segment), term(&term), cachedBlock(UINT32_MAX)
+		{
+		}
+
+		size_t GetCount() const { return plain != nullptr ? plain->size() : term->count; }
+
+		template <typename TFunc>
+		void ForEachDescending(TFunc&& func)
+		{
+			if (plain != nullptr)
+			{
+				for (auto it = plain->rbegin(); it != plain->rend(); ++it)
+				{
+					if (!func(*it))
+						return;
+				}
+
+				return;
+			}
+
+			const uint32_t numBlocks = (term->count + ChatSearchIndex::BLOCK_SIZE - 1) / ChatSearchIndex::BLOCK_SIZE;
+			for (uint32_t block = numBlocks; block-- > 0;)
+			{
+				Load(block);
+
+				for (auto it = decoded.rbegin(); it != decoded.rend(); ++it)
+				{
+					if (!func(*it))
+						return;
+				}
+			}
+		}
+
+		bool Contains(uint32_t doc)
+		{
+			if (plain != nullptr)
+				return binary_search(plain->begin(), plain->end(), doc);
+
+			const uint32_t numBlocks = (term->count + ChatSearchIndex::BLOCK_SIZE - 1) / ChatSearchIndex::BLOCK_SIZE;
+			auto first = segment->blocks.begin() + term->firstBlock;
+			auto last = first + numBlocks;
+
+			// The last block whose first document is not after doc.
+			auto it = upper_bound(first, last, doc, [](uint32_t value, const ChatSearchIndex::Segment::Block& block)
+				{
+					return value < block.firstDoc;
+				});
+
+			if (it == first)
+				return false;
+
+			Load(static_cast<uint32_t>(it - first) - 1);
+			return binary_search(decoded.begin(), decoded.end(), doc);
+		}
+
+	private:
+		void Load(uint32_t block)
+		{
+			if (cachedBlock == block)
+				return;
+
+			cachedBlock = block;
+			segment->DecodeBlock(*term, block, decoded);
+		}
+	};
+}
+
+const ChatSearchIndex::Segment::Term* ChatSearchIndex::Segment::Find(const string& term) const
+{
+	auto it = lower_bound(terms.begin(), terms.end(), term);
+	if (it == terms.end() || *it != term)
+		return nullptr;
+
+	return &termInfos[it - terms.begin()];
+}
+
+void ChatSearchIndex::Segment::DecodeBlock(const Term& term, uint32_t blockIndex, vector<uint32_t>& docs) const
+{
+	docs.clear();
+
+	auto& block = blocks[term.firstBlock + blockIndex];
+	const uint32_t numInBlock = std::min(BLOCK_SIZE, term.count - blockIndex * BLOCK_SIZE);
+
+	const uint8_t* cursor = data.data() + block.offset;
+	uint32_t doc = block.firstDoc;
+	docs.push_back(doc);
+
+	for (uint32_t i = 1; i < numInBlock; ++i)
+	{
+		doc += ReadVarint(cursor);
+		docs.push_back(doc);
+	}
+}
+
+void ChatSearchIndex::Segment::Append(const string& term, const vector<uint32_t>& docs)
+{
+	if (docs.empty())
+		return;
+
+	terms.push_back(term);
+	termInfos.push_back({ static_cast<uint32_t>(docs.size()), static_cast<uint32_t>(blocks.size()) });
+
+	for (size_t i = 0; i < docs.size(); ++i)
+	{
+		if (i % BLOCK_SIZE == 0)
+		{
+			blocks.push_back({ docs[i], static_cast<uint32_t>(data.size()) });
+			continue;
+		}
+
+		WriteVarint(data, docs[i] - docs[i - 1]);
+	}
+}
+
+size_t ChatSearchIndex::Segment::GetNumBytes() const
+{
+	size_t numBytes = data.size() + blocks.size() * sizeof(Block) + termInfos.size() * sizeof(Term);
+	for (auto& term : terms)
+	{
+		numBytes += sizeof(term) + term.capacity();
+	}
+
+	return numBytes;
+}
+
+ChatSearchIndex::ChatSearchIndex()
+	: activeFirstDoc(0)
+	, numActiveDocs(0)
+{
+}
+
+ChatSearchIndex::Query ChatSearchIndex::MakeQuery(string_view text, string_view sender, size_t maxResults)
+{
+	Query query;
+	query.maxResults = maxResults;
+
+	Tokenize(text, [&query](const string& term)
+		{
+			if (find(query.keys.begin(), query.keys.end(), term) == query.keys.end())
+			{
+				query.keys.push_back(term);
+			}
+		});
+
+	if (!sender.empty())
+	{
+		query.keys.push_back(SenderKey(sender));
+	}
+
+	return query;
+}
+
+void ChatSearchIndex::Tokenize(string_view text, const function<void(const string& term)>& func)
+{
+	string term;
+
+	for (size_t i = 0; i <= text.size(); ++i)
+	{
+		const auto ch = i < text.size() ? static_cast<unsigned char>(text[i]) : 0;
+		if (isalnum(ch))
+		{
+			term.push_back(static_cast<char>(tolower(ch)));
+			continue;
+		}
+
+		if (term.size() >= MIN_TERM_LENGTH && term.size() <= MAX_TERM_LENGTH)
+		{
+			func(term);
+		}
+
+		term.clear();
+	}
+}
+
+string ChatSearchIndex::SenderKey(string_view sender)
+{
+	// '@' never survives tokenizing, so sender keys cannot collide with terms.
+	string key("@");
+	for (auto ch : sender)
+	{
+		key.push_back(static_cast<char>(tolower(static_cast<unsigned char>(ch))));
+	}
+
+	return key;
+}
+
+void ChatSearchIndex::Add(uint32_t doc, string_view sender, string_view text)
+{
+	if (numActiveDocs == 0)
+	{
+		activeFirstDoc = doc;
+	}
+
+	auto addPosting = [this, doc](const string& key)
+	{
+		auto& postings = activePostings[key];
+		if (postings.empty() || postings.back() != doc)
+		{
+			postings.push_back(doc);
+		}
+	};
+
+	Tokenize(text, addPosting);
+	addPosting(SenderKey(sender));
+
+	if (++numActiveDocs >= SEGMENT_SIZE)
+	{
+		Seal();
+	}
+}
+
+void ChatSearchIndex::Seal()
+{
+	if (numActiveDocs == 0)
+		return;
+
+	map<string, vector<uint32_t>> sorted;
+	for (auto& postings : activePostings)
+	{
+		sorted.emplace(postings.first, move(postings.second));
+	}
+
+	auto segment = make_shared<Segment>();
+	segment->firstDoc = activeFirstDoc;
+	segment->numDocs = numActiveDocs;
+
+	for (auto& postings : sorted)
+	{
+		segment->Append(postings.first, postings.second);
+	}
+
+	segments.emplace_back(move(segment));
+	activePostings.clear();
+	numActiveDocs = 0;
+}
+
+ChatSearchIndex::Snapshot ChatSearchIndex::TakeSnapshot(const Query& query) const
+{
+	Snapshot snapshot;
+	snapshot.segments = segments;
+
+	for (auto& key : query.keys)
+	{
+		auto it = activePostings.find(key);
+		if (it != activePostings.end())
+		{
+			snapshot.activePostings.emplace(key, it->second);
+		}
+	}
+
+	return snapshot;
+}
+
+vector<uint32_t> ChatSearchIndex::Search(const Query& query) const
+{
+	return Search(TakeSnapshot(query), query);
+}
+
+vector<uint32_t> ChatSearchIndex::Search(const Snapshot& snapshot, const Query& query)
+{
+	vector<uint32_t> results;
+	if (query.keys.empty() || query.maxResults == 0)
+		return results;
+
+	// Intersects one source, driving with the shortest list and probing the others.
+	auto collect = [&results, &query](vector<PostingList>& lists)
+	{
+		sort(lists.begin(), lists.end(), [](const PostingList& lhs, const PostingList& rhs)
+			{
+				return lhs.GetCount() < rhs.GetCount();
+			});
+
+		lists.front().ForEachDescending([&](uint32_t doc)
+			{
+				for (size_t i = 1; i < lists.size(); ++i)
+				{
+					if (!lists[i].Contains(doc))
+						return true;
+				}
+
+				results.push_back(doc);
+				return results.size() < query.maxResults;
+			});
+	};
+
+	{
+		vector<PostingList> lists;
+		for (auto& key : query.keys)
+		{
+			auto it = snapshot.activePostings.find(key);
+			if (it == snapshot.activePostings.end())
+				break;
+
+			lists.emplace_back(it->second);
+		}
+
+		if (lists.size() == query.keys.size())
+		{
+			collect(lists);
+		}
+	}
+
+	for (auto it = snapshot.segments.rbegin(); it != snapshot.segments.rend() && results.size() < query.maxResults; ++it)
+	{
+		auto& segment = **it;
+
+		vector<PostingList> lists;
+		for (auto& key : query.keys)
+		{
+			auto term = segment.Find(key);
+			if (term == nullptr)
+				break;
+
+			lists.emplace_back(segment, *term);
+		}
+
+		if (lists.size() == query.keys.size())
+		{
+			collect(lists);
+		}
+	}
+
+	return results;
+}
+
+bool ChatSearchIndex::PlanMerge(TSegments& inputs) const
+{
+	// Tiers grow by MERGE_FACTOR, so every document is rewritten only log(N) times.
+	auto tierOf = [](const TSegment& segment)
+	{
+		int tier = 0;
+		for (uint64_t size = SEGMENT_SIZE * MERGE_FACTOR; segment->numDocs >= size; size *= MERGE_FACTOR)
+		{
+			++tier;
+		}
+
+		return tier;
+	};
+
+	for (size_t begin = 0; begin + MERGE_FACTOR <= segments.size(); ++begin)
+	{
+		const int tier = tierOf(segments[begin]);
+
+		size_t end = begin + 1;
+		while (end < segments.size() && end - begin < MERGE_FACTOR && tierOf(segments[end]) == tier)
+		{
+			++end;
+		}
+
+		if (end - begin == MERGE_FACTOR)
+		{
+			inputs.assign(segments.begin() + begin, segments.begin() + end);
+			return true;
+		}
+	}
+
+	return false;
+}
+
+ChatSearchIndex::TSegment ChatSearchIndex::Merge(const TSegments& inputs)
+{
+	auto merged = make_shared<Segment>();
+	if (inputs.empty())
+		return merged;
+
+	merged->firstDoc = inputs.front()->firstDoc;
+	for (auto& input : inputs)
+	{
+		merged->numDocs += input->numDocs;
+	}
+
+	// Inputs cover ascending document ranges, so a term's merged list is the concatenation of its lists.
+	vector<size_t> cursors(inputs.size(), 0);
+	vector<uint32_t> docs;
+	vector<uint32_t> block;
+
+	while (true)
+	{
+		const string* next = nullptr;
+		for (size_t i = 0; i < inputs.size(); ++i)
+		{
+			if (cursors[i] < inputs[i]->terms.size() && (next == nullptr || inputs[i]->terms[cursors[i]] < *next))
+			{
+				next = &inputs[i]->terms[cursors[i]];
+			}
+		}
+
+		if (next == nullptr)
+			break;
+
+		const string term(*next);
+		docs.clear();
+
+		for (size_t i = 0; i < inputs.size(); ++i)
+		{
+			auto& input = *inputs[i];
+			if (cursors[i] >= input.terms.size() || input.terms[cursors[i]] != term)
+				continue;
+
+			auto& info = input.termInfos[cursors[i]];
+			const uint32_t numBlocks = (info.count + BLOCK_SIZE - 1) / BLOCK_SIZE;
+
+			for (uint32_t blockIndex = 0; blockIndex < numBlocks; ++blockIndex)
+			{
+				input.DecodeBlock(info, blockIndex, block);
+				docs.insert(docs.end(), block.begin(), block.end());
+			}
+
+			++cursors[i];
+		}
+
+		merged->Append(term, docs);
+	}
+
+	return merged;
+}
+
+void ChatSearchIndex::CompleteMerge(const TSegments& inputs, TSegment merged)
+{
+	if (inputs.empty())
+		return;
+
+	auto first = find(segments.begin(), segments.end(), inputs.front());
+	if (first == segments.end() || size_t(segments.end() - first) < inputs.size()
+		|| !equal(inputs.begin(), inputs.end(), first))
+	{
+		return;
+	}
+
+	first = segments.erase(first, first + inputs.size());
+	segments.insert(first, move(merged));
+}
+
+size_t ChatSearchIndex::GetNumBytes() const
+{
+	size_t numBytes = 0;
+	for (auto& segment : segments)
+	{
+		numBytes += segment->GetNumBytes();
+	}
+
+	for (auto& postings : activePostings)
+	{
+		numBytes += postings.first.capacity() + postings.second.capacity() * sizeof(uint32_t);
+	}
+
+	return numBytes;
+}
\ No newline at end of file
@@ -0,0 +1,99 @@
+#pragma once
+
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+
+// Incremental inverted index over chat history. New messages go into a mutable in-memory segment that is
+// sealed into an immutable, compressed segment every SEGMENT_SIZE messages. Posting lists in sealed segments
+// are blocks of varint deltas with a skip entry per block, so the newest postings can be read without
+// decoding a whole list. Sealed segments of the same size tier are merged off the owner thread.
+class ChatSearchIndex final
+{
+public:
+	static constexpr uint32_t SEGMENT_SIZE = 1 << 16;
+	static constexpr uint32_t BLOCK_SIZE = 128;
+	static constexpr size_t MERGE_FACTOR = 8;
+	static constexpr size_t MIN_TERM_LENGTH = 2;
+	static constexpr size_t MAX_TERM_LENGTH = 32;
+
+	struct Segment
+	{
+		struct Term
+		{
+			uint32_t count;
+			uint32_t firstBlock;
+		};
+
+		struct Block
+		{
+			uint32_t firstDoc;
+			uint32_t offset;
+		};
+
+		uint32_t firstDoc = 0;
+		uint32_t numDocs = 0;
+		std::vector<std::string> terms;
+		std::vector<Term> termInfos;
+		std::vector<Block> blocks;
+		std::vector<uint8_t> data;
+
+		const Term* Find(const std::string& term) const;
+		void DecodeBlock(const Term& term, uint32_t blockIndex, std::vector<uint32_t>& docs) const;
+		void Append(const std::string& term, const std::vector<uint32_t>& docs);
+		size_t GetNumBytes() const;
+	};
+
+	using TSegment = std::shared_ptr<const Segment>;
+	using TSegments = std::vector<TSegment>;
+
+	// Query terms plus the optional sender key; a result has to match all of them.
+	struct Query
+	{
+		std::vector<std::string> keys;
+		size_t maxResults = 10;
+	};
+
+	// What a query needs, detached from the index so it can run on another thread.
+	struct Snapshot
+	{
+		TSegments segments;
+		std::unordered_map<std::string, std::vector<uint32_t>> activePostings;
+	};
+
+private:
+	TSegments segments;
+	std::unordered_map<std::string, std::vector<uint32_t>> activePostings;
+	uint32_t activeFirstDoc;
+	uint32_t numActiveDocs;
+
+public:
+	ChatSearchIndex();
+	~ChatSearchIndex() = default;
+
+	static Query MakeQuery(std::string_view text, std::string_view sender, size_t maxResults);
+	static void Tokenize(std::string_view text, const std::function<void(const std::string& term)>& func);
+
+	// Documents have to be added in ascending order.
+	void Add(uint32_t doc, std::string_view sender, std::string_view text);
+
+	Snapshot TakeSnapshot(const Query& query) const;
+	std::vector<uint32_t> Search(const Query& query) const;
+	static std::vector<uint32_t> Search(const Snapshot& snapshot, const Query& query);
+
+	bool PlanMerge(TSegments& inputs) const;
+	static TSegment Merge(const TSegments& inputs);
+	void CompleteMerge(const TSegments& inputs, TSegment merged);
+
+	inline auto GetNumSegments() const { return segments.size(); }
+	size_t GetNumBytes() const;
+
+private:
+	static std::string SenderKey(std::string_view sender);
+	void Seal();
+};
\ No newline at end of file
@@ -1,23 +1,58 @@
 
 #include "ChatServer.h"
 
+#include <algorithm>
+#include <cstring>
+#include <fstream>
 #include <iostream>
+#include <memory>
+#include <unordered_map>
 
 #define WIN32_LEAN_AND_MEAN
 
+#include <afunix.h>
 #include <windows.h>
 #include <ws2tcpip.h>
 
 #include "ChatConstant.h"
+#include "ChatIdTable.h"
+#include "ChatTracer.h"
 #include "GreetingsPacket.h"
+#include "IdMapPacket.h"
 #include "MessagePacket.h"
+#include "PeerHelloPacket.h"
+#include "PeerPresencePacket.h"
+#include "PrivateMessagePacket.h"
+#include "SearchPacket.h"
 
 
 using namespace std;
 
 ChatServer::ChatServer(const char* port)
 	: port(port)
+	, nodeName(string("node:") + port)
 	, listenSocket(INVALID_SOCKET)
+	, localListenSocket(INVALID_SOCKET)
+	, isRunning(false)
+	, scheduler(chatSignal, [this](uint64_t connectionHandle) { return FindConnection(connectionHandle); })
+	, isSearchEnabled(false)
+	, isIndexMerging(false)
+	, sessionTokens((static_cast<uint64_t>(random_device{}()) << 32) | random_device{}())
+	, room(ChatConstant::ROOM_RING_CAPACITY)
+	, numLappedReads(0)
+	, numSkippedMessages(0)
+	, numFanOutThreads(std::max<size_t>(thread::hardware_concurrency(), 1) - 1)
+	, fannedOutHead(0)
+	, hasRoomBacklog(false)
+	, coalesceSize(ChatConstant::COALESCE_SIZE)
+	, coalesceDelay(ChatConstant::COALESCE_DELAY)
+	, cpuMask(0)
+	, spinWindow(0)
+	, lastActivityTime(chrono::steady_clock::now())
+	, numSpinWakeUps(0)
+	, numBlockedWakeUps(0)
+	, nextConnectionHandle(0)
+	, isVerbose(true)
 {
 	BuildTableProcessor();
 }
@@ -31,7 +66,106 @@ ChatServer::~ChatServer()
 		chatThread.join();
 	}
 
+	if (peerThread.joinable())
+	{
+		peerThread.join();
+	}
+
 	Release();
+
+	if (localListenThread.joinable())
+	{
+		localListenThread.join();
+	}
+}
+
+void ChatServer::SetNodeName(const char* name)
+{
+	nodeName = name;
+}
+
+void ChatServer::AddPeer(const char* address, const char* port)
+{
+	PeerAddress peer;
+	peer.address = address;
+	peer.port = port;
+
+	peerAddresses.emplace_back(move(peer));
+}
+
+bool ChatServer::SetCapture(const char* path)
+{
+	return capture.Open(path, ChatConstant::CAPTURE_CAPACITY);
+}
+
+void ChatServer::SetVerbose(bool isVerbose)
+{
+	this->isVerbose = isVerbose;
+}
+
+void ChatServer::SetLocalPath(const char* path)
+{
+	localPath = path;
+}
+
+void ChatServer::SetAuthFile(const char* path)
+{
+	authPath = path;
+}
+
+bool ChatServer::SetFilterFile(const char* path)
+{
+	auto filter = ChatContentFilter::Load(path);
+	if (filter == nullptr)
+		return false;
+
+	cout << "[TheChatServer] content filter loaded, patterns = " << filter->GetNumPatterns()
+		<< ", states = " << filter->GetNumStates() << endl;
+
+	error_code error;
+	filterWriteTime = filesystem::last_write_time(path, error);
+	filterPath = path;
+	contentFilter = move(filter);
+
+	AddMessageStage([this](MessagePacket& message)
+		{
+			const int numMatches = contentFilter->Apply(message.message.data, message.message.length);
+			if (numMatches > 0 && isVerbose)
+			{
+				cout << "[TheChatServer] filtered " << numMatches << " match(es) from " << GetSenderID(message) << endl;
+			}
+
+			return true;
+		});
+
+	return true;
+}
+
+void ChatServer::SetSearchEnabled(bool isEnabled)
+{
+	isSearchEnabled = isEnabled;
+}
+
+void ChatServer::AddMessageStage(TMessageStage&& stage)
+{
+	messageStages.Add(move(stage));
+}
+
+void ChatServer::SetLowLatency(uint64_t cpuMask, std::chrono::microseconds spinWindow)
+{
+	this->cpuMask = cpuMask;
+	this->spinWindow = spinWindow;
+}
+
+void ChatServer::SetCoalescePolicy(size_t maxMessages, std::chrono::milliseconds maxDelay)
+{
+	coalesceSize = maxMessages;
+	coalesceDelay = maxDelay;
+}
+
+void ChatServer::SetFanOutThreads(size_t numThreads)
+{
+	numFanOutThreads = numThreads;
 }
 
 void ChatServer::Run()
@@ -39,6 +173,18 @@ void ChatServer::Run()
 	isRunning = true;
 
 	StartChatThread();
+
+	if (!peerAddresses.empty())
+	{
+		cout << "[TheChatServer] cluster node " << nodeName << ", peers = " << peerAddresses.size() << endl;
+		StartPeerThread();
+	}
+
+	if (!localPath.empty())
+	{
+		localListenThread = thread([this]() { ListenLocal(); });
+	}
+
 	Listen();
 
 	Release();
@@ -98,9 +244,53 @@ void ChatServer::Listen()
 	cout << "[TheChatServer] Listen port = " << port << endl;
 
 	isRunning = true;
+	AcceptLoop(listenSocket);
+}
+
+void ChatServer::ListenLocal()
+{
+	struct sockaddr_un sockAddr;
+	ZeroMemory(&sockAddr, sizeof(sockAddr));
+	sockAddr.sun_family = AF_UNIX;
+
+	if (localPath.size() >= sizeof(sockAddr.sun_path))
+	{
+		cerr << "[TheChatServer] local socket path is too long: " << localPath << endl;
+		return;
+	}
+
+	memcpy(sockAddr.sun_path, localPath.c_str(), localPath.size());
+
+	// A stale socket file from a previous run would make bind fail.
+	DeleteFileA(localPath.c_str());
+
+	localListenSocket = ::socket(AF_UNIX, SOCK_STREAM, 0);
+	if (localListenSocket == INVALID_SOCKET)
+	{
+		cerr << "[TheChatServer] local socket failed. error = " << WSAGetLastError() << endl;
+		return;
+	}
+
+	if (::bind(localListenSocket, (sockaddr*)(&sockAddr), sizeof(sockAddr)) == SOCKET_ERROR
+		|| listen(localListenSocket, SOMAXCONN) == SOCKET_ERROR)
+	{
+		cerr << "[TheChatServer] local listen failed. error = " << WSAGetLastError() << endl;
+
+		closesocket(localListenSocket);
+		localListenSocket = INVALID_SOCKET;
+		return;
+	}
+
+	cout << "[TheChatServer] Listen local = " << localPath << endl;
+
+	AcceptLoop(localListenSocket);
+}
+
+void ChatServer::AcceptLoop(Network::TSocket socket)
+{
 	while (isRunning)
 	{
-		auto clientSocket = accept(listenSocket, NULL, NULL);
+		auto clientSocket = accept(socket, NULL, NULL);
 		if (clientSocket == INVALID_SOCKET)
 		{
 			cerr << "[TheChatServer] accept failed, error = " << WSAGetLastError() << endl;
@@ -118,127 +308,208 @@ void ChatServer::Listen()
 			continue;
 		}
 
-		{
-			lock_guard<mutex> lock(connectionsLock);
+		acceptedSockets.Push(clientSocket);
+		chatSignal.Notify();
+	}
+}
 
-			connections.emplace_back(clientSocket);
-			clientSocket = INVALID_SOCKET;
+void ChatServer::StartChatThread()
+{
+	auto Func = [this]()
+	{
+		vector<WSAPOLLFD> pollFds;
 
-			auto& connection = connections.back();
-			cout << "[TheChatServer] connection established with " << connection.GetID()
-				<< '@' << connection.GetAddress() << endl;
+		ChatTracer::NameThread("chat");
+		PinChatThread();
 
-			auto func = [](const auto& connection) -> bool
-			{
-				bool isAlive = connection.IsAlive();
-				if (!isAlive)
-				{
-					cout << "[TheChatServer] client connection closed." << endl;
-					return true;
-				}
+		fanOutPool.Start(numFanOutThreads);
+
+		if (!filterPath.empty())
+		{
+			scheduler.Spawn(WatchFilterFile());
+		}
 
-				return false;
-			};
+		while (isRunning)
+		{
+			AcceptConnections();
+			SweepConnections();
 
-			for (auto iter = connections.begin(); iter != connections.end(); ++iter)
-			{
-				if (!func(*iter))
-					continue;
+			ReportMetrics();
+			ProcessPeerLinks();
+			PublishPresence();
 
-				iter = connections.erase(iter);
-			}
+			PollConnections(pollFds);
+			scheduler.Run();
 		}
+
+		fanOutPool.Stop();
+		scheduler.StopWorkers();
+
+		activePeers.clear();
+		peerLinks.clear();
+		connectionsByHandle.clear();
+		connections.clear();
+	};
+
+	chatThread = thread(Func);
+}
+
+void ChatServer::PinChatThread()
+{
+	if (!IsLowLatency())
+		return;
+
+	if (cpuMask != 0 && SetThreadAffinityMask(GetCurrentThread(), static_cast<DWORD_PTR>(cpuMask)) == 0)
+	{
+		cerr << "[TheChatServer] SetThreadAffinityMask failed, error = " << GetLastError() << endl;
+	}
+
+	if (!SetThreadPriority(GetCurrentThread(), THREAD_PRIORITY_HIGHEST))
+	{
+		cerr << "[TheChatServer] SetThreadPriority failed, error = " << GetLastError() << endl;
 	}
+
+	cout << "[TheChatServer] low-latency mode, cpu mask = 0x" << hex << cpuMask << dec
+		<< ", spin window = " << spinWindow.count() << "us" << endl;
 }
 
-void ChatServer::StartChatThread()
+void ChatServer::Replay(const char* path, bool isPaced)
 {
-	auto Func = [this]()
+	auto entries = ChatCapture::Load(path);
+	if (entries.empty())
 	{
-		fd_set readSet;
-		fd_set writeSet;
-		timeval tval{ 0, 0 };
+		cerr << "[TheChatServer] nothing to replay in " << path << endl;
+		return;
+	}
 
-		vector<ChatPacket> sendBuffer;
-		vector<Network::TSocket> quitList;
+	cout << "[TheChatServer] replaying " << entries.size() << " entries from " << path
+		<< (isPaced ? " at recorded pace" : " as fast as possible") << endl;
 
-		while (isRunning)
+	unordered_map<uint64_t, ChatConnection*> replayed;
+	uint64_t numPackets = 0;
+	uint64_t numSent = 0;
+
+	const auto firstTimestamp = entries.front().timestamp;
+	const auto startTime = chrono::steady_clock::now();
+
+	for (auto& entry : entries)
+	{
+		if (isPaced)
 		{
-			lock_guard<mutex> lock(connectionsLock);
-			
-			{
-				for (auto it = connections.begin(); it != connections.end();)
-				{
-					auto& connection = *it;
-					if (connection.IsAlive())
-					{
-						++it;
-						continue;
-					}
-					
-					cout << "[TheChatServer] connection closed with " << connection.GetID()
-						<< '@' << connection.GetAddress() << endl;
-
-					it = connections.erase(it);
-				}
-			}
+			this_thread::sleep_until(startTime + chrono::microseconds(entry.timestamp - firstTimestamp));
+		}
 
-			const auto numConnections = connections.size();
-			if (numConnections < 1)
+		auto iter = replayed.find(entry.handle);
+
+		if (entry.event == ChatCapture::EEvent::Close)
+		{
+			if (iter == replayed.end())
 				continue;
 
-			FD_ZERO(&readSet);
-			FD_ZERO(&writeSet);
+			iter->second->Close();
+			replayed.erase(iter);
 
-			for (auto& connection : connections)
-			{
-				FD_SET(connection.GetSocket(), &readSet);
-				FD_SET(connection.GetSocket(), &writeSet);
-			}
+			SweepConnections();
+			continue;
+		}
 
-			int count = select(0, &readSet, &writeSet, nullptr, &tval);
-			if (count <= 0)
-				continue;
+		if (iter == replayed.end())
+		{
+			connections.emplace_back(make_unique<ChatConnection>(INVALID_SOCKET));
 
-			for (auto& connection : connections)
-			{
-				if (!FD_ISSET(connection.GetSocket(), &readSet))
-					continue;
+			auto connection = connections.back().get();
+			connection->SetDeliveryLatencyHistogram(&deliveryLatency);
+			connection->SetCoalescePolicy(coalesceSize, coalesceDelay);
+			connection->SetHandle(entry.handle);
+			connectionsByHandle[entry.handle] = connection;
 
-				connection.Receive();
-				auto received = connection.ExtractReceived();
+			iter = replayed.emplace(entry.handle, connection).first;
+		}
 
-				if (received.size() <= 0)
-					continue;
+		auto& connection = *iter->second;
+		connection.InjectReceived(entry.packet);
 
-				for (auto& packet : received)
-				{
-					ProcessTable(connection, packet);
-				}
+		for (auto& packet : connection.ExtractReceived())
+		{
+			ProcessTable(connection, packet);
+		}
+
+		++numPackets;
+		scheduler.Run();
+
+		for (auto& peer : connections)
+		{
+			ReadRoom(*peer);
+
+			numSent += peer->GetNumSendRequests();
+			peer->FlushSendRequests();
+		}
+
+		PublishPresence();
+	}
+
+	const auto elapsed = chrono::duration<double>(chrono::steady_clock::now() - startTime).count();
+
+	cout << "[TheChatServer] replay finished: packets = " << numPackets
+		<< ", elapsed = " << elapsed << "s"
+		<< ", packets/s = " << static_cast<uint64_t>(numPackets / std::max(elapsed, 1e-9))
+		<< ", sends = " << numSent
+		<< ", sends/s = " << static_cast<uint64_t>(numSent / std::max(elapsed, 1e-9)) << endl;
+
+	scheduler.StopWorkers();
+
+	activePeers.clear();
+	connectionsByHandle.clear();
+	connections.clear();
+}
+
+void ChatServer::StartPeerThread()
+{
+	auto func = [this]()
+	{
+		vector<bool> isLinked(peerAddresses.size(), false);
+
+		while (isRunning)
+		{
+			size_t lost = 0;
+			while (lostPeers.Pop(lost))
+			{
+				isLinked[lost] = false;
 			}
 
-			for (auto& connection : connections)
+			for (size_t i = 0; i < peerAddresses.size(); ++i)
 			{
-				if (!FD_ISSET(connection.GetSocket(), &writeSet))
+				if (isLinked[i])
+					continue;
+
+				const auto& peer = peerAddresses[i];
+				auto socket = Network::Connect(peer.address.c_str(), peer.port.c_str());
+				if (socket == INVALID_SOCKET)
 					continue;
 
-				connection.FlushSendRequests();
+				connectedPeers.Push({ i, socket });
+				chatSignal.Notify();
+
+				isLinked[i] = true;
 			}
-		}
 
-		Release();
+			this_thread::sleep_for(chrono::milliseconds(ChatConstant::PEER_RETRY_PERIOD));
+		}
 	};
 
-	chatThread = thread(Func);
+	peerThread = thread(func);
 }
 
 void ChatServer::Release()
 {
 	isRunning = false;
+	chatSignal.Notify();
 
+	if (localListenSocket != INVALID_SOCKET)
 	{
-		lock_guard<mutex> lock(connectionsLock);
-		connections.clear();
+		closesocket(localListenSocket);
+		localListenSocket = INVALID_SOCKET;
+		DeleteFileA(localPath.c_str());
 	}
 
 	if (listenSocket == INVALID_SOCKET)
@@ -254,54 +525,1154 @@ void ChatServer::Release()
 	listenSocket = INVALID_SOCKET;
 }
 
-void ChatServer::BuildTableProcessor()
+void ChatServer::AcceptConnections()
 {
-	procMap.emplace(EChatTableID::MESSAGE_TABLE, [this](ChatConnection& connection, ChatPacket& packet)
+	Network::TSocket socket = INVALID_SOCKET;
+
+	while (acceptedSockets.Pop(socket))
+	{
+		connections.emplace_back(make_unique<ChatConnection>(socket));
+
+		auto& connection = *connections.back();
+		if (IsLowLatency() && !connection.IsLocal())
 		{
-			auto& message = packet.As<MessagePacket>();
-			message.Validate();
+			Network::SetNoDelay(socket);
+		}
 
-			cout << "[TheChatServer] From: " << message.GetSenderID() << ", Message: " << message.GetMessage() << endl;
+		connection.SetDeliveryLatencyHistogram(&deliveryLatency);
+		connection.SetTrafficStats(&trafficStats);
+		connection.SetCoalescePolicy(coalesceSize, coalesceDelay);
+		connection.SetHandle(++nextConnectionHandle);
+		connectionsByHandle[connection.GetHandle()] = &connection;
 
-			for (auto& peer : connections)
-			{
-				if (connection == peer)
-					continue;
+		if (capture.IsOpen())
+		{
+			connection.SetCapture(&capture);
+		}
+
+		if (isVerbose)
+		{
+			cout << "[TheChatServer] connection established with " << connection.GetID()
+				<< '@' << connection.GetAddress() << endl;
+		}
+	}
+}
+
+void ChatServer::SweepConnections()
+{
+	const auto currentTime = chrono::steady_clock::now();
 
-				peer.RequestSend(packet);
+	for (auto it = connections.begin(); it != connections.end();)
+	{
+		auto& connection = **it;
+		if (connection.IsAlive())
+		{
+			// Only connections that went quiet are pinged; the next flush sends it.
+			if (connection.IsPingDue(currentTime))
+			{
+				connection.SendPing();
 			}
-		});
 
-	procMap.emplace(EChatTableID::GREETINGS_TABLE, [this](ChatConnection& connection, ChatPacket& packet)
+			++it;
+			continue;
+		}
+
+		if (isVerbose)
 		{
-			auto& greetings = packet.As<GreetingsPacket>();
-			connection.SetID(greetings.GetSenderID());
+			cout << "[TheChatServer] connection closed with " << connection.GetID()
+				<< '@' << connection.GetAddress() << endl;
+		}
 
-			cout << "[TheChatServer] From: " << greetings.GetSenderID() << ", Greetings! " << endl;
-		});
+		capture.WriteClose(connection.GetHandle());
+		RetireConnection(connection);
+		connectionsByHandle.erase(connection.GetHandle());
+		it = connections.erase(it);
+	}
 }
 
-void ChatServer::ProcessTable(ChatConnection& connection, ChatPacket& packet)
+void ChatServer::PollConnections(vector<WSAPOLLFD>& pollFds)
 {
-	const auto tableId = packet.header.tableId;
-	auto iter = procMap.find(tableId);
-	if (iter == procMap.end())
+	auto wakeUp = GetNextWakeUp();
+
+	auto addPollFd = [this, &pollFds, &wakeUp](ChatConnection& connection)
 	{
-		cerr << "[TheChatServer][Error] unhandled table id " << static_cast<uint16_t>(tableId)
-			<< " from " << connection.GetID() << '@' << connection.GetAddress() << endl;
-		return;
+		WSAPOLLFD pollFd;
+		pollFd.fd = connection.GetSocket();
+		pollFd.events = connection.IsSendBlocked() ? (POLLRDNORM | POLLWRNORM) : POLLRDNORM;
+		pollFd.revents = 0;
+
+		pollFds.push_back(pollFd);
+		wakeUp = std::min({ wakeUp, connection.GetNextDueTime(), connection.GetNextPingTime() });
+
+		if (IsBehindRoom(connection))
+		{
+			wakeUp = chrono::steady_clock::now();
+		}
+	};
+
+	pollFds.clear();
+	pollFds.push_back({ chatSignal.GetSocket(), POLLRDNORM, 0 });
+
+	for (auto& connection : connections)
+	{
+		addPollFd(*connection);
 	}
-		
-	auto proc = iter->second;
-	if (proc == nullptr)
+
+	for (auto& link : peerLinks)
 	{
-		cerr << "[TheChatServer][Error] null processor for table id " << static_cast<uint16_t>(tableId)
-			<< " from " << connection.GetID() << '@' << connection.GetAddress() << endl;
+		addPollFd(*link.connection);
+	}
+
+	int count = WaitForEvents(pollFds, wakeUp);
+	if (count == SOCKET_ERROR)
+	{
+		cerr << "[TheChatServer] WSAPoll failed, error = " << WSAGetLastError() << endl;
 		return;
 	}
-	
-	cout << "[TheChatServer] Process table " << static_cast<uint16_t>(tableId)
-		<< " from " << connection.GetID() << '@' << connection.GetAddress() << endl;
 
-	proc(connection, packet);
+	if (pollFds[0].revents != 0)
+	{
+		chatSignal.Drain();
+	}
+
+	for (size_t i = 0; i < connections.size(); ++i)
+	{
+		if (pollFds[i + 1].revents == 0)
+			continue;
+
+		auto& connection = *connections[i];
+		connection.Receive();
+
+		for (auto& packet : connection.ExtractReceived())
+		{
+			ProcessTable(connection, packet);
+		}
+	}
+
+	FlushConnections();
 }
+
+// Each connection is read and flushed by exactly one thread per pass, so what it sends stays in order.
+// Only the connections themselves are written in parallel; the room is not published to during a pass.
+void ChatServer::FlushConnections()
+{
+	auto flush = [this](ChatConnection& connection)
+	{
+		ReadRoom(connection);
+
+		if (connection.HasSendRequests())
+		{
+			connection.FlushSendRequests();
+		}
+	};
+
+	const bool isRoomMoved = room.GetHead() != fannedOutHead || hasRoomBacklog.load(memory_order_relaxed);
+
+	if (!fanOutPool.IsStarted() || connections.size() < ChatConstant::FAN_OUT_PARALLEL_THRESHOLD || !isRoomMoved)
+	{
+		for (auto& connection : connections)
+		{
+			flush(*connection);
+		}
+
+		return;
+	}
+
+	ChatTraceScope traceScope("ParallelFanOut", room.At(room.GetHead() - 1).message.header.traceId);
+
+	hasRoomBacklog.store(false, memory_order_relaxed);
+	fannedOutHead = room.GetHead();
+
+	const auto numChunks = (connections.size() + ChatConstant::FAN_OUT_CHUNK_SIZE - 1) / ChatConstant::FAN_OUT_CHUNK_SIZE;
+
+	fanOutPool.Run(numChunks, [this, &flush](size_t chunk)
+		{
+			const auto begin = chunk * ChatConstant::FAN_OUT_CHUNK_SIZE;
+			const auto end = std::min(begin + ChatConstant::FAN_OUT_CHUNK_SIZE, connections.size());
+
+			for (size_t i = begin; i < end; ++i)
+			{
+				flush(*connections[i]);
+			}
+		});
+}
+
+// Moves what the connection has not read from the room yet into its send queue, a window at a time,
+// so a slow reader keeps its backlog in the room instead of its own queue.
+void ChatServer::ReadRoom(ChatConnection& connection)
+{
+	if (connection.IsPeer() || !connection.IsIdentified())
+		return;
+
+	auto cursor = connection.GetRoomCursor();
+	if (cursor == room.GetHead())
+		return;
+
+	const auto numSkipped = room.CatchUp(cursor);
+	if (numSkipped > 0)
+	{
+		++numLappedReads;
+		numSkippedMessages += numSkipped;
+
+		// The reader is told where the gap is, in order, rather than seeing the conversation jump.
+		MessagePacket notice;
+		notice.SetSenderNumber(ChatIdTable::SERVER_NUMBER);
+		notice.SetMessage("You missed " + to_string(numSkipped) + " messages while falling behind.");
+
+		connection.RequestSendMessage(notice);
+	}
+
+	while (cursor < room.GetHead() && connection.GetNumSendRequests() < ChatConstant::SEND_WINDOW)
+	{
+		const auto& entry = room.At(cursor++);
+		if (entry.senderHandle == connection.GetHandle())
+			continue;
+
+		connection.RequestSendMessage(entry.message);
+	}
+
+	connection.SetRoomCursor(cursor);
+
+	if (cursor < room.GetHead())
+	{
+		hasRoomBacklog.store(true, memory_order_relaxed);
+	}
+}
+
+bool ChatServer::IsBehindRoom(const ChatConnection& connection) const
+{
+	return connection.GetRoomCursor() < room.GetHead() && connection.IsIdentified() && !connection.IsPeer()
+		&& !connection.IsSendBlocked() && connection.GetNumSendRequests() < ChatConstant::SEND_WINDOW;
+}
+
+Network::TTimeStamp ChatServer::GetNextWakeUp() const
+{
+	auto wakeUp = std::min(nextMetricsReport, scheduler.GetNextDueTime());
+
+	if (presence.HasChanges())
+	{
+		wakeUp = std::min(wakeUp, nextPresenceTick);
+	}
+
+	return wakeUp;
+}
+
+int ChatServer::WaitForEvents(vector<WSAPOLLFD>& pollFds, Network::TTimeStamp wakeUp)
+{
+	const auto fds = pollFds.data();
+	const auto numFds = static_cast<u_long>(pollFds.size());
+	const auto pollStartTime = chrono::steady_clock::now();
+
+	auto recordWakeUp = [this, pollStartTime](uint64_t& numWakeUps)
+	{
+		const auto currentTime = chrono::steady_clock::now();
+		idleGap.Record(chrono::duration_cast<chrono::microseconds>(currentTime - pollStartTime));
+		lastActivityTime = currentTime;
+		++numWakeUps;
+	};
+
+	// Spinning only right after activity keeps bursts on the fast path without burning a core while idle.
+	const auto spinEndTime = std::min(lastActivityTime + spinWindow, wakeUp);
+	while (chrono::steady_clock::now() < spinEndTime)
+	{
+		int count = WSAPoll(fds, numFds, 0);
+		if (count > 0)
+		{
+			recordWakeUp(numSpinWakeUps);
+		}
+
+		if (count != 0)
+			return count;
+
+		YieldProcessor();
+	}
+
+	const auto currentTime = chrono::steady_clock::now();
+	auto timeout = chrono::duration_cast<chrono::milliseconds>(wakeUp - currentTime).count() + 1;
+	timeout = std::max<long long>(0, std::min<long long>(timeout, ChatConstant::METRICS_REPORT_PERIOD));
+
+	int count = WSAPoll(fds, numFds, static_cast<int>(timeout));
+	if (count > 0)
+	{
+		recordWakeUp(numBlockedWakeUps);
+	}
+	else if (count == 0 && timeout > 0)
+	{
+		const auto lateness = std::max(chrono::steady_clock::now() - wakeUp, chrono::steady_clock::duration::zero());
+		wakeUpLateness.Record(chrono::duration_cast<chrono::microseconds>(lateness));
+	}
+
+	return count;
+}
+
+void ChatServer::ProcessPeerLinks()
+{
+	PeerSocket peerSocket;
+
+	while (connectedPeers.Pop(peerSocket))
+	{
+		PeerLink link{ peerSocket.addressIndex, string(), make_unique<ChatConnection>(peerSocket.socket) };
+		auto& connection = *link.connection;
+		connection.SetBatchPolicy(ChatConstant::PEER_BATCH_SIZE, chrono::milliseconds(ChatConstant::PEER_BATCH_DELAY));
+
+		// Presence follows once the other node has replied and is known by name.
+		PeerHelloPacket hello(nodeName);
+		connection.RequestSend(ChatPacket::Encode(hello));
+
+		const auto& peer = peerAddresses[link.addressIndex];
+		cout << "[TheChatServer] peer link established with " << peer.address << ':' << peer.port << endl;
+
+		peerLinks.emplace_back(move(link));
+	}
+
+	const auto currentTime = chrono::steady_clock::now();
+
+	for (auto it = peerLinks.begin(); it != peerLinks.end();)
+	{
+		auto& link = *it;
+		auto& connection = *link.connection;
+
+		if (!connection.IsAlive())
+		{
+			const auto& peer = peerAddresses[link.addressIndex];
+			cout << "[TheChatServer] peer link lost with " << link.nodeName
+				<< '@' << peer.address << ':' << peer.port << endl;
+
+			DeactivatePeer(connection);
+			lostPeers.Push(link.addressIndex);
+			it = peerLinks.erase(it);
+			continue;
+		}
+
+		// Both nodes ping a quiet link, so either notices a dead one without the other.
+		if (connection.IsPingDue(currentTime))
+		{
+			connection.SendPing();
+		}
+
+		connection.Receive();
+
+		// The link carries traffic both ways: presence, messages and ID maps of the other node arrive here too.
+		for (auto& packet : connection.ExtractReceived())
+		{
+			if (packet.header.tableId == EChatTableID::PEER_HELLO_TABLE)
+			{
+				PeerHelloPacket hello;
+				if (!packet.Decode(hello) || !hello.IsReply() || connection.IsPeer())
+					continue;
+
+				link.nodeName = hello.GetNodeName();
+				connection.SetPeer(hello.GetNodeName());
+				ActivatePeer(connection, true);
+				continue;
+			}
+
+			if (connection.IsPeer())
+			{
+				ProcessTable(connection, packet);
+			}
+		}
+
+		connection.FlushSendRequests();
+		++it;
+	}
+}
+
+void ChatServer::JoinPresence(ChatConnection& connection)
+{
+	const auto& id = connection.GetID();
+	if (presence.Join(id, connection) != 1)
+		return;
+
+	PeerPresencePacket join(PeerPresencePacket::EOperation::Join, id);
+	SendToPeers(ChatPacket::Encode(join));
+}
+
+void ChatServer::LeavePresence(ChatConnection& connection)
+{
+	const auto& id = connection.GetID();
+	if (presence.Leave(id, connection) != 0)
+		return;
+
+	PeerPresencePacket leave(PeerPresencePacket::EOperation::Leave, id);
+	SendToPeers(ChatPacket::Encode(leave));
+}
+
+void ChatServer::ClearRemotePresence(const string& node)
+{
+	auto iter = remotePresence.find(node);
+	if (iter == remotePresence.end())
+		return;
+
+	for (auto& member : iter->second)
+	{
+		presence.LeaveRemote(member.first);
+	}
+
+	iter->second.clear();
+}
+
+void ChatServer::PublishPresence()
+{
+	const auto currentTime = chrono::steady_clock::now();
+	if (currentTime < nextPresenceTick || !presence.HasChanges())
+		return;
+
+	nextPresenceTick = currentTime + chrono::milliseconds(ChatConstant::PRESENCE_TICK);
+
+	auto deltas = presence.ExtractDeltas();
+	if (deltas.empty())
+		return;
+
+	for (auto& connection : connections)
+	{
+		if (connection->IsPeer() || !connection->IsIdentified())
+			continue;
+
+		for (auto& packet : deltas)
+		{
+			connection->RequestSend(packet);
+		}
+	}
+}
+
+void ChatServer::SendToPeers(const ChatPacket& packet)
+{
+	for (auto& [node, connection] : activePeers)
+	{
+		connection->RequestSend(packet);
+	}
+}
+
+void ChatServer::ForwardToPeers(const MessagePacket& message)
+{
+	ChatTraceScope traceScope("ForwardToPeers", message.header.traceId);
+
+	for (auto& [node, connection] : activePeers)
+	{
+		if (!IsNodeInterested(node))
+			continue;
+
+		// Maps the sender number on the link the first time it is used there.
+		connection->RequestSendMessage(message);
+	}
+}
+
+ChatConnection* ChatServer::FindPeerOf(const string& id)
+{
+	for (auto& [node, connection] : activePeers)
+	{
+		auto iter = remotePresence.find(node);
+		if (iter == remotePresence.end())
+			continue;
+
+		if (iter->second.count(id) > 0)
+			return connection;
+	}
+
+	return nullptr;
+}
+
+// Nodes that list each other are linked twice. Both ends send on the link dialed by the node with the smaller name,
+// so every message and presence change crosses exactly one of them; the other only takes over when that one is lost.
+void ChatServer::ActivatePeer(ChatConnection& connection, bool isDialed)
+{
+	const auto& node = connection.GetID();
+	auto& active = activePeers[node];
+
+	if (active != nullptr && active != &connection && (isDialed ? nodeName : node) != std::min(nodeName, node))
+		return;
+
+	active = &connection;
+
+	PeerPresencePacket reset(PeerPresencePacket::EOperation::Reset);
+	connection.RequestSend(ChatPacket::Encode(reset));
+
+	for (auto& id : presence.GetLocalIDs())
+	{
+		PeerPresencePacket join(PeerPresencePacket::EOperation::Join, id);
+		connection.RequestSend(ChatPacket::Encode(join));
+	}
+}
+
+void ChatServer::DeactivatePeer(ChatConnection& connection)
+{
+	const string node = connection.GetID();
+
+	auto iter = activePeers.find(node);
+	if (iter == activePeers.end() || iter->second != &connection)
+		return;
+
+	activePeers.erase(iter);
+	ClearRemotePresence(node);
+	remotePresence.erase(node);
+
+	auto promote = [this, &connection, &node](ChatConnection& other, bool isDialed)
+	{
+		if (other != connection && other.IsPeer() && other.GetID() == node && other.IsAlive())
+		{
+			ActivatePeer(other, isDialed);
+		}
+	};
+
+	for (auto& link : peerLinks)
+	{
+		promote(*link.connection, true);
+	}
+
+	for (auto& other : connections)
+	{
+		promote(*other, false);
+	}
+}
+
+bool ChatServer::IsNodeInterested(const string& node) const
+{
+	auto iter = remotePresence.find(node);
+	if (iter == remotePresence.end())
+		return false;
+
+	return !iter->second.empty();
+}
+
+void ChatServer::RetireConnection(ChatConnection& connection)
+{
+	awaitingAuth.erase(connection.GetHandle());
+
+	if (connection.IsPeer())
+	{
+		DeactivatePeer(connection);
+		return;
+	}
+
+	if (!connection.IsIdentified())
+		return;
+
+	LeavePresence(connection);
+	retainedSessions[connection.GetID()] = connection.ExtractSession();
+}
+
+void ChatServer::ExpireSessions()
+{
+	const auto currentTime = chrono::steady_clock::now();
+	const auto retentionPeriod = chrono::milliseconds(ChatConstant::SESSION_RETENTION_PERIOD);
+
+	for (auto it = retainedSessions.begin(); it != retainedSessions.end();)
+	{
+		if (currentTime - it->second.retiredTime < retentionPeriod)
+		{
+			++it;
+			continue;
+		}
+
+		cout << "[TheChatServer] session expired for " << it->first
+			<< ", unacknowledged packets = " << it->second.retransmitBuffer.size() << endl;
+
+		it = retainedSessions.erase(it);
+	}
+}
+
+void ChatServer::ReportMetrics()
+{
+	const auto currentTime = chrono::steady_clock::now();
+	if (currentTime < nextMetricsReport)
+		return;
+
+	const auto period = chrono::milliseconds(ChatConstant::METRICS_REPORT_PERIOD);
+	const auto elapsed = chrono::duration<double>(currentTime - (nextMetricsReport - period)).count();
+	nextMetricsReport = currentTime + period;
+
+	if (trafficStats.numSendCalls.load() > 0 && elapsed > 0.0)
+	{
+		cout << "[TheChatServer] traffic: " << static_cast<uint64_t>(trafficStats.numSentPackets / elapsed) << " packets/s, "
+			<< static_cast<uint64_t>(trafficStats.numSendCalls / elapsed) << " sends/s, "
+			<< trafficStats.numPings / elapsed << " pings/s" << endl;
+
+		trafficStats.numSentPackets.store(0);
+		trafficStats.numSendCalls.store(0);
+		trafficStats.numPings.store(0);
+	}
+
+	// Smoothed round trips of the connections that answered a ping, and how far idle ones have backed off.
+	ChatHistogram roundTrip;
+	size_t numBackedOff = 0;
+
+	for (auto& connection : connections)
+	{
+		if (connection->GetSmoothedRtt().count() > 0)
+		{
+			roundTrip.Record(connection->GetSmoothedRtt());
+		}
+
+		if (connection->GetHeartBeatPeriod() > chrono::milliseconds(ChatConstant::HEART_BEAT_PERIOD))
+		{
+			++numBackedOff;
+		}
+	}
+
+	if (roundTrip.GetCount() > 0)
+	{
+		roundTrip.Report(cout, "connection rtt");
+		cout << "[TheChatServer] heartbeats: " << numBackedOff << " of " << connections.size() << " connections backed off" << endl;
+	}
+
+	if (numLappedReads > 0)
+	{
+		cout << "[TheChatServer] room: " << numLappedReads << " reads fell a lap behind, "
+			<< numSkippedMessages << " messages skipped" << endl;
+
+		numLappedReads = 0;
+		numSkippedMessages = 0;
+	}
+
+	if (deliveryLatency.GetCount() > 0)
+	{
+		deliveryLatency.Report(cout, "delivery latency");
+		deliveryLatency.Reset();
+	}
+
+	if (IsLowLatency())
+	{
+		cout << "[TheChatServer] wake-ups: spinning = " << numSpinWakeUps << ", blocked = " << numBlockedWakeUps << endl;
+		idleGap.Report(cout, "idle gap before wake-up");
+		wakeUpLateness.Report(cout, "timer wake-up lateness");
+
+		numSpinWakeUps = 0;
+		numBlockedWakeUps = 0;
+	}
+
+	idleGap.Reset();
+	wakeUpLateness.Reset();
+
+	ExpireSessions();
+}
+
+void ChatServer::BuildTableProcessor()
+{
+	procMap.emplace(EChatTableID::MESSAGE_TABLE, [this](ChatConnection& connection, ChatPacket& packet)
+		{
+			MessagePacket message;
+			if (!packet.Decode(message))
+				return;
+
+			if (connection.IsPeer())
+			{
+				// Peer nodes number IDs on their own and map each number before using it.
+				const auto senderNumber = connection.FindPeerNumber(message.GetSenderNumber());
+				if (senderNumber == ChatConnection::NO_NUMBER)
+				{
+					cerr << "[TheChatServer][Error] unmapped sender number " << message.GetSenderNumber()
+						<< " from peer node " << connection.GetID() << endl;
+					return;
+				}
+
+				message.SetSenderNumber(senderNumber);
+			}
+			else
+			{
+				// Only here: messages from peers went through the stages on their origin node.
+				ChatTraceScope stageScope("MessageStages", packet.header.traceId);
+
+				if (!messageStages.Run(connection.GetIDNumber(), message))
+					return;
+			}
+
+			if (isVerbose)
+			{
+				cout << "[TheChatServer] From: " << GetSenderID(message) << ", Message: " << message.GetMessage() << endl;
+			}
+
+			if (isSearchEnabled)
+			{
+				IndexMessage(message);
+			}
+
+			{
+				ChatTraceScope fanOutScope("FanOut", packet.header.traceId);
+				room.Publish(message, connection.GetHandle());
+			}
+
+			if (!connection.IsPeer())
+			{
+				ForwardToPeers(message);
+			}
+		});
+
+	procMap.emplace(EChatTableID::ID_MAP_TABLE, [](ChatConnection& connection, ChatPacket& packet)
+		{
+			if (!connection.IsPeer())
+			{
+				cerr << "[TheChatServer][Error] ID map from a non-peer connection "
+					<< connection.GetAddress() << endl;
+				return;
+			}
+
+			IdMapPacket idMap;
+			if (!packet.Decode(idMap))
+				return;
+
+			idMap.ForEach([&connection](uint32_t peerNumber, const string& id)
+				{
+					connection.MapPeerNumber(peerNumber, ChatIdTable::GetNumber(id));
+				});
+		});
+
+	procMap.emplace(EChatTableID::PRIVATE_MESSAGE_TABLE, [this](ChatConnection& connection, ChatPacket& packet)
+		{
+			PrivateMessagePacket message;
+			if (!packet.Decode(message))
+				return;
+
+			if (!connection.IsPeer())
+			{
+				// Like room messages, a private one goes out under the ID its sender greeted with, whatever it claimed.
+				ChatTraceScope stageScope("MessageStages", packet.header.traceId);
+
+				if (!messageStages.Run(connection.GetIDNumber(), connection.GetID(), message))
+					return;
+
+				packet = ChatPacket::Encode(message);
+			}
+
+			if (isVerbose)
+			{
+				cout << "[TheChatServer] From: " << message.GetSenderID() << ", To: " << message.GetRecipientID()
+					<< ", Message: " << message.GetMessage() << endl;
+			}
+
+			auto recipient = presence.Find(message.GetRecipientID());
+			if (recipient != nullptr)
+			{
+				recipient->RequestSend(packet);
+				return;
+			}
+
+			if (!connection.IsPeer())
+			{
+				auto peer = FindPeerOf(message.GetRecipientID());
+				if (peer != nullptr)
+				{
+					peer->RequestSend(packet);
+					return;
+				}
+			}
+
+			if (connection.IsPeer())
+				return;
+
+			MessagePacket notice;
+			notice.SetSenderNumber(ChatIdTable::SERVER_NUMBER);
+			notice.SetMessage(string(message.GetRecipientID()) + " is not online.");
+
+			connection.RequestSend(ChatPacket::Encode(notice));
+		});
+
+	asyncProcMap.emplace(EChatTableID::SEARCH_TABLE, [this](uint64_t connectionHandle, ChatPacket packet) -> ChatTask
+		{
+			SearchPacket request;
+			if (!packet.Decode(request) || !request.IsRequest())
+				co_return;
+
+			// History is only searchable by someone who has greeted, so an anonymous socket can't scrape it.
+			{
+				auto connection = FindConnection(connectionHandle);
+				if (connection == nullptr || !connection->IsIdentified())
+					co_return;
+			}
+
+			vector<uint32_t> results;
+
+			if (isSearchEnabled)
+			{
+				const auto maxResults = std::clamp<uint16_t>(request.maxResults, 1, SearchPacket::MAX_RESULTS);
+				const auto query = ChatSearchIndex::MakeQuery(request.GetText(), request.GetSenderID(), maxResults);
+
+				// Sealed segments are immutable and the snapshot copies the rest, so the worker never touches the live index.
+				const auto snapshot = searchIndex.TakeSnapshot(query);
+				co_await scheduler.RunOnWorker([&results, &snapshot, &query]() { results = ChatSearchIndex::Search(snapshot, query); });
+			}
+
+			auto connection = FindConnection(connectionHandle);
+			if (connection == nullptr || !connection->IsAlive())
+				co_return;
+
+			if (results.empty())
+			{
+				SearchPacket answer(request.requestId, false);
+				connection->RequestSend(ChatPacket::Encode(answer));
+				co_return;
+			}
+
+			for (size_t i = 0; i < results.size(); ++i)
+			{
+				SearchPacket hit(request.requestId, false);
+				hit.messageNumber = results[i];
+				hit.index = static_cast<uint16_t>(i);
+				hit.numResults = static_cast<uint16_t>(results.size());
+				hit.SetSenderID(history.GetSender(results[i]));
+				hit.SetText(history.GetText(results[i]));
+
+				connection->RequestSend(ChatPacket::Encode(hit));
+			}
+		});
+
+	asyncProcMap.emplace(EChatTableID::GREETINGS_TABLE, [this](uint64_t connectionHandle, ChatPacket packet) -> ChatTask
+		{
+			GreetingsPacket greetings;
+			if (!packet.Decode(greetings))
+				co_return;
+
+			const string id(greetings.GetSenderID());
+			const char* refusal = nullptr;
+
+			// Taking a reserved number would pass the client's messages off as server notices.
+			if (ChatIdTable::IsReserved(id))
+			{
+				cout << "[TheChatServer] " << id << " is a reserved ID, refused." << endl;
+				refusal = "This ID is reserved.";
+			}
+
+			if (refusal == nullptr && !authPath.empty())
+			{
+				awaitingAuth.try_emplace(connectionHandle);
+
+				// The lookup reads the file, so it runs on a worker instead of stalling every connection.
+				bool isAuthorized = false;
+
+				co_await scheduler.RunOnWorker([this, &id, &isAuthorized]() { isAuthorized = IsAuthorized(authPath, id); });
+
+				if (!isAuthorized)
+				{
+					cout << "[TheChatServer] " << id << " is not authorized." << endl;
+
+					co_await scheduler.Sleep(chrono::milliseconds(ChatConstant::AUTH_FAILURE_DELAY));
+					refusal = "Not authorized.";
+				}
+			}
+
+			// The ID table never gives a number back, so once it is full only the IDs it already holds get in.
+			if (refusal == nullptr && ChatIdTable::TryIntern(id) == nullptr)
+			{
+				cout << "[TheChatServer] ID table is full, " << id << " refused." << endl;
+				refusal = "Server is full.";
+			}
+
+			if (refusal != nullptr)
+			{
+				awaitingAuth.erase(connectionHandle);
+
+				MessagePacket notice;
+				notice.SetSenderNumber(ChatIdTable::SERVER_NUMBER);
+				notice.SetMessage(refusal);
+
+				if (co_await scheduler.SendAndFlush(connectionHandle, ChatPacket::Encode(notice)))
+				{
+					FindConnection(connectionHandle)->Close();
+				}
+
+				co_return;
+			}
+
+			auto held = awaitingAuth.extract(connectionHandle);
+
+			auto connection = FindConnection(connectionHandle);
+			if (connection == nullptr || !connection->IsAlive())
+				co_return;
+
+			Greet(*connection, greetings);
+
+			if (!held.empty())
+			{
+				for (auto& heldPacket : held.mapped())
+				{
+					ProcessTable(*connection, heldPacket);
+				}
+			}
+		});
+
+	procMap.emplace(EChatTableID::PEER_HELLO_TABLE, [this](ChatConnection& connection, ChatPacket& packet)
+		{
+			PeerHelloPacket hello;
+			if (!packet.Decode(hello) || hello.IsReply() || connection.IsPeer() || connection.IsIdentified())
+				return;
+
+			connection.SetPeer(hello.GetNodeName());
+
+			cout << "[TheChatServer] peer node " << connection.GetID() << '@' << connection.GetAddress() << " joined." << endl;
+
+			PeerHelloPacket reply(nodeName, true);
+			connection.RequestSend(ChatPacket::Encode(reply));
+			ActivatePeer(connection, false);
+		});
+
+	procMap.emplace(EChatTableID::PEER_PRESENCE_TABLE, [this](ChatConnection& connection, ChatPacket& packet)
+		{
+			if (!connection.IsPeer())
+			{
+				cerr << "[TheChatServer][Error] peer presence from a non-peer connection "
+					<< connection.GetID() << '@' << connection.GetAddress() << endl;
+				return;
+			}
+
+			PeerPresencePacket change;
+			if (!packet.Decode(change))
+				return;
+
+			auto& members = remotePresence[connection.GetID()];
+
+			switch (change.GetOperation())
+			{
+			case PeerPresencePacket::EOperation::Reset:
+				ClearRemotePresence(connection.GetID());
+				break;
+
+			case PeerPresencePacket::EOperation::Join:
+				if (members[change.GetID()]++ == 0)
+				{
+					presence.JoinRemote(change.GetID());
+				}
+				break;
+
+			case PeerPresencePacket::EOperation::Leave:
+				if (members.erase(change.GetID()) > 0)
+				{
+					presence.LeaveRemote(change.GetID());
+				}
+				break;
+
+			default:
+				cerr << "[TheChatServer][Error] unknown presence operation from " << connection.GetID() << endl;
+				break;
+			}
+		});
+}
+
+ChatTask ChatServer::WatchFilterFile()
+{
+	while (isRunning)
+	{
+		co_await scheduler.Sleep(chrono::milliseconds(ChatConstant::FILTER_RELOAD_PERIOD));
+
+		// Building the automaton can take a while for large lists, so it happens on a worker
+		// and the loop only swaps the pointer; messages keep flowing through the old filter meanwhile.
+		shared_ptr<const ChatContentFilter> reloaded;
+		co_await scheduler.RunOnWorker([this, &reloaded]()
+			{
+				error_code error;
+				const auto writeTime = filesystem::last_write_time(filterPath, error);
+				if (error || writeTime == filterWriteTime)
+					return;
+
+				filterWriteTime = writeTime;
+				reloaded = ChatContentFilter::Load(filterPath.c_str());
+			});
+
+		if (reloaded == nullptr)
+			continue;
+
+		cout << "[TheChatServer] content filter reloaded, patterns = " << reloaded->GetNumPatterns()
+			<< ", states = " << reloaded->GetNumStates() << endl;
+
+		contentFilter = move(reloaded);
+	}
+}
+
+void ChatServer::IndexMessage(const MessagePacket& message)
+{
+	const auto& senderId = GetSenderID(message);
+	const auto number = history.Append(senderId, message.GetMessage());
+	searchIndex.Add(number, senderId, message.GetMessage());
+
+	ScheduleIndexMerge();
+}
+
+void ChatServer::ScheduleIndexMerge()
+{
+	if (isIndexMerging)
+		return;
+
+	ChatSearchIndex::TSegments inputs;
+	if (!searchIndex.PlanMerge(inputs))
+		return;
+
+	isIndexMerging = true;
+	scheduler.Spawn(MergeIndex(move(inputs)));
+}
+
+ChatTask ChatServer::MergeIndex(ChatSearchIndex::TSegments inputs)
+{
+	// Queries keep reading the input segments until the merged one replaces them.
+	ChatSearchIndex::TSegment merged;
+	co_await scheduler.RunOnWorker([&inputs, &merged]() { merged = ChatSearchIndex::Merge(inputs); });
+
+	searchIndex.CompleteMerge(inputs, move(merged));
+	isIndexMerging = false;
+
+	if (isVerbose)
+	{
+		cout << "[TheChatServer] search index merged, segments = " << searchIndex.GetNumSegments() << endl;
+	}
+
+	ScheduleIndexMerge();
+}
+
+ChatConnection* ChatServer::FindConnection(uint64_t connectionHandle) const
+{
+	auto iter = connectionsByHandle.find(connectionHandle);
+	if (iter == connectionsByHandle.end())
+		return nullptr;
+
+	return iter->second;
+}
+
+void ChatServer::Greet(ChatConnection& connection, const GreetingsPacket& greetings)
+{
+	if (connection.IsPeer())
+		return;
+
+	if (connection.IsIdentified())
+	{
+		LeavePresence(connection);
+	}
+	else
+	{
+		// What was published to the room before the client identified itself is not delivered to it.
+		connection.SetRoomCursor(room.GetHead());
+	}
+
+	connection.SetID(greetings.GetSenderID());
+	JoinPresence(connection);
+
+	cout << "[TheChatServer] From: " << greetings.GetSenderID() << ", Greetings! " << endl;
+
+	// Only the client that was handed the token gets the session back; anyone else claiming the ID starts a new one.
+	auto iter = retainedSessions.find(connection.GetID());
+	const bool isResumed = iter != retainedSessions.end() && greetings.GetSessionToken() != 0
+		&& iter->second.token == greetings.GetSessionToken();
+
+	if (isResumed)
+	{
+		connection.RestoreSession(move(iter->second), greetings.GetLastReceivedSequence());
+		retainedSessions.erase(iter);
+
+		cout << "[TheChatServer] session resumed for " << connection.GetID()
+			<< ", peer received up to " << greetings.GetLastReceivedSequence() << endl;
+	}
+	else if (connection.GetSessionToken() == 0)
+	{
+		uint64_t token = 0;
+		while (token == 0)
+		{
+			token = sessionTokens();
+		}
+
+		connection.SetSessionToken(token);
+	}
+
+	GreetingsPacket reply(ChatIdTable::SERVER_ID, connection.GetReceivedSequence(), connection.GetSessionToken(), isResumed);
+	connection.RequestSend(ChatPacket::Encode(reply));
+
+	for (auto& snapshot : presence.BuildSnapshot())
+	{
+		connection.RequestSend(snapshot);
+	}
+}
+
+bool ChatServer::IsAuthorized(const string& path, const string& id)
+{
+	ifstream file(path);
+	if (!file)
+	{
+		cerr << "[TheChatServer][Error] failed to open the auth file " << path << endl;
+		return false;
+	}
+
+	string line;
+	while (getline(file, line))
+	{
+		if (!line.empty() && line.back() == '\r')
+		{
+			line.pop_back();
+		}
+
+		if (line == id)
+			return true;
+	}
+
+	return false;
+}
+
+void ChatServer::ProcessTable(ChatConnection& connection, ChatPacket& packet)
+{
+	const auto tableId = packet.header.tableId;
+	ChatTraceScope traceScope("ProcessTable", packet.header.traceId);
+
+	// Until the greeting is authorized, only the greeting itself and a peer introduction get through.
+	if (!authPath.empty() && !connection.IsIdentified() && !connection.IsPeer()
+		&& tableId != EChatTableID::GREETINGS_TABLE && tableId != EChatTableID::PEER_HELLO_TABLE)
+	{
+		HoldUntilAuthorized(connection, packet);
+		return;
+	}
+
+	auto asyncIter = asyncProcMap.find(tableId);
+	if (asyncIter != asyncProcMap.end())
+	{
+		scheduler.Spawn(asyncIter->second(connection.GetHandle(), packet));
+		return;
+	}
+
+	auto iter = procMap.find(tableId);
+	if (iter == procMap.end())
+	{
+		cerr << "[TheChatServer][Error] unhandled table id " << static_cast<uint16_t>(tableId)
+			<< " from " << connection.GetID() << '@' << connection.GetAddress() << endl;
+		return;
+	}
+		
+	auto proc = iter->second;
+	if (proc == nullptr)
+	{
+		cerr << "[TheChatServer][Error] null processor for table id " << static_cast<uint16_t>(tableId)
+			<< " from " << connection.GetID() << '@' << connection.GetAddress() << endl;
+		return;
+	}
+	
+	if (isVerbose)
+	{
+		cout << "[TheChatServer] Process table " << static_cast<uint16_t>(tableId)
+			<< " from " << connection.GetID() << '@' << connection.GetAddress() << endl;
+	}
+
+	proc(connection, packet);
+}
+
+void ChatServer::HoldUntilAuthorized(ChatConnection& connection, const ChatPacket& packet)
+{
+	auto iter = awaitingAuth.find(connection.GetHandle());
+	if (iter == awaitingAuth.end())
+	{
+		// The packet was acknowledged, so the client is told it went nowhere rather than left to assume it did.
+		MessagePacket notice;
+		notice.SetSenderNumber(ChatIdTable::SERVER_NUMBER);
+		notice.SetMessage("Greet before sending anything else.");
+
+		connection.RequestSend(ChatPacket::Encode(notice));
+		return;
+	}
+
+	if (iter->second.size() >= ChatConstant::MAX_PACKETS_AWAITING_AUTH)
+	{
+		cerr << "[TheChatServer][Error] " << connection.GetAddress() << " sent too much before being authorized." << endl;
+		connection.Close();
+		return;
+	}
+
+	iter->second.push_back(packet);
+}
+
+const string& ChatServer::GetSenderID(const MessagePacket& message)
+{
+	const auto id = ChatIdTable::Find(message.GetSenderNumber());
+	return id != nullptr ? *id : ChatIdTable::Unknown();
+}
\ No newline at end of file
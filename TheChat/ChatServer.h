@@ -1,42 +1,211 @@
 #pragma once
 
 #include <functional>
+#include <atomic>
+#include <chrono>
+#include <filesystem>
 #include <map>
-#include <mutex>
+#include <memory>
+#include <random>
 #include <string>
 #include <thread>
+#include <unordered_map>
 #include <vector>
 
+#include "ChatCapture.h"
 #include "ChatConnection.h"
+#include "ChatContentFilter.h"
+#include "ChatFanOutPool.h"
+#include "ChatHistory.h"
+#include "ChatHistogram.h"
+#include "ChatMessageStages.h"
+#include "ChatMPSCQueue.h"
 #include "ChatPacket.h"
+#include "ChatPresence.h"
+#include "ChatRoomRing.h"
+#include "ChatScheduler.h"
+#include "ChatSearchIndex.h"
+#include "ChatSession.h"
+#include "ChatSignal.h"
+#include "ChatTask.h"
+#include "GreetingsPacket.h"
+#include "MessagePacket.h"
 #include "Network.h"
 
 
 class ChatServer final
 {
+private:
+	struct PeerAddress
+	{
+		std::string address;
+		std::string port;
+	};
+
+	struct PeerSocket
+	{
+		size_t addressIndex = 0;
+		Network::TSocket socket = INVALID_SOCKET;
+	};
+
+	struct PeerLink
+	{
+		size_t addressIndex;
+		std::string nodeName;
+		std::unique_ptr<ChatConnection> connection;
+	};
+
 private:
 	std::string port;
+	std::string nodeName;
 	std::thread chatThread;
+	std::thread peerThread;
 	Network::TSocket listenSocket;
+	std::string localPath;
+	std::thread localListenThread;
+	Network::TSocket localListenSocket;
 
 	std::atomic<bool> isRunning;
-	std::mutex connectionsLock;
-	std::vector<ChatConnection> connections;
+	ChatSignal chatSignal;
+	ChatMPSCQueue<Network::TSocket> acceptedSockets;
+	std::vector<std::unique_ptr<ChatConnection>> connections;
+	std::unordered_map<uint64_t, ChatConnection*> connectionsByHandle;
+	ChatScheduler scheduler;
+	std::string authPath;
+	// Packets a client sent while its greeting is being authorized, by connection handle. They were already acknowledged.
+	std::unordered_map<uint64_t, std::vector<ChatPacket>> awaitingAuth;
+
+	// Stages run on every chat message from a client before fan-out; a stage returning false drops the message.
+	using TMessageStage = ChatMessageStages::TStage;
+	ChatMessageStages messageStages;
+
+	std::string filterPath;
+	std::filesystem::file_time_type filterWriteTime;
+	std::shared_ptr<const ChatContentFilter> contentFilter;
+
+	bool isSearchEnabled;
+	bool isIndexMerging;
+	ChatHistory history;
+	ChatSearchIndex searchIndex;
+
+	std::map<std::string, ChatSession> retainedSessions;
+	std::mt19937_64 sessionTokens;
+
+	std::vector<PeerAddress> peerAddresses;
+	std::vector<PeerLink> peerLinks;
+	ChatMPSCQueue<PeerSocket> connectedPeers;
+	ChatMPSCQueue<size_t> lostPeers;
+	std::map<std::string, std::map<std::string, int>> remotePresence;
+	// The link each connected node is sent to through, whichever side dialed it.
+	std::map<std::string, ChatConnection*> activePeers;
+
+	ChatPresence presence;
+	Network::TTimeStamp nextPresenceTick;
+
+	// Chat messages are published once to the room; each client connection reads them through its own cursor.
+	ChatRoomRing room;
+	std::atomic<uint64_t> numLappedReads;
+	std::atomic<uint64_t> numSkippedMessages;
+
+	// Large rooms are read and flushed in parallel; the pool only runs while the chat thread waits for it.
+	// A pass goes parallel when the room moved since the last one or a reader was left behind.
+	ChatFanOutPool fanOutPool;
+	size_t numFanOutThreads;
+	uint64_t fannedOutHead;
+	std::atomic<bool> hasRoomBacklog;
+
+	ChatHistogram deliveryLatency;
+	ChatTrafficStats trafficStats;
+	size_t coalesceSize;
+	std::chrono::milliseconds coalesceDelay;
+	Network::TTimeStamp nextMetricsReport;
+
+	// Low-latency mode: the chat thread is pinned to cpuMask and keeps polling without blocking
+	// for spinWindow after the last activity before it falls back to a blocking poll.
+	uint64_t cpuMask;
+	std::chrono::microseconds spinWindow;
+	Network::TTimeStamp lastActivityTime;
+	ChatHistogram idleGap;
+	ChatHistogram wakeUpLateness;
+	uint64_t numSpinWakeUps;
+	uint64_t numBlockedWakeUps;
+
+	ChatCapture capture;
+	uint64_t nextConnectionHandle;
+	bool isVerbose;
 
 	using TProc = std::function<void(ChatConnection& connection, ChatPacket& packet)>;
 	std::map<EChatTableID, TProc> procMap;
 
+	// Handlers that may suspend; they get a copy of the packet and look their connection up again after each co_await.
+	using TAsyncProc = std::function<ChatTask(uint64_t connectionHandle, ChatPacket packet)>;
+	std::map<EChatTableID, TAsyncProc> asyncProcMap;
+
 public:
 	ChatServer(const char* port);
 	~ChatServer();
 
+	void SetNodeName(const char* name);
+	void AddPeer(const char* address, const char* port);
+	bool SetCapture(const char* path);
+	void SetVerbose(bool isVerbose);
+	void SetLocalPath(const char* path);
+	void SetAuthFile(const char* path);
+	bool SetFilterFile(const char* path);
+	void SetSearchEnabled(bool isEnabled);
+	void AddMessageStage(TMessageStage&& stage);
+	void SetLowLatency(uint64_t cpuMask, std::chrono::microseconds spinWindow);
+	void SetCoalescePolicy(size_t maxMessages, std::chrono::milliseconds maxDelay);
+	// 0 reads the room and flushes on the chat thread only.
+	void SetFanOutThreads(size_t numThreads);
+
 	void Run();
+	void Replay(const char* path, bool isPaced);
 
 private:
 	void Listen();
+	void ListenLocal();
+	void AcceptLoop(Network::TSocket socket);
 	void StartChatThread();
+	void StartPeerThread();
 	void Release();
 
+	void AcceptConnections();
+	void SweepConnections();
+	void PollConnections(std::vector<WSAPOLLFD>& pollFds);
+	int WaitForEvents(std::vector<WSAPOLLFD>& pollFds, Network::TTimeStamp wakeUp);
+	void PinChatThread();
+	inline bool IsLowLatency() const { return cpuMask != 0 || spinWindow.count() > 0; }
+	Network::TTimeStamp GetNextWakeUp() const;
+
+	void ProcessPeerLinks();
+	void JoinPresence(ChatConnection& connection);
+	void LeavePresence(ChatConnection& connection);
+	void ClearRemotePresence(const std::string& node);
+	void PublishPresence();
+	void FlushConnections();
+	void ReadRoom(ChatConnection& connection);
+	bool IsBehindRoom(const ChatConnection& connection) const;
+	void SendToPeers(const ChatPacket& packet);
+	void ForwardToPeers(const MessagePacket& message);
+	ChatConnection* FindPeerOf(const std::string& id);
+	void ActivatePeer(ChatConnection& connection, bool isDialed);
+	void DeactivatePeer(ChatConnection& connection);
+	bool IsNodeInterested(const std::string& node) const;
+
+	void RetireConnection(ChatConnection& connection);
+	void ExpireSessions();
+	void ReportMetrics();
+
 	void BuildTableProcessor();
+	ChatConnection* FindConnection(uint64_t connectionHandle) const;
+	void Greet(ChatConnection& connection, const GreetingsPacket& greetings);
+	void HoldUntilAuthorized(ChatConnection& connection, const ChatPacket& packet);
+	ChatTask WatchFilterFile();
+	void IndexMessage(const MessagePacket& message);
+	void ScheduleIndexMerge();
+	ChatTask MergeIndex(ChatSearchIndex::TSegments inputs);
+	static bool IsAuthorized(const std::string& path, const std::string& id);
+	static const std::string& GetSenderID(const MessagePacket& message);
 	void ProcessTable(ChatConnection& connection, ChatPacket& packet);
 };
\ No newline at end of file
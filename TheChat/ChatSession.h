@@ -0,0 +1,25 @@
+#pragma once
+
+#include <cstdint>
+#include <deque>
+
+#include "ChatPacket.h"
+#include "Network.h"
+
+
+// Delivery state of one identity. It outlives a ChatConnection so unacknowledged packets
+// can be retransmitted when the same identity reconnects; only a greeting carrying the token resumes it.
+struct ChatSession final
+{
+	struct PendingPacket
+	{
+		ChatPacket packet;
+		Network::TTimeStamp sentTime;
+	};
+
+	uint32_t sendSequence = 0;
+	uint32_t receivedSequence = 0;
+	uint64_t token = 0;
+	std::deque<PendingPacket> retransmitBuffer;
+	Network::TTimeStamp retiredTime;
+};
\ No newline at end of file
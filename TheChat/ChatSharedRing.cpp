@@ -0,0 +1,180 @@
+#include "ChatSharedRing.h"
+
+#include <algorithm>
+#include <cstring>
+#include <iostream>
+
+#define WIN32_LEAN_AND_MEAN
+
+#include <windows.h>
+
+
+using namespace std;
+
+ChatSharedRing::ChatSharedRing()
+	: mapping(nullptr)
+	, header(nullptr)
+	, capacity(0)
+	, outCursor(nullptr)
+	, inCursor(nullptr)
+	, outPackets(nullptr)
+	, inPackets(nullptr)
+{
+}
+
+ChatSharedRing::~ChatSharedRing()
+{
+	Close();
+}
+
+bool ChatSharedRing::Create(const string& name, uint32_t capacity)
+{
+	Close();
+
+	const uint64_t size = sizeof(Header) + uint64_t(capacity) * 2 * sizeof(ChatPacket);
+
+	mapping = CreateFileMappingA(INVALID_HANDLE_VALUE, nullptr, PAGE_READWRITE,
+		static_cast<DWORD>(size >> 32), static_cast<DWORD>(size & 0xFFFFFFFF), name.c_str());
+	if (mapping == nullptr)
+	{
+		cerr << "[ChatSharedRing] failed to create " << name << ", error = " << GetLastError() << endl;
+		return false;
+	}
+
+	this->name = name;
+	this->capacity = capacity;
+
+	return Map(true);
+}
+
+bool ChatSharedRing::Open(const string& name)
+{
+	Close();
+
+	mapping = OpenFileMappingA(FILE_MAP_ALL_ACCESS, FALSE, name.c_str());
+	if (mapping == nullptr)
+	{
+		cerr << "[ChatSharedRing] failed to open " << name << ", error = " << GetLastError() << endl;
+		return false;
+	}
+
+	this->name = name;
+
+	return Map(false);
+}
+
+bool ChatSharedRing::Map(bool isCreator)
+{
+	auto view = static_cast<uint8_t*>(MapViewOfFile(mapping, FILE_MAP_ALL_ACCESS, 0, 0, 0));
+	if (view == nullptr)
+	{
+		cerr << "[ChatSharedRing] failed to map a view of " << name << ", error = " << GetLastError() << endl;
+
+		Close();
+		return false;
+	}
+
+	header = reinterpret_cast<Header*>(view);
+
+	if (isCreator)
+	{
+		header->capacity = capacity;
+
+		for (auto& cursor : header->cursors)
+		{
+			cursor.head.store(0, memory_order_relaxed);
+			cursor.tail.store(0, memory_order_relaxed);
+		}
+
+		atomic_thread_fence(memory_order_release);
+		header->magic = MAGIC;
+	}
+	else
+	{
+		atomic_thread_fence(memory_order_acquire);
+
+		if (header->magic != MAGIC || header->capacity == 0)
+		{
+			cerr << "[ChatSharedRing] " << name << " is not a chat ring." << endl;
+
+			Close();
+			return false;
+		}
+
+		capacity = header->capacity;
+	}
+
+	auto packets = reinterpret_cast<ChatPacket*>(view + sizeof(Header));
+	const int outIndex = isCreator ? 0 : 1;
+	const int inIndex = 1 - outIndex;
+
+	outCursor = &header->cursors[outIndex];
+	inCursor = &header->cursors[inIndex];
+	outPackets = packets + size_t(outIndex) * capacity;
+	inPackets = packets + size_t(inIndex) * capacity;
+
+	return true;
+}
+
+void ChatSharedRing::Close()
+{
+	if (header != nullptr)
+	{
+		UnmapViewOfFile(header);
+		header = nullptr;
+	}
+
+	if (mapping != nullptr)
+	{
+		CloseHandle(mapping);
+		mapping = nullptr;
+	}
+
+	capacity = 0;
+	outCursor = nullptr;
+	inCursor = nullptr;
+	outPackets = nullptr;
+	inPackets = nullptr;
+}
+
+size_t ChatSharedRing::Write(const ChatPacket* packets, size_t count, bool& needsWakeUp)
+{
+	needsWakeUp = false;
+
+	if (header == nullptr || count == 0)
+		return 0;
+
+	const auto tail = outCursor->tail.load(memory_order_relaxed);
+	const auto head = outCursor->head.load(memory_order_acquire);
+	const auto numWritten = std::min<size_t>(count, capacity - (tail - head));
+
+	for (size_t i = 0; i < numWritten; ++i)
+	{
+		memcpy(&outPackets[(tail + i) % capacity], &packets[i], sizeof(ChatPacket));
+	}
+
+	if (numWritten == 0)
+		return 0;
+
+	// Publishing the tail and then loading the head pairs with the reader storing its head and then
+	// loading the tail, so either the reader sees the new packets or the writer sees an idle reader.
+	outCursor->tail.store(tail + numWritten, memory_order_seq_cst);
+	needsWakeUp = outCursor->head.load(memory_order_seq_cst) == tail;
+
+	return numWritten;
+}
+
+bool ChatSharedRing::Read(ChatPacket& packet)
+{
+	if (header == nullptr)
+		return false;
+
+	const auto head = inCursor->head.load(memory_order_relaxed);
+	if (head == inCursor->tail.load(memory_order_seq_cst))
+		return false;
+
+	memcpy(&packet, &inPackets[head % capacity], sizeof(ChatPacket));
+	inCursor->head.store(head + 1, memory_order_seq_cst);
+
+	return true;
+}
\ No newline at end of file
@@ -0,0 +1,64 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <string>
+
+#include "ChatPacket.h"
+
+
+// Pair of single-producer single-consumer packet rings in a named shared memory section.
+// The creator writes the first ring and reads the second; the opener does the opposite.
+// A writer has to wake the reader up only when the reader had drained everything before the write.
+class ChatSharedRing final
+{
+public:
+	static constexpr uint32_t MAGIC = 0x474E5254; // "TRNG"
+
+private:
+	struct Cursor
+	{
+		alignas(64) std::atomic<uint64_t> head;
+		alignas(64) std::atomic<uint64_t> tail;
+	};
+
+	static_assert(std::atomic<uint64_t>::is_always_lock_free, "Shared ring cursors must be lock free.");
+
+	struct Header
+	{
+		uint32_t magic;
+		uint32_t capacity;
+		Cursor cursors[2];
+	};
+
+private:
+	std::string name;
+	void* mapping;
+	Header* header;
+	uint32_t capacity;
+	Cursor* outCursor;
+	Cursor* inCursor;
+	ChatPacket* outPackets;
+	ChatPacket* inPackets;
+
+public:
+	ChatSharedRing();
+	~ChatSharedRing();
+
+	ChatSharedRing(const ChatSharedRing&) = delete;
+	ChatSharedRing& operator = (const ChatSharedRing&) = delete;
+
+	bool Create(const std::string& name, uint32_t capacity);
+	bool Open(const std::string& name);
+	void Close();
+
+	// Returns the number of packets written; needsWakeUp is set when the reader was idle.
+	size_t Write(const ChatPacket* packets, size_t count, bool& needsWakeUp);
+	bool Read(ChatPacket& packet);
+
+	inline bool IsOpen() const { return header != nullptr; }
+	inline auto& GetName() const { return name; }
+
+private:
+	bool Map(bool isCreator);
+};
\ No newline at end of file
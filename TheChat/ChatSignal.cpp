@@ -0,0 +1,56 @@
+#include "ChatSignal.h"
+
+#include <iostream>
+
+
+using namespace std;
+
+ChatSignal::ChatSignal()
+	: readSocket(INVALID_SOCKET)
+	, writeSocket(INVALID_SOCKET)
+	, isSignaled(false)
+{
+	if (!Network::CreateSocketPair(readSocket, writeSocket))
+	{
+		cerr << "[ChatSignal][Error] failed to create a wake-up socket pair." << endl;
+	}
+}
+
+ChatSignal::~ChatSignal()
+{
+	if (writeSocket != INVALID_SOCKET)
+	{
+		closesocket(writeSocket);
+		writeSocket = INVALID_SOCKET;
+	}
+
+	if (readSocket != INVALID_SOCKET)
+	{
+		closesocket(readSocket);
+		readSocket = INVALID_SOCKET;
+	}
+}
+
+bool ChatSignal::IsValid() const
+{
+	return readSocket != INVALID_SOCKET && writeSocket != INVALID_SOCKET;
+}
+
+void ChatSignal::Notify()
+{
+	if (isSignaled.exchange(true))
+		return;
+
+	const char token = 1;
+	send(writeSocket, &token, sizeof(token), 0);
+}
+
+void ChatSignal::Drain()
+{
+	isSignaled = false;
+
+	char buffer[64];
+	while (recv(readSocket, buffer, sizeof(buffer), 0) > 0)
+	{
+	}
+}
\ No newline at end of file
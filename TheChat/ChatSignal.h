@@ -0,0 +1,29 @@
+#pragma once
+
+#include <atomic>
+
+#include "Network.h"
+
+
+// Self-pipe wake-up for socket event loops.
+// Notify() may be called from any thread; the owner polls GetSocket() for readability and calls Drain().
+class ChatSignal final
+{
+private:
+	Network::TSocket readSocket;
+	Network::TSocket writeSocket;
+	std::atomic<bool> isSignaled;
+
+public:
+	ChatSignal();
+	~ChatSignal();
+
+	ChatSignal(const ChatSignal&) = delete;
+	ChatSignal& operator = (const ChatSignal&) = delete;
+
+	bool IsValid() const;
+	void Notify();
+	void Drain();
+
+	inline auto GetSocket() const { return readSocket; }
+};
\ No newline at end of file
@@ -9,5 +9,14 @@ enum class EChatTableID : uint16_t
 	MESSAGE_TABLE,
 	GREETINGS_TABLE,
 	ID_LIST_TABLE,
+	ACK_TABLE,
+	PEER_HELLO_TABLE,
+	PEER_PRESENCE_TABLE,
+	PRIVATE_MESSAGE_TABLE,
+	MESSAGE_BATCH_TABLE,
+	SHARED_RING_TABLE,
+	SEARCH_TABLE,
+	ID_MAP_TABLE,
+	PING_TABLE,
 	MAX
-};
+};
\ No newline at end of file
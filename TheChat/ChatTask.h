@@ -0,0 +1,127 @@
+#pragma once
+
+#include <coroutine>
+#include <exception>
+#include <iostream>
+#include <utility>
+
+
+// Lazily started coroutine returning nothing. Awaiting a ChatTask runs it and resumes the awaiter when it finishes;
+// ChatScheduler::Spawn() detaches a top level task, whose frame then frees itself on completion.
+class ChatTask final
+{
+public:
+	struct promise_type;
+	using THandle = std::coroutine_handle<promise_type>;
+
+	struct FinalAwaiter
+	{
+		bool await_ready() const noexcept { return false; }
+
+		std::coroutine_handle<> await_suspend(THandle handle) noexcept
+		{
+			auto& promise = handle.promise();
+			if (promise.isDetached)
+			{
+				handle.destroy();
+				return std::noop_coroutine();
+			}
+
+			if (promise.continuation)
+				return promise.continuation;
+
+			return std::noop_coroutine();
+		}
+
+		void await_resume() const noexcept {}
+	};
+
+	struct promise_type
+	{
+		std::coroutine_handle<> continuation;
+		bool isDetached = false;
+
+		ChatTask get_return_object() { return ChatTask(THandle::from_promise(*this)); }
+		std::suspend_always initial_suspend() const noexcept { return {}; }
+		FinalAwaiter final_suspend() const noexcept { return {}; }
+		void return_void() const noexcept {}
+
+		void unhandled_exception() const noexcept
+		{
+			try
+			{
+				std::rethrow_exception(std::current_exception());
+			}
+			catch (const std::exception& e)
+			{
+				std::cerr << "[ChatTask][Error] unhandled exception: " << e.what() << std::endl;
+			}
+			catch (...)
+			{
+				std::cerr << "[ChatTask][Error] unhandled exception." << std::endl;
+			}
+		}
+	};
+
+	struct Awaiter
+	{
+		THandle handle;
+
+		bool await_ready() const noexcept { return !handle || handle.done(); }
+
+		std::coroutine_handle<> await_suspend(std::coroutine_handle<> awaiting) noexcept
+		{
+			handle.promise().continuation = awaiting;
+			return handle;
+		}
+
+		void await_resume() const noexcept {}
+	};
+
+private:
+	THandle handle;
+
+public:
+	ChatTask() : handle(nullptr) {}
+	explicit ChatTask(THandle handle) : handle(handle) {}
+	ChatTask(ChatTask&& other) noexcept : handle(std::exchange(other.handle, nullptr)) {}
+
+	~ChatTask()
+	{
+		if (handle)
+		{
+			handle.destroy();
+		}
+	}
+
+	ChatTask(const ChatTask&) = delete;
+	ChatTask& operator = (const ChatTask&) = delete;
+
+	ChatTask& operator = (ChatTask&& other) noexcept
+	{
+		if (this != &other)
+		{
+			if (handle)
+			{
+				handle.destroy();
+			}
+
+			handle = std::exchange(other.handle, nullptr);
+		}
+
+		return *this;
+	}
+
+	Awaiter operator co_await() const noexcept { return Awaiter{ handle }; }
+
+	// Runs the task up to its first suspension and hands the frame over to itself.
+	void Detach()
+	{
+		if (!handle)
+			return;
+
+		auto detached = std::exchange(handle, nullptr);
+		detached.promise().isDetached = true;
+		detached.resume();
+	}
+};
\ No newline at end of file
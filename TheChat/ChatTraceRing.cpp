@@ -0,0 +1,63 @@
+#include "ChatTraceRing.h"
+
+#include <algorithm>
+#include <bit>
+
+
+using namespace std;
+
+ChatTraceRing::ChatTraceRing(size_t capacity)
+	: capacity(bit_ceil(std::max<uint64_t>(capacity, 1)))
+	, slots(new Slot[this->capacity])
+	, head(0)
+{
+}
+
+void ChatTraceRing::Push(const Span& span)
+{
+	const auto number = head.load(memory_order_relaxed);
+	auto& slot = slots[number & (capacity - 1)];
+
+	// The odd word goes out before any field changes, so a reader that overlaps this write sees it on the re-check.
+	slot.sequence.store(number * 2 + 1, memory_order_relaxed);
+	atomic_thread_fence(memory_order_release);
+
+	slot.name.store(span.name, memory_order_relaxed);
+	slot.traceId.store(span.traceId, memory_order_relaxed);
+	slot.startTime.store(span.startTime, memory_order_relaxed);
+	slot.endTime.store(span.endTime, memory_order_relaxed);
+
+	slot.sequence.store(number * 2 + 2, memory_order_release);
+	head.store(number + 1, memory_order_release);
+}
+
+vector<ChatTraceRing::Span> ChatTraceRing::Copy() const
+{
+	const auto end = head.load(memory_order_acquire);
+	const auto begin = end > capacity ? end - capacity : 0;
+
+	vector<Span> spans;
+	spans.reserve(static_cast<size_t>(end - begin));
+
+	for (auto number = begin; number < end; ++number)
+	{
+		auto& slot = slots[number & (capacity - 1)];
+
+		const auto sequence = slot.sequence.load(memory_order_acquire);
+		if (sequence != number * 2 + 2)
+			continue;
+
+		const Span span{ slot.name.load(memory_order_relaxed), slot.traceId.load(memory_order_relaxed),
+			slot.startTime.load(memory_order_relaxed), slot.endTime.load(memory_order_relaxed) };
+
+		// Keeps the loads above from sinking past the re-check.
+		atomic_thread_fence(memory_order_acquire);
+
+		if (slot.sequence.load(memory_order_relaxed) == sequence)
+		{
+			spans.push_back(span);
+		}
+	}
+
+	return spans;
+}
\ No newline at end of file
@@ -0,0 +1,51 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+
+// Ring of trace spans that one thread writes and any thread copies out. Every field is a relaxed atomic, and each
+// slot carries a sequence word that is odd while the slot is written and 2 * (span number + 1) once it is whole,
+// a per-slot seqlock. A reader keeps a span only if the word matched before and after copying it, so a span the
+// writer laps or is still writing is dropped instead of coming out torn.
+class ChatTraceRing final
+{
+public:
+	struct Span
+	{
+		const char* name;
+		uint32_t traceId;
+		int64_t startTime;
+		int64_t endTime;
+	};
+
+private:
+	struct Slot
+	{
+		std::atomic<uint64_t> sequence{ 0 };
+		std::atomic<const char*> name{ nullptr };
+		std::atomic<uint32_t> traceId{ 0 };
+		std::atomic<int64_t> startTime{ 0 };
+		std::atomic<int64_t> endTime{ 0 };
+	};
+
+	const uint64_t capacity;
+	std::unique_ptr<Slot[]> slots;
+	std::atomic<uint64_t> head;
+
+public:
+	// Capacity is rounded up to a power of two.
+	explicit ChatTraceRing(size_t capacity);
+	~ChatTraceRing() = default;
+
+	// Owner thread only.
+	void Push(const Span& span);
+
+	// The intact spans among the last capacity pushed, oldest first.
+	std::vector<Span> Copy() const;
+
+	inline auto GetCapacity() const { return capacity; }
+	inline auto GetNumPushed() const { return head.load(std::memory_order_relaxed); }
+};
\ No newline at end of file
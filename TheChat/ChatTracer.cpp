@@ -0,0 +1,171 @@
+#include "ChatTracer.h"
+
+#include <chrono>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <memory>
+#include <mutex>
+#include <random>
+#include <string>
+#include <vector>
+
+#define WIN32_LEAN_AND_MEAN
+
+#include <windows.h>
+
+#include "ChatTraceRing.h"
+
+
+using namespace std;
+
+namespace
+{
+	// Written by its own thread only; a dump copies the ring from another thread.
+	struct ThreadBuffer
+	{
+		uint32_t threadIndex = 0;
+		string threadName;
+		ChatTraceRing ring{ ChatTracer::BUFFER_SIZE };
+	};
+
+	mutex registryMutex;
+	vector<shared_ptr<ThreadBuffer>> registry;
+
+	atomic<uint32_t> sampleRate{ 0 };
+	atomic<uint32_t> nextTraceId{ 0 };
+
+	thread_local shared_ptr<ThreadBuffer> localBuffer;
+	thread_local string localThreadName;
+	thread_local uint32_t numUntraced = 0;
+
+	string breakDumpPath;
+
+	ThreadBuffer& GetLocalBuffer()
+	{
+		if (localBuffer != nullptr)
+			return *localBuffer;
+
+		localBuffer = make_shared<ThreadBuffer>();
+
+		lock_guard<mutex> lock(registryMutex);
+		localBuffer->threadIndex = static_cast<uint32_t>(registry.size()) + 1;
+		localBuffer->threadName = localThreadName.empty() ? "thread " + to_string(localBuffer->threadIndex) : localThreadName;
+		registry.push_back(localBuffer);
+
+		return *localBuffer;
+	}
+
+	BOOL WINAPI OnConsoleControl(DWORD controlType)
+	{
+		if (controlType != CTRL_BREAK_EVENT)
+			return FALSE;
+
+		ChatTracer::Dump(breakDumpPath.c_str());
+		return TRUE;
+	}
+}
+
+std::atomic<bool> ChatTracer::isEnabled{ false };
+
+void ChatTracer::Enable(uint32_t rate)
+{
+	// Random start so trace IDs from different nodes rarely collide in a merged dump.
+	nextTraceId = random_device()();
+	sampleRate = rate;
+	isEnabled = rate > 0;
+}
+
+uint32_t ChatTracer::Sample()
+{
+	if (!IsEnabled() || ++numUntraced < sampleRate.load(memory_order_relaxed))
+		return 0;
+
+	numUntraced = 0;
+
+	auto traceId = nextTraceId.fetch_add(1, memory_order_relaxed);
+	return traceId != 0 ? traceId : nextTraceId.fetch_add(1, memory_order_relaxed);
+}
+
+void ChatTracer::NameThread(const char* name)
+{
+	localThreadName = name;
+
+	if (localBuffer != nullptr)
+	{
+		lock_guard<mutex> lock(registryMutex);
+		localBuffer->threadName = name;
+	}
+}
+
+int64_t ChatTracer::Now()
+{
+	const auto now = chrono::steady_clock::now().time_since_epoch();
+	return chrono::duration_cast<chrono::nanoseconds>(now).count();
+}
+
+void ChatTracer::Record(const char* name, uint32_t traceId, int64_t startTime, int64_t endTime)
+{
+	GetLocalBuffer().ring.Push({ name, traceId, startTime, endTime });
+}
+
+bool ChatTracer::Dump(const char* path)
+{
+	ofstream output(path, ios::trunc);
+	if (!output)
+	{
+		cerr << "[ChatTracer] cannot open " << path << endl;
+		return false;
+	}
+
+	const auto processId = GetCurrentProcessId();
+	size_t numEvents = 0;
+	bool isFirst = true;
+
+	auto separator = [&output, &isFirst]() -> ostream&
+	{
+		output << (isFirst ? "\n" : ",\n");
+		isFirst = false;
+		return output;
+	};
+
+	output << "{\"displayTimeUnit\":\"ns\",\"traceEvents\":[" << fixed << setprecision(3);
+
+	lock_guard<mutex> lock(registryMutex);
+	for (auto& buffer : registry)
+	{
+		separator() << "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":" << processId << ",\"tid\":" << buffer->threadIndex
+			<< ",\"args\":{\"name\":\"" << buffer->threadName << "\"}}";
+
+		// Spans of one trace ID are chained by flow events, so one message can be followed across threads.
+		for (auto& event : buffer->ring.Copy())
+		{
+			separator() << "{\"name\":\"" << event.name << "\",\"cat\":\"chat\",\"ph\":\"X\",\"pid\":" << processId
+				<< ",\"tid\":" << buffer->threadIndex
+				<< ",\"ts\":" << event.startTime / 1000.0
+				<< ",\"dur\":" << (event.endTime - event.startTime) / 1000.0
+				<< ",\"bind_id\":\"0x" << hex << event.traceId << "\",\"flow_in\":true,\"flow_out\":true"
+				<< ",\"args\":{\"trace\":\"0x" << event.traceId << dec << "\"}}";
+
+			++numEvents;
+		}
+	}
+
+	output << "\n]}\n";
+
+	cout << "[ChatTracer] " << numEvents << " spans written to " << path << endl;
+	return static_cast<bool>(output);
+}
+
+bool ChatTracer::DumpOnBreak(const char* path)
+{
+	breakDumpPath = path;
+
+	if (!SetConsoleCtrlHandler(OnConsoleControl, TRUE))
+	{
+		cerr << "[ChatTracer] SetConsoleCtrlHandler failed, error = " << GetLastError() << endl;
+		return false;
+	}
+
+	return true;
+}
\ No newline at end of file
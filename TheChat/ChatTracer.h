@@ -0,0 +1,59 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+
+
+// Sampled per-packet trace spans. A packet picked at ingress gets a non-zero trace ID in its header, which
+// travels with every copy of it, so the spans of one message on all recipients and cluster nodes share it.
+// Each thread records into its own ring that only it writes; Dump() writes them as Chrome trace-event JSON,
+// readable by chrome://tracing and Perfetto. While disabled, a span costs one relaxed load.
+namespace ChatTracer
+{
+	static constexpr size_t BUFFER_SIZE = 1 << 16;
+
+	extern std::atomic<bool> isEnabled;
+
+	inline bool IsEnabled() { return isEnabled.load(std::memory_order_relaxed); }
+
+	// Traces 1 in sampleRate packets, 0 disables tracing.
+	void Enable(uint32_t sampleRate);
+	uint32_t Sample();
+
+	void NameThread(const char* name);
+	int64_t Now();
+	void Record(const char* name, uint32_t traceId, int64_t startTime, int64_t endTime);
+
+	bool Dump(const char* path);
+	// Dumps to path whenever the console receives CTRL+BREAK, without stopping the process.
+	bool DumpOnBreak(const char* path);
+}
+
+
+// Records a span over its lifetime if the packet is traced.
+class ChatTraceScope final
+{
+private:
+	const char* name;
+	uint32_t traceId;
+	int64_t startTime;
+
+public:
+	inline ChatTraceScope(const char* name, uint32_t traceId)
+		: name(name)
+		, traceId(traceId != 0 && ChatTracer::IsEnabled() ? traceId : 0)
+		, startTime(this->traceId != 0 ? ChatTracer::Now() : 0)
+	{
+	}
+
+	inline ~ChatTraceScope()
+	{
+		if (traceId != 0)
+		{
+			ChatTracer::Record(name, traceId, startTime, ChatTracer::Now());
+		}
+	}
+
+	ChatTraceScope(const ChatTraceScope&) = delete;
+	ChatTraceScope& operator = (const ChatTraceScope&) = delete;
+};
\ No newline at end of file
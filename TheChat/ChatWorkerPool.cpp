@@ -0,0 +1,86 @@
+#include "ChatWorkerPool.h"
+
+#include <algorithm>
+#include <exception>
+#include <iostream>
+
+
+using namespace std;
+
+ChatWorkerPool::ChatWorkerPool()
+	: isStopping(false)
+{
+}
+
+ChatWorkerPool::~ChatWorkerPool()
+{
+	Stop();
+}
+
+void ChatWorkerPool::Start(size_t numThreads)
+{
+	Stop();
+
+	isStopping = false;
+	numThreads = std::max<size_t>(numThreads, 1);
+
+	for (size_t i = 0; i < numThreads; ++i)
+	{
+		threads.emplace_back([this]() { Work(); });
+	}
+}
+
+void ChatWorkerPool::Stop()
+{
+	{
+		lock_guard<std::mutex> lock(mutex);
+		isStopping = true;
+	}
+
+	condition.notify_all();
+
+	for (auto& thread : threads)
+	{
+		thread.join();
+	}
+
+	threads.clear();
+}
+
+void ChatWorkerPool::Post(TJob&& job)
+{
+	{
+		lock_guard<std::mutex> lock(mutex);
+		jobs.emplace_back(move(job));
+	}
+
+	condition.notify_one();
+}
+
+void ChatWorkerPool::Work()
+{
+	while (true)
+	{
+		TJob job;
+
+		{
+			unique_lock<std::mutex> lock(mutex);
+			condition.wait(lock, [this]() { return isStopping || !jobs.empty(); });
+
+			if (jobs.empty())
+				return;
+
+			job = move(jobs.front());
+			jobs.pop_front();
+		}
+
+		try
+		{
+			job();
+		}
+		catch (const exception& e)
+		{
+			cerr << "[ChatWorkerPool][Error] job failed: " << e.what() << endl;
+		}
+	}
+}
\ No newline at end of file
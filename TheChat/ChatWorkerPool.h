@@ -0,0 +1,40 @@
+#pragma once
+
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+
+// Fixed set of threads running blocking jobs away from the event loop.
+// Stop() lets the threads finish every queued job first: a job may hold the only handle to a suspended coroutine.
+class ChatWorkerPool final
+{
+public:
+	using TJob = std::function<void()>;
+
+private:
+	std::mutex mutex;
+	std::condition_variable condition;
+	std::deque<TJob> jobs;
+	std::vector<std::thread> threads;
+	bool isStopping;
+
+public:
+	ChatWorkerPool();
+	~ChatWorkerPool();
+
+	ChatWorkerPool(const ChatWorkerPool&) = delete;
+	ChatWorkerPool& operator = (const ChatWorkerPool&) = delete;
+
+	void Start(size_t numThreads);
+	void Stop();
+	void Post(TJob&& job);
+
+	inline bool IsStarted() const { return !threads.empty(); }
+
+private:
+	void Work();
+};
\ No newline at end of file
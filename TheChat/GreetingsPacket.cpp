@@ -1,18 +1,12 @@
 #include "GreetingsPacket.h"
 
 
-GreetingsPacket::GreetingsPacket(const std::string& id)
-	: packet()
+GreetingsPacket::GreetingsPacket(const std::string& id, uint32_t lastReceivedSequence, uint64_t sessionToken, bool isResumed)
+	: header()
+	, lastReceivedSequence(lastReceivedSequence)
+	, sessionToken(sessionToken)
+	, isResumed(isResumed ? 1 : 0)
 {
 	header.tableId = GetTableID();
-
-	const int length = std::min<int>(static_cast<int>(id.size()), ChatConstant::ID_LENGTH);
-
-	int i = 0;
-	for (; i < length; ++i)
-	{
-		senderId[i] = id.at(i);
-	}
-
-	senderId[i] = '\0';
+	senderId.Assign(id);
 }
\ No newline at end of file
@@ -4,6 +4,7 @@
 
 #include "ChatConstant.h"
 #include "ChatPacket.h"
+#include "ChatSchema.h"
 #include "ChatTableID.h"
 
 
@@ -11,22 +12,28 @@ class GreetingsPacket final
 {
 public:
 	static constexpr EChatTableID GetTableID() { return EChatTableID::GREETINGS_TABLE; }
-
-public:
-	union
+	static constexpr auto GetFields()
 	{
-		ChatPacket packet;
-		struct
-		{
-			ChatPacket::Header header;
-			char senderId[ChatConstant::ID_LENGTH + 1];
-		};
-	};
-
-	static_assert((sizeof(header) + sizeof(senderId)) <= sizeof(ChatPacket), "GreetingsPacket size overflow.");
+		return ChatSchema::Fields(&GreetingsPacket::senderId, &GreetingsPacket::lastReceivedSequence,
+			&GreetingsPacket::sessionToken, &GreetingsPacket::isResumed);
+	}
 
-	GreetingsPacket(const std::string& id);
+public:
+	ChatPacket::Header header;
+	ChatSchema::String<ChatConstant::ID_LENGTH> senderId;
+	uint32_t lastReceivedSequence;
+	// The client presents the token of the session it wants to resume, 0 for none. The server answers with
+	// the token of the session the connection got, and whether it is the one asked for.
+	uint64_t sessionToken;
+	uint8_t isResumed;
+
+	GreetingsPacket(const std::string& id = std::string(), uint32_t lastReceivedSequence = 0, uint64_t sessionToken = 0, bool isResumed = false);
 	~GreetingsPacket() = default;
 
-	inline const char* GetSenderID() const { return static_cast<const char*>(senderId); }
-};
\ No newline at end of file
+	inline const char* GetSenderID() const { return senderId.c_str(); }
+	inline auto GetLastReceivedSequence() const { return lastReceivedSequence; }
+	inline auto GetSessionToken() const { return sessionToken; }
+	inline bool IsResumed() const { return isResumed != 0; }
+};
+
+static_assert(ChatSchema::MaxSize<GreetingsPacket>() <= ChatPacket::PAYLOAD_SIZE, "GreetingsPacket size overflow.");
\ No newline at end of file
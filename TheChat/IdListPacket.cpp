@@ -0,0 +1,51 @@
+#include "IdListPacket.h"
+
+#include <algorithm>
+#include <cstring>
+
+
+using namespace std;
+
+IdListPacket::IdListPacket(EKind kind)
+	: header()
+	, kind(kind)
+	, count(0)
+{
+	header.tableId = GetTableID();
+}
+
+bool IdListPacket::Add(EOperation operation, const string& id)
+{
+	const int length = std::min<int>(static_cast<int>(id.size()), ChatConstant::ID_LENGTH);
+	const int offset = entries.length;
+
+	if (count == UINT8_MAX || offset + 2 + length > ENTRIES_SIZE)
+		return false;
+
+	entries.data[offset] = static_cast<uint8_t>(operation);
+	entries.data[offset + 1] = static_cast<uint8_t>(length);
+	memcpy(entries.data + offset + 2, id.data(), length);
+
+	entries.length = static_cast<uint16_t>(offset + 2 + length);
+	++count;
+
+	return true;
+}
+
+void IdListPacket::ForEach(const function<void(EOperation operation, const string& id)>& func) const
+{
+	const int used = std::min<int>(entries.length, ENTRIES_SIZE);
+
+	int offset = 0;
+	for (int i = 0; i < count && offset + 2 <= used; ++i)
+	{
+		const auto operation = static_cast<EOperation>(entries.data[offset]);
+		const int length = entries.data[offset + 1];
+
+		if (offset + 2 + length > used)
+			break;
+
+		func(operation, string(reinterpret_cast<const char*>(entries.data + offset + 2), length));
+		offset += 2 + length;
+	}
+}
\ No newline at end of file
@@ -0,0 +1,50 @@
+#pragma once
+
+#include <functional>
+#include <string>
+
+#include "ChatConstant.h"
+#include "ChatPacket.h"
+#include "ChatSchema.h"
+#include "ChatTableID.h"
+
+
+// Packed list of presence entries. Each entry is [operation][length][id bytes] so a packet carries as many IDs as fit.
+class IdListPacket final
+{
+public:
+	static constexpr EChatTableID GetTableID() { return EChatTableID::ID_LIST_TABLE; }
+	static constexpr auto GetFields() { return ChatSchema::Fields(&IdListPacket::kind, &IdListPacket::count, &IdListPacket::entries); }
+
+	enum class EKind : uint8_t
+	{
+		Delta = 0,
+		SnapshotBegin = 1,
+		Snapshot = 2
+	};
+
+	enum class EOperation : uint8_t
+	{
+		Join = 0,
+		Leave = 1
+	};
+
+	static constexpr int ENTRIES_SIZE = ChatPacket::PAYLOAD_SIZE - 4;
+
+public:
+	ChatPacket::Header header;
+	EKind kind;
+	uint8_t count;
+	ChatSchema::Bytes<ENTRIES_SIZE> entries;
+
+	IdListPacket(EKind kind = EKind::Delta);
+	~IdListPacket() = default;
+
+	bool Add(EOperation operation, const std::string& id);
+	void ForEach(const std::function<void(EOperation operation, const std::string& id)>& func) const;
+
+	inline auto GetKind() const { return kind; }
+	inline auto GetCount() const { return count; }
+};
+
+static_assert(ChatSchema::MaxSize<IdListPacket>() <= ChatPacket::PAYLOAD_SIZE, "IdListPacket size overflow.");
\ No newline at end of file
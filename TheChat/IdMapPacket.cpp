@@ -0,0 +1,55 @@
+#include "IdMapPacket.h"
+
+#include <algorithm>
+#include <cstring>
+
+
+using namespace std;
+
+IdMapPacket::IdMapPacket()
+	: header()
+	, count(0)
+{
+	header.tableId = GetTableID();
+}
+
+bool IdMapPacket::Add(uint32_t number, string_view id)
+{
+	const int length = std::min<int>(static_cast<int>(id.size()), ChatConstant::ID_LENGTH);
+	const int offset = entries.length;
+	const int entrySize = sizeof(number) + 1 + length;
+
+	if (count == UINT8_MAX || offset + entrySize > ENTRIES_SIZE)
+		return false;
+
+	uint8_t* entry = ChatSchema::Field<uint32_t>::Encode(number, entries.data + offset);
+	entry[0] = static_cast<uint8_t>(length);
+	memcpy(entry + 1, id.data(), length);
+
+	entries.length = static_cast<uint16_t>(offset + entrySize);
+	++count;
+
+	return true;
+}
+
+void IdMapPacket::ForEach(const function<void(uint32_t number, const string& id)>& func) const
+{
+	const uint8_t* cursor = entries.data;
+	const uint8_t* end = entries.data + std::min<int>(entries.length, ENTRIES_SIZE);
+
+	for (int i = 0; i < count; ++i)
+	{
+		uint32_t number = 0;
+
+		cursor = ChatSchema::Field<uint32_t>::Decode(number, cursor, end);
+		if (cursor == nullptr || cursor >= end)
+			break;
+
+		const int length = cursor[0];
+		if (end - cursor - 1 < length)
+			break;
+
+		func(number, string(reinterpret_cast<const char*>(cursor + 1), length));
+		cursor += 1 + length;
+	}
+}
\ No newline at end of file
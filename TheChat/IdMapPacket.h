@@ -0,0 +1,36 @@
+#pragma once
+
+#include <functional>
+#include <string>
+#include <string_view>
+
+#include "ChatConstant.h"
+#include "ChatPacket.h"
+#include "ChatSchema.h"
+#include "ChatTableID.h"
+
+
+// Tells the receiver which ID a sender number stands for, once per number and connection, ahead of the
+// messages carrying it. Each entry is [number][length][id bytes], so a packet carries as many as fit.
+class IdMapPacket final
+{
+public:
+	static constexpr EChatTableID GetTableID() { return EChatTableID::ID_MAP_TABLE; }
+	static constexpr auto GetFields() { return ChatSchema::Fields(&IdMapPacket::count, &IdMapPacket::entries); }
+	static constexpr int ENTRIES_SIZE = ChatPacket::PAYLOAD_SIZE - 3;
+
+public:
+	ChatPacket::Header header;
+	uint8_t count;
+	ChatSchema::Bytes<ENTRIES_SIZE> entries;
+
+	IdMapPacket();
+	~IdMapPacket() = default;
+
+	bool Add(uint32_t number, std::string_view id);
+	void ForEach(const std::function<void(uint32_t number, const std::string& id)>& func) const;
+
+	inline auto GetCount() const { return count; }
+};
+
+static_assert(ChatSchema::MaxSize<IdMapPacket>() <= ChatPacket::PAYLOAD_SIZE, "IdMapPacket size overflow.");
\ No newline at end of file
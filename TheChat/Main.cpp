@@ -1,24 +1,451 @@
 // Copyleft.
 
+#include "ChatBenchmark.h"
 #include "ChatClient.h"
+#include "ChatConstant.h"
+#include "ChatProxy.h"
 #include "ChatServer.h"
+#include "ChatTracer.h"
 #include "Network.h"
 
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
 #include <iostream>
+#include <string>
+#include <vector>
 
 
+namespace
+{
+	// > TheChat server <port> [--node <name>] [--peer <address>:<port>]... [--local <path>] [--auth <file>] [--filter <file>] [--trace <file>] [--trace-sample <1 in n>] [--pin <cpu>[,<cpu>]...] [--spin <us>] [--capture <file>] [--coalesce <messages>[:<delay ms>]] [--fan-out <threads>] [--search] [--quiet]
+	void RunServer(int argc, const char* argv[])
+	{
+		using namespace std;
+
+		ChatServer server(argc > 2 ? argv[2] : "8089");
+		uint64_t cpuMask = 0;
+		int spinWindow = 0;
+		uint32_t traceSampleRate = ChatConstant::TRACE_SAMPLE_RATE;
+
+		for (int i = 3; i < argc; ++i)
+		{
+			const char* option = argv[i];
+
+			if (strcmp(option, "--quiet") == 0)
+			{
+				server.SetVerbose(false);
+				continue;
+			}
+
+			if (strcmp(option, "--search") == 0)
+			{
+				server.SetSearchEnabled(true);
+				continue;
+			}
+
+			if (i + 1 >= argc)
+			{
+				cerr << "Missing value for server option: " << option << endl;
+				break;
+			}
+
+			const char* value = argv[++i];
+
+			if (strcmp(option, "--capture") == 0)
+			{
+				server.SetCapture(value);
+				continue;
+			}
+
+			if (strcmp(option, "--coalesce") == 0)
+			{
+				// <messages>[:<delay ms>], 1 disables coalescing.
+				const string policy(value);
+				const auto pos = policy.find(':');
+				const auto maxMessages = atoi(policy.substr(0, pos).c_str());
+				const auto maxDelay = pos == string::npos ? ChatConstant::COALESCE_DELAY : atoi(policy.substr(pos + 1).c_str());
+
+				server.SetCoalescePolicy(std::max(maxMessages, 1), chrono::milliseconds(std::max<int>(maxDelay, 0)));
+				continue;
+			}
+
+			if (strcmp(option, "--fan-out") == 0)
+			{
+				// Threads helping the chat thread fan out to large rooms, 0 disables.
+				server.SetFanOutThreads(static_cast<size_t>(std::max(atoi(value), 0)));
+				continue;
+			}
+
+			if (strcmp(option, "--pin") == 0)
+			{
+				// Comma separated cpu indices for the chat thread, e.g. 2,3
+				const string cpus(value);
+				size_t begin = 0;
+
+				while (begin < cpus.size())
+				{
+					const auto end = std::min(cpus.find(',', begin), cpus.size());
+					const int index = atoi(cpus.substr(begin, end - begin).c_str());
+					if (index >= 0 && index < 64)
+					{
+						cpuMask |= uint64_t(1) << index;
+					}
+
+					begin = end + 1;
+				}
+
+				server.SetLowLatency(cpuMask, chrono::microseconds(spinWindow));
+				continue;
+			}
+
+			if (strcmp(option, "--spin") == 0)
+			{
+				spinWindow = std::max(atoi(value), 0);
+				server.SetLowLatency(cpuMask, chrono::microseconds(spinWindow));
+				continue;
+			}
+
+			if (strcmp(option, "--trace") == 0)
+			{
+				// Spans are dumped to the file on CTRL+BREAK.
+				ChatTracer::Enable(traceSampleRate);
+				ChatTracer::DumpOnBreak(value);
+				continue;
+			}
+
+			if (strcmp(option, "--trace-sample") == 0)
+			{
+				traceSampleRate = static_cast<uint32_t>(std::max(atoi(value), 1));
+				if (ChatTracer::IsEnabled())
+				{
+					ChatTracer::Enable(traceSampleRate);
+				}
+
+				continue;
+			}
+
+			if (strcmp(option, "--filter") == 0)
+			{
+				server.SetFilterFile(value);
+				continue;
+			}
+
+			if (strcmp(option, "--auth") == 0)
+			{
+				server.SetAuthFile(value);
+				continue;
+			}
+
+			if (strcmp(option, "--local") == 0)
+			{
+				server.SetLocalPath(value);
+				continue;
+			}
+
+			if (strcmp(option, "--node") == 0)
+			{
+				server.SetNodeName(value);
+				continue;
+			}
+
+			if (strcmp(option, "--peer") == 0)
+			{
+				const string peer(value);
+				const auto pos = peer.rfind(':');
+				if (pos == string::npos)
+				{
+					cerr << "Invalid peer address: " << peer << endl;
+					continue;
+				}
+
+				server.AddPeer(peer.substr(0, pos).c_str(), peer.substr(pos + 1).c_str());
+				continue;
+			}
+
+			cerr << "Unknown server option: " << option << endl;
+		}
+
+		server.Run();
+	}
+
+	// > TheChat replay <file> [--paced] [--quiet]
+	void RunReplay(int argc, const char* argv[])
+	{
+		using namespace std;
+
+		if (argc < 3)
+		{
+			cerr << "Usage: " << argv[0] << " replay <file> [--paced] [--quiet]" << endl;
+			return;
+		}
+
+		bool isPaced = false;
+		ChatServer server("0");
+
+		for (int i = 3; i < argc; ++i)
+		{
+			if (strcmp(argv[i], "--paced") == 0)
+			{
+				isPaced = true;
+				continue;
+			}
+
+			if (strcmp(argv[i], "--quiet") == 0)
+			{
+				server.SetVerbose(false);
+				continue;
+			}
+
+			cerr << "Unknown replay option: " << argv[i] << endl;
+		}
+
+		server.Replay(argv[2], isPaced);
+	}
+
+	// > TheChat proxy <port> <address>:<port> [--latency <ms>] [--jitter <ms>] [--bandwidth <bytes/s>] [--stall <ms>[:<every ms>]] [--script <file>]
+	void RunProxy(int argc, const char* argv[])
+	{
+		using namespace std;
+
+		const string server(argc > 3 ? argv[3] : "");
+		const auto pos = server.rfind(':');
+
+		if (argc < 4 || pos == string::npos)
+		{
+			cerr << "Usage: " << argv[0] << " proxy <port> <address>:<port> [--latency <ms>] [--jitter <ms>] [--bandwidth <bytes/s>] [--stall <ms>[:<every ms>]] [--script <file>]" << endl;
+			return;
+		}
+
+		ChatProxy proxy(argv[2], server.substr(0, pos).c_str(), server.substr(pos + 1).c_str());
+		ChatProxy::Impairment impairment;
+
+		for (int i = 4; i < argc; ++i)
+		{
+			const char* option = argv[i];
+
+			if (i + 1 >= argc)
+			{
+				cerr << "Missing value for proxy option: " << option << endl;
+				break;
+			}
+
+			const char* value = argv[++i];
+
+			if (strcmp(option, "--latency") == 0)
+			{
+				impairment.latency = std::max(atoi(value), 0);
+				continue;
+			}
+
+			if (strcmp(option, "--jitter") == 0)
+			{
+				impairment.jitter = std::max(atoi(value), 0);
+				continue;
+			}
+
+			if (strcmp(option, "--bandwidth") == 0)
+			{
+				impairment.bandwidth = std::max<long long>(atoll(value), 0);
+				continue;
+			}
+
+			if (strcmp(option, "--stall") == 0)
+			{
+				// <ms>[:<every ms>], stalls once at start without a period.
+				const string stall(value);
+				const auto separator = stall.find(':');
+
+				impairment.stallDuration = std::max(atoi(stall.substr(0, separator).c_str()), 0);
+				impairment.stallPeriod = separator == string::npos ? 0 : std::max(atoi(stall.substr(separator + 1).c_str()), 0);
+				continue;
+			}
+
+			if (strcmp(option, "--script") == 0)
+			{
+				if (!proxy.LoadScript(value))
+					return;
+
+				continue;
+			}
+
+			cerr << "Unknown proxy option: " << option << endl;
+		}
+
+		proxy.SetImpairment(impairment);
+		proxy.Run();
+	}
+
+	// > TheChat local <path> <id> [--shm]
+	void RunLocalClient(int argc, const char* argv[])
+	{
+		using namespace std;
+
+		if (argc < 4)
+		{
+			cerr << "Usage: " << argv[0] << " local <path> <id> [--shm]" << endl;
+			return;
+		}
+
+		ChatClient client(argv[2], "", argv[3]);
+		client.SetLocalTransport(argc > 4 && strcmp(argv[4], "--shm") == 0);
+		client.Run();
+	}
+
+	// > TheChat bench cluster <clients> <messages> <address>:<port>...
+	// > TheChat bench dm <users> <messages> <address>:<port>
+	// > TheChat bench bots <bots> <messages> <address>:<port>
+	// > TheChat bench local <messages> <address>:<port> <path>
+	// > TheChat bench room <readers> <messages>
+	// > TheChat bench fanout <readers> <messages> <threads>
+	// > TheChat bench filter <messages> <pattern file>
+	// > TheChat bench search <messages> <queries>
+	// > TheChat bench idle <connections> <port>
+	// > TheChat bench trace <spans>
+	// > TheChat bench codec <packets>
+	void RunBenchmark(int argc, const char* argv[])
+	{
+		using namespace std;
+
+		if (argc >= 6 && strcmp(argv[2], "cluster") == 0)
+		{
+			vector<string> nodes;
+			for (int i = 5; i < argc; ++i)
+			{
+				nodes.emplace_back(argv[i]);
+			}
+
+			ChatBenchmark::RunClusterFanOut(nodes, atoi(argv[3]), atoi(argv[4]));
+			return;
+		}
+
+		if (argc >= 6 && strcmp(argv[2], "dm") == 0)
+		{
+			ChatBenchmark::RunDirectVsBroadcast(argv[5], atoi(argv[3]), atoi(argv[4]));
+			return;
+		}
+
+		if (argc >= 6 && strcmp(argv[2], "bots") == 0)
+		{
+			ChatBenchmark::RunBots(argv[5], atoi(argv[3]), atoi(argv[4]));
+			return;
+		}
+
+		if (argc >= 5 && strcmp(argv[2], "room") == 0)
+		{
+			ChatBenchmark::RunRoomFanOut(atoi(argv[3]), atoi(argv[4]));
+			return;
+		}
+
+		if (argc >= 6 && strcmp(argv[2], "fanout") == 0)
+		{
+			ChatBenchmark::RunParallelFanOut(atoi(argv[3]), atoi(argv[4]), atoi(argv[5]));
+			return;
+		}
+
+		if (argc >= 5 && strcmp(argv[2], "filter") == 0)
+		{
+			ChatBenchmark::RunContentFilter(argv[4], atoi(argv[3]));
+			return;
+		}
+
+		if (argc >= 5 && strcmp(argv[2], "search") == 0)
+		{
+			ChatBenchmark::RunHistorySearch(atoi(argv[3]), atoi(argv[4]));
+			return;
+		}
+
+		if (argc >= 4 && strcmp(argv[2], "codec") == 0)
+		{
+			ChatBenchmark::RunPacketCodec(atoi(argv[3]));
+			return;
+		}
+
+		if (argc >= 4 && strcmp(argv[2], "trace") == 0)
+		{
+			ChatBenchmark::RunTracing(atoi(argv[3]));
+			return;
+		}
+
+		if (argc >= 5 && strcmp(argv[2], "idle") == 0)
+		{
+			ChatBenchmark::RunIdleConnections(atoi(argv[3]), argv[4]);
+			return;
+		}
+
+		if (argc >= 6 && strcmp(argv[2], "local") == 0)
+		{
+			ChatBenchmark::RunLocalTransports(argv[4], argv[5], atoi(argv[3]));
+			return;
+		}
+
+		cerr << "Usage: " << argv[0] << " bench cluster <clients> <messages> <address>:<port>..." << endl;
+		cerr << "       " << argv[0] << " bench dm <users> <messages> <address>:<port>" << endl;
+		cerr << "       " << argv[0] << " bench bots <bots> <messages> <address>:<port>" << endl;
+		cerr << "       " << argv[0] << " bench local <messages> <address>:<port> <path>" << endl;
+		cerr << "       " << argv[0] << " bench room <readers> <messages>" << endl;
+		cerr << "       " << argv[0] << " bench fanout <readers> <messages> <threads>" << endl;
+		cerr << "       " << argv[0] << " bench filter <messages> <pattern file>" << endl;
+		cerr << "       " << argv[0] << " bench search <messages> <queries>" << endl;
+		cerr << "       " << argv[0] << " bench idle <connections> <port>" << endl;
+		cerr << "       " << argv[0] << " bench trace <spans>" << endl;
+		cerr << "       " << argv[0] << " bench codec <packets>" << endl;
+	}
+}
+
 int main(int argc, const char* argv[])
 {
 	Network::Initialize();
 
 	using namespace std;
 
-	if (argc < 2)
+	if (argc >= 2 && strcmp(argv[1], "server") == 0)
+	{
+		cout << "Selected Mode: Server" << endl;
+		RunServer(argc, argv);
+	}
+	else if (argc >= 2 && strcmp(argv[1], "replay") == 0)
+	{
+		cout << "Selected Mode: Replay" << endl;
+		RunReplay(argc, argv);
+	}
+	else if (argc >= 2 && strcmp(argv[1], "proxy") == 0)
+	{
+		cout << "Selected Mode: Proxy" << endl;
+		RunProxy(argc, argv);
+	}
+	else if (argc >= 2 && strcmp(argv[1], "local") == 0)
+	{
+		cout << "Selected Mode: Client" << endl;
+		RunLocalClient(argc, argv);
+	}
+	else if (argc >= 2 && strcmp(argv[1], "bench") == 0)
+	{
+		cout << "Selected Mode: Benchmark" << endl;
+		RunBenchmark(argc, argv);
+	}
+	else if (argc < 2)
 	{
 		cout << "Usage: " << endl;
 		cout << "Server: > " << argv[0] << endl;
 		cout << "Server: > " << argv[0] << " <port>" << endl;
-		cout << "Clinet: > " << argv[0] << "<address> <port> <id>" << endl << endl;
+		cout << "Server: > " << argv[0] << " server <port> [--node <name>] [--peer <address>:<port>]... [--local <path>] [--auth <file>] [--filter <file>] [--trace <file>] [--trace-sample <1 in n>] [--pin <cpu>[,<cpu>]...] [--spin <us>] [--capture <file>] [--coalesce <messages>[:<delay ms>]] [--fan-out <threads>] [--search] [--quiet]" << endl;
+		cout << "Replay: > " << argv[0] << " replay <file> [--paced] [--quiet]" << endl;
+		cout << "Proxy:  > " << argv[0] << " proxy <port> <address>:<port> [--latency <ms>] [--jitter <ms>] [--bandwidth <bytes/s>] [--stall <ms>[:<every ms>]] [--script <file>]" << endl;
+		cout << "Clinet: > " << argv[0] << "<address> <port> <id>" << endl;
+		cout << "Client: > " << argv[0] << " local <path> <id> [--shm]" << endl;
+		cout << "Bench:  > " << argv[0] << " bench cluster <clients> <messages> <address>:<port>..." << endl;
+		cout << "Bench:  > " << argv[0] << " bench dm <users> <messages> <address>:<port>" << endl;
+		cout << "Bench:  > " << argv[0] << " bench bots <bots> <messages> <address>:<port>" << endl;
+		cout << "Bench:  > " << argv[0] << " bench local <messages> <address>:<port> <path>" << endl;
+		cout << "Bench:  > " << argv[0] << " bench room <readers> <messages>" << endl;
+		cout << "Bench:  > " << argv[0] << " bench fanout <readers> <messages> <threads>" << endl;
+		cout << "Bench:  > " << argv[0] << " bench filter <messages> <pattern file>" << endl;
+		cout << "Bench:  > " << argv[0] << " bench search <messages> <queries>" << endl;
+		cout << "Bench:  > " << argv[0] << " bench idle <connections> <port>" << endl;
+		cout << "Bench:  > " << argv[0] << " bench trace <spans>" << endl;
+		cout << "Bench:  > " << argv[0] << " bench codec <packets>" << endl << endl;
 
 		cout << "Selected Mode: Server" << endl;
 		ChatServer server("8089");
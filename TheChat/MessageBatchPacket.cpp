@@ -0,0 +1,55 @@
+#include "MessageBatchPacket.h"
+
+#include <algorithm>
+#include <cstring>
+
+
+using namespace std;
+
+MessageBatchPacket::MessageBatchPacket()
+	: header()
+	, count(0)
+{
+	header.tableId = GetTableID();
+}
+
+bool MessageBatchPacket::Add(uint32_t senderNumber, string_view message)
+{
+	const int messageLength = std::min<int>(static_cast<int>(message.size()), UINT8_MAX);
+	const int offset = entries.length;
+	const int entrySize = sizeof(senderNumber) + 1 + messageLength;
+
+	if (count == UINT8_MAX || offset + entrySize > ENTRIES_SIZE)
+		return false;
+
+	uint8_t* entry = ChatSchema::Field<uint32_t>::Encode(senderNumber, entries.data + offset);
+	entry[0] = static_cast<uint8_t>(messageLength);
+	memcpy(entry + 1, message.data(), messageLength);
+
+	entries.length = static_cast<uint16_t>(offset + entrySize);
+	++count;
+
+	return true;
+}
+
+void MessageBatchPacket::ForEach(const function<void(uint32_t senderNumber, const string& message)>& func) const
+{
+	const uint8_t* cursor = entries.data;
+	const uint8_t* end = entries.data + std::min<int>(entries.length, ENTRIES_SIZE);
+
+	for (int i = 0; i < count; ++i)
+	{
+		uint32_t senderNumber = 0;
+
+		cursor = ChatSchema::Field<uint32_t>::Decode(senderNumber, cursor, end);
+		if (cursor == nullptr || cursor >= end)
+			break;
+
+		const int messageLength = cursor[0];
+		if (end - cursor - 1 < messageLength)
+			break;
+
+		func(senderNumber, string(reinterpret_cast<const char*>(cursor + 1), messageLength));
+		cursor += 1 + messageLength;
+	}
+}
\ No newline at end of file
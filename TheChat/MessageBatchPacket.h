@@ -0,0 +1,36 @@
+#pragma once
+
+#include <functional>
+#include <string>
+#include <string_view>
+
+#include "ChatConstant.h"
+#include "ChatPacket.h"
+#include "ChatSchema.h"
+#include "ChatTableID.h"
+
+
+// Several chat messages coalesced into one frame, sent only as long as its entries.
+// Each entry is [sender number][message length][message].
+class MessageBatchPacket final
+{
+public:
+	static constexpr EChatTableID GetTableID() { return EChatTableID::MESSAGE_BATCH_TABLE; }
+	static constexpr auto GetFields() { return ChatSchema::Fields(&MessageBatchPacket::count, &MessageBatchPacket::entries); }
+	static constexpr int ENTRIES_SIZE = ChatPacket::PAYLOAD_SIZE - 3;
+
+public:
+	ChatPacket::Header header;
+	uint8_t count;
+	ChatSchema::Bytes<ENTRIES_SIZE> entries;
+
+	MessageBatchPacket();
+	~MessageBatchPacket() = default;
+
+	bool Add(uint32_t senderNumber, std::string_view message);
+	void ForEach(const std::function<void(uint32_t senderNumber, const std::string& message)>& func) const;
+
+	inline auto GetCount() const { return count; }
+};
+
+static_assert(ChatSchema::MaxSize<MessageBatchPacket>() <= ChatPacket::PAYLOAD_SIZE, "MessageBatchPacket size overflow.");
\ No newline at end of file
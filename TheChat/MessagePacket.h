@@ -1,40 +1,35 @@
 #pragma once
 
 #include <string>
+#include <string_view>
 
 #include "ChatConstant.h"
 #include "ChatPacket.h"
+#include "ChatSchema.h"
 #include "ChatTableID.h"
 
 
+// A room message. The sender is a ChatIdTable number, mapped to its ID by an IdMapPacket sent ahead of it.
 class MessagePacket final
 {
 public:
 	static constexpr int MESSAGE_LENGTH = 128;
 	static constexpr EChatTableID GetTableID() { return EChatTableID::MESSAGE_TABLE; }
+	static constexpr auto GetFields() { return ChatSchema::Fields(&MessagePacket::senderNumber, &MessagePacket::message); }
 
 public:
-	union
-	{
-		ChatPacket packet;
-		struct
-		{
-			ChatPacket::Header header;
-			char senderId[ChatConstant::ID_LENGTH + 1];
-			char message[MESSAGE_LENGTH + 1];
-		};
-	};
-
-	static_assert((sizeof(header) + sizeof(senderId) + sizeof(message)) <= sizeof(ChatPacket), "Message packet size overflow.");
+	ChatPacket::Header header;
+	uint32_t senderNumber;
+	ChatSchema::String<MESSAGE_LENGTH> message;
 
 	MessagePacket();
 	~MessagePacket() = default;
 
-	void SetSenderID(const std::string& id);
 	int SetMessage(const std::string& text, int offset = 0);
 
-	void Validate();
+	inline void SetSenderNumber(uint32_t number) { senderNumber = number; }
+	inline auto GetSenderNumber() const { return senderNumber; }
+	inline const char* GetMessage() const { return message.c_str(); }
+};
 
-	inline const char* GetSenderID() const { return static_cast<const char*>(senderId); }
-	inline const char* GetMessage() const { return static_cast<const char*>(message); }
-};
\ No newline at end of file
+static_assert(ChatSchema::MaxSize<MessagePacket>() <= ChatPacket::PAYLOAD_SIZE, "Message packet size overflow.");
\ No newline at end of file
@@ -1,10 +1,12 @@
 
 #include "Network.h"
 
+#include <cstring>
 #include <iostream>
 
 #define WIN32_LEAN_AND_MEAN
 
+#include <afunix.h>
 #include <mstcpip.h>
 #include <windows.h>
 #include <winsock2.h>
@@ -34,3 +36,217 @@ void Network::Deinit()
 {
 	WSACleanup();
 }
+
+
+bool Network::CreateSocketPair(TSocket& readSocket, TSocket& writeSocket)
+{
+	readSocket = INVALID_SOCKET;
+	writeSocket = INVALID_SOCKET;
+
+	auto listenSocket = ::socket(AF_INET, SOCK_STREAM, IPPROTO_TCP);
+	if (listenSocket == INVALID_SOCKET)
+	{
+		cerr << "[Network] socket pair: socket failed. error = " << WSAGetLastError() << endl;
+		return false;
+	}
+
+	struct sockaddr_in sockAddr;
+	ZeroMemory(&sockAddr, sizeof(sockAddr));
+	sockAddr.sin_family = AF_INET;
+	sockAddr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+	sockAddr.sin_port = 0;
+
+	int nameLen = sizeof(sockAddr);
+	if (::bind(listenSocket, (sockaddr*)(&sockAddr), nameLen) == SOCKET_ERROR
+		|| getsockname(listenSocket, (sockaddr*)(&sockAddr), &nameLen) == SOCKET_ERROR
+		|| listen(listenSocket, 1) == SOCKET_ERROR)
+	{
+		cerr << "[Network] socket pair: listen failed. error = " << WSAGetLastError() << endl;
+
+		closesocket(listenSocket);
+		return false;
+	}
+
+	writeSocket = ::socket(AF_INET, SOCK_STREAM, IPPROTO_TCP);
+	if (writeSocket == INVALID_SOCKET
+		|| connect(writeSocket, (sockaddr*)(&sockAddr), nameLen) == SOCKET_ERROR)
+	{
+		cerr << "[Network] socket pair: connect failed. error = " << WSAGetLastError() << endl;
+
+		if (writeSocket != INVALID_SOCKET)
+			closesocket(writeSocket);
+
+		writeSocket = INVALID_SOCKET;
+		closesocket(listenSocket);
+		return false;
+	}
+
+	readSocket = accept(listenSocket, NULL, NULL);
+	closesocket(listenSocket);
+
+	if (readSocket == INVALID_SOCKET)
+	{
+		cerr << "[Network] socket pair: accept failed. error = " << WSAGetLastError() << endl;
+
+		closesocket(writeSocket);
+		writeSocket = INVALID_SOCKET;
+		return false;
+	}
+
+	BOOL noDelay = TRUE;
+	setsockopt(writeSocket, IPPROTO_TCP, TCP_NODELAY, (const char*)(&noDelay), sizeof(noDelay));
+
+	return SetNonBlocking(readSocket) && SetNonBlocking(writeSocket);
+}
+
+bool Network::SetNonBlocking(TSocket socket)
+{
+	u_long nonBlockingMode = 1;
+	if (ioctlsocket(socket, FIONBIO, &nonBlockingMode) != 0)
+	{
+		cerr << "[Network] ioctlsocket failed, error = " << WSAGetLastError() << endl;
+		return false;
+	}
+
+	return true;
+}
+
+bool Network::SetNoDelay(TSocket socket)
+{
+	BOOL noDelay = TRUE;
+	if (setsockopt(socket, IPPROTO_TCP, TCP_NODELAY, (const char*)(&noDelay), sizeof(noDelay)) != 0)
+	{
+		cerr << "[Network] setsockopt TCP_NODELAY failed, error = " << WSAGetLastError() << endl;
+		return false;
+	}
+
+	return true;
+}
+
+Network::TSocket Network::Connect(const char* address, const char* port)
+{
+	struct addrinfo* addressInfo = nullptr;
+	struct addrinfo hints;
+
+	ZeroMemory(&hints, sizeof(hints));
+	hints.ai_family = AF_UNSPEC;
+	hints.ai_socktype = SOCK_STREAM;
+	hints.ai_protocol = IPPROTO_TCP;
+
+	auto result = getaddrinfo(address, port, &hints, &addressInfo);
+	if (result != 0)
+	{
+		cerr << "[Network] getaddrinfo failed. error = " << result << endl;
+		return INVALID_SOCKET;
+	}
+
+	TSocket socket = INVALID_SOCKET;
+
+	for (auto ptr = addressInfo; ptr != NULL; ptr = ptr->ai_next)
+	{
+		socket = ::socket(ptr->ai_family, ptr->ai_socktype, ptr->ai_protocol);
+		if (socket == INVALID_SOCKET)
+			break;
+
+		result = connect(socket, ptr->ai_addr, (int)ptr->ai_addrlen);
+		if (result == SOCKET_ERROR)
+		{
+			closesocket(socket);
+			socket = INVALID_SOCKET;
+			continue;
+		}
+
+		break;
+	}
+
+	freeaddrinfo(addressInfo);
+
+	if (socket == INVALID_SOCKET)
+		return INVALID_SOCKET;
+
+	if (!SetNonBlocking(socket))
+	{
+		shutdown(socket, SD_SEND);
+		closesocket(socket);
+		return INVALID_SOCKET;
+	}
+
+	return socket;
+}
+
+Network::TSocket Network::ConnectAsync(const char* address, const char* port)
+{
+	struct addrinfo* addressInfo = nullptr;
+	struct addrinfo hints;
+
+	// Only one address is tried, as there is no waiting for it to fail; the servers listen on IPv4.
+	ZeroMemory(&hints, sizeof(hints));
+	hints.ai_family = AF_INET;
+	hints.ai_socktype = SOCK_STREAM;
+	hints.ai_protocol = IPPROTO_TCP;
+
+	auto result = getaddrinfo(address, port, &hints, &addressInfo);
+	if (result != 0)
+	{
+		cerr << "[Network] getaddrinfo failed. error = " << result << endl;
+		return INVALID_SOCKET;
+	}
+
+	TSocket socket = ::socket(addressInfo->ai_family, addressInfo->ai_socktype, addressInfo->ai_protocol);
+
+	if (socket != INVALID_SOCKET
+		&& (!SetNonBlocking(socket)
+			|| (connect(socket, addressInfo->ai_addr, (int)addressInfo->ai_addrlen) == SOCKET_ERROR && WSAGetLastError() != WSAEWOULDBLOCK)))
+	{
+		cerr << "[Network] connect failed. error = " << WSAGetLastError() << endl;
+		closesocket(socket);
+		socket = INVALID_SOCKET;
+	}
+
+	freeaddrinfo(addressInfo);
+	return socket;
+}
+
+int Network::GetConnectError(TSocket socket)
+{
+	int error = 0;
+	int length = sizeof(error);
+
+	if (getsockopt(socket, SOL_SOCKET, SO_ERROR, (char*)(&error), &length) == SOCKET_ERROR)
+		return WSAGetLastError();
+
+	return error;
+}
+
+Network::TSocket Network::ConnectLocal(const char* path)
+{
+	struct sockaddr_un sockAddr;
+	ZeroMemory(&sockAddr, sizeof(sockAddr));
+	sockAddr.sun_family = AF_UNIX;
+
+	if (strlen(path) >= sizeof(sockAddr.sun_path))
+	{
+		cerr << "[Network] local socket path is too long: " << path << endl;
+		return INVALID_SOCKET;
+	}
+
+	memcpy(sockAddr.sun_path, path, strlen(path));
+
+	TSocket socket = ::socket(AF_UNIX, SOCK_STREAM, 0);
+	if (socket == INVALID_SOCKET)
+	{
+		cerr << "[Network] local socket failed. error = " << WSAGetLastError() << endl;
+		return INVALID_SOCKET;
+	}
+
+	if (connect(socket, (sockaddr*)(&sockAddr), sizeof(sockAddr)) == SOCKET_ERROR
+		|| !SetNonBlocking(socket))
+	{
+		cerr << "[Network] failed to connect to " << path << ", error = " << WSAGetLastError() << endl;
+
+		closesocket(socket);
+		return INVALID_SOCKET;
+	}
+
+	return socket;
+}
\ No newline at end of file
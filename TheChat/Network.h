@@ -11,4 +11,14 @@ namespace Network
 	using TTimeStamp = std::chrono::time_point<std::chrono::steady_clock>;
 	bool Initialize();
 	void Deinit();
+
+	bool CreateSocketPair(TSocket& readSocket, TSocket& writeSocket);
+	bool SetNonBlocking(TSocket socket);
+	bool SetNoDelay(TSocket socket);
+	TSocket Connect(const char* address, const char* port);
+	// Starts connecting without waiting for it: the socket polls writable once the connect finished,
+	// and GetConnectError() then tells whether it succeeded.
+	TSocket ConnectAsync(const char* address, const char* port);
+	int GetConnectError(TSocket socket);
+	TSocket ConnectLocal(const char* path);
 }
@@ -0,0 +1,10 @@
+#include "PeerHelloPacket.h"
+
+
+PeerHelloPacket::PeerHelloPacket(const std::string& nodeName, bool isReply)
+	: header()
+	, isReply(isReply ? 1 : 0)
+{
+	header.tableId = GetTableID();
+	this->nodeName.Assign(nodeName);
+}
\ No newline at end of file
@@ -0,0 +1,30 @@
+#pragma once
+
+#include <string>
+
+#include "ChatConstant.h"
+#include "ChatPacket.h"
+#include "ChatSchema.h"
+#include "ChatTableID.h"
+
+
+// First packet on an inter-node link. The dialing node introduces itself and the other end replies with its own name.
+class PeerHelloPacket final
+{
+public:
+	static constexpr EChatTableID GetTableID() { return EChatTableID::PEER_HELLO_TABLE; }
+	static constexpr auto GetFields() { return ChatSchema::Fields(&PeerHelloPacket::nodeName, &PeerHelloPacket::isReply); }
+
+public:
+	ChatPacket::Header header;
+	ChatSchema::String<ChatConstant::ID_LENGTH> nodeName;
+	uint8_t isReply;
+
+	PeerHelloPacket(const std::string& nodeName = std::string(), bool isReply = false);
+	~PeerHelloPacket() = default;
+
+	inline const char* GetNodeName() const { return nodeName.c_str(); }
+	inline bool IsReply() const { return isReply != 0; }
+};
+
+static_assert(ChatSchema::MaxSize<PeerHelloPacket>() <= ChatPacket::PAYLOAD_SIZE, "PeerHelloPacket size overflow.");
\ No newline at end of file
@@ -0,0 +1,10 @@
+#include "PeerPresencePacket.h"
+
+
+PeerPresencePacket::PeerPresencePacket(EOperation operation, const std::string& id)
+	: header()
+	, operation(operation)
+{
+	header.tableId = GetTableID();
+	this->id.Assign(id);
+}
\ No newline at end of file
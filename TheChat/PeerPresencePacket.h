@@ -0,0 +1,38 @@
+#pragma once
+
+#include <string>
+
+#include "ChatConstant.h"
+#include "ChatPacket.h"
+#include "ChatSchema.h"
+#include "ChatTableID.h"
+
+
+// Node-level presence change sent over an inter-node link.
+// A link starts with Reset followed by a Join for every local ID, then carries deltas only.
+class PeerPresencePacket final
+{
+public:
+	static constexpr EChatTableID GetTableID() { return EChatTableID::PEER_PRESENCE_TABLE; }
+	static constexpr auto GetFields() { return ChatSchema::Fields(&PeerPresencePacket::operation, &PeerPresencePacket::id); }
+
+	enum class EOperation : uint8_t
+	{
+		Reset = 0,
+		Join = 1,
+		Leave = 2
+	};
+
+public:
+	ChatPacket::Header header;
+	EOperation operation;
+	ChatSchema::String<ChatConstant::ID_LENGTH> id;
+
+	PeerPresencePacket(EOperation operation = EOperation::Reset, const std::string& id = std::string());
+	~PeerPresencePacket() = default;
+
+	inline auto GetOperation() const { return operation; }
+	inline const char* GetID() const { return id.c_str(); }
+};
+
+static_assert(ChatSchema::MaxSize<PeerPresencePacket>() <= ChatPacket::PAYLOAD_SIZE, "PeerPresencePacket size overflow.");
\ No newline at end of file
@@ -0,0 +1,11 @@
+#include "PingPacket.h"
+
+
+PingPacket::PingPacket(uint64_t sendTime, uint32_t heartBeatPeriod, bool isRequest)
+	: header()
+	, sendTime(sendTime)
+	, heartBeatPeriod(heartBeatPeriod)
+{
+	header.tableId = GetTableID();
+	header.packetType = isRequest ? ChatPacket::EPacketType::Request : ChatPacket::EPacketType::Normal;
+}
\ No newline at end of file
@@ -0,0 +1,32 @@
+#pragma once
+
+#include <cstdint>
+
+#include "ChatPacket.h"
+#include "ChatSchema.h"
+#include "ChatTableID.h"
+
+
+// Liveness probe (Request) and its answer (Normal). The pong echoes sendTime, a steady clock reading of the pinging
+// side in microseconds, so only that side ever reads it. heartBeatPeriod tells the pinged side how long in ms it
+// may go without hearing anything before the next ping is sent.
+class PingPacket final
+{
+public:
+	static constexpr EChatTableID GetTableID() { return EChatTableID::PING_TABLE; }
+	static constexpr auto GetFields() { return ChatSchema::Fields(&PingPacket::sendTime, &PingPacket::heartBeatPeriod); }
+
+public:
+	ChatPacket::Header header;
+	uint64_t sendTime;
+	uint32_t heartBeatPeriod;
+
+	PingPacket(uint64_t sendTime = 0, uint32_t heartBeatPeriod = 0, bool isRequest = false);
+	~PingPacket() = default;
+
+	inline bool IsRequest() const { return header.packetType == ChatPacket::EPacketType::Request; }
+	inline auto GetSendTime() const { return sendTime; }
+	inline auto GetHeartBeatPeriod() const { return heartBeatPeriod; }
+};
+
+static_assert(ChatSchema::MaxSize<PingPacket>() <= ChatPacket::PAYLOAD_SIZE, "PingPacket size overflow.");
\ No newline at end of file
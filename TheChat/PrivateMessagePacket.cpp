@@ -0,0 +1,28 @@
+#include "PrivateMessagePacket.h"
+
+#include <algorithm>
+
+
+using namespace std;
+
+PrivateMessagePacket::PrivateMessagePacket()
+	: header()
+{
+	header.tableId = GetTableID();
+}
+
+void PrivateMessagePacket::SetSenderID(string_view id)
+{
+	senderId.Assign(id);
+}
+
+void PrivateMessagePacket::SetRecipientID(string_view id)
+{
+	recipientId.Assign(id);
+}
+
+int PrivateMessagePacket::SetMessage(const string& text, int offset)
+{
+	const auto begin = std::min<size_t>(offset, text.size());
+	return static_cast<int>(begin + message.Assign(string_view(text).substr(begin)));
+}
\ No newline at end of file
@@ -0,0 +1,40 @@
+#pragma once
+
+#include <string>
+#include <string_view>
+
+#include "ChatConstant.h"
+#include "ChatPacket.h"
+#include "ChatSchema.h"
+#include "ChatTableID.h"
+
+
+class PrivateMessagePacket final
+{
+public:
+	static constexpr int MESSAGE_LENGTH = 128;
+	static constexpr EChatTableID GetTableID() { return EChatTableID::PRIVATE_MESSAGE_TABLE; }
+	static constexpr auto GetFields()
+	{
+		return ChatSchema::Fields(&PrivateMessagePacket::senderId, &PrivateMessagePacket::recipientId, &PrivateMessagePacket::message);
+	}
+
+public:
+	ChatPacket::Header header;
+	ChatSchema::String<ChatConstant::ID_LENGTH> senderId;
+	ChatSchema::String<ChatConstant::ID_LENGTH> recipientId;
+	ChatSchema::String<MESSAGE_LENGTH> message;
+
+	PrivateMessagePacket();
+	~PrivateMessagePacket() = default;
+
+	void SetSenderID(std::string_view id);
+	void SetRecipientID(std::string_view id);
+	int SetMessage(const std::string& text, int offset = 0);
+
+	inline const char* GetSenderID() const { return senderId.c_str(); }
+	inline const char* GetRecipientID() const { return recipientId.c_str(); }
+	inline const char* GetMessage() const { return message.c_str(); }
+};
+
+static_assert(ChatSchema::MaxSize<PrivateMessagePacket>() <= ChatPacket::PAYLOAD_SIZE, "Private message packet size overflow.");
\ No newline at end of file
@@ -0,0 +1,26 @@
+#include "SearchPacket.h"
+
+
+using namespace std;
+
+SearchPacket::SearchPacket(uint32_t requestId, bool isRequest)
+	: header()
+	, requestId(requestId)
+	, messageNumber(0)
+	, maxResults(0)
+	, index(0)
+	, numResults(0)
+{
+	header.tableId = GetTableID();
+	header.packetType = isRequest ? ChatPacket::EPacketType::Request : ChatPacket::EPacketType::Normal;
+}
+
+void SearchPacket::SetSenderID(string_view id)
+{
+	senderId.Assign(id);
+}
+
+void SearchPacket::SetText(string_view text)
+{
+	this->text.Assign(text);
+}
\ No newline at end of file
@@ -0,0 +1,47 @@
+#pragma once
+
+#include <string>
+#include <string_view>
+
+#include "ChatConstant.h"
+#include "ChatPacket.h"
+#include "ChatSchema.h"
+#include "ChatTableID.h"
+
+
+// History search. A Request carries the query terms in text and an optional sender filter.
+// The answer is one Normal packet per hit, newest first, or a single packet with numResults = 0.
+class SearchPacket final
+{
+public:
+	static constexpr int TEXT_LENGTH = 128;
+	static constexpr uint16_t MAX_RESULTS = 50;
+	static constexpr EChatTableID GetTableID() { return EChatTableID::SEARCH_TABLE; }
+	static constexpr auto GetFields()
+	{
+		return ChatSchema::Fields(&SearchPacket::requestId, &SearchPacket::messageNumber, &SearchPacket::maxResults,
+			&SearchPacket::index, &SearchPacket::numResults, &SearchPacket::senderId, &SearchPacket::text);
+	}
+
+public:
+	ChatPacket::Header header;
+	uint32_t requestId;
+	uint32_t messageNumber;
+	uint16_t maxResults;
+	uint16_t index;
+	uint16_t numResults;
+	ChatSchema::String<ChatConstant::ID_LENGTH> senderId;
+	ChatSchema::String<TEXT_LENGTH> text;
+
+	SearchPacket(uint32_t requestId = 0, bool isRequest = false);
+	~SearchPacket() = default;
+
+	void SetSenderID(std::string_view id);
+	void SetText(std::string_view text);
+
+	inline bool IsRequest() const { return header.packetType == ChatPacket::EPacketType::Request; }
+	inline const char* GetSenderID() const { return senderId.c_str(); }
+	inline const char* GetText() const { return text.c_str(); }
+};
+
+static_assert(ChatSchema::MaxSize<SearchPacket>() <= ChatPacket::PAYLOAD_SIZE, "SearchPacket size overflow.");
\ No newline at end of file
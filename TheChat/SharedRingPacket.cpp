@@ -0,0 +1,11 @@
+#include "SharedRingPacket.h"
+
+
+SharedRingPacket::SharedRingPacket(const std::string& name, bool isRequest, bool isAccepted)
+	: header()
+	, isAccepted(isAccepted ? 1 : 0)
+{
+	header.tableId = GetTableID();
+	header.packetType = isRequest ? ChatPacket::EPacketType::Request : ChatPacket::EPacketType::Normal;
+	this->name.Assign(name);
+}
\ No newline at end of file
@@ -0,0 +1,32 @@
+#pragma once
+
+#include <string>
+
+#include "ChatPacket.h"
+#include "ChatSchema.h"
+#include "ChatTableID.h"
+
+
+// Asks a same-host server to move the connection onto a shared memory ring (Request),
+// and carries the answer back (Normal). After the exchange the socket only carries wake-up bytes.
+class SharedRingPacket final
+{
+public:
+	static constexpr EChatTableID GetTableID() { return EChatTableID::SHARED_RING_TABLE; }
+	static constexpr auto GetFields() { return ChatSchema::Fields(&SharedRingPacket::isAccepted, &SharedRingPacket::name); }
+	static constexpr int NAME_LENGTH = 128;
+
+public:
+	ChatPacket::Header header;
+	uint8_t isAccepted;
+	ChatSchema::String<NAME_LENGTH> name;
+
+	SharedRingPacket(const std::string& name = std::string(), bool isRequest = false, bool isAccepted = false);
+	~SharedRingPacket() = default;
+
+	inline bool IsRequest() const { return header.packetType == ChatPacket::EPacketType::Request; }
+	inline bool IsAccepted() const { return isAccepted != 0; }
+	inline const char* GetName() const { return name.c_str(); }
+};
+
+static_assert(ChatSchema::MaxSize<SharedRingPacket>() <= ChatPacket::PAYLOAD_SIZE, "SharedRingPacket size overflow.");
\ No newline at end of file
@@ -0,0 +1,200 @@
+#include "ChatTest.h"
+
+#include <chrono>
+#include <memory>
+#include <set>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "ChatConnection.h"
+#include "ChatIdTable.h"
+#include "ChatPacket.h"
+#include "ChatSession.h"
+#include "ChatTableID.h"
+#include "IdMapPacket.h"
+#include "MessageBatchPacket.h"
+#include "MessagePacket.h"
+#include "Network.h"
+
+
+namespace
+{
+	// Two connections over a loopback socket pair: the sender as the server side, the receiver as its client.
+	struct ConnectionPair
+	{
+		std::unique_ptr<ChatConnection> sender;
+		std::unique_ptr<ChatConnection> receiver;
+
+		ConnectionPair()
+		{
+			Network::TSocket readSocket = INVALID_SOCKET;
+			Network::TSocket writeSocket = INVALID_SOCKET;
+
+			if (!Network::Initialize() || !Network::CreateSocketPair(readSocket, writeSocket))
+				return;
+
+			sender = std::make_unique<ChatConnection>(writeSocket);
+			receiver = std::make_unique<ChatConnection>(readSocket);
+		}
+
+		~ConnectionPair()
+		{
+			sender.reset();
+			receiver.reset();
+			Network::Deinit();
+		}
+
+		inline bool IsValid() const { return sender != nullptr; }
+
+		// Flushes the sender and returns what arrived, waiting until the link has been quiet for a while.
+		std::vector<ChatPacket> Deliver()
+		{
+			sender->FlushSendRequests();
+
+			std::vector<ChatPacket> received;
+			int numQuietRounds = 0;
+
+			for (int i = 0; i < 1000 && numQuietRounds < 20; ++i)
+			{
+				receiver->Receive();
+
+				auto packets = receiver->ExtractReceived();
+				numQuietRounds = packets.empty() ? numQuietRounds + 1 : 0;
+				received.insert(received.end(), packets.begin(), packets.end());
+
+				std::this_thread::sleep_for(std::chrono::milliseconds(1));
+			}
+
+			return received;
+		}
+	};
+
+	MessagePacket MakeMessage(const std::string& senderId, const std::string& text)
+	{
+		MessagePacket message;
+		message.SetSenderNumber(ChatIdTable::GetNumber(senderId));
+		message.SetMessage(text);
+
+		return message;
+	}
+
+	std::string MakeID(const char* prefix, int index)
+	{
+		// Full length IDs fill an ID map after a handful of entries.
+		auto id = std::string(prefix) + std::to_string(index);
+		id.resize(ChatConstant::ID_LENGTH, '.');
+
+		return id;
+	}
+
+	// Checks every sender number is mapped once, before the first message using it; returns the messages seen.
+	size_t CountMappedMessages(const std::vector<ChatPacket>& packets, bool& isOrdered)
+	{
+		std::set<uint32_t> mapped;
+		size_t numMessages = 0;
+		isOrdered = true;
+
+		auto checkSender = [&mapped, &numMessages, &isOrdered](uint32_t senderNumber)
+			{
+				isOrdered = isOrdered && mapped.count(senderNumber) > 0;
+				++numMessages;
+			};
+
+		for (auto& packet : packets)
+		{
+			switch (packet.header.tableId)
+			{
+			case EChatTableID::ID_MAP_TABLE:
+			{
+				IdMapPacket idMap;
+				isOrdered = isOrdered && packet.Decode(idMap);
+				idMap.ForEach([&mapped, &isOrdered](uint32_t number, const std::string&) { isOrdered = isOrdered && mapped.insert(number).second; });
+				break;
+			}
+
+			case EChatTableID::MESSAGE_BATCH_TABLE:
+			{
+				MessageBatchPacket batch;
+				isOrdered = isOrdered && packet.Decode(batch);
+				batch.ForEach([&checkSender](uint32_t senderNumber, const std::string&) { checkSender(senderNumber); });
+				break;
+			}
+
+			case EChatTableID::MESSAGE_TABLE:
+			{
+				MessagePacket message;
+				isOrdered = isOrdered && packet.Decode(message);
+				checkSender(message.GetSenderNumber());
+				break;
+			}
+
+			default:
+				break;
+			}
+		}
+
+		return numMessages;
+	}
+}
+
+CHAT_TEST(SendLanesKeepSequencedTablesOutOfControl)
+{
+	// The control lane skips the window and the resume hold, which only unsequenced packets may.
+	for (uint16_t i = 0; i < static_cast<uint16_t>(EChatTableID::MAX); ++i)
+	{
+		const auto tableId = static_cast<EChatTableID>(i);
+		CHAT_CHECK(!ChatPacket::IsSequenced(tableId) || ChatPacket::GetSendLane(tableId) != ChatPacket::ESendLane::Control);
+	}
+}
+
+CHAT_TEST(ConnectionMapsIDsBeforeCoalescedMessages)
+{
+	ConnectionPair pair;
+	CHAT_CHECK(pair.IsValid());
+	if (!pair.IsValid())
+		return;
+
+	// More new senders than an ID map holds, so maps are flushed while a batch is still open.
+	pair.sender->SetCoalescePolicy(8, std::chrono::milliseconds(1000));
+
+	for (int i = 0; i < 24; ++i)
+	{
+		pair.sender->RequestSendMessage(MakeMessage(MakeID("coalesced-", i), "message " + std::to_string(i)));
+	}
+
+	bool isOrdered = false;
+	CHAT_CHECK(CountMappedMessages(pair.Deliver(), isOrdered) == 24);
+	CHAT_CHECK(isOrdered);
+}
+
+CHAT_TEST(ConnectionHoldsIDMapsWhileResuming)
+{
+	ConnectionPair pair;
+	CHAT_CHECK(pair.IsValid());
+	if (!pair.IsValid())
+		return;
+
+	// Nothing sequenced goes out before the peer said what it received, ID maps included.
+	pair.sender->AdoptSession(ChatSession());
+
+	for (int i = 0; i < 3; ++i)
+	{
+		pair.sender->RequestSendMessage(MakeMessage(MakeID("resuming-", i), "held"));
+	}
+
+	const auto early = pair.Deliver();
+
+	for (auto& packet : early)
+	{
+		CHAT_CHECK(!ChatPacket::IsSequenced(packet.header.tableId));
+	}
+
+	bool isOrdered = false;
+
+	pair.sender->Resume(0);
+
+	const auto received = pair.Deliver();
+	CHAT_CHECK(CountMappedMessages(received, isOrdered) == 3);
+	CHAT_CHECK(isOrdered);
+}
\ No newline at end of file
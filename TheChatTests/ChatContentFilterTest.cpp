@@ -0,0 +1,212 @@
+#include "ChatTest.h"
+
+#include <cctype>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "ChatContentFilter.h"
+
+
+namespace
+{
+	// Few patterns with distinct leading pairs: the shuffle prefilter engages where the CPU has it.
+	const std::vector<std::string> SHUFFLE_PATTERNS = { "badword", "Worse", "qux" };
+	// Single bytes let any pair through, so only the compare against eight first bytes is left.
+	const std::vector<std::string> COMPARE_PATTERNS = { "e", "t", "a", "o", "eat", "tea", "oat" };
+
+	// More first bytes than the compare takes and too many pairs for the shuffle: one table step per byte.
+	std::vector<std::string> MakeScalarPatterns()
+	{
+		auto patterns = SHUFFLE_PATTERNS;
+		for (char first = 'a'; first <= 'z'; ++first)
+		{
+			for (char second = '0'; second <= '9'; ++second)
+			{
+				patterns.push_back(std::string{ first, second, '#' });
+			}
+		}
+
+		return patterns;
+	}
+
+	// Masks the longest pattern ending at each position, by brute force over the original text.
+	int ApplyNaive(const std::vector<std::string>& patterns, std::string& text)
+	{
+		const auto original = text;
+		int numMatches = 0;
+
+		for (size_t end = 1; end <= original.size(); ++end)
+		{
+			size_t longest = 0;
+			for (auto& pattern : patterns)
+			{
+				if (pattern.empty() || pattern.size() > ChatContentFilter::MAX_PATTERN_LENGTH || pattern.size() > end || pattern.size() <= longest)
+					continue;
+
+				bool isMatch = true;
+				for (size_t i = 0; i < pattern.size() && isMatch; ++i)
+				{
+					isMatch = tolower(static_cast<unsigned char>(original[end - pattern.size() + i])) == tolower(static_cast<unsigned char>(pattern[i]));
+				}
+
+				longest = isMatch ? pattern.size() : longest;
+			}
+
+			if (longest == 0)
+				continue;
+
+			text.replace(end - longest, longest, longest, ChatContentFilter::MASK);
+			++numMatches;
+		}
+
+		return numMatches;
+	}
+
+	bool IsSameAsNaive(const ChatContentFilter& filter, const std::vector<std::string>& patterns, const std::string& text)
+	{
+		auto filtered = text;
+		auto expected = text;
+
+		const int numMatches = filter.Apply(filtered.data(), filtered.size());
+		return numMatches == ApplyNaive(patterns, expected) && filtered == expected;
+	}
+
+	std::string Filter(const ChatContentFilter& filter, std::string text, int& numMatches)
+	{
+		numMatches = filter.Apply(text.data(), text.size());
+		return text;
+	}
+}
+
+CHAT_TEST(ContentFilterPicksItsScanPath)
+{
+#if defined(_M_X64) || defined(__SSSE3__)
+	CHAT_CHECK(ChatContentFilter(SHUFFLE_PATTERNS).IsPrefilterEnabled());
+#endif
+	CHAT_CHECK(!ChatContentFilter(COMPARE_PATTERNS).IsPrefilterEnabled());
+	CHAT_CHECK(!ChatContentFilter(MakeScalarPatterns()).IsPrefilterEnabled());
+}
+
+CHAT_TEST(ContentFilterMatchesAtEveryOffset)
+{
+	// Three 16 byte blocks and a tail: every offset puts the pattern inside a block, across a boundary or in the tail.
+	const std::string filler(16 * 3 + 5, ' ');
+	const std::string pattern = "badword";
+
+	for (auto& patterns : { SHUFFLE_PATTERNS, MakeScalarPatterns() })
+	{
+		const ChatContentFilter filter(patterns);
+
+		for (size_t offset = 0; offset + pattern.size() <= filler.size(); ++offset)
+		{
+			auto text = filler;
+			text.replace(offset, pattern.size(), pattern);
+
+			auto expected = filler;
+			expected.replace(offset, pattern.size(), pattern.size(), ChatContentFilter::MASK);
+
+			int numMatches = 0;
+			CHAT_CHECK(Filter(filter, text, numMatches) == expected);
+			CHAT_CHECK(numMatches == 1);
+		}
+	}
+
+	const ChatContentFilter filter(COMPARE_PATTERNS);
+	for (size_t offset = 0; offset < filler.size(); ++offset)
+	{
+		auto text = filler;
+		text[offset] = 'E';
+
+		auto expected = filler;
+		expected[offset] = ChatContentFilter::MASK;
+
+		int numMatches = 0;
+		CHAT_CHECK(Filter(filter, text, numMatches) == expected);
+		CHAT_CHECK(numMatches == 1);
+	}
+}
+
+CHAT_TEST(ContentFilterIgnoresCase)
+{
+	const ChatContentFilter filter(SHUFFLE_PATTERNS);
+	int numMatches = 0;
+
+	CHAT_CHECK(Filter(filter, "a BadWord, WORSE and worse", numMatches) == "a *******, ***** and *****");
+	CHAT_CHECK(numMatches == 3);
+	CHAT_CHECK(Filter(filter, "bad words are not worsened", numMatches) == "bad words are not *****ned");
+	CHAT_CHECK(numMatches == 1);
+}
+
+CHAT_TEST(ContentFilterMasksTheLongestMatch)
+{
+	int numMatches = 0;
+
+	// Nested: the inner pattern is masked first, then the outer one ending later covers it.
+	const ChatContentFilter nested({ "ass", "class" });
+	CHAT_CHECK(Filter(nested, "classic", numMatches) == "*****ic");
+	CHAT_CHECK(numMatches == 1);
+	CHAT_CHECK(Filter(nested, "a bass", numMatches) == "a b***");
+	CHAT_CHECK(numMatches == 1);
+
+	// Inner pattern ending before the outer one: both are counted and the outer mask covers the inner one.
+	const ChatContentFilter inner({ "bad", "a" });
+	CHAT_CHECK(Filter(inner, "bad", numMatches) == "***");
+	CHAT_CHECK(numMatches == 2);
+
+	// Overlapping: the masks join.
+	const ChatContentFilter overlapping({ "abcd", "cdef" });
+	CHAT_CHECK(Filter(overlapping, "xabcdefx", numMatches) == "x******x");
+	CHAT_CHECK(numMatches == 2);
+}
+
+CHAT_TEST(ContentFilterTakesTheLongestPattern)
+{
+	std::string longest(ChatContentFilter::MAX_PATTERN_LENGTH, 'x');
+	longest.front() = 'z';
+
+	const ChatContentFilter filter({ longest, longest + "y" });
+	CHAT_CHECK(filter.GetNumPatterns() == 1);
+
+	int numMatches = 0;
+	const auto text = "(" + longest + "y)";
+	CHAT_CHECK(Filter(filter, text, numMatches) == "(" + std::string(longest.size(), ChatContentFilter::MASK) + "y)");
+	CHAT_CHECK(numMatches == 1);
+}
+
+CHAT_TEST(ContentFilterPathsAgree)
+{
+	std::mt19937 random(7);
+	const std::string alphabet = "abdeorstwquxBDEOW 0123";
+	const auto scalarPatterns = MakeScalarPatterns();
+
+	const ChatContentFilter shuffle(SHUFFLE_PATTERNS);
+	const ChatContentFilter compare(COMPARE_PATTERNS);
+	const ChatContentFilter scalar(scalarPatterns);
+
+	for (int round = 0; round < 200; ++round)
+	{
+		std::string text(random() % 80, ' ');
+		for (auto& ch : text)
+		{
+			ch = alphabet[random() % alphabet.size()];
+		}
+
+		// Plant whole patterns now and then, random letters rarely spell one.
+		const auto& planted = SHUFFLE_PATTERNS[random() % SHUFFLE_PATTERNS.size()];
+		if (text.size() >= planted.size())
+		{
+			text.replace(random() % (text.size() - planted.size() + 1), planted.size(), planted);
+		}
+
+		CHAT_CHECK(IsSameAsNaive(shuffle, SHUFFLE_PATTERNS, text));
+		CHAT_CHECK(IsSameAsNaive(compare, COMPARE_PATTERNS, text));
+		CHAT_CHECK(IsSameAsNaive(scalar, scalarPatterns, text));
+
+		// Without '#' none of the scalar filter's extra patterns occur, so it has to agree with the shuffle filter.
+		auto viaShuffle = text;
+		auto viaScalar = text;
+		CHAT_CHECK(shuffle.Apply(viaShuffle.data(), viaShuffle.size()) == scalar.Apply(viaScalar.data(), viaScalar.size()));
+		CHAT_CHECK(viaShuffle == viaScalar);
+	}
+}
\ No newline at end of file
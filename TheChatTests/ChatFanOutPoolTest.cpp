@@ -0,0 +1,115 @@
+#include "ChatTest.h"
+
+#include <atomic>
+#include <chrono>
+#include <memory>
+#include <mutex>
+#include <set>
+#include <stdexcept>
+#include <thread>
+
+#include "ChatFanOutPool.h"
+
+
+namespace
+{
+	// Runs numTasks and checks every index ran exactly once before Run returned.
+	bool RunsEveryIndexOnce(ChatFanOutPool& pool, size_t numTasks)
+	{
+		auto counts = std::make_unique<std::atomic<int>[]>(numTasks);
+		pool.Run(numTasks, [&counts](size_t index) { counts[index].fetch_add(1); });
+
+		for (size_t i = 0; i < numTasks; ++i)
+		{
+			if (counts[i].load() != 1)
+				return false;
+		}
+
+		return true;
+	}
+}
+
+CHAT_TEST(FanOutRunsInlineWithoutThreads)
+{
+	ChatFanOutPool pool;
+	CHAT_CHECK(!pool.IsStarted());
+
+	std::set<std::thread::id> threadIDs;
+	pool.Run(10, [&threadIDs](size_t) { threadIDs.insert(std::this_thread::get_id()); });
+
+	CHAT_CHECK(threadIDs == std::set<std::thread::id>({ std::this_thread::get_id() }));
+	CHAT_CHECK(RunsEveryIndexOnce(pool, 0));
+}
+
+CHAT_TEST(FanOutRunsEveryIndexOnce)
+{
+	ChatFanOutPool pool;
+	pool.Start(3);
+	CHAT_CHECK(pool.GetNumThreads() == 3);
+
+	// Fewer tasks than participants, uneven shares, and many loops back to back.
+	for (size_t numTasks : { 1, 2, 3, 4, 5, 7, 1000 })
+	{
+		CHAT_CHECK(RunsEveryIndexOnce(pool, numTasks));
+	}
+
+	for (int i = 0; i < 200; ++i)
+	{
+		CHAT_CHECK(RunsEveryIndexOnce(pool, 64));
+	}
+}
+
+CHAT_TEST(FanOutStealsFromASlowShare)
+{
+	ChatFanOutPool pool;
+	pool.Start(3);
+
+	// The first of four shares holds every slow task; the threads done with their own take them over.
+	constexpr size_t numTasks = 100;
+	std::mutex mutex;
+	std::set<std::thread::id> slowThreadIDs;
+
+	pool.Run(numTasks, [&](size_t index)
+		{
+			if (index >= numTasks / 4)
+				return;
+
+			std::this_thread::sleep_for(std::chrono::milliseconds(2));
+
+			std::lock_guard<std::mutex> lock(mutex);
+			slowThreadIDs.insert(std::this_thread::get_id());
+		});
+
+	CHAT_CHECK(slowThreadIDs.size() > 1);
+}
+
+CHAT_TEST(FanOutSurvivesAThrowingTask)
+{
+	ChatFanOutPool pool;
+	pool.Start(2);
+
+	std::atomic<int> numRun = 0;
+	pool.Run(50, [&numRun](size_t index)
+		{
+			++numRun;
+
+			if (index == 25)
+				throw std::runtime_error("expected by the test");
+		});
+
+	CHAT_CHECK(numRun.load() == 50);
+	CHAT_CHECK(RunsEveryIndexOnce(pool, 50));
+}
+
+CHAT_TEST(FanOutRestarts)
+{
+	ChatFanOutPool pool;
+	pool.Start(2);
+	pool.Stop();
+	CHAT_CHECK(!pool.IsStarted());
+	CHAT_CHECK(RunsEveryIndexOnce(pool, 10));
+
+	pool.Start(4);
+	CHAT_CHECK(pool.GetNumThreads() == 4);
+	CHAT_CHECK(RunsEveryIndexOnce(pool, 100));
+}
\ No newline at end of file
@@ -0,0 +1,29 @@
+#include "ChatTest.h"
+
+#include <string>
+
+#include "ChatIdTable.h"
+
+
+CHAT_TEST(IdTableReservesServerAndUnknown)
+{
+	CHAT_CHECK(ChatIdTable::IsReserved(ChatIdTable::SERVER_ID));
+	CHAT_CHECK(ChatIdTable::IsReserved(ChatIdTable::Unknown()));
+
+	// Interning does not refuse them, it hands out the reserved numbers; that is why greetings check first.
+	CHAT_CHECK(ChatIdTable::GetNumber(ChatIdTable::SERVER_ID) == ChatIdTable::SERVER_NUMBER);
+	CHAT_CHECK(ChatIdTable::TryIntern(ChatIdTable::Unknown()) == &ChatIdTable::Unknown());
+}
+
+CHAT_TEST(IdTableLetsOtherIDsIn)
+{
+	CHAT_CHECK(!ChatIdTable::IsReserved("alice"));
+	CHAT_CHECK(!ChatIdTable::IsReserved("server"));
+	CHAT_CHECK(!ChatIdTable::IsReserved("Server "));
+	CHAT_CHECK(!ChatIdTable::IsReserved(""));
+
+	const auto number = ChatIdTable::GetNumber("IdTableLetsOtherIDsIn");
+	CHAT_CHECK(number != ChatIdTable::SERVER_NUMBER);
+	CHAT_CHECK(number != ChatIdTable::GetNumber(ChatIdTable::Unknown()));
+	CHAT_CHECK(*ChatIdTable::Find(number) == "IdTableLetsOtherIDsIn");
+}
\ No newline at end of file
@@ -0,0 +1,118 @@
+#include "ChatTest.h"
+
+#include <cstdint>
+#include <memory>
+#include <thread>
+#include <vector>
+
+#include "ChatMPSCQueue.h"
+
+
+CHAT_TEST(MPSCQueuePopsInPushOrder)
+{
+	ChatMPSCQueue<int> queue;
+	int value = -1;
+
+	CHAT_CHECK(queue.IsEmpty());
+	CHAT_CHECK(!queue.Pop(value) && value == -1);
+
+	for (int i = 0; i < 5; ++i)
+	{
+		queue.Push(i);
+	}
+
+	CHAT_CHECK(!queue.IsEmpty());
+
+	// Pushes between pops go behind what is already queued.
+	for (int i = 0; i < 5; ++i)
+	{
+		CHAT_CHECK(queue.Pop(value) && value == i);
+		queue.Push(i + 5);
+	}
+
+	for (int i = 5; i < 10; ++i)
+	{
+		CHAT_CHECK(queue.Pop(value) && value == i);
+	}
+
+	CHAT_CHECK(queue.IsEmpty());
+	CHAT_CHECK(!queue.Pop(value) && value == 9);
+}
+
+CHAT_TEST(MPSCQueueReleasesWhatIsLeft)
+{
+	auto shared = std::make_shared<int>(7);
+
+	{
+		ChatMPSCQueue<std::shared_ptr<int>> queue;
+		queue.Push(shared);
+		queue.Push(shared);
+		queue.Push(shared);
+
+		std::shared_ptr<int> value;
+		CHAT_CHECK(queue.Pop(value) && value == shared);
+		CHAT_CHECK(shared.use_count() == 4);
+	}
+
+	// One popped out, two destroyed with the queue.
+	CHAT_CHECK(shared.use_count() == 1);
+
+	// Move-only values go through as well.
+	ChatMPSCQueue<std::unique_ptr<int>> queue;
+	queue.Push(std::make_unique<int>(3));
+
+	std::unique_ptr<int> value;
+	CHAT_CHECK(queue.Pop(value) && value != nullptr && *value == 3);
+}
+
+CHAT_TEST(MPSCQueueKeepsEachProducersOrder)
+{
+	// Producers push while the owner pops; every value arrives once, each producer's in the order it pushed them.
+	constexpr uint64_t numProducers = 4;
+	constexpr uint64_t numPerProducer = 50000;
+
+	ChatMPSCQueue<uint64_t> queue;
+	std::vector<std::thread> producers;
+
+	for (uint64_t producer = 0; producer < numProducers; ++producer)
+	{
+		producers.emplace_back([&queue, producer]()
+			{
+				for (uint64_t i = 0; i < numPerProducer; ++i)
+				{
+					queue.Push(producer << 32 | i);
+				}
+			});
+	}
+
+	std::vector<uint64_t> nextExpected(numProducers, 0);
+	uint64_t numPopped = 0;
+	bool isOrdered = true;
+
+	while (numPopped < numProducers * numPerProducer)
+	{
+		uint64_t value = 0;
+		if (!queue.Pop(value))
+		{
+			std::this_thread::yield();
+			continue;
+		}
+
+		const auto producer = value >> 32;
+		isOrdered = isOrdered && producer < numProducers && (value & UINT32_MAX) == nextExpected[producer]++;
+		++numPopped;
+	}
+
+	for (auto& producer : producers)
+	{
+		producer.join();
+	}
+
+	CHAT_CHECK(isOrdered);
+	CHAT_CHECK(queue.IsEmpty());
+
+	for (auto next : nextExpected)
+	{
+		CHAT_CHECK(next == numPerProducer);
+	}
+}
\ No newline at end of file
@@ -0,0 +1,66 @@
+#include "ChatTest.h"
+
+#include <string>
+#include <vector>
+
+#include "ChatMessageStages.h"
+#include "MessagePacket.h"
+#include "PrivateMessagePacket.h"
+
+
+CHAT_TEST(StagesReplaceAForgedSenderNumber)
+{
+	ChatMessageStages stages;
+	std::vector<uint32_t> seenSenders;
+	stages.Add([&seenSenders](MessagePacket& message) { seenSenders.push_back(message.GetSenderNumber()); return true; });
+
+	MessagePacket message;
+	message.SetSenderNumber(0);
+	message.SetMessage("hello");
+
+	CHAT_CHECK(stages.Run(42, message));
+	CHAT_CHECK(message.GetSenderNumber() == 42);
+	CHAT_CHECK(seenSenders == std::vector<uint32_t>({ 42 }));
+}
+
+CHAT_TEST(StagesReplaceAForgedPrivateSender)
+{
+	ChatMessageStages stages;
+	std::vector<uint32_t> seenSenders;
+	stages.Add([&seenSenders](MessagePacket& message) { seenSenders.push_back(message.GetSenderNumber()); return true; });
+
+	PrivateMessagePacket message;
+	message.SetSenderID("alice");
+	message.SetRecipientID("bob");
+	message.SetMessage("it is me, alice");
+
+	CHAT_CHECK(stages.Run(7, "mallory", message));
+	CHAT_CHECK(std::string(message.GetSenderID()) == "mallory");
+	CHAT_CHECK(std::string(message.GetRecipientID()) == "bob");
+	CHAT_CHECK(seenSenders == std::vector<uint32_t>({ 7 }));
+
+	// The replaced sender is what goes onto the wire.
+	PrivateMessagePacket relayed;
+	CHAT_CHECK(ChatPacket::Encode(message).Decode(relayed));
+	CHAT_CHECK(std::string(relayed.GetSenderID()) == "mallory");
+}
+
+CHAT_TEST(StagesRewriteAndDropPrivateMessages)
+{
+	ChatMessageStages stages;
+	stages.Add([](MessagePacket& message) { message.message.Assign("***"); return true; });
+
+	PrivateMessagePacket message;
+	message.SetMessage("secret");
+
+	CHAT_CHECK(stages.Run(7, "mallory", message));
+	CHAT_CHECK(std::string(message.GetMessage()) == "***");
+
+	// Stages after one that dropped the message do not run.
+	int numLaterRuns = 0;
+	stages.Add([](MessagePacket&) { return false; });
+	stages.Add([&numLaterRuns](MessagePacket&) { ++numLaterRuns; return true; });
+
+	CHAT_CHECK(!stages.Run(7, "mallory", message));
+	CHAT_CHECK(numLaterRuns == 0);
+}
\ No newline at end of file
@@ -0,0 +1,200 @@
+#include "ChatTest.h"
+
+#include <algorithm>
+#include <string>
+#include <tuple>
+#include <vector>
+
+#include "ChatConnection.h"
+#include "ChatConstant.h"
+#include "ChatPacket.h"
+#include "ChatPresence.h"
+#include "IdListPacket.h"
+
+
+namespace
+{
+	using EKind = IdListPacket::EKind;
+	using EOperation = IdListPacket::EOperation;
+	using TEntries = std::vector<std::tuple<EKind, EOperation, std::string>>;
+
+	// Every entry of every packet, tagged with its packet's kind; entries within a tick come in no particular order.
+	TEntries Collect(const std::vector<ChatPacket>& packets)
+	{
+		TEntries entries;
+		for (auto& packet : packets)
+		{
+			IdListPacket idList;
+			CHAT_CHECK(packet.Decode(idList));
+
+			idList.ForEach([&entries, &idList](EOperation operation, const std::string& id) { entries.emplace_back(idList.GetKind(), operation, id); });
+		}
+
+		std::sort(entries.begin(), entries.end());
+		return entries;
+	}
+
+	std::string MakeID(size_t length, int index)
+	{
+		auto id = std::to_string(index);
+		id.resize(std::max(length, id.size()), '.');
+
+		return id;
+	}
+}
+
+CHAT_TEST(PresenceReportsJoinsAndLeaves)
+{
+	ChatPresence presence;
+	ChatConnection alice;
+	ChatConnection bob;
+
+	CHAT_CHECK(presence.Join("alice", alice) == 1);
+	CHAT_CHECK(presence.Join("bob", bob) == 1);
+	CHAT_CHECK(presence.HasChanges());
+	CHAT_CHECK(Collect(presence.ExtractDeltas()) == TEntries({ { EKind::Delta, EOperation::Join, "alice" }, { EKind::Delta, EOperation::Join, "bob" } }));
+	CHAT_CHECK(!presence.HasChanges());
+	CHAT_CHECK(presence.ExtractDeltas().empty());
+
+	CHAT_CHECK(presence.Leave("bob", bob) == 0);
+	CHAT_CHECK(Collect(presence.ExtractDeltas()) == TEntries({ { EKind::Delta, EOperation::Leave, "bob" } }));
+	CHAT_CHECK(presence.Find("bob") == nullptr && presence.Find("alice") == &alice);
+	CHAT_CHECK(presence.GetNumOnline() == 1);
+}
+
+CHAT_TEST(PresenceDropsWhatChangedBackWithinATick)
+{
+	ChatPresence presence;
+	ChatConnection alice;
+	ChatConnection bob;
+
+	// Touch keeps the state an ID had when first seen in the tick, so the delta compares against that.
+	presence.Join("alice", alice);
+	presence.Leave("alice", alice);
+
+	presence.Join("bob", bob);
+	presence.ExtractDeltas();
+	presence.Leave("bob", bob);
+	presence.Join("bob", bob);
+
+	CHAT_CHECK(presence.HasChanges());
+	CHAT_CHECK(presence.ExtractDeltas().empty());
+	CHAT_CHECK(presence.Find("alice") == nullptr && presence.Find("bob") == &bob);
+
+	// A second connection under an online ID is no change either.
+	ChatConnection bobAgain;
+	CHAT_CHECK(presence.Join("bob", bobAgain) == 2);
+	CHAT_CHECK(presence.Leave("bob", bob) == 1);
+	CHAT_CHECK(presence.ExtractDeltas().empty());
+	CHAT_CHECK(presence.Find("bob") == &bobAgain);
+
+	// Leaving with a connection that never joined changes nothing.
+	CHAT_CHECK(presence.Leave("bob", alice) == 1);
+	CHAT_CHECK(presence.Leave("carol", alice) == 0);
+	CHAT_CHECK(!presence.HasChanges());
+}
+
+CHAT_TEST(PresenceCountsRemoteIDs)
+{
+	ChatPresence presence;
+	ChatConnection alice;
+
+	// Online on two other nodes: listed, but not found locally.
+	presence.JoinRemote("alice");
+	presence.JoinRemote("alice");
+	CHAT_CHECK(Collect(presence.ExtractDeltas()) == TEntries({ { EKind::Delta, EOperation::Join, "alice" } }));
+	CHAT_CHECK(presence.Find("alice") == nullptr);
+	CHAT_CHECK(presence.GetLocalIDs().empty());
+	CHAT_CHECK(presence.GetNumOnline() == 1);
+
+	// Still online until the last node and the local connection are gone.
+	presence.LeaveRemote("alice");
+	presence.Join("alice", alice);
+	presence.LeaveRemote("alice");
+	CHAT_CHECK(presence.ExtractDeltas().empty());
+	CHAT_CHECK(presence.GetLocalIDs() == std::vector<std::string>({ "alice" }));
+
+	// More remote leaves than joins are ignored.
+	presence.LeaveRemote("alice");
+	CHAT_CHECK(!presence.HasChanges());
+
+	presence.Leave("alice", alice);
+	CHAT_CHECK(Collect(presence.ExtractDeltas()) == TEntries({ { EKind::Delta, EOperation::Leave, "alice" } }));
+	CHAT_CHECK(presence.GetNumOnline() == 0);
+}
+
+CHAT_TEST(PresenceSplitsSnapshotsWhenFull)
+{
+	ChatPresence presence;
+	ChatConnection connection;
+
+	// Full length IDs run out of entry bytes, a few at a time.
+	const int perPacket = IdListPacket::ENTRIES_SIZE / (2 + ChatConstant::ID_LENGTH);
+	const int numIDs = perPacket * 3 + 1;
+
+	for (int i = 0; i < numIDs; ++i)
+	{
+		presence.Join(MakeID(ChatConstant::ID_LENGTH, i), connection);
+	}
+
+	const auto packets = presence.BuildSnapshot();
+	CHAT_CHECK(packets.size() == 4);
+
+	int numEntries = 0;
+	for (size_t i = 0; i < packets.size(); ++i)
+	{
+		IdListPacket idList;
+		CHAT_CHECK(packets[i].Decode(idList));
+		CHAT_CHECK(idList.GetKind() == (i == 0 ? EKind::SnapshotBegin : EKind::Snapshot));
+		CHAT_CHECK(idList.GetCount() == (i + 1 < packets.size() ? perPacket : 1));
+		numEntries += idList.GetCount();
+	}
+
+	CHAT_CHECK(numEntries == numIDs);
+
+	for (auto& entry : Collect(packets))
+	{
+		CHAT_CHECK(std::get<1>(entry) == EOperation::Join && presence.Find(std::get<2>(entry)) == &connection);
+	}
+}
+
+CHAT_TEST(PresenceSplitsSnapshotsOfShortIDs)
+{
+	ChatPresence presence;
+	ChatConnection connection;
+
+	// One byte IDs take three bytes each; the entry bytes still run out before the count would.
+	const int perPacket = IdListPacket::ENTRIES_SIZE / 3;
+	CHAT_CHECK(perPacket < UINT8_MAX);
+
+	for (int i = 0; i < perPacket + 2; ++i)
+	{
+		presence.Join(std::string(1, static_cast<char>(i)), connection);
+	}
+
+	const auto packets = presence.BuildSnapshot();
+	CHAT_CHECK(packets.size() == 2);
+	CHAT_CHECK(Collect(packets).size() == static_cast<size_t>(perPacket) + 2);
+
+	// An empty directory still sends the packet that starts a snapshot.
+	ChatPresence empty;
+	const auto none = empty.BuildSnapshot();
+	CHAT_CHECK(none.size() == 1);
+	CHAT_CHECK(Collect(none).empty());
+}
+
+CHAT_TEST(PresenceSplitsDeltasWhenFull)
+{
+	ChatPresence presence;
+	ChatConnection connection;
+
+	const int perPacket = IdListPacket::ENTRIES_SIZE / (2 + ChatConstant::ID_LENGTH);
+	for (int i = 0; i < perPacket * 2; ++i)
+	{
+		presence.Join(MakeID(ChatConstant::ID_LENGTH, i), connection);
+	}
+
+	const auto packets = presence.ExtractDeltas();
+	CHAT_CHECK(packets.size() == 2);
+	CHAT_CHECK(Collect(packets).size() == static_cast<size_t>(perPacket) * 2);
+}
\ No newline at end of file
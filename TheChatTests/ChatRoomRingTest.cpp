@@ -0,0 +1,76 @@
+#include "ChatTest.h"
+
+#include <cstdint>
+#include <string>
+
+#include "ChatRoomRing.h"
+#include "MessagePacket.h"
+
+
+namespace
+{
+	void Publish(ChatRoomRing& ring, uint64_t count)
+	{
+		for (uint64_t i = 0; i < count; ++i)
+		{
+			MessagePacket message;
+			message.SetMessage(std::to_string(ring.GetHead()));
+			ring.Publish(message, ring.GetHead() + 100);
+		}
+	}
+
+	bool IsEntry(const ChatRoomRing& ring, uint64_t sequence)
+	{
+		auto& entry = ring.At(sequence);
+		return entry.message.GetMessage() == std::to_string(sequence) && entry.senderHandle == sequence + 100;
+	}
+}
+
+CHAT_TEST(RoomRingRoundsCapacityUp)
+{
+	CHAT_CHECK(ChatRoomRing(0).GetCapacity() == 1);
+	CHAT_CHECK(ChatRoomRing(5).GetCapacity() == 8);
+	CHAT_CHECK(ChatRoomRing(8).GetCapacity() == 8);
+}
+
+CHAT_TEST(RoomRingReadsInOrder)
+{
+	ChatRoomRing ring(8);
+	Publish(ring, 5);
+
+	uint64_t cursor = 0;
+	CHAT_CHECK(ring.CatchUp(cursor) == 0 && cursor == 0);
+
+	for (; cursor < ring.GetHead(); ++cursor)
+	{
+		CHAT_CHECK(IsEntry(ring, cursor));
+	}
+
+	CHAT_CHECK(cursor == 5);
+}
+
+CHAT_TEST(RoomRingCatchesUpALappedReader)
+{
+	ChatRoomRing ring(8);
+	uint64_t cursor = 0;
+
+	// A full ring has not lapped anybody yet.
+	Publish(ring, 8);
+	CHAT_CHECK(ring.CatchUp(cursor) == 0 && cursor == 0);
+
+	Publish(ring, 3);
+	CHAT_CHECK(ring.CatchUp(cursor) == 3 && cursor == 3);
+	CHAT_CHECK(IsEntry(ring, cursor));
+
+	// Several laps are skipped at once, to the oldest message left.
+	Publish(ring, 8 * 3 + 1);
+	CHAT_CHECK(ring.CatchUp(cursor) == 8 * 3 + 1 && cursor == ring.GetHead() - 8);
+
+	for (; cursor < ring.GetHead(); ++cursor)
+	{
+		CHAT_CHECK(IsEntry(ring, cursor));
+	}
+
+	// A reader at the head is never behind.
+	CHAT_CHECK(ring.CatchUp(cursor) == 0 && cursor == ring.GetHead());
+}
\ No newline at end of file
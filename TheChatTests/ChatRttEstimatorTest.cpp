@@ -0,0 +1,74 @@
+#include "ChatTest.h"
+
+#include <chrono>
+
+#include "ChatRttEstimator.h"
+
+
+using std::chrono::microseconds;
+
+CHAT_TEST(RttStartsEmpty)
+{
+	ChatRttEstimator rtt;
+	CHAT_CHECK(rtt.GetSmoothedRtt().count() == 0);
+	CHAT_CHECK(rtt.GetVariance().count() == 0);
+	CHAT_CHECK(rtt.GetRetransmitTimeout().count() == 0);
+}
+
+CHAT_TEST(RttFirstSampleSetsBoth)
+{
+	ChatRttEstimator rtt;
+	rtt.AddSample(microseconds(800));
+
+	CHAT_CHECK(rtt.GetSmoothedRtt() == microseconds(800));
+	CHAT_CHECK(rtt.GetVariance() == microseconds(400));
+	CHAT_CHECK(rtt.GetRetransmitTimeout() == microseconds(800 + 4 * 400));
+}
+
+CHAT_TEST(RttSmoothsLaterSamples)
+{
+	ChatRttEstimator rtt;
+	rtt.AddSample(microseconds(800));
+	rtt.AddSample(microseconds(1600));
+
+	// variance = (3 * 400 + |800 - 1600|) / 4, srtt = (7 * 800 + 1600) / 8
+	CHAT_CHECK(rtt.GetVariance() == microseconds(500));
+	CHAT_CHECK(rtt.GetSmoothedRtt() == microseconds(900));
+
+	rtt.AddSample(microseconds(100));
+	CHAT_CHECK(rtt.GetVariance() == microseconds((3 * 500 + 800) / 4));
+	CHAT_CHECK(rtt.GetSmoothedRtt() == microseconds((7 * 900 + 100) / 8));
+}
+
+CHAT_TEST(RttConvergesOnASteadyLink)
+{
+	ChatRttEstimator rtt;
+	rtt.AddSample(microseconds(10000));
+
+	for (int i = 0; i < 100; ++i)
+	{
+		rtt.AddSample(microseconds(2000));
+	}
+
+	CHAT_CHECK(rtt.GetSmoothedRtt() < microseconds(2010));
+	CHAT_CHECK(rtt.GetVariance() < microseconds(10));
+
+	// One spike moves the estimate by an eighth of it and widens the timeout by its deviation.
+	const auto timeout = rtt.GetRetransmitTimeout();
+	rtt.AddSample(microseconds(10000));
+
+	CHAT_CHECK(rtt.GetSmoothedRtt() > microseconds(2900) && rtt.GetSmoothedRtt() < microseconds(3100));
+	CHAT_CHECK(rtt.GetRetransmitTimeout() > timeout + microseconds(7000));
+}
+
+CHAT_TEST(RttCountsZeroSamples)
+{
+	// A loopback round trip can measure zero; it still counts as a sample.
+	ChatRttEstimator rtt;
+	rtt.AddSample(microseconds(0));
+
+	CHAT_CHECK(rtt.GetSmoothedRtt() == microseconds(1));
+
+	rtt.AddSample(microseconds(0));
+	CHAT_CHECK(rtt.GetSmoothedRtt() == microseconds(1));
+}
\ No newline at end of file
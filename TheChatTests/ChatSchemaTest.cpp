@@ -0,0 +1,135 @@
+#include "ChatTest.h"
+
+#include <cstdint>
+#include <cstring>
+
+#include "ChatPacket.h"
+#include "ChatSchema.h"
+#include "ChatTableID.h"
+#include "GreetingsPacket.h"
+
+
+namespace
+{
+	struct Sample
+	{
+		static constexpr auto GetFields() { return ChatSchema::Fields(&Sample::number, &Sample::name, &Sample::tableId, &Sample::blob); }
+
+		uint32_t number = 0;
+		ChatSchema::String<4> name;
+		EChatTableID tableId = EChatTableID::HEARTBEAT;
+		ChatSchema::Bytes<3> blob;
+	};
+
+	static_assert(ChatSchema::MaxSize<Sample>() == 4 + (1 + 4) + sizeof(EChatTableID) + (2 + 3));
+
+	Sample MakeSample()
+	{
+		Sample sample;
+		sample.number = 0x11223344;
+		sample.name.Assign("abc");
+		sample.tableId = EChatTableID::MESSAGE_TABLE;
+		sample.blob.data[0] = 7;
+		sample.blob.length = 1;
+
+		return sample;
+	}
+}
+
+CHAT_TEST(SchemaEncodesLittleEndianWithoutPadding)
+{
+	uint8_t bytes[ChatSchema::MaxSize<Sample>()] = {};
+	const auto length = ChatSchema::Encode(MakeSample(), bytes);
+
+	CHAT_CHECK(length == 4 + (1 + 3) + sizeof(EChatTableID) + (2 + 1));
+	CHAT_CHECK(bytes[0] == 0x44 && bytes[1] == 0x33 && bytes[2] == 0x22 && bytes[3] == 0x11);
+	CHAT_CHECK(bytes[4] == 3 && memcmp(bytes + 5, "abc", 3) == 0);
+
+	const auto blob = 8 + sizeof(EChatTableID);
+	CHAT_CHECK(bytes[blob] == 1 && bytes[blob + 1] == 0 && bytes[blob + 2] == 7);
+}
+
+CHAT_TEST(SchemaRoundTrip)
+{
+	uint8_t bytes[ChatSchema::MaxSize<Sample>()] = {};
+	const auto length = ChatSchema::Encode(MakeSample(), bytes);
+
+	Sample decoded;
+	CHAT_CHECK(ChatSchema::Decode(decoded, bytes, length));
+	CHAT_CHECK(decoded.number == 0x11223344);
+	CHAT_CHECK(decoded.name.View() == "abc" && decoded.name.c_str()[3] == '\0');
+	CHAT_CHECK(decoded.tableId == EChatTableID::MESSAGE_TABLE);
+	CHAT_CHECK(decoded.blob.length == 1 && decoded.blob.data[0] == 7);
+}
+
+CHAT_TEST(SchemaRejectsTruncatedInput)
+{
+	uint8_t bytes[ChatSchema::MaxSize<Sample>()] = {};
+	const auto length = ChatSchema::Encode(MakeSample(), bytes);
+
+	// Every prefix of the encoding misses part of a field.
+	for (size_t i = 0; i < length; ++i)
+	{
+		Sample decoded;
+		CHAT_CHECK(!ChatSchema::Decode(decoded, bytes, i));
+	}
+}
+
+CHAT_TEST(SchemaRejectsOversizedLengths)
+{
+	uint8_t bytes[ChatSchema::MaxSize<Sample>()] = {};
+	const auto length = ChatSchema::Encode(MakeSample(), bytes);
+
+	// A string longer than its capacity fails there and leaves the fields after it untouched.
+	bytes[4] = 5;
+
+	Sample decoded;
+	decoded.tableId = EChatTableID::PING_TABLE;
+	CHAT_CHECK(!ChatSchema::Decode(decoded, bytes, sizeof(bytes)));
+	CHAT_CHECK(decoded.number == 0x11223344);
+	CHAT_CHECK(decoded.name.length == 0);
+	CHAT_CHECK(decoded.tableId == EChatTableID::PING_TABLE);
+
+	// So does a blob longer than its capacity.
+	bytes[4] = 3;
+	bytes[8 + sizeof(EChatTableID)] = 4;
+	CHAT_CHECK(!ChatSchema::Decode(decoded, bytes, length));
+}
+
+CHAT_TEST(SchemaStringAssignTruncates)
+{
+	ChatSchema::String<4> name;
+	CHAT_CHECK(name.Assign("abcdef") == 4);
+	CHAT_CHECK(name.View() == "abcd" && name.c_str()[4] == '\0');
+}
+
+CHAT_TEST(PacketRoundTrip)
+{
+	GreetingsPacket greetings("alice", 42, 0x0123456789abcdefull, true);
+	const auto packet = ChatPacket::Encode(greetings);
+
+	uint8_t bytes[ChatPacket::PAYLOAD_SIZE] = {};
+	CHAT_CHECK(packet.header.tableId == EChatTableID::GREETINGS_TABLE);
+	CHAT_CHECK(packet.header.payloadLength == ChatSchema::Encode(greetings, bytes));
+	CHAT_CHECK(packet.GetWireSize() == sizeof(ChatPacket::Header) + packet.header.payloadLength);
+
+	GreetingsPacket decoded;
+	CHAT_CHECK(packet.Decode(decoded));
+	CHAT_CHECK(decoded.senderId.View() == "alice");
+	CHAT_CHECK(decoded.GetLastReceivedSequence() == 42);
+	CHAT_CHECK(decoded.GetSessionToken() == 0x0123456789abcdefull);
+	CHAT_CHECK(decoded.IsResumed());
+}
+
+CHAT_TEST(PacketRejectsMalformedFrames)
+{
+	auto packet = ChatPacket::Encode(GreetingsPacket("alice", 42, 1, false));
+	GreetingsPacket decoded;
+
+	// A payload length beyond the payload, or short of the fields, is dropped.
+	packet.header.payloadLength = ChatPacket::PAYLOAD_SIZE + 1;
+	CHAT_CHECK(!packet.Decode(decoded));
+
+	packet.header.payloadLength = 3;
+	CHAT_CHECK(!packet.Decode(decoded));
+}
\ No newline at end of file
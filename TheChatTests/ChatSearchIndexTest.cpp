@@ -0,0 +1,223 @@
+#include "ChatTest.h"
+
+#include <algorithm>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "ChatHistory.h"
+#include "ChatSearchIndex.h"
+
+
+namespace
+{
+	// Eight sealed segments, enough for one merge, and a partly filled active segment on top.
+	constexpr uint32_t NUM_SEALED_DOCS = ChatSearchIndex::SEGMENT_SIZE * ChatSearchIndex::MERGE_FACTOR;
+	constexpr uint32_t NUM_ACTIVE_DOCS = 1000;
+
+	// Gaps of 300 take two varint bytes; "hay" fills blocks densely.
+	std::string MakeText(uint32_t doc)
+	{
+		std::string text = doc % 300 == 0 ? "Needle, " : "";
+		text += doc % 7 == 0 ? "hay" : "a";
+
+		return text;
+	}
+
+	struct SearchFixture
+	{
+		ChatHistory history;
+		ChatSearchIndex index;
+
+		SearchFixture()
+		{
+			for (uint32_t i = 0; i < NUM_SEALED_DOCS + NUM_ACTIVE_DOCS; ++i)
+			{
+				const auto doc = history.Append(i % 3 == 0 ? "Alice" : "bob", MakeText(i));
+				index.Add(doc, history.GetSender(doc), history.GetText(doc));
+			}
+		}
+
+		// Every matching message, newest first, by tokenizing the whole history.
+		std::vector<uint32_t> SearchNaive(const std::string& text, const std::string& sender, size_t maxResults) const
+		{
+			std::vector<std::string> terms;
+			ChatSearchIndex::Tokenize(text, [&terms](const std::string& term) { terms.push_back(term); });
+
+			std::vector<uint32_t> results;
+			for (uint32_t doc = history.GetNumMessages(); doc-- > 0 && results.size() < maxResults;)
+			{
+				std::vector<std::string> docTerms;
+				ChatSearchIndex::Tokenize(history.GetText(doc), [&docTerms](const std::string& term) { docTerms.push_back(term); });
+
+				bool isMatch = sender.empty() || ChatSearchIndex::MakeQuery("", sender, 1).keys == ChatSearchIndex::MakeQuery("", history.GetSender(doc), 1).keys;
+				for (auto& term : terms)
+				{
+					isMatch = isMatch && std::find(docTerms.begin(), docTerms.end(), term) != docTerms.end();
+				}
+
+				if (isMatch)
+				{
+					results.push_back(doc);
+				}
+			}
+
+			return results;
+		}
+
+		bool IsSameAsNaive(const std::string& text, const std::string& sender, size_t maxResults) const
+		{
+			const auto results = index.Search(ChatSearchIndex::MakeQuery(text, sender, maxResults));
+			return !results.empty() && results == SearchNaive(text, sender, maxResults);
+		}
+	};
+
+	const SearchFixture& GetFixture()
+	{
+		static const SearchFixture fixture;
+		return fixture;
+	}
+}
+
+CHAT_TEST(HistoryStoresMessagesInOrder)
+{
+	ChatHistory history;
+	CHAT_CHECK(history.Append("alice", "first") == 0);
+	CHAT_CHECK(history.Append("", "") == 1);
+	CHAT_CHECK(history.Append("bob", std::string(300, 'x')) == 2);
+
+	CHAT_CHECK(history.GetNumMessages() == 3);
+	CHAT_CHECK(history.GetSender(0) == "alice" && history.GetText(0) == "first");
+	CHAT_CHECK(history.GetSender(1).empty() && history.GetText(1).empty());
+	CHAT_CHECK(history.GetSender(2) == "bob" && history.GetText(2) == std::string(UINT8_MAX, 'x'));
+	CHAT_CHECK(history.GetSender(3).empty() && history.GetText(3).empty());
+}
+
+CHAT_TEST(SearchIndexSealsEverySegmentSize)
+{
+	auto& fixture = GetFixture();
+	CHAT_CHECK(fixture.index.GetNumSegments() == ChatSearchIndex::MERGE_FACTOR);
+	CHAT_CHECK(fixture.history.GetNumMessages() == NUM_SEALED_DOCS + NUM_ACTIVE_DOCS);
+}
+
+CHAT_TEST(SearchIndexFindsNewestFirst)
+{
+	auto& fixture = GetFixture();
+
+	// Matches in the active segment and in every sealed one.
+	CHAT_CHECK(fixture.IsSameAsNaive("needle", "", 5000));
+	// Driven by the needles, probing dense "hay" and sender lists across blocks.
+	CHAT_CHECK(fixture.IsSameAsNaive("hay NEEDLE", "alice", 5000));
+	CHAT_CHECK(fixture.IsSameAsNaive("", "Bob", 500));
+	CHAT_CHECK(fixture.index.Search(ChatSearchIndex::MakeQuery("needle", "carol", 10)).empty());
+	CHAT_CHECK(fixture.index.Search(ChatSearchIndex::MakeQuery("needle straw", "", 10)).empty());
+}
+
+CHAT_TEST(SearchIndexStopsAtMaxResults)
+{
+	auto& fixture = GetFixture();
+	const auto all = fixture.index.Search(ChatSearchIndex::MakeQuery("needle", "", 5000));
+
+	for (size_t maxResults : { 1, 5, 100 })
+	{
+		const auto results = fixture.index.Search(ChatSearchIndex::MakeQuery("needle", "", maxResults));
+		CHAT_CHECK(results.size() == maxResults);
+		CHAT_CHECK(std::equal(results.begin(), results.end(), all.begin()));
+	}
+
+	// Stops at the end of the active segment, right after it, and several sealed segments further.
+	CHAT_CHECK(fixture.IsSameAsNaive("needle", "", NUM_ACTIVE_DOCS / 300));
+	CHAT_CHECK(fixture.IsSameAsNaive("needle", "", NUM_ACTIVE_DOCS / 300 + 1));
+	CHAT_CHECK(fixture.IsSameAsNaive("hay", "", ChatSearchIndex::SEGMENT_SIZE));
+	CHAT_CHECK(fixture.index.Search(ChatSearchIndex::MakeQuery("needle", "", 0)).empty());
+}
+
+CHAT_TEST(SearchIndexMergeKeepsResults)
+{
+	auto& fixture = GetFixture();
+	auto index = fixture.index;
+
+	const std::vector<ChatSearchIndex::Query> queries = {
+		ChatSearchIndex::MakeQuery("needle", "", 5000),
+		ChatSearchIndex::MakeQuery("hay needle", "alice", 5000),
+		ChatSearchIndex::MakeQuery("", "bob", 500),
+	};
+
+	std::vector<std::vector<uint32_t>> before;
+	for (auto& query : queries)
+	{
+		before.push_back(index.Search(query));
+	}
+
+	ChatSearchIndex::TSegments inputs;
+	CHAT_CHECK(index.PlanMerge(inputs));
+	CHAT_CHECK(inputs.size() == ChatSearchIndex::MERGE_FACTOR);
+
+	const auto merged = ChatSearchIndex::Merge(inputs);
+	CHAT_CHECK(merged->numDocs == NUM_SEALED_DOCS);
+
+	const auto numBytes = index.GetNumBytes();
+	index.CompleteMerge(inputs, merged);
+	CHAT_CHECK(index.GetNumSegments() == 1);
+	CHAT_CHECK(index.GetNumBytes() <= numBytes);
+
+	for (size_t i = 0; i < queries.size(); ++i)
+	{
+		CHAT_CHECK(index.Search(queries[i]) == before[i]);
+	}
+
+	// One segment is left, so there is nothing to merge; completing the same merge again changes nothing.
+	CHAT_CHECK(!index.PlanMerge(inputs));
+	index.CompleteMerge(inputs, merged);
+	CHAT_CHECK(index.GetNumSegments() == 1);
+}
+
+CHAT_TEST(SearchIndexProbesAcrossBlocks)
+{
+	constexpr uint32_t NUM_DOCS = ChatSearchIndex::BLOCK_SIZE * 2 + 44;
+
+	// "aa" spans three blocks of two-byte deltas; "bb" holds both edges of each block and docs "aa" lacks.
+	std::vector<uint32_t> aa;
+	for (uint32_t i = 0; i < NUM_DOCS; ++i)
+	{
+		aa.push_back(1000 + i * 200);
+	}
+
+	std::vector<uint32_t> bb = { 1 };
+	std::vector<uint32_t> expected;
+	for (uint32_t i = 0; i < NUM_DOCS; ++i)
+	{
+		const bool isEdge = i % ChatSearchIndex::BLOCK_SIZE == 0 || i % ChatSearchIndex::BLOCK_SIZE == ChatSearchIndex::BLOCK_SIZE - 1 || i == NUM_DOCS - 1;
+		if (isEdge)
+		{
+			bb.push_back(aa[i]);
+			expected.insert(expected.begin(), aa[i]);
+		}
+
+		bb.push_back(aa[i] + 1);
+	}
+
+	auto segment = std::make_shared<ChatSearchIndex::Segment>();
+	segment->Append("aa", aa);
+	segment->Append("bb", bb);
+	CHAT_CHECK(segment->blocks.size() == 3 + (bb.size() + ChatSearchIndex::BLOCK_SIZE - 1) / ChatSearchIndex::BLOCK_SIZE);
+
+	std::vector<uint32_t> decoded;
+	std::vector<uint32_t> docs;
+	for (uint32_t block = 0; block < 3; ++block)
+	{
+		segment->DecodeBlock(*segment->Find("aa"), block, decoded);
+		docs.insert(docs.end(), decoded.begin(), decoded.end());
+	}
+
+	CHAT_CHECK(docs == aa);
+
+	ChatSearchIndex::Snapshot snapshot;
+	snapshot.segments.push_back(segment);
+
+	ChatSearchIndex::Query query;
+	query.keys = { "aa", "bb" };
+	query.maxResults = NUM_DOCS;
+	CHAT_CHECK(ChatSearchIndex::Search(snapshot, query) == expected);
+}
\ No newline at end of file
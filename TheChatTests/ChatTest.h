@@ -0,0 +1,34 @@
+#pragma once
+
+#include <vector>
+
+
+// Self-registering test cases for the parts that need no network. CHAT_TEST(Name) defines a case and
+// CHAT_CHECK(condition) reports a failed condition and carries on. Main runs every case and exits non-zero
+// if any check failed.
+namespace ChatTest
+{
+	struct Case
+	{
+		const char* name;
+		void (*func)();
+	};
+
+	std::vector<Case>& GetCases();
+	void Fail(const char* file, int line, const char* condition);
+
+	struct Registrar
+	{
+		Registrar(const char* name, void (*func)())
+		{
+			GetCases().push_back({ name, func });
+		}
+	};
+}
+
+#define CHAT_TEST(name) \
+	static void name(); \
+	static ChatTest::Registrar name##Registrar(#name, &name); \
+	static void name()
+
+#define CHAT_CHECK(condition) do { if (!(condition)) ChatTest::Fail(__FILE__, __LINE__, #condition); } while (false)
\ No newline at end of file
@@ -0,0 +1,129 @@
+#include "ChatTest.h"
+
+#include <atomic>
+#include <cstdint>
+#include <thread>
+#include <vector>
+
+#include "ChatTraceRing.h"
+
+
+namespace
+{
+	const char* const NAMES[] = { "receive", "fan-out", "send" };
+
+	// Every field follows from the span number, so a torn copy cannot pass for a whole one.
+	ChatTraceRing::Span MakeSpan(uint64_t number)
+	{
+		const auto time = static_cast<int64_t>(number) * 10;
+		return { NAMES[number % 3], static_cast<uint32_t>(number + 1), time, time + static_cast<int64_t>(number % 7) };
+	}
+
+	bool IsWhole(const ChatTraceRing::Span& span)
+	{
+		const auto expected = MakeSpan(span.traceId - 1);
+		return span.traceId != 0 && span.name == expected.name && span.startTime == expected.startTime && span.endTime == expected.endTime;
+	}
+
+	bool IsRun(const std::vector<ChatTraceRing::Span>& spans, uint64_t first, uint64_t count)
+	{
+		if (spans.size() != count)
+			return false;
+
+		for (uint64_t i = 0; i < count; ++i)
+		{
+			if (spans[i].traceId != first + i + 1 || !IsWhole(spans[i]))
+				return false;
+		}
+
+		return true;
+	}
+}
+
+CHAT_TEST(TraceRingRoundsCapacityUp)
+{
+	CHAT_CHECK(ChatTraceRing(0).GetCapacity() == 1);
+	CHAT_CHECK(ChatTraceRing(5).GetCapacity() == 8);
+	CHAT_CHECK(ChatTraceRing(8).GetCapacity() == 8);
+}
+
+CHAT_TEST(TraceRingCopiesOldestFirst)
+{
+	ChatTraceRing ring(8);
+	CHAT_CHECK(ring.Copy().empty());
+
+	for (uint64_t i = 0; i < 5; ++i)
+	{
+		ring.Push(MakeSpan(i));
+	}
+
+	CHAT_CHECK(IsRun(ring.Copy(), 0, 5));
+}
+
+CHAT_TEST(TraceRingKeepsTheLastLap)
+{
+	ChatTraceRing ring(8);
+
+	// A full ring, then one and a half laps over it: only the newest capacity spans are left.
+	for (uint64_t i = 0; i < 8; ++i)
+	{
+		ring.Push(MakeSpan(i));
+	}
+
+	CHAT_CHECK(IsRun(ring.Copy(), 0, 8));
+
+	for (uint64_t i = 8; i < 20; ++i)
+	{
+		ring.Push(MakeSpan(i));
+	}
+
+	CHAT_CHECK(ring.GetNumPushed() == 20);
+	CHAT_CHECK(IsRun(ring.Copy(), 12, 8));
+}
+
+CHAT_TEST(TraceRingDropsWhatTheWriterLaps)
+{
+	// A ring of four slots the writer keeps lapping while it is copied; every span that comes out must be whole and in order.
+	ChatTraceRing ring(4);
+	std::atomic<bool> isDone{ false };
+
+	std::thread writer([&ring, &isDone]()
+		{
+			for (uint64_t i = 0; i < 20000; ++i)
+			{
+				ring.Push(MakeSpan(i));
+
+				// Pauses now and then so the reader also gets to copy spans nobody is writing.
+				if (i % 64 == 0)
+				{
+					std::this_thread::yield();
+				}
+			}
+
+			isDone = true;
+		});
+
+	size_t numSpans = 0;
+	bool isIntact = true;
+
+	do
+	{
+		const auto spans = ring.Copy();
+
+		for (size_t i = 0; i < spans.size(); ++i)
+		{
+			isIntact = isIntact && IsWhole(spans[i]) && (i == 0 || spans[i].traceId > spans[i - 1].traceId);
+		}
+
+		numSpans += spans.size();
+	} while (!isDone.load());
+
+	writer.join();
+
+	CHAT_CHECK(isIntact);
+	CHAT_CHECK(numSpans > 0);
+
+	// Once the writer stopped, the whole last lap is intact again.
+	const auto pushed = ring.GetNumPushed();
+	CHAT_CHECK(IsRun(ring.Copy(), pushed - ring.GetCapacity(), ring.GetCapacity()));
+}
\ No newline at end of file
@@ -0,0 +1,107 @@
+#include "ChatTest.h"
+
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "ChatConstant.h"
+#include "ChatPacket.h"
+#include "IdListPacket.h"
+
+
+namespace
+{
+	using EOperation = IdListPacket::EOperation;
+	using TEntries = std::vector<std::pair<EOperation, std::string>>;
+
+	TEntries Collect(const IdListPacket& idList)
+	{
+		TEntries entries;
+		idList.ForEach([&entries](EOperation operation, const std::string& id) { entries.emplace_back(operation, id); });
+
+		return entries;
+	}
+}
+
+CHAT_TEST(IdListRoundTrip)
+{
+	IdListPacket idList(IdListPacket::EKind::SnapshotBegin);
+	CHAT_CHECK(idList.Add(EOperation::Join, "alice"));
+	CHAT_CHECK(idList.Add(EOperation::Leave, ""));
+	CHAT_CHECK(idList.Add(EOperation::Join, std::string(ChatConstant::ID_LENGTH + 5, 'z')));
+
+	IdListPacket decoded;
+	CHAT_CHECK(ChatPacket::Encode(idList).Decode(decoded));
+	CHAT_CHECK(decoded.GetKind() == IdListPacket::EKind::SnapshotBegin);
+	CHAT_CHECK(decoded.GetCount() == 3);
+	CHAT_CHECK(Collect(decoded) == TEntries({ { EOperation::Join, "alice" }, { EOperation::Leave, "" },
+		{ EOperation::Join, std::string(ChatConstant::ID_LENGTH, 'z') } }));
+}
+
+CHAT_TEST(IdListAddStopsWhenFull)
+{
+	IdListPacket idList;
+	const std::string id(ChatConstant::ID_LENGTH, 'i');
+
+	int numAdded = 0;
+	while (idList.Add(EOperation::Join, id))
+	{
+		++numAdded;
+	}
+
+	const int entrySize = 2 + ChatConstant::ID_LENGTH;
+	CHAT_CHECK(numAdded == IdListPacket::ENTRIES_SIZE / entrySize);
+	CHAT_CHECK(idList.entries.length == numAdded * entrySize);
+	CHAT_CHECK(Collect(idList).size() == static_cast<size_t>(numAdded));
+}
+
+CHAT_TEST(IdListAddStopsAtTheCountLimit)
+{
+	// Even empty IDs fill the bytes first, so the count limit only guards a count set by hand.
+	static_assert(IdListPacket::ENTRIES_SIZE / 2 < UINT8_MAX, "IdListPacket entries outgrow its count.");
+
+	IdListPacket idList;
+	idList.count = UINT8_MAX;
+	CHAT_CHECK(!idList.Add(EOperation::Join, ""));
+	CHAT_CHECK(idList.entries.length == 0);
+}
+
+CHAT_TEST(IdListForEachStopsAtTheEntries)
+{
+	IdListPacket idList;
+	idList.Add(EOperation::Join, "one");
+	idList.Add(EOperation::Leave, "two");
+
+	const TEntries first = { { EOperation::Join, "one" } };
+
+	// A count beyond the entries present stops at their end.
+	idList.count = 200;
+	CHAT_CHECK(Collect(idList) == TEntries({ { EOperation::Join, "one" }, { EOperation::Leave, "two" } }));
+
+	// So does an ID running past the end, or an entry cut short before its length byte.
+	idList.entries.data[5 + 1] = 50;
+	CHAT_CHECK(Collect(idList) == first);
+
+	idList.entries.length = 5 + 1;
+	CHAT_CHECK(Collect(idList) == first);
+
+	// A length beyond the capacity is clamped to it.
+	idList.entries.length = UINT16_MAX;
+	idList.count = 1;
+	CHAT_CHECK(Collect(idList) == first);
+}
+
+CHAT_TEST(IdListRejectsOversizedEntries)
+{
+	IdListPacket idList;
+	idList.Add(EOperation::Join, "one");
+
+	auto packet = ChatPacket::Encode(idList);
+
+	// [kind][count][16-bit entries length]: a length beyond ENTRIES_SIZE is malformed.
+	packet.payload[2] = 0xff;
+	packet.payload[3] = 0xff;
+
+	IdListPacket decoded;
+	CHAT_CHECK(!packet.Decode(decoded));
+}
\ No newline at end of file
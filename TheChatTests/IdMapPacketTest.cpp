@@ -0,0 +1,89 @@
+#include "ChatTest.h"
+
+#include <cstdint>
+#include <string>
+
+#include "ChatConstant.h"
+#include "ChatIdTable.h"
+#include "IdMapPacket.h"
+#include "PackedEntriesTest.h"
+
+
+using PackedEntriesTest::TEntries;
+
+CHAT_TEST(IdMapRoundTrip)
+{
+	PackedEntriesTest::CheckRoundTrip<IdMapPacket>({ { 1, "alice" }, { 1 << 20, "bob" }, { UINT32_MAX, "carol" } });
+}
+
+CHAT_TEST(IdMapMapsNumbersBackToIDs)
+{
+	// What a connection announces: interned IDs under their numbers, which the receiver keys its table by.
+	IdMapPacket idMap;
+	for (auto id : { "IdMapMapsNumbersBackToIDs-1", "IdMapMapsNumbersBackToIDs-2", "IdMapMapsNumbersBackToIDs-3" })
+	{
+		CHAT_CHECK(idMap.Add(ChatIdTable::GetNumber(id), id));
+	}
+
+	IdMapPacket decoded;
+	CHAT_CHECK(ChatPacket::Encode(idMap).Decode(decoded));
+
+	size_t numMapped = 0;
+	decoded.ForEach([&numMapped](uint32_t number, const std::string& id)
+		{
+			auto interned = ChatIdTable::Find(number);
+			CHAT_CHECK(interned != nullptr && *interned == id);
+			CHAT_CHECK(ChatIdTable::GetNumber(id) == number);
+			++numMapped;
+		});
+
+	CHAT_CHECK(numMapped == 3);
+}
+
+CHAT_TEST(IdMapCarriesReservedNumbers)
+{
+	// The packet has no numbers of its own to reserve; Server and Unknown go through like any other entry.
+	const auto unknownNumber = ChatIdTable::GetNumber(ChatIdTable::Unknown());
+	CHAT_CHECK(unknownNumber != ChatIdTable::SERVER_NUMBER);
+
+	PackedEntriesTest::CheckRoundTrip<IdMapPacket>({
+		{ ChatIdTable::SERVER_NUMBER, ChatIdTable::SERVER_ID },
+		{ unknownNumber, ChatIdTable::Unknown() },
+	});
+}
+
+CHAT_TEST(IdMapTakesAZeroLengthID)
+{
+	// Five bytes of number and length, and the next entry right after them.
+	IdMapPacket idMap;
+	CHAT_CHECK(idMap.Add(5, ""));
+	CHAT_CHECK(idMap.entries.length == PackedEntriesTest::NUMBER_SIZE + 1);
+
+	PackedEntriesTest::CheckRoundTrip<IdMapPacket>({ { 5, "" }, { 6, "f" }, { 7, "" } });
+
+	IdMapPacket full;
+	PackedEntriesTest::Fill(full, 0);
+}
+
+CHAT_TEST(IdMapTruncatesLongIDs)
+{
+	IdMapPacket idMap;
+	CHAT_CHECK(idMap.Add(7, std::string(ChatConstant::ID_LENGTH + 10, 'z')));
+	CHAT_CHECK(PackedEntriesTest::Collect(idMap) == TEntries({ { 7, std::string(ChatConstant::ID_LENGTH, 'z') } }));
+}
+
+CHAT_TEST(IdMapAddStopsWhenFull)
+{
+	IdMapPacket idMap;
+	PackedEntriesTest::Fill(idMap, ChatConstant::ID_LENGTH);
+}
+
+CHAT_TEST(IdMapForEachStopsAtTheEntries)
+{
+	PackedEntriesTest::CheckForEachStopsAtTheEntries<IdMapPacket>();
+}
+
+CHAT_TEST(IdMapRejectsOversizedEntries)
+{
+	PackedEntriesTest::CheckRejectsOversizedEntries<IdMapPacket>();
+}
\ No newline at end of file
@@ -0,0 +1,55 @@
+// Copyleft.
+
+#include "ChatTest.h"
+
+#include <exception>
+#include <iostream>
+
+
+namespace
+{
+	int numFailedChecks = 0;
+}
+
+std::vector<ChatTest::Case>& ChatTest::GetCases()
+{
+	static std::vector<Case> cases;
+	return cases;
+}
+
+void ChatTest::Fail(const char* file, int line, const char* condition)
+{
+	++numFailedChecks;
+	std::cerr << "[ChatTest] " << file << '(' << line << "): failed " << condition << std::endl;
+}
+
+// > TheChatTests
+int main()
+{
+	using namespace std;
+
+	const auto& cases = ChatTest::GetCases();
+	size_t numFailedCases = 0;
+
+	for (auto& testCase : cases)
+	{
+		const int numFailedBefore = numFailedChecks;
+
+		try
+		{
+			testCase.func();
+		}
+		catch (const exception& e)
+		{
+			ChatTest::Fail(testCase.name, 0, e.what());
+		}
+
+		const bool isPassed = numFailedChecks == numFailedBefore;
+		numFailedCases += isPassed ? 0 : 1;
+
+		cout << "[ChatTest] " << (isPassed ? "passed " : "FAILED ") << testCase.name << endl;
+	}
+
+	cout << "[ChatTest] " << (cases.size() - numFailedCases) << '/' << cases.size() << " passed" << endl;
+	return numFailedCases == 0 ? 0 : 1;
+}
\ No newline at end of file
@@ -0,0 +1,44 @@
+#include "ChatTest.h"
+
+#include <string>
+
+#include "MessageBatchPacket.h"
+#include "PackedEntriesTest.h"
+
+
+using PackedEntriesTest::TEntries;
+
+CHAT_TEST(MessageBatchRoundTrip)
+{
+	PackedEntriesTest::CheckRoundTrip<MessageBatchPacket>({ { 3, "hello" }, { 70000, "" }, { 5, "world" } });
+}
+
+CHAT_TEST(MessageBatchAddStopsWhenFull)
+{
+	MessageBatchPacket batch;
+	const int numAdded = PackedEntriesTest::Fill(batch, 100);
+
+	// A shorter message still fits in what a long one left over.
+	CHAT_CHECK(batch.Add(0, "short"));
+	CHAT_CHECK(PackedEntriesTest::Collect(batch).size() == static_cast<size_t>(numAdded) + 1);
+}
+
+CHAT_TEST(MessageBatchRefusesWhatDoesNotFit)
+{
+	MessageBatchPacket batch;
+	CHAT_CHECK(batch.Add(1, "one"));
+	CHAT_CHECK(!batch.Add(2, std::string(MessageBatchPacket::ENTRIES_SIZE, 'y')));
+
+	CHAT_CHECK(batch.GetCount() == 1);
+	CHAT_CHECK(PackedEntriesTest::Collect(batch) == TEntries({ { 1, "one" } }));
+}
+
+CHAT_TEST(MessageBatchForEachStopsAtTheEntries)
+{
+	PackedEntriesTest::CheckForEachStopsAtTheEntries<MessageBatchPacket>();
+}
+
+CHAT_TEST(MessageBatchRejectsOversizedEntries)
+{
+	PackedEntriesTest::CheckRejectsOversizedEntries<MessageBatchPacket>();
+}
\ No newline at end of file
@@ -0,0 +1,110 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "ChatPacket.h"
+#include "ChatTest.h"
+
+
+// Checks shared by the packets that pack [number][length][bytes] entries into one frame, IdMapPacket and
+// MessageBatchPacket. Each packet's own test runs them and adds what is particular to it.
+namespace PackedEntriesTest
+{
+	constexpr int NUMBER_SIZE = sizeof(uint32_t);
+
+	using TEntries = std::vector<std::pair<uint32_t, std::string>>;
+
+	template <typename TPacket>
+	TEntries Collect(const TPacket& packet)
+	{
+		TEntries entries;
+		packet.ForEach([&entries](uint32_t number, const std::string& bytes) { entries.emplace_back(number, bytes); });
+
+		return entries;
+	}
+
+	// Adds the entries, sends them through a frame and expects them back in order, in fewer bytes than a full frame.
+	template <typename TPacket>
+	void CheckRoundTrip(const TEntries& entries)
+	{
+		TPacket packet;
+		for (auto& entry : entries)
+		{
+			CHAT_CHECK(packet.Add(entry.first, entry.second));
+		}
+
+		const auto frame = ChatPacket::Encode(packet);
+		CHAT_CHECK(frame.GetWireSize() < sizeof(ChatPacket::Header) + ChatPacket::PAYLOAD_SIZE);
+
+		TPacket decoded;
+		CHAT_CHECK(frame.Decode(decoded));
+		CHAT_CHECK(decoded.GetCount() == entries.size());
+		CHAT_CHECK(Collect(decoded) == entries);
+	}
+
+	// Adds entries of the given length until one is refused; returns how many went in.
+	template <typename TPacket>
+	int Fill(TPacket& packet, size_t length)
+	{
+		const std::string bytes(length, 'x');
+
+		int numAdded = 0;
+		while (packet.Add(numAdded, bytes))
+		{
+			++numAdded;
+		}
+
+		const int entrySize = NUMBER_SIZE + 1 + static_cast<int>(length);
+		CHAT_CHECK(numAdded == TPacket::ENTRIES_SIZE / entrySize);
+		CHAT_CHECK(packet.GetCount() == numAdded);
+		CHAT_CHECK(packet.entries.length == numAdded * entrySize);
+		CHAT_CHECK(Collect(packet).size() == static_cast<size_t>(numAdded));
+
+		return numAdded;
+	}
+
+	template <typename TPacket>
+	void CheckForEachStopsAtTheEntries()
+	{
+		TPacket packet;
+		packet.Add(1, "one");
+		packet.Add(2, "two");
+
+		const int entrySize = NUMBER_SIZE + 1 + 3;
+
+		// A count beyond the entries present stops at their end.
+		packet.count = 200;
+		CHAT_CHECK(Collect(packet) == TEntries({ { 1, "one" }, { 2, "two" } }));
+
+		// So does an entry whose bytes run past the end, or whose number is cut short.
+		packet.entries.data[entrySize + NUMBER_SIZE] = 50;
+		CHAT_CHECK(Collect(packet) == TEntries({ { 1, "one" } }));
+
+		packet.entries.length = entrySize + 2;
+		CHAT_CHECK(Collect(packet) == TEntries({ { 1, "one" } }));
+
+		// A length beyond the capacity is clamped to it.
+		packet.entries.length = UINT16_MAX;
+		packet.count = 1;
+		CHAT_CHECK(Collect(packet) == TEntries({ { 1, "one" } }));
+	}
+
+	template <typename TPacket>
+	void CheckRejectsOversizedEntries()
+	{
+		TPacket packet;
+		packet.Add(1, "one");
+
+		auto frame = ChatPacket::Encode(packet);
+
+		// [count][16-bit entries length]: a length beyond ENTRIES_SIZE is malformed.
+		frame.payload[1] = 0xff;
+		frame.payload[2] = 0xff;
+
+		TPacket decoded;
+		CHAT_CHECK(!frame.Decode(decoded));
+	}
+}
\ No newline at end of file